@@ -1,1018 +1,1870 @@
-/****************************************************************************
-                  (ENSC488 - PHANTOM Haptic Device Sample Code)
-
-Module Name: main.cpp
-
-Original Author: SensAble Technologies (c) 2004
-
-Modified and Commented by:  Wayne Chen (waynec@sfu.ca)
-
-Last Update: 09/24/2004
-
-Description:
-
-  This sample code introduces the use of basic Phantom haptic device
-  operations, including initialization, setting forces, getting data,
-  and termination.
-
-  This program runs in a "multi-threaded" (multi-processing) fashion. 
-  Within an asynchronous callback, one process reads the stylus tip
-  position and sets the force to the device.  Within a synchronous
-  callback, another process gets the stylus tip position, orientation, forces, and 
-  button status, and the scene is redrawn accordingly..
-
-  This program has the following features:
-  - Two spheres, which represent a positive and negative charges, are drawn 
-    on the screen.
-  - The user moves/orients one of the spheres using Phantom's stylus.
-  - The user feels the attraction forces between the two spheres.
-  - An arrow is drawn to show the magnitude and direction of the attraction force.
-  - The user can rotate/scale the other sphere by dragging the LEFT/MIDDLE
-    buttons of the mouse.
-  - RIGHT-clicking the mouse brings up a popup menu.  Currently two items
-    are in the menu: "How to Play" and "About"
-
-******************************************************************************/
-
-//*****************************************************************************
-//                INCLUDED HEADER FILES       
-//*****************************************************************************
-#include <iostream>
-#include <stdio.h>
-#include <conio.h>
-#include <assert.h>
-
-#include <GL/glut.h>            //needed for graphics (OpenGL)
-#include <HDU/hduVector.h>      //useful utility (vector)
-#include <HDU/hduMath.h>
-#include <HDU/hduMatrix.h>      //useful utility (matrix)
-#include <HD/hd.h>              //needed for haptic device (general)
-#include <HDU/hduError.h>       //needed for haptic device (error handling)
-
-
-//*****************************************************************************
-//                GLOBAL CONSTANTS
-//*****************************************************************************
-#define SPHERE_RADIUS   12      //the initial radius of the two spheres to be drawn
-#define CUBE_SIZE 150
-#define SPHERE_MASS 5
-//the colours of the axes to be drawn
-//the columns are the colour vector (R, G, B, transparency).
-const float AXIS_COLOUR[ 4 ][ 3 ] = 
-{ 
-    { 1, 0, 0 },
-    { 0, 1, 0 },
-    { 0, 0, 1 },
-    { 1, 1, 1 }
-};
-
-//the vertices (endpoints) of the axes to be drawn
-const float AXIS_VERTEX[ 4 ][ 3 ] = 
-{          
-    { SPHERE_RADIUS*2, 0, 0 },
-    { 0, SPHERE_RADIUS*2, 0 },
-    { 0, 0, SPHERE_RADIUS*2 },
-    { 0, 0, 0 }
-};
-
-//*****************************************************************************
-//                USER-DEFINED DATA STRUCTURES
-//*****************************************************************************
-//storage for recording current data from the haptic device
-struct HapticDeviceState
-{
-    HHD m_hHD;              //handle of the haptic device
-    HDint button;           //button status: 0 (no press); 1 (blue button); 2 (white button)
-    double position[3];     //position of the stylus tip
-    double transform_matrix[16];    //transformation (position & orientation)
-                                    // of the stylus tip
-    double force[3];        //output force vector (X,Y,Z) of the haptic device
-};
-
-
-//*****************************************************************************
-//                GLOBAL VARIABLES
-//*****************************************************************************
-//for the mouse
-int gLastMouseX, gLastMouseY;   //mouse position at previous time stamp
-const int MAXTRIANGLES  =   20; //max triabgles for polygon array
-int i,j;                    // Variable User as counter in the Loops
-double identityTransform[16] = {1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1};
-double spherePosition[3] = {0,0,0};
-double contactPoint[3] = {0,0,0};
-double offsetSphere[3] = {0,0,0};
-bool gettingBallPosition = true;
-bool ballAttached = false;
-//double wallForce[3] = {0,0,0};
-
-//Camera Attributes (Rotation/Scaling on the centre sphere)
-double CamRotationY = 0;            //rotation (degrees)
-double CamRotationX = 0;
-double CamZoom = 1;                 //scale factor
-double sphereMass = 1;
-bool gIsRotatingCamera = false;     //flags to indicate which operation to perform
-bool gIsScalingCamera = false;      // according to different mouse clicks.
-bool gIsTranslatingCamera = false;
-
-//for the haptic device
-HHD ghHD = HD_INVALID_HANDLE;   //handle of the device
-HDSchedulerHandle gSchedulerCallback = HD_INVALID_HANDLE;   //handle of the scheduler
-
-//*****************************************************************************
-//                USER-DEFINED CLASS
-//*****************************************************************************
-
-//*****************************************************************************
-//                UTILITY FUNCTION PROTOTYPES
-//*****************************************************************************
-
-//=====================================================================
-//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
-//=====================================================================
-
-//This procedure intializes the GLUT setting.  It creates the graphics window
-// and assigns functions for display, mouse click, mouse movement, and popup menu.
-void initGlut(int argc, char* argv[]);
-
-//This procedure detects which mouse button is clicked and sets the
-// appropriate flags to indicate which event should occur.
-void MyGlutMouse(int button, int state, int x, int y);
-
-//This procedure detects the motion of the mouse (i.e. dragging"),
-// and performs operations depending on how the mouse is dragged
-// and which flag is set.
-void MyGlutMotion(int x, int y);
-
-//This function takes care of operations to perform when the program is idle.
-void MyGlutIdle(void);
-
-//This procedure sets up the functionalities of the menu items of the popup
-// menus when a mouse button is clicked.
-//For this example, both menu items display certain texts.
-void MyGlutMenu(int ID);
-
-// This handler gets automatically called when the program is exiting. 
-//  The program ensures that the haptic device and the scheduler are
-//  properly shutdown
-void __cdecl exitHandler();
-
-
-//=====================================================================
-//     <HAPTICS>:FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
-//=====================================================================
-
-//This procedure sends to the scheduler a task (i.e. a callback function)
-// that updates the force feedback of the device continuously.
-void ScheduleForceFeedback();
-
-//This is the callback function calculates the force (by calling 
-// "CalculateForce()" and SET the resulting forces to the device.
-//The callback function is scheduled to the scheduler in an "asynchronous"
-// fashion, and the function is called repeatedly each time it finishes.
-HDCallbackCode HDCALLBACK SettingForceCallback(void *data);
-
-//This callback function has the responsibility of GETTING haptic device data that is
-// constantly modified by the device. 
-//In the main graphics loop function, this callback function is scheduled 
-// to the scheduler in a "synchronous" fashion.  
-HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData);
-
-//This function calculates the force vector to be sent to the haptic device.
-//Currently, the force is calculated based on the current position of the 
-// device cursor and Coulomb's Law.
-hduVector3Dd CalculateForce(double* spherePosition);
-
-//=====================================================================
-//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
-//=====================================================================
-
-//This procedure sets up the viewing condition for the scene to be drawn.
-//This procedure uses the haptic device coordinate space as model space 
-// of our scene.  An orthographic projection is defined to fit this space.
-//NOTE: LLB means Low, Left, Back point of device workspace.
-//      TRF means Top, Right, Front point of device workspace. 
-void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3]);
-
-//This procedure sets up the lighting (and shading) conditions 
-// for the scene to be drawn.
-void initGraphicsLighting();
-
-//This is the main display looping function that is run and draws the 
-// screen continuously.
-//Currently this function draws one fixed sphere (with axes), one movable
-// sphere (with axes), and an arrow (representing the force).
-void MyGlutDisplay(void);
-
-//This procedure draws the X,Y,Z axis for the current coordinate frame.
-void drawAxes();
-
-//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
-// of the current coordinate frame.
-void drawFixedSphere(GLUquadricObj* quadObj);
-
-//This procedure draws the "movable sphere" that corresponds to the cursor
-// of the haptic device.
-void drawMovableSphere(GLUquadricObj* quadObj,
-                       const double transform[16],
-                       HDint button_state);
-
-//This procedure draws the visual representation (an arrow) that represents
-// the magnitude and direction of the Coulomb Force.
-void drawForceVisualRepresentation(GLUquadricObj* quadObj,
-                                   const double position[3],                       
-                                   const double strength);
-
-
-void drawball(GLUquadricObj* quadObj, HapticDeviceState state);
-//void drawHollowCube();
-//*****************************************************************************
-//                THE MAIN FUNCTION - (this is where things start...)
-//*****************************************************************************
-int main(int argc, char* argv[])
-{
-    HDErrorInfo error;
-
-    printf("ENSC488 - Haptic Device Sample Program\n\n");
-    printf("Starting application\n");
-    
-    //Set up the TERMINATION procedures when program finishes.
-    //Things to take care of including shutting down the haptic device and scheduler.
-    atexit(exitHandler);
-
-    //Initialize the haptic device.  This needs to be called before any actions on 
-    // the device.
-    ghHD = hdInitDevice(HD_DEFAULT_DEVICE);
-    //Check for any initialization error.  If so, terminate the program.
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Failed to initialize haptic device");
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
-        return -1;
-    }
-
-    //Retrieve and display the model name of the haptic device.
-    printf("Found device %s\n",hdGetString(HD_DEVICE_MODEL_TYPE));
-    
-    //Enable haptic force feedback
-    hdEnable(HD_FORCE_OUTPUT);
-    hdEnable(HD_MAX_FORCE_CLAMPING);
-
-    //Find the workspace of the robotic links of the haptic device.
-    //The workspace is defined by two vertices: the Low Left Back point
-    // and the Top Right Front point.
-    printf("The workspace two corner vertices are:\n");
-    HDdouble maxWorkspace[6];
-    hdGetDoublev(HD_MAX_WORKSPACE_DIMENSIONS, maxWorkspace);
-    printf("%lf %lf %lf %lf %lf %lf\n", maxWorkspace[0],
-           maxWorkspace[1],
-           maxWorkspace[2],
-           maxWorkspace[3],
-           maxWorkspace[4],
-           maxWorkspace[5]);
-    printf("\n");
-
-    //Start the scheduler of the haptic device.
-    hdStartScheduler();
-    //Check if the scheduler is initialized properly.
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Failed to start scheduler");
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
-        return -1;
-    }
-    
-    //Initializes all GLUT related functions.
-    initGlut(argc, argv);
-
-    //Based on the workspace of the haptic device,
-    // set the viewing volumn of the scene to correspond
-    // to this workspace.
-    //Low, Left, Back point of device workspace.
-    hduVector3Dd LLB; 
-    LLB.set(maxWorkspace[0], maxWorkspace[1], maxWorkspace[2]);
-    //Top, Right, Front point of device workspace.
-    hduVector3Dd TRF;
-    TRF.set(maxWorkspace[3], maxWorkspace[4], maxWorkspace[5]);
-    //Initializes the viewing condition for the scene
-    initGraphicsViewing(LLB, TRF);
-
-    //Initializes the lighting condition for the scene
-    initGraphicsLighting();
-
-
-    //Schedule the force feedback process to the scheduler
-    std::cout << "Starting haptics callback..." << std::endl;
-    ScheduleForceFeedback();
-
-    //Enter the main loop for drawing the scene
-    std::cout << "Starting graphics callback..." << std::endl;
-    glutMainLoop(); //This is the "famous" GLUT infinite loop
-                    // that runs forever unless the program exits.
-
-    printf("Done\n");
-    return 0;
-}
-
-/******************************************************************************/
-
-
-//=====================================================================
-//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
-//=====================================================================
-
-//This procedure intializes the GLUT setting.  It creates the graphics window
-// and assigns functions for display, mouse click, mouse movement, and popup menu.
-void initGlut(int argc, char* argv[])
-{
-    glutInit(&argc, argv);          // Initialize GLUT.
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
-    glutInitWindowSize(500, 500);   //graphics window creation
-    glutCreateWindow("Haptic Device Demo - Coulomb Force");
-
-    glutDisplayFunc(MyGlutDisplay);   //GLUT callback - display or draw scene
-    //glutReshapeFunc(reshape);
-    glutMouseFunc(MyGlutMouse);       //GLUT callback - mouse button detection
-    glutMotionFunc(MyGlutMotion);     //GLUT callback - mouse button movement
-    glutIdleFunc(MyGlutIdle);         //GLUT callback - idle operations
-
-    glutCreateMenu(MyGlutMenu);       //GLUT callback - Setup GLUT popup menu
-    glutAddMenuEntry("How to Play", 0);
-	glutAddMenuEntry("Increase Sphere Mass", 1);
-	glutAddMenuEntry("Decrese Sphere Mass", 2);
-    glutAddMenuEntry("About", 3);
-    glutAttachMenu(GLUT_RIGHT_BUTTON);//Right click the mouse to launch the popup menu
-
-}//END of initGlut
-
-
-//This procedure detects which mouse button is clicked and sets the
-// appropriate flags to indicate which event should occur.
-void MyGlutMouse(int button, int state, int x, int y)
-{
-    if (state == GLUT_DOWN)
-    {   //some mouse button is pressed
-        if (button == GLUT_LEFT_BUTTON)
-        {   //Left click the mouse to rotate the centre sphere.
-            gIsRotatingCamera = true;            
-        }
-        else if (button == GLUT_MIDDLE_BUTTON)
-        {   //Click the centre button to scale the centre sphere.
-            gIsScalingCamera = true;            
-        }
-
-        //record the current mouse PIXEL location
-        gLastMouseX = x;
-        gLastMouseY = y;
-    }
-    else
-    {   //no mouse button is pressed...
-        gIsRotatingCamera = false;
-        gIsScalingCamera = false;
-        gIsTranslatingCamera = false;
-    }
-}//END of MyGlutMouse
-
-
-//This procedure detects the motion of the mouse (i.e. dragging"),
-// and performs operations depending on how the mouse is dragged
-// and which flag is set.
-void MyGlutMotion(int x, int y)
-{
-    if (gIsRotatingCamera)
-    {   
-        //rotate the centre sphere
-        //dragging the mouse horizontally rotates the object about Y axis
-        CamRotationY = CamRotationY + 0.1*(x - gLastMouseX);
-        //dragging the mouse vertically rotates the object about X axis
-        CamRotationX = CamRotationX + 0.1*(y - gLastMouseY);
-    }
-    else if (gIsScalingCamera)
-    {
-        //dragging the mouse vertically scales the object up or down.
-        CamZoom = CamZoom - 0.01*(y - gLastMouseY);
-    }
-
-    //record the current mouse PIXEL position.
-    gLastMouseX = x;
-    gLastMouseY = y;
-}//END of MyGlutMotion
-
-
-//This function takes care of operations to perform when the program is idle.
-void MyGlutIdle(void)
-{
-    //redisplay the scene
-    glutPostRedisplay();
-
-    //check if the scheduler has exited... if so, terminate program as well.
-    if (!hdWaitForCompletion(gSchedulerCallback, HD_WAIT_CHECK_STATUS))
-    {
-        printf("The main scheduler callback has exited\n");
-        printf("Press any key to quit.\n");
-        getch();
-        exit(-1);
-    }
-}//END of MyGlutIdle
-
-
-//This procedure sets up the functionalities of the menu items of the popup
-// menus when a mouse button is clicked.
-//For this example, both menu items display certain texts.
-void MyGlutMenu(int ID)
-{
-    switch(ID) 
-    {
-        case 0: //"How to Play" information in the popup menu.
-            
-            break;
-        case 1: //Increase mass
-            sphereMass ++;
-            break;
-		case 2: //Decrease mass
-            sphereMass --;
-			if (sphereMass < 0)
-				sphereMass = 0;
-			break;
-
-		case 3: //"About" information in the popup menu
-            
-        break;
-    }
-}//END of MyGlutMenu      
-
-
-// This handler gets automatically called when the program is exiting. 
-//  The program ensures that the haptic device and the scheduler are
-//  properly shutdown
-void __cdecl exitHandler()
-{
-    //stop the scheduler and cleans up any unfinished jobs on the scheduler.
-    hdStopScheduler();
-    hdUnschedule(gSchedulerCallback);
-
-    //if the haptic device hasn't been disabled yet, disable it now.
-    if (ghHD != HD_INVALID_HANDLE)
-    {
-        hdDisableDevice(ghHD);
-        ghHD = HD_INVALID_HANDLE;
-    }
-}//END of exitHandler
-
-
-
-//=====================================================================
-//   <HAPTICS>: FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
-//=====================================================================
-
-//This procedure sends to the scheduler a task (i.e. a callback function)
-// that updates the force feedback of the device continuously.
-void ScheduleForceFeedback()
-{
-    //schedule asynchronously to the scheduler a process for setting forces.
-    gSchedulerCallback = hdScheduleAsynchronous(
-        SettingForceCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY);
-
-    //checks if the process is scheduled successfully
-    HDErrorInfo error;
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Failed to initialize haptic device");
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
-        exit(-1);
-    }
-
-}//END of ScheduleForceFeedback
-
-
-
-//This is the callback function calculates the force (by calling 
-// "CalculateForce()" and SET the resulting forces to the device.
-//The callback function is scheduled to the scheduler in an "asynchronous"
-// fashion, and the function is called repeatedly each time it finishes.
-HDCallbackCode HDCALLBACK SettingForceCallback(void *data)
-{
-    //get a "handle" on the current haptic device
-    HHD hHD = hdGetCurrentDevice();
-	hduVector3Dd forceVec;
-    //NOTE: Setting forces must be in between the "hdBeginFrame()"
-    // and "hdEndFrame()".  Between these two lines, the haptic status
-    // (forces) is constant.
-    hdBeginFrame(hHD);
-
-    //Obtain the current position of the tip of the stylus
-    hduVector3Dd pos;
-    hdGetDoublev(HD_CURRENT_POSITION,pos);
-    forceVec = CalculateForce(spherePosition);
-    hdSetDoublev(HD_CURRENT_FORCE, forceVec);
-        
-    hdEndFrame(hHD);
-
-    //Check if the scheduler returns any error when executing this process...
-    HDErrorInfo error;
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Error during scheduler callback");
-
-        if (hduIsSchedulerError(&error))
-        {
-            //if there is error in scheduler, terminates (by force) the current
-            // process
-            return HD_CALLBACK_DONE;
-        }
-    }
-
-    //continue executing the setting up of the force feedback
-    // by telling the scheduler to repeat on the process after it is completed
-    // each time.
-    //NOTE: this is how we can have a process to set up device forces that runs
-    // in parallel with other (graphics, getting data) processes.
-    return HD_CALLBACK_CONTINUE;
-}//END of SettingForceCallback
-
-
-//This callback function has the responsibility of GETTING haptic device data that is
-// constantly modified by the device. 
-//In the main graphics loop function, this callback function is scheduled 
-// to the scheduler in a "synchronous" fashion.  
-HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData)
-{
-    //rename the variable and type cast it as the user
-    // defined data structure "HapticDeviceState"
-    HapticDeviceState *pDisplayState = 
-        static_cast<HapticDeviceState *>(pUserData);
-
-    //Get current stylus tip position
-    hdGetDoublev(HD_CURRENT_POSITION, pDisplayState->position);
-    //Get the overal transformation matrix for the stylus tip.
-    hdGetDoublev(HD_CURRENT_TRANSFORM, pDisplayState->transform_matrix);
-    //Get the force vector that is currently set in the haptic device
-    hdGetDoublev(HD_CURRENT_FORCE, pDisplayState->force);
-    //Get the info on which button of the stylus is pressed.
-    hdGetIntegerv(HD_CURRENT_BUTTONS, &pDisplayState->button);
-
-    //Execute this only once - since we are already doing it repeatedly (inside
-    // the GlutDisplay function)
-    return HD_CALLBACK_DONE;
-
-}//END of GettingDeviceStateCallback
-
-
-
-//This function calculates the force vector to be sent to the haptic device.
-//Currently, the force is calculated based on the current position of the 
-// device cursor and Coulomb's Law.
-hduVector3Dd CalculateForce(double* spherePosition)
-{
-	hduVector3Dd forceVec;
-	//Calculating wall force
-	if (ballAttached){
-		for( int i = 0; i < 3; i++ ){
-			if((abs(spherePosition[i]) + 2*SPHERE_RADIUS) >= CUBE_SIZE/2) {
-				if(spherePosition[i] > 0) 
-					forceVec[i] = -10;
-				else {
-					forceVec[i] = 10;
-				}
-				//std::cout << "feel the force" << forceVec[i] << "\n";
-			}
-	
-		}
-
-		//Add force for gravity
-		forceVec[1] += - sphereMass; 
-		//std::cout << "feel the gravity" << forceVec[2] << "\n";
-		return forceVec;
-	}
-	forceVec[0] = 0;
-	forceVec[1] = 0;
-	forceVec[2] = 0;
-
-    return forceVec;
-}//END of CalculateForce
-
-
-
-
-//=====================================================================
-//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
-//=====================================================================
-
-//This procedure sets up the viewing condition for the scene to be drawn.
-//This procedure uses the haptic device coordinate space as model space 
-// of our scene.  An orthographic projection is defined to fit this space.
-//NOTE: LLB means Low, Left, Back point of device workspace.
-//      TRF means Top, Right, Front point of device workspace. 
-void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3])
-{
-    glMatrixMode(GL_PROJECTION); /* Setup perspective projection. */
-    glLoadIdentity();
-
-    //Find the (Cartesian) centre point of the device workspace.
-    HDdouble centerScreen[3];
-    centerScreen[0] = (TRF[0] + LLB[0])/2.0;
-    centerScreen[1] = (TRF[1] + LLB[1])/2.0;
-    centerScreen[2] = (TRF[2] + LLB[2])/2.0;
-
-    //According to the haptic device workspace, set the view volumn 
-    // (screen dimension).
-    HDdouble screenDims[3];
-    screenDims[0] = TRF[0] - LLB[0];
-    screenDims[1] = TRF[1] - LLB[1];
-    screenDims[2] = TRF[2] - LLB[2];
-
-    //find the dimension corresponding to the larger "range" 
-    // between the X and Y directions
-    HDdouble maxDimXY = (screenDims[0] > screenDims[1] ? screenDims[0]:screenDims[1]);
-    //find the dimension corresponding to the larger "range" 
-    // among the X, Y, and Z directions
-    HDdouble maxDim = (maxDimXY > screenDims[2] ? maxDimXY:screenDims[2]);
-    maxDim /= 2.0;
-
-    //orthographic projection (1st parameter has largest "range", and so on...)
-    glOrtho(centerScreen[0]-maxDim, centerScreen[0]+maxDim, 
-             centerScreen[1]-maxDim, centerScreen[1]+maxDim,
-             centerScreen[2]-maxDim, centerScreen[2]+maxDim);
-    
-    //for testing only...
-//    printf("glortho %lf %lf %lf %lf %lf %lf\n",
-//           centerScreen[0]-maxDim, centerScreen[0]+maxDim, 
-//           centerScreen[1]-maxDim, centerScreen[1]+maxDim,
-//           centerScreen[2]-maxDim, centerScreen[2]+maxDim);
-
- 
-    glMatrixMode(GL_MODELVIEW); // Setup model transformations. 
-    glLoadIdentity();
-
-    glClearDepth(1.0); // Setup background colour. 
-    glClearColor(0.7, 0.7, 0.7, 0);
-    glDisable(GL_DEPTH_TEST);
-
-}//END of initGraphicsWorkspace
-
-
-//This procedure sets up the lighting (and shading) conditions 
-// for the scene to be drawn.
-void initGraphicsLighting()
-{
-    //smooth (interpolated) shading
-    glShadeModel(GL_SMOOTH);
-
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-    glEnable(GL_NORMALIZE);
-    glEnable(GL_LIGHT_MODEL_TWO_SIDE);
-    
-    GLfloat lightZeroPosition[] = {10.0, 4.0, 100.0, 0.0};
-    GLfloat lightZeroColor[] = {0.6, 0.6, 0.6, 1.0}; //grey light
-    GLfloat lightOnePosition[] = {-1.0, -2.0, -100.0, 0.0};
-    GLfloat lightOneColor[] = {0.6, 0.6, 0.6, 1.0};  //grey light as well
-    
-    GLfloat light_ambient[] = {0.8, 0.8, 0.8, 1.0}; //Ambient lighting (grey)
-    GLfloat light_diffuse[] = {0.0, 0.0, 0.0, 1.0}; //Diffuse lighting (none)    
-    GLfloat light_position[] = {0.0, 0.0, 100.0, 1.0}; //light source far away
-    
-    glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, 1);
-    glLightfv(GL_LIGHT0, GL_POSITION, lightZeroPosition);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, lightZeroColor);
-    glLightfv(GL_LIGHT1, GL_POSITION, lightOnePosition);
-    glLightfv(GL_LIGHT1, GL_DIFFUSE, lightOneColor);
-    glEnable(GL_LIGHT0);    //enable light0
-    glEnable(GL_LIGHT1);    //enable light1
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-
-}//END of initGraphicsLighting
-
-
-//This is the main display looping function that is run and draws the 
-// screen continuously.
-//Currently this function draws one fixed sphere (with axes), one movable
-// sphere (with axes), and an arrow (representing the force).
-void MyGlutDisplay(void)
-{
-    glMatrixMode(GL_MODELVIEW); // Setup model transformations.
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glLoadIdentity();
-	glRotatef(15,1,1,1);
-	glRotatef(CamRotationY, 0, 1, 0);
-	glRotatef(CamRotationX, 1, 0, 0);
-	glScalef(CamZoom, CamZoom, CamZoom);
-    glPushMatrix();
-    //need to enable "colour material" in order to see the
-    // different surfaces of objects having different colours (shades)
-    glEnable(GL_COLOR_MATERIAL);
-
-    drawAxes();
-	glutWireCube(CUBE_SIZE);
-	glPopMatrix();
-   // drawHollowCube();
-    //Draw the end effector (sphere) and the arrow
-    // Get the current position/orientation of end effector and
-    // the current button state.
-    //A process for getting device data is sent to the scheduler
-    // (synchronously).
-    HapticDeviceState state;
-    hdScheduleSynchronous(GettingDeviceStateCallback, &state,
-                          HD_MIN_SCHEDULER_PRIORITY);
-    GLUquadricObj* quadObj = gluNewQuadric();
-
-   //double forceMag = 400.0 * sqrt(state.force[0]*state.force[0] + 
-     //                             state.force[1]*state.force[1] + 
-       //                          state.force[2]*state.force[2]);
-    
-    //draw ball
-    drawball(quadObj, state);
-
-    //draw the sphere (tip of the stylus)
-    drawMovableSphere(quadObj, state.transform_matrix, state.button);
-    //draw the force arrow
-    //drawForceVisualRepresentation(quadObj, state.position, forceMag);
-
-    // Always delete a Quadric (since you previouly dynamically allocated one)
-    gluDeleteQuadric(quadObj);
-
-    glDisable(GL_COLOR_MATERIAL);
-  
-    glPopMatrix();
-
-    // Double buffers are used to speed things up...
-    glutSwapBuffers();
-}//END of MyGlutDisplay
-
-
-//--------------------------------------------------------
-// *** NOTE: The following are the utility functions that
-//   draw the individual objects in the scene. ***
-//--------------------------------------------------------
-
-//This procedure draws the X,Y,Z axis for the current coordinate frame.
-void drawAxes()
-{
-    //disable lighting and material when drawing axes.
-    glDisable(GL_LIGHTING);
-    glDisable(GL_COLOR_MATERIAL);
-    for(int i = 0; i < 3; i++) 
-    {               
-        glColor3fv(AXIS_COLOUR[ i ]);
-        glBegin(GL_LINES);  //draw a line - define two endpoints between
-                            // the "glBegin" and "glEnd" pair
-        glVertex3fv(AXIS_VERTEX[ i ]);
-        glVertex3fv(AXIS_VERTEX[ 3 ]);
-        glEnd();
-    }
-    glEnable(GL_LIGHTING);
-    glEnable(GL_COLOR_MATERIAL);
-
-}//END of drawAxes
-
-
-
-//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
-// of the current coordinate frame.
-void drawFixedSphere(GLUquadricObj* quadObj)
-{
-    //Display a sphere to show the static electric charge (greenish blue).
-    glColor4f(0.2, 0.8, 0.8, 0.8);
-
-    //Draw the center sphere.
-    gluSphere(quadObj, SPHERE_RADIUS, 20, 20); 
-
-}//END of drawFixedSphere
-
-
-//This procedure draws the "movable sphere" that corresponds to the cursor
-// of the haptic device.
-void drawMovableSphere(GLUquadricObj* quadObj,
-                       const double transform[16],
-                       HDint button_state)
-
-{
-   //Display one sphere to represent the haptic cursor and the dynamic 
-   //    charge.
-    glPushMatrix();
-
-    glLoadIdentity();
-    glMultMatrixd(transform);   //transform the movable sphere
-                                // such that its location and orientation
-                                // correponds to those of the stylus of the device.
-
-    drawAxes();
-    if (button_state == 0)  //no button is pressed
-        glColor4f(0.8, 0.2, 0.2, 0.8);      //red colour
-    else if (button_state == 1) //the first (blue) button is pressed
-        glColor4f(0.2, 0.8, 0.2, 0.8);     //green colour
-    else if (button_state == 2) //the second (white) button is pressed
-        glColor4f(0.2, 0.2, 0.8, 0.8);      //blue colour
-
-    gluSphere(quadObj, SPHERE_RADIUS, 20, 20);  
-
-    glPopMatrix();
-
-}//END of drawMovableSphere
-
-
-//This procedure draws the visual representation (an arrow) that represents
-// the magnitude and direction of the Coulomb Force.
-void drawForceVisualRepresentation(GLUquadricObj* quadObj,
-                                   const double position[3],                       
-                                   const double strength)
-{
-    //Display the force vector, change the force magnitude/direction
-    // rotote the force vector first. 
-    hduVector3Dd ForceVectorAxis(position); 
-    ForceVectorAxis *= -1;  //points to the opposite direction of "position"
-
-    //normalize the force vector such that its length is 1.
-    hduVector3Dd UnitForceVectorAxis;
-    UnitForceVectorAxis = normalize(ForceVectorAxis);
-
-    //For calculation of rotation angle.
-    hduVector3Dd ZAxis;  //Z axis is chosen because when drawing a cylinder,
-                         // it is drawn along the Z-axis by default.
-    ZAxis.set(0.0, 0.0, 1.0);
-
-    hduVector3Dd ToolRotAxis; 
-    //the tool rotation axis points to direction perpendicular to 
-    // both Z axis and force vector axis
-    ToolRotAxis = crossProduct(ZAxis, ForceVectorAxis);
-        
-    //the angle around the "ToolRotAxis" that will rotate Z axis into 
-    // ForceVectorAxis 
-    double ToolRotAngle = acos(UnitForceVectorAxis[2]);
-    hduMatrix rotMatrix;    
-    //the overall rotation matrix for this force vector is...
-    //NOTE: defined using "equivalent angle axis" theorem.
-    // you don't need to worry about implementation details
-    // just find the axis and angle and use the following function (createRotation)
-    rotMatrix = hduMatrix::createRotation(ToolRotAxis, ToolRotAngle);
-
-    double rotVals[4][4];
-    rotMatrix.get(rotVals); //get the elements of matrix "rotMatrix" and save them
-                            // into a 4 by 4 array (something OpenGL understands)
-    glMultMatrixd((double*)rotVals);
-
-    //The force arrow: composed of a cylinder and a cone.
-    glDisable(GL_LIGHTING);
-    glColor3f(0.2, 0.7, 0.2);
-    //Draw the cylinder part 
-    // parameters are: object_name, base_radius, top_radius, height, slices, stacks)
-    gluCylinder(quadObj,SPHERE_RADIUS*0.1, SPHERE_RADIUS*0.1, strength, 16, 2); 
-    glTranslatef(0, 0, strength);
-    glColor3f(0.2, 0.8, 0.3);
-    //Draw the cone part.
-    gluCylinder(quadObj, SPHERE_RADIUS*0.2, 0.0, strength*0.15, 16, 2); 
-    glEnable(GL_LIGHTING);
-}//END of drawForceVisualRepresentation
-
-void drawball(GLUquadricObj* quadObj, HapticDeviceState state)
-{
-    //contact detection
-    double sqrt_dist = sqrt(pow((state.position[0]-spherePosition[0]),2) + pow((state.position[1]
-        - spherePosition[1]),2) + pow((state.position[2]-spherePosition[2]),2));
-
-	glPushMatrix();
-    glLoadIdentity();
-	if(sqrt_dist <= 3*SPHERE_RADIUS && state.button){
-		ballAttached = true;
-           for( int i = 0; i < 16; i++ ){
-               identityTransform[i] = state.transform_matrix[i];
-			}
-          
-		   if (gettingBallPosition) {
-			   offsetSphere[0] = state.position[0] - spherePosition[0];
-			   offsetSphere[1] = state.position[1] - spherePosition[1];
-			   offsetSphere[2] = state.position[2] - spherePosition[2];
-			   gettingBallPosition = false;
-		   }
-
-		   for( int i = 0; i < 3; i++ ){
-               spherePosition[i] = state.position[i] - offsetSphere[i];
-		   }
-		   
-		   glTranslatef(-offsetSphere[0], -offsetSphere[1], -offsetSphere[2]);
-		   glMultMatrixd(state.transform_matrix); 
-
-	} else {
-		glTranslatef(-offsetSphere[0], -offsetSphere[1], -offsetSphere[2]);
-		glMultMatrixd(identityTransform);
-		gettingBallPosition = true;
-		ballAttached = false;
-        
-	}
-	
-	//draw axes
-    drawAxes();
-    if (sqrt_dist <= 3*SPHERE_RADIUS) {
-        glColor4f(0.8, 0.2, 0.2, 0.8);
-        
-    } else
-    {
-        //set default sphere color
-        glColor4f(0.2, 0.8, 0.8, 0.8);
-
-    }
-    
-    //Draw the center sphere.
-    gluSphere(quadObj, SPHERE_RADIUS*2, 20, 20);
-
-	glPopMatrix();
-	glPopMatrix();
-
-	//back
-	if (ballAttached){
-		if((abs(spherePosition[2]) + 2*SPHERE_RADIUS) >= CUBE_SIZE/2){
-			if(spherePosition[2]<0) {
-				glBegin(GL_QUADS);
-				glColor4f(0.3, 1, 1, 1);
-				glVertex3f(-75, -75,-75);
-				glVertex3f(75,-75,-75);
-				glVertex3f(75,75,-75);
-				glVertex3f(-75,75,-75);
-				glEnd();
-			}
-		}
-	}
-
-	//right
-	if (ballAttached){
-		if((abs(spherePosition[0]) + 2*SPHERE_RADIUS) >= CUBE_SIZE/2){
-			if(spherePosition[0]>0) {
-				glBegin(GL_QUADS);
-				glColor4f(0.3, 1, 1, 1);
-				glVertex3f(75,-75,-75);
-				glVertex3f(75,-75,75);
-				glVertex3f(75,75,75);
-				glVertex3f(75,75,-75);
-				glEnd();
-			}
-		}
-	}
-
-	//down
-	if (ballAttached){
-		if((abs(spherePosition[1]) + 2*SPHERE_RADIUS) >= CUBE_SIZE/2){
-			if(spherePosition[1]<0) {
-				glBegin(GL_QUADS);
-				glColor4f(0.3, 1, 1, 1);
-				glVertex3f(-75,-75,-75);
-				glVertex3f(-75,-75,75);
-				glVertex3f(75,-75,75);
-				glVertex3f(75,-75,-75);
-				glEnd();
-			}
-		}
-	}
-	//left
-	if (ballAttached){
-		if((abs(spherePosition[0]) + 2*SPHERE_RADIUS) >= CUBE_SIZE/2){
-			if(spherePosition[0]<0) {
-				glBegin(GL_QUADS);
-				glColor4f(0.3, 1, 1, 1);
-				glVertex3f(-75,-75,-75);
-				glVertex3f(-75,-75,75);
-				glVertex3f(-75,75,75);
-				glVertex3f(-75,75,-75);
-				glEnd();
-			}
-		}
-	}
-
-	//up
-	if (ballAttached){
-		if((abs(spherePosition[1]) + 2*SPHERE_RADIUS) >= CUBE_SIZE/2){
-			if(spherePosition[1]>0) {
-				glBegin(GL_QUADS);
-				glColor4f(0.3, 1, 1, 1);
-				glVertex3f(-75,75,-75);
-				glVertex3f(-75,75,75);
-				glVertex3f(75,75,75);
-				glVertex3f(75,75,-75);
-				glEnd();
-			}
-		}
-	}
-
-		//Front
-	if (ballAttached){
-		if((abs(spherePosition[2]) + 2*SPHERE_RADIUS) >= CUBE_SIZE/2){
-			if(spherePosition[2]>0) {
-				glBegin(GL_QUADS);
-				glColor4f(0.3, 1, 1, 1);
-				glVertex3f(-75,-75,75);
-				glVertex3f(75,-75,75);
-				glVertex3f(75,75,75);
-				glVertex3f(-75,75,75);
-				glEnd();
-			}
-		}
-	}
-}
-
-//******************************************************************************
-//           ~~~~~~  END OF main.cpp   ~~~~~~
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: main.cpp
+
+Original Author: SensAble Technologies (c) 2004
+
+Modified and Commented by:  Wayne Chen (waynec@sfu.ca)
+
+Last Update: 09/24/2004
+
+Description:
+
+  This sample code introduces the use of basic Phantom haptic device
+  operations, including initialization, setting forces, getting data,
+  and termination.
+
+  This program runs in a "multi-threaded" (multi-processing) fashion. 
+  Within an asynchronous callback, one process reads the stylus tip
+  position and sets the force to the device.  Within a synchronous
+  callback, another process gets the stylus tip position, orientation, forces, and 
+  button status, and the scene is redrawn accordingly..
+
+  This program has the following features:
+  - Two spheres, which represent a positive and negative charges, are drawn 
+    on the screen.
+  - The user moves/orients one of the spheres using Phantom's stylus.
+  - The user feels the attraction forces between the two spheres.
+  - An arrow is drawn to show the magnitude and direction of the attraction force.
+  - The user can rotate/scale the other sphere by dragging the LEFT/MIDDLE
+    buttons of the mouse.
+  - RIGHT-clicking the mouse brings up a popup menu.  Currently two items
+    are in the menu: "How to Play" and "About"
+  - Running the program with "-bench [results.json]" times the force,
+    kinematics and contact detection kernels (no device needed) and writes
+    the results in Google Benchmark JSON format, after checking that 100000
+    simulated servo ticks make no heap allocation.  On Linux the
+    CMakeLists.txt at the top of the repository builds it.
+  - Every servo tick (pose, joint/gimbal angles, buttons and force) is
+    published to shared memory for external readers, see DeviceStateShm.h.
+  - Adding "-latency [frames.csv]" measures the motion-to-photon latency
+    of every frame and prints a breakdown on exit, see LatencyProbe.h.
+  - The stylus (and the ball it holds) is drawn where it is predicted to
+    be when the frame reaches the screen, see PosePredictor.h; the popup
+    menu cycles through off/linear/constant acceleration prediction.
+  - "Add Balls" fills the cube with more (smaller) balls, which collide
+    with each other, the walls and the stylus; any of them can be pushed
+    with the stylus, or grabbed by holding a stylus button.  They are
+    simulated on all the cores (TaskPool.h), see BallPhysics.h.
+  - "Toggle Fluid" swaps the balls for a pool of water in the bottom of
+    the cube, stirred by the stylus, which feels its pressure and drag.
+    The fluid runs on a thread of its own and hands the servo callback a
+    local force model to interpolate, see SphFluid.h.
+  - The cube and the balls are nodes of a scene graph, drawn from a flat
+    list of shapes; only the balls that moved get new matrices, see
+    SceneGraph.h.
+  - Spheres, cylinders and disks are tessellated by how large they are on
+    the screen (with the zoom), see TessellationLod.h and SceneDraw.h.
+  - The servo callback runs its work as prioritized tasks with time
+    budgets (force, pose history, state publishing, event log); "Servo
+    Task Costs" prints what each costs, see ServoScheduler.h.
+  - The walls of the cube are planes of a constraint set, which the
+    held ball is pushed back from and which are highlighted where it
+    touches; boxes and convex polytopes (a maze, say) can be added the
+    same way, see ConstraintSet.h.
+
+******************************************************************************/
+
+//*****************************************************************************
+//                INCLUDED HEADER FILES       
+//*****************************************************************************
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <conio.h>
+#else
+#define getch getchar           //(no conio.h: waits for Enter instead of any key)
+#define __cdecl                 //(the only calling convention)
+#endif
+#include <assert.h>
+
+#include <GL/glut.h>            //needed for graphics (OpenGL)
+#include <HDU/hduVector.h>      //useful utility (vector)
+#include <HDU/hduMath.h>
+#include <HDU/hduMatrix.h>      //useful utility (matrix)
+#include <HD/hd.h>              //needed for haptic device (general)
+#include <HDU/hduError.h>       //needed for haptic device (error handling)
+
+#include "../../Common/HapticBench.h"   //micro-benchmark harness ("-bench" mode)
+#include "../../Common/ServoAllocTracker.h" //catches heap use inside the servo callback
+#include "../../Common/ServoEventLog.h"     //non-blocking error reporting from the servo thread
+#include "../../Common/ServoScheduler.h"    //the tasks of the servo callback, with time budgets
+#include "../../Common/ServoWatchdog.h"     //ramps the force down on overruns/stale state/NaN
+#include "../../Common/PassivityController.h" //time-domain passivity observer/controller
+#include "../../Common/DeviceStateShm.h"    //publishes the device state to other processes
+#include "../../Common/LatencyProbe.h"      //motion-to-photon latency ("-latency" mode)
+#include "../../Common/PosePredictor.h"     //draws the stylus where it will be when seen
+#include "../../Common/TaskPool.h"          //worker threads for the ball simulation
+#include "../../Common/BallPhysics.h"       //the balls in the cube
+#include "../../Common/SphFluid.h"          //the fluid in the cube
+#include "../../Common/SceneGraph.h"        //the nodes drawn and their transforms
+#include "../../Common/SceneDraw.h"         //scene graphs drawn, shapes tessellated by their size on screen
+#include "../../Common/ConstraintSet.h"     //the walls the held ball is kept in, as data
+
+
+//*****************************************************************************
+//                GLOBAL CONSTANTS
+//*****************************************************************************
+#define SPHERE_RADIUS   12      //the initial radius of the two spheres to be drawn
+#define CUBE_SIZE 150
+#define SPHERE_MASS 5
+#define BALL_RADIUS (2*SPHERE_RADIUS)   //the original ball
+#define SMALL_BALL_RADIUS 4     //the balls added from the menu
+#define BALLS_PER_ADD 250       //balls added by "Add Balls"
+#define FLUID_PARTICLES 2000    //the fluid of "Toggle Fluid"...
+#define FLUID_WIDTH 100         //...poured as a square block this wide
+//the colours of the axes to be drawn
+//the columns are the colour vector (R, G, B, transparency).
+const float AXIS_COLOUR[ 4 ][ 3 ] = 
+{ 
+    { 1, 0, 0 },
+    { 0, 1, 0 },
+    { 0, 0, 1 },
+    { 1, 1, 1 }
+};
+
+//the vertices (endpoints) of the axes to be drawn
+const float AXIS_VERTEX[ 4 ][ 3 ] = 
+{          
+    { SPHERE_RADIUS*2, 0, 0 },
+    { 0, SPHERE_RADIUS*2, 0 },
+    { 0, 0, SPHERE_RADIUS*2 },
+    { 0, 0, 0 }
+};
+
+//*****************************************************************************
+//                USER-DEFINED DATA STRUCTURES
+//*****************************************************************************
+//storage for recording current data from the haptic device
+struct HapticDeviceState
+{
+    HHD m_hHD;              //handle of the haptic device
+    HDint button;           //button status: 0 (no press); 1 (blue button); 2 (white button)
+    double position[3];     //position of the stylus tip
+    double transform_matrix[16];    //transformation (position & orientation)
+                                    // of the stylus tip
+    double sample_time;             //when the servo callback read this state
+    double force[3];        //output force vector (X,Y,Z) of the haptic device
+};
+
+
+//*****************************************************************************
+//                GLOBAL VARIABLES
+//*****************************************************************************
+//for the mouse
+int gLastMouseX, gLastMouseY;   //mouse position at previous time stamp
+const int MAXTRIANGLES  =   20; //max triabgles for polygon array
+int i,j;                    // Variable User as counter in the Loops
+double contactPoint[3] = {0,0,0};
+bool ballAttached = false;
+//the balls in the cube (ball 0 is the original one), stepped by the
+// graphics loop
+BallWorld gBalls;
+double gLastBallStep = 0;           //when they were last stepped (s)
+TaskPool gTaskPool;                 //started when balls are added
+bool gTaskPoolStarted = false;
+//what the servo callback needs of them (written by the graphics loop)
+double gHeldBallPosition[3] = {0,0,0};  //the ball held by the stylus
+double gHeldBallRadius = BALL_RADIUS;
+double gBallPushForce[3] = {0,0,0};     //the balls pushing back on the stylus (N)
+bool gBallsTouching = false;            //the stylus (or held ball) touches a ball
+//the fluid replacing the balls while on (menu), stepped by a thread of
+// its own; the servo callback feels it through SphFluid's force model
+SphFluid gFluid;
+bool gFluidOn = false;
+bool gFluidFilled = false;
+//the scene graph: the cube turned by the camera, and the balls in the
+// frame of the device (not turned); ball k is node CUBE_NUM_NODES + k
+enum CubeNode
+{
+    CUBE_NODE_ROOM = 0,         //the wire cube
+    CUBE_NODE_ROOM_AXES,
+    CUBE_NODE_BALLS,            //the frame of the balls
+    CUBE_NODE_BALL_AXES,        //with the original ball
+    CUBE_NUM_NODES
+};
+SceneNode gSceneNodes[CUBE_NUM_NODES + BALL_MAX];
+int gSceneDrawList[CUBE_NUM_NODES + BALL_MAX];
+SceneGraph gScene;
+ConstraintSet gCubeWalls;   //the six walls of the cube, facing in (read by the servo too)
+int gPosePrediction = POSE_PREDICT_LINEAR;  //how the drawn stylus pose is predicted (menu)
+PresentEstimator gPresentEstimator = { 0, 0 };  //when the frames reach the screen
+//double wallForce[3] = {0,0,0};
+
+//Camera Attributes (Rotation/Scaling on the centre sphere)
+double CamRotationY = 0;            //rotation (degrees)
+double CamRotationX = 0;
+double CamZoom = 1;                 //scale factor
+SceneView gSceneView = { 1, 1, NULL };  //what the shapes are tessellated for
+double sphereMass = 1;
+bool gIsRotatingCamera = false;     //flags to indicate which operation to perform
+bool gIsScalingCamera = false;      // according to different mouse clicks.
+bool gIsTranslatingCamera = false;
+
+//for the haptic device
+HHD ghHD = HD_INVALID_HANDLE;   //handle of the device
+HDSchedulerHandle gSchedulerCallback = HD_INVALID_HANDLE;   //handle of the scheduler
+DeviceStateMapping gDeviceStatePublisher;   //shared memory the servo publishes to
+//the work of the servo callback (tasks set up in setupServoTasks): the
+// device state is read into the frame at the start of the tick and the
+// force sent from it at the end, so the tasks never talk to the device
+struct ServoFrame
+{
+    hduVector3Dd pos;           //stylus tip read at the start of the tick
+    double transform[16];       //and its transformation,
+    double jointAngles[3];      // the joint and gimbal angles
+    double gimbalAngles[3];
+    int buttons;                // and the buttons
+    hduVector3Dd forceVec;      //force sent to the device
+};
+ServoScheduler gServoScheduler;
+ServoFrame gServoFrame;                 //servo thread only
+
+//*****************************************************************************
+//                USER-DEFINED CLASS
+//*****************************************************************************
+
+//*****************************************************************************
+//                UTILITY FUNCTION PROTOTYPES
+//*****************************************************************************
+
+//=====================================================================
+//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
+//=====================================================================
+
+//This procedure intializes the GLUT setting.  It creates the graphics window
+// and assigns functions for display, mouse click, mouse movement, and popup menu.
+void initGlut(int argc, char* argv[]);
+
+//This procedure detects which mouse button is clicked and sets the
+// appropriate flags to indicate which event should occur.
+void MyGlutMouse(int button, int state, int x, int y);
+
+//This procedure detects the motion of the mouse (i.e. dragging"),
+// and performs operations depending on how the mouse is dragged
+// and which flag is set.
+void MyGlutMotion(int x, int y);
+
+//This function takes care of operations to perform when the program is idle.
+void MyGlutIdle(void);
+
+//This procedure sets up the functionalities of the menu items of the popup
+// menus when a mouse button is clicked.
+//For this example, both menu items display certain texts.
+void MyGlutMenu(int ID);
+
+// This handler gets automatically called when the program is exiting. 
+//  The program ensures that the haptic device and the scheduler are
+//  properly shutdown
+void __cdecl exitHandler();
+
+//This function starts the worker threads of the ball simulation the
+// first time it is called, and returns their pool.
+TaskPool& startTaskPool();
+
+
+//=====================================================================
+//     <HAPTICS>:FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
+//=====================================================================
+
+//This procedure sends to the scheduler a task (i.e. a callback function)
+// that updates the force feedback of the device continuously.
+void ScheduleForceFeedback();
+
+//This procedure sets up the tasks of the servo callback, most important
+// first (also driven by "runServoAllocationCheck").
+void setupServoTasks();
+
+//This is the callback function calculates the force (by calling 
+// "CalculateForce()" and SET the resulting forces to the device.
+//The callback function is scheduled to the scheduler in an "asynchronous"
+// fashion, and the function is called repeatedly each time it finishes.
+HDCallbackCode HDCALLBACK SettingForceCallback(void *data);
+
+//This procedure reads the state of the device the servo tasks use into
+// "frame" (it must be called inside the haptic frame).
+void servoReadDevice(ServoFrame& frame);
+
+//This procedure performs the work of one servo tick: given the current
+// stylus tip position, it computes the force to be sent to the device.
+//It doesn't talk to the device, so it can also be driven by simulated ticks.
+void ServoTick(const hduVector3Dd& pos, hduVector3Dd& forceVec);
+
+//These procedures are the tasks of the servo callback (see ServoScheduler.h),
+// given the ServoFrame of the tick: the force (always run), the pose history and publishing the device
+// state (skipped when the tick is late) and the event log (deferred when
+// the tick is late).
+void servoForceTask(void* data, double now, double elapsed);
+void servoPoseTask(void* data, double now, double elapsed);
+void servoPublishTask(void* data, double now, double elapsed);
+void servoEventTask(void* data, double now, double elapsed);
+
+//This procedure publishes the device state of the current servo tick to
+// the shared memory.
+void publishDeviceState(double now, const ServoFrame& frame);
+
+//This callback function has the responsibility of GETTING haptic device data that is
+// constantly modified by the device. 
+//In the main graphics loop function, this callback function is scheduled 
+// to the scheduler in a "synchronous" fashion.  
+HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData);
+
+//This function calculates the force vector to be sent to the haptic device.
+//Currently, the force is calculated based on the current position of the 
+// device cursor and Coulomb's Law.
+hduVector3Dd CalculateForce(const double* ballPosition, double ballRadius);
+
+//This procedure builds the walls of the cube as planes of "gCubeWalls".
+void buildCubeWalls();
+
+//=====================================================================
+//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
+//=====================================================================
+
+//This procedure sets up the viewing condition for the scene to be drawn.
+//This procedure uses the haptic device coordinate space as model space 
+// of our scene.  An orthographic projection is defined to fit this space.
+//NOTE: LLB means Low, Left, Back point of device workspace.
+//      TRF means Top, Right, Front point of device workspace. 
+void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3]);
+
+//This procedure sets up the lighting (and shading) conditions 
+// for the scene to be drawn.
+void initGraphicsLighting();
+
+//This is the main display looping function that is run and draws the 
+// screen continuously.
+//Currently this function draws one fixed sphere (with axes), one movable
+// sphere (with axes), and an arrow (representing the force).
+void MyGlutDisplay(void);
+
+//This procedure draws the X,Y,Z axis for the current coordinate frame.
+void drawAxes();
+
+//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
+// of the current coordinate frame.
+void drawFixedSphere(GLUquadricObj* quadObj);
+
+//This procedure draws the "movable sphere" that corresponds to the cursor
+// of the haptic device.
+void drawMovableSphere(GLUquadricObj* quadObj,
+                       const double transform[16],
+                       HDint button_state);
+
+//This procedure draws the visual representation (an arrow) that represents
+// the magnitude and direction of the Coulomb Force.
+void drawForceVisualRepresentation(GLUquadricObj* quadObj,
+                                   const double position[3],                       
+                                   const double strength);
+
+
+//This procedure grabs/releases the balls with the stylus, steps their
+// simulation and passes what the servo callback needs on to it.
+void updateBalls(const HapticDeviceState& state);
+
+//This procedure moves and colours the nodes of the balls (adding or
+// removing nodes as balls were).  "drawTransform" is the (predicted)
+// stylus transform the held ball is drawn with.
+void poseBalls(const HapticDeviceState& state, const double drawTransform[16]);
+
+//This procedure highlights the walls of the cube the held ball touches.
+void drawWallHighlights();
+
+//This procedure builds the scene graph: the cube and the frame of the
+// balls (their nodes are added as they are).
+void buildScene();
+
+//This procedure adds "count" small balls at random places in the cube.
+void addBalls(long count);
+
+//This procedure swaps the balls for the fluid, or back.
+void toggleFluid();
+
+//This procedure draws the fluid particles.
+void drawFluid();
+
+//This procedure computes the stylus transform to draw this frame: the
+// servo pose history extrapolated to when the frame will be seen.
+void predictStylusTransform(const HapticDeviceState& state, double transform[16]);
+
+//This function returns the distance between the stylus tip and the centre
+// of the ball.
+double ballContactDistance(const double position[3], const double ballPosition[3]);
+
+//=====================================================================
+//    <BENCHMARK>: MICRO-BENCHMARKS OF THE HOT PATHS ("-bench" mode)
+//=====================================================================
+
+
+//This procedure times the force and contact detection kernels and
+// (optionally) writes the results as JSON.  It runs without the
+// haptic device and without opening a window.
+int runBenchmarks(const char* jsonPath, const char* executable);
+
+//This function drives the tasks of the servo callback through many
+// simulated ticks and returns the number of heap allocations made inside
+// them (which must be zero).
+long runServoAllocationCheck(long ticks);
+//void drawHollowCube();
+//*****************************************************************************
+//                THE MAIN FUNCTION - (this is where things start...)
+//*****************************************************************************
+int main(int argc, char* argv[])
+{
+    HDErrorInfo error;
+
+    //Count (or trap) any heap allocation made inside the servo callback.
+    servoAllocTrackerInstall();
+
+    //the original ball, in the middle of the cube
+    double ballStart[3] = {0, 0, 0};
+    ballWorldInit(gBalls, CUBE_SIZE, SMALL_BALL_RADIUS, NULL);
+    ballWorldAdd(gBalls, ballStart, BALL_RADIUS);
+    buildScene();
+    buildCubeWalls();
+
+    //"myFirstProject -bench [results.json]" only runs the micro-benchmarks
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+        return runBenchmarks(argc > 2 ? argv[2] : NULL, argv[0]);
+
+    printf("ENSC488 - Haptic Device Sample Program\n\n");
+    printf("Starting application\n");
+
+    //"-latency [frames.csv]" (after any other option) measures the
+    // motion-to-photon latency of every frame
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-latency") != 0)
+            continue;
+        const char* csvPath = (a + 1 < argc && argv[a + 1][0] != '-') ? argv[a + 1] : NULL;
+        if (latencyProbeStart(gLatencyProbe, csvPath))
+            printf("Measuring motion-to-photon latency (reported on exit)\n");
+    }
+    
+    //Set up the TERMINATION procedures when program finishes.
+    //Things to take care of including shutting down the haptic device and scheduler.
+    atexit(exitHandler);
+
+    //Initialize the haptic device.  This needs to be called before any actions on 
+    // the device.
+    ghHD = hdInitDevice(HD_DEFAULT_DEVICE);
+    //Check for any initialization error.  If so, terminate the program.
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to initialize haptic device");
+        fprintf(stderr, "\nPress any key to quit.\n");
+        getch();
+        return -1;
+    }
+
+    //Retrieve and display the model name of the haptic device.
+    printf("Found device %s\n",hdGetString(HD_DEVICE_MODEL_TYPE));
+    
+    //Enable haptic force feedback
+    hdEnable(HD_FORCE_OUTPUT);
+    hdEnable(HD_MAX_FORCE_CLAMPING);
+
+    //Find the workspace of the robotic links of the haptic device.
+    //The workspace is defined by two vertices: the Low Left Back point
+    // and the Top Right Front point.
+    printf("The workspace two corner vertices are:\n");
+    HDdouble maxWorkspace[6];
+    hdGetDoublev(HD_MAX_WORKSPACE_DIMENSIONS, maxWorkspace);
+    printf("%lf %lf %lf %lf %lf %lf\n", maxWorkspace[0],
+           maxWorkspace[1],
+           maxWorkspace[2],
+           maxWorkspace[3],
+           maxWorkspace[4],
+           maxWorkspace[5]);
+    printf("\n");
+
+    //Start the scheduler of the haptic device.
+    hdStartScheduler();
+    //Check if the scheduler is initialized properly.
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to start scheduler");
+        fprintf(stderr, "\nPress any key to quit.\n");
+        getch();
+        return -1;
+    }
+    
+    //Initializes all GLUT related functions.
+    initGlut(argc, argv);
+
+    //Based on the workspace of the haptic device,
+    // set the viewing volumn of the scene to correspond
+    // to this workspace.
+    //Low, Left, Back point of device workspace.
+    hduVector3Dd LLB; 
+    LLB.set(maxWorkspace[0], maxWorkspace[1], maxWorkspace[2]);
+    //Top, Right, Front point of device workspace.
+    hduVector3Dd TRF;
+    TRF.set(maxWorkspace[3], maxWorkspace[4], maxWorkspace[5]);
+    //Initializes the viewing condition for the scene
+    initGraphicsViewing(LLB, TRF);
+
+    //Initializes the lighting condition for the scene
+    initGraphicsLighting();
+
+
+    //Schedule the force feedback process to the scheduler
+    std::cout << "Starting haptics callback..." << std::endl;
+    //Publish the device state for other processes (loggers, dashboards).
+    if (deviceStateMap(&gDeviceStatePublisher, 1) != 0)
+        fprintf(stderr, "Warning: cannot publish the device state to shared memory\n");
+
+    ScheduleForceFeedback();
+
+    //Enter the main loop for drawing the scene
+    std::cout << "Starting graphics callback..." << std::endl;
+    glutMainLoop(); //This is the "famous" GLUT infinite loop
+                    // that runs forever unless the program exits.
+
+    printf("Done\n");
+    return 0;
+}
+
+/******************************************************************************/
+
+
+//=====================================================================
+//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
+//=====================================================================
+
+//This procedure intializes the GLUT setting.  It creates the graphics window
+// and assigns functions for display, mouse click, mouse movement, and popup menu.
+void initGlut(int argc, char* argv[])
+{
+    glutInit(&argc, argv);          // Initialize GLUT.
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+    glutInitWindowSize(500, 500);   //graphics window creation
+    glutCreateWindow("Haptic Device Demo - Coulomb Force");
+
+    glutDisplayFunc(MyGlutDisplay);   //GLUT callback - display or draw scene
+    //glutReshapeFunc(reshape);
+    glutMouseFunc(MyGlutMouse);       //GLUT callback - mouse button detection
+    glutMotionFunc(MyGlutMotion);     //GLUT callback - mouse button movement
+    glutIdleFunc(MyGlutIdle);         //GLUT callback - idle operations
+
+    glutCreateMenu(MyGlutMenu);       //GLUT callback - Setup GLUT popup menu
+    glutAddMenuEntry("How to Play", 0);
+	glutAddMenuEntry("Increase Sphere Mass", 1);
+	glutAddMenuEntry("Decrese Sphere Mass", 2);
+    glutAddMenuEntry("About", 3);
+    glutAddMenuEntry("Toggle Passivity Control", 4);
+    glutAddMenuEntry("Cycle Pose Prediction", 5);
+    glutAddMenuEntry("Add Balls", 6);
+    glutAddMenuEntry("Remove Added Balls", 7);
+    glutAddMenuEntry("Toggle Fluid", 8);
+    glutAddMenuEntry("Servo Task Costs", 9);
+    glutAttachMenu(GLUT_RIGHT_BUTTON);//Right click the mouse to launch the popup menu
+
+}//END of initGlut
+
+
+//This procedure detects which mouse button is clicked and sets the
+// appropriate flags to indicate which event should occur.
+void MyGlutMouse(int button, int state, int x, int y)
+{
+    if (state == GLUT_DOWN)
+    {   //some mouse button is pressed
+        if (button == GLUT_LEFT_BUTTON)
+        {   //Left click the mouse to rotate the centre sphere.
+            gIsRotatingCamera = true;            
+        }
+        else if (button == GLUT_MIDDLE_BUTTON)
+        {   //Click the centre button to scale the centre sphere.
+            gIsScalingCamera = true;            
+        }
+
+        //record the current mouse PIXEL location
+        gLastMouseX = x;
+        gLastMouseY = y;
+    }
+    else
+    {   //no mouse button is pressed...
+        gIsRotatingCamera = false;
+        gIsScalingCamera = false;
+        gIsTranslatingCamera = false;
+    }
+}//END of MyGlutMouse
+
+
+//This procedure detects the motion of the mouse (i.e. dragging"),
+// and performs operations depending on how the mouse is dragged
+// and which flag is set.
+void MyGlutMotion(int x, int y)
+{
+    if (gIsRotatingCamera)
+    {   
+        //rotate the centre sphere
+        //dragging the mouse horizontally rotates the object about Y axis
+        CamRotationY = CamRotationY + 0.1*(x - gLastMouseX);
+        //dragging the mouse vertically rotates the object about X axis
+        CamRotationX = CamRotationX + 0.1*(y - gLastMouseY);
+    }
+    else if (gIsScalingCamera)
+    {
+        //dragging the mouse vertically scales the object up or down.
+        CamZoom = CamZoom - 0.01*(y - gLastMouseY);
+    }
+
+    //record the current mouse PIXEL position.
+    gLastMouseX = x;
+    gLastMouseY = y;
+}//END of MyGlutMotion
+
+
+//This function takes care of operations to perform when the program is idle.
+void MyGlutIdle(void)
+{
+    //redisplay the scene
+    glutPostRedisplay();
+
+    //print the errors/events queued by the servo callback
+    servoEventDrain(stderr);
+
+    //report any heap allocation the servo callback has made since last time
+    static long reportedServoAllocs = 0;
+    if (gServoAllocCount != reportedServoAllocs)
+    {
+        reportedServoAllocs = gServoAllocCount;
+        fprintf(stderr, "Warning: %ld heap allocation(s) inside the servo callback"
+                " (last one %ld bytes)\n", reportedServoAllocs, gServoAllocLastSize);
+    }
+
+    //check if the scheduler has exited... if so, terminate program as well.
+    if (!hdWaitForCompletion(gSchedulerCallback, HD_WAIT_CHECK_STATUS))
+    {
+        printf("The main scheduler callback has exited\n");
+        printf("Press any key to quit.\n");
+        getch();
+        exit(-1);
+    }
+}//END of MyGlutIdle
+
+
+//This procedure sets up the functionalities of the menu items of the popup
+// menus when a mouse button is clicked.
+//For this example, both menu items display certain texts.
+void MyGlutMenu(int ID)
+{
+    switch(ID) 
+    {
+        case 0: //"How to Play" information in the popup menu.
+            
+            break;
+        case 1: //Increase mass
+            sphereMass ++;
+            break;
+		case 2: //Decrease mass
+            sphereMass --;
+			if (sphereMass < 0)
+				sphereMass = 0;
+			break;
+
+		case 3: //"About" information in the popup menu
+            
+        break;
+
+        case 4: //Passivity control on/off (the observer always runs)
+            gPassivity.enabled = !gPassivity.enabled;
+            printf("Passivity control %s (%.1f mJ dissipated so far)\n",
+                   gPassivity.enabled ? "on" : "off", gPassivity.dissipated);
+            break;
+
+        case 5: //Pose prediction: off -> linear -> constant acceleration
+        {
+            static const char* modeNames[POSE_PREDICT_NUM_MODES] =
+                { "off", "linear", "constant acceleration" };
+            gPosePrediction = (gPosePrediction + 1) % POSE_PREDICT_NUM_MODES;
+            printf("Pose prediction: %s (frames take %.1f ms to reach the swap)\n",
+                   modeNames[gPosePrediction], gPresentEstimator.drawToSwap * 1000);
+            break;
+        }
+
+        case 6: //more balls, simulated on all the cores
+            gBalls.pool = &startTaskPool();
+            addBalls(BALLS_PER_ADD);
+            printf("%ld balls\n", gBalls.count);
+            break;
+
+        case 7: //back to the original ball alone
+            ballWorldTruncate(gBalls, 1);
+            break;
+
+        case 8: //the fluid instead of the balls, or back
+            toggleFluid();
+            break;
+
+        case 9: //what the tasks of the servo callback cost so far
+            servoSchedulerPrint(gServoScheduler, stdout);
+            break;
+    }
+}//END of MyGlutMenu      
+
+
+// This handler gets automatically called when the program is exiting. 
+//  The program ensures that the haptic device and the scheduler are
+//  properly shutdown
+void __cdecl exitHandler()
+{
+    //stop the scheduler and cleans up any unfinished jobs on the scheduler.
+    hdStopScheduler();
+    hdUnschedule(gSchedulerCallback);
+
+    //the servo callback has stopped, so nothing publishes any more
+    deviceStateClose(&gDeviceStatePublisher);
+
+    //print whatever the servo callback reported last
+    servoEventDrain(stderr);
+
+    //report the latency measurements, if any
+    latencyProbeFinish(gLatencyProbe, stdout);
+
+    //and what the servo tasks cost
+    if (gServoScheduler.ticks > 0)
+        servoSchedulerPrint(gServoScheduler, stdout);
+
+    //stop the fluid thread, then the workers it and the balls use
+    sphFluidStop(gFluid);
+    if (gTaskPoolStarted)
+        taskPoolStop(gTaskPool);
+
+    //if the haptic device hasn't been disabled yet, disable it now.
+    if (ghHD != HD_INVALID_HANDLE)
+    {
+        hdDisableDevice(ghHD);
+        ghHD = HD_INVALID_HANDLE;
+    }
+}//END of exitHandler
+
+
+//This function starts the worker threads of the ball simulation the
+// first time it is called, and returns their pool.  (If no thread can be
+// started, the pool runs everything on the graphics loop.)
+TaskPool& startTaskPool()
+{
+    if (!gTaskPoolStarted)
+    {
+        gTaskPoolStarted = true;
+        if (taskPoolStart(gTaskPool, 0, 0))
+            printf("%d ball simulation worker(s)\n", gTaskPool.workerCount);
+        else
+            fprintf(stderr, "Failed to start the ball simulation workers\n");
+    }
+    return gTaskPool;
+}//END of startTaskPool
+
+
+//=====================================================================
+//   <HAPTICS>: FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
+//=====================================================================
+
+//This procedure sends to the scheduler a task (i.e. a callback function)
+// that updates the force feedback of the device continuously.
+void ScheduleForceFeedback()
+{
+    setupServoTasks();
+
+    //schedule asynchronously to the scheduler a process for setting forces.
+    gSchedulerCallback = hdScheduleAsynchronous(
+        SettingForceCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY);
+
+    //checks if the process is scheduled successfully
+    HDErrorInfo error;
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to initialize haptic device");
+        fprintf(stderr, "\nPress any key to quit.\n");
+        getch();
+        exit(-1);
+    }
+
+}//END of ScheduleForceFeedback
+
+
+//This procedure sets up the tasks of the servo callback, most important
+// first (also driven by "runServoAllocationCheck").
+void setupServoTasks()
+{
+    servoSchedulerInit(gServoScheduler, SERVO_SCHED_TICK_BUDGET);
+    servoSchedulerAdd(gServoScheduler, "force", servoForceTask, &gServoFrame, 0, SERVO_TASK_ALWAYS, 100);
+    servoSchedulerAdd(gServoScheduler, "pose", servoPoseTask, &gServoFrame, 1, SERVO_TASK_SKIP, 10);
+    servoSchedulerAdd(gServoScheduler, "publish", servoPublishTask, &gServoFrame, 2, SERVO_TASK_SKIP, 20);
+    servoSchedulerAdd(gServoScheduler, "events", servoEventTask, NULL, 3, SERVO_TASK_DEFER, 10);
+}
+
+
+//This is the callback function calculates the force (by calling 
+// "CalculateForce()" and SET the resulting forces to the device.
+//The callback function is scheduled to the scheduler in an "asynchronous"
+// fashion, and the function is called repeatedly each time it finishes.
+HDCallbackCode HDCALLBACK SettingForceCallback(void *)
+{
+    //the servo thread must not touch the heap (see ServoAllocTracker.h)
+    ServoAllocScope allocScope;
+
+    //get a "handle" on the current haptic device
+    HHD hHD = hdGetCurrentDevice();
+
+    //NOTE: Setting forces must be in between the "hdBeginFrame()"
+    // and "hdEndFrame()".  Between these two lines, the haptic status
+    // (forces) is constant.
+    hdBeginFrame(hHD);
+
+    //Obtain the current position of the tip of the stylus (and the rest
+    // of the device state)
+    servoReadDevice(gServoFrame);
+
+    //Calculate the force vector, then whatever else the tick has time for
+    // (see setupServoTasks), and set the force vector to the haptic device.
+    servoSchedulerRun(gServoScheduler, servoClockSeconds());
+    hdSetDoublev(HD_CURRENT_FORCE, gServoFrame.forceVec);
+
+    hdEndFrame(hHD);
+
+    //Check if the scheduler returns any error when executing this process...
+    //NOTE: the error is only queued here; printing it (blocking console I/O)
+    // is left to the graphics loop, see ServoEventLog.h
+    HDErrorInfo error;
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        servoEventPostError(&error, "Error during scheduler callback");
+
+        if (hduIsSchedulerError(&error))
+        {
+            //if there is error in scheduler, terminates (by force) the current
+            // process
+            return HD_CALLBACK_DONE;
+        }
+    }
+
+    //continue executing the setting up of the force feedback
+    // by telling the scheduler to repeat on the process after it is completed
+    // each time.
+    //NOTE: this is how we can have a process to set up device forces that runs
+    // in parallel with other (graphics, getting data) processes.
+    return HD_CALLBACK_CONTINUE;
+}//END of SettingForceCallback
+
+
+//This procedure reads the state of the device the servo tasks use into
+// "frame" (it must be called inside the haptic frame).
+void servoReadDevice(ServoFrame& frame)
+{
+    hdGetDoublev(HD_CURRENT_POSITION, frame.pos);
+    hdGetDoublev(HD_CURRENT_TRANSFORM, frame.transform);
+    hdGetDoublev(HD_CURRENT_JOINT_ANGLES, frame.jointAngles);
+    hdGetDoublev(HD_CURRENT_GIMBAL_ANGLES, frame.gimbalAngles);
+    hdGetIntegerv(HD_CURRENT_BUTTONS, &frame.buttons);
+}
+
+
+//This procedure performs the work of one servo tick: given the current
+// stylus tip position, it computes the force to be sent to the device.
+//It doesn't talk to the device, so it can also be driven by simulated ticks.
+void ServoTick(const hduVector3Dd& pos, hduVector3Dd& forceVec)
+{
+    //the wall forces act on the ball, which follows the stylus while attached
+    forceVec = CalculateForce(gHeldBallPosition, gHeldBallRadius);
+
+    //and the balls the stylus (or that ball) pushes push back
+    forceVec[0] += gBallPushForce[0];
+    forceVec[1] += gBallPushForce[1];
+    forceVec[2] += gBallPushForce[2];
+
+    //or the fluid does (from the model its thread last handed over)
+    if (gFluidOn)
+    {
+        double fluidForce[3];
+        sphServoForce(gFluid.coupling, servoClockSeconds(), pos, fluidForce);
+        forceVec[0] += fluidForce[0];
+        forceVec[1] += fluidForce[1];
+        forceVec[2] += fluidForce[2];
+    }
+}//END of ServoTick
+
+
+//This procedure is the force task of the servo callback: computes the
+// force and filters it (the callback sends it to the device).
+void servoForceTask(void* data, double now, double)
+{
+    ServoFrame& frame = *static_cast<ServoFrame*>(data);
+    ServoTick(frame.pos, frame.forceVec);
+    //the ball is moved by the graphics loop, so while it is attached the
+    // force is only valid as long as the graphics keep running
+    servoWatchdogFilter(gServoWatchdog, now, frame.forceVec, ballAttached || gBallsTouching);
+    //remove any energy the (step-like) walls have injected, last, so the
+    // observer sees the force actually sent
+    passivityFilter(gPassivity, now, frame.pos, frame.forceVec);
+}//END of servoForceTask
+
+
+//This procedure is the pose history task of the servo callback: keeps
+// the stylus poses the graphics loop predicts from.
+void servoPoseTask(void* data, double now, double)
+{
+    ServoFrame& frame = *static_cast<ServoFrame*>(data);
+    poseHistoryPush(gPoseHistory, now, frame.transform);
+}
+
+
+//This procedure is the publishing task of the servo callback.
+void servoPublishTask(void* data, double now, double)
+{
+    ServoFrame& frame = *static_cast<ServoFrame*>(data);
+    if (gDeviceStatePublisher.shm != NULL)
+        publishDeviceState(now, frame);
+}
+
+
+//This procedure is the event log task of the servo callback.
+void servoEventTask(void*, double, double)
+{
+    servoEventPoll();
+}
+
+
+//This procedure publishes the device state of the current servo tick to
+// the shared memory.
+void publishDeviceState(double now, const ServoFrame& frame)
+{
+    DeviceStateRecord record;
+    record.time = now;
+    for (int i = 0; i < 3; i++)
+    {
+        record.position[i] = frame.pos[i];
+        record.jointAngles[i] = frame.jointAngles[i];
+        record.gimbalAngles[i] = frame.gimbalAngles[i];
+        record.force[i] = frame.forceVec[i];
+    }
+    memcpy(record.transform, frame.transform, sizeof(record.transform));
+    record.buttons = frame.buttons;
+    record.reserved = 0;
+
+    //the readers never hold the servo up, see DeviceStateShm.h
+    deviceStatePublish(gDeviceStatePublisher.shm, &record);
+}//END of publishDeviceState
+
+
+//This callback function has the responsibility of GETTING haptic device data that is
+// constantly modified by the device. 
+//In the main graphics loop function, this callback function is scheduled 
+// to the scheduler in a "synchronous" fashion.  
+HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData)
+{
+    //rename the variable and type cast it as the user
+    // defined data structure "HapticDeviceState"
+    HapticDeviceState *pDisplayState = 
+        static_cast<HapticDeviceState *>(pUserData);
+    pDisplayState->sample_time = servoClockSeconds();
+
+    //Get current stylus tip position
+    hdGetDoublev(HD_CURRENT_POSITION, pDisplayState->position);
+    //Get the overal transformation matrix for the stylus tip.
+    hdGetDoublev(HD_CURRENT_TRANSFORM, pDisplayState->transform_matrix);
+    //Get the force vector that is currently set in the haptic device
+    hdGetDoublev(HD_CURRENT_FORCE, pDisplayState->force);
+    //Get the info on which button of the stylus is pressed.
+    hdGetIntegerv(HD_CURRENT_BUTTONS, &pDisplayState->button);
+
+    //Execute this only once - since we are already doing it repeatedly (inside
+    // the GlutDisplay function)
+    return HD_CALLBACK_DONE;
+
+}//END of GettingDeviceStateCallback
+
+
+
+//This function calculates the force vector to be sent to the haptic device.
+//Currently, the force is calculated based on the current position of the 
+// device cursor and Coulomb's Law.
+hduVector3Dd CalculateForce(const double* ballPosition, double ballRadius)
+{
+	hduVector3Dd forceVec(0, 0, 0);
+	if (ballAttached){
+		//Calculating wall force
+		double wallForce[3];
+		constraintForce(gCubeWalls, ballPosition, ballRadius, wallForce);
+		forceVec.set(wallForce[0], wallForce[1], wallForce[2]);
+
+		//Add force for gravity
+		forceVec[1] += - sphereMass; 
+	}
+    return forceVec;
+}//END of CalculateForce
+
+
+//This procedure builds the walls of the cube as planes of "gCubeWalls":
+// each pushes the held ball back with 10 N as soon as it touches.
+void buildCubeWalls()
+{
+    constraintSetInit(gCubeWalls, 10, 0);
+    for (int i = 0; i < 3; i++)
+        for (int side = -1; side <= 1; side += 2)
+        {
+            double normal[3] = {0, 0, 0};
+            normal[i] = -side;
+            constraintAddPlane(gCubeWalls, normal, -CUBE_SIZE/2);
+        }
+}//END of buildCubeWalls
+
+
+
+
+//=====================================================================
+//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
+//=====================================================================
+
+//This procedure sets up the viewing condition for the scene to be drawn.
+//This procedure uses the haptic device coordinate space as model space 
+// of our scene.  An orthographic projection is defined to fit this space.
+//NOTE: LLB means Low, Left, Back point of device workspace.
+//      TRF means Top, Right, Front point of device workspace. 
+void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3])
+{
+    glMatrixMode(GL_PROJECTION); /* Setup perspective projection. */
+    glLoadIdentity();
+
+    //Find the (Cartesian) centre point of the device workspace.
+    HDdouble centerScreen[3];
+    centerScreen[0] = (TRF[0] + LLB[0])/2.0;
+    centerScreen[1] = (TRF[1] + LLB[1])/2.0;
+    centerScreen[2] = (TRF[2] + LLB[2])/2.0;
+
+    //According to the haptic device workspace, set the view volumn 
+    // (screen dimension).
+    HDdouble screenDims[3];
+    screenDims[0] = TRF[0] - LLB[0];
+    screenDims[1] = TRF[1] - LLB[1];
+    screenDims[2] = TRF[2] - LLB[2];
+
+    //find the dimension corresponding to the larger "range" 
+    // between the X and Y directions
+    HDdouble maxDimXY = (screenDims[0] > screenDims[1] ? screenDims[0]:screenDims[1]);
+    //find the dimension corresponding to the larger "range" 
+    // among the X, Y, and Z directions
+    HDdouble maxDim = (maxDimXY > screenDims[2] ? maxDimXY:screenDims[2]);
+    maxDim /= 2.0;
+
+    //orthographic projection (1st parameter has largest "range", and so on...)
+    glOrtho(centerScreen[0]-maxDim, centerScreen[0]+maxDim, 
+             centerScreen[1]-maxDim, centerScreen[1]+maxDim,
+             centerScreen[2]-maxDim, centerScreen[2]+maxDim);
+    sceneViewInit(gSceneView, 2 * maxDim, drawAxes);
+    
+    //for testing only...
+//    printf("glortho %lf %lf %lf %lf %lf %lf\n",
+//           centerScreen[0]-maxDim, centerScreen[0]+maxDim, 
+//           centerScreen[1]-maxDim, centerScreen[1]+maxDim,
+//           centerScreen[2]-maxDim, centerScreen[2]+maxDim);
+
+ 
+    glMatrixMode(GL_MODELVIEW); // Setup model transformations. 
+    glLoadIdentity();
+
+    glClearDepth(1.0); // Setup background colour. 
+    glClearColor(0.7, 0.7, 0.7, 0);
+    glDisable(GL_DEPTH_TEST);
+
+}//END of initGraphicsWorkspace
+
+
+//This procedure sets up the lighting (and shading) conditions 
+// for the scene to be drawn.
+void initGraphicsLighting()
+{
+    //smooth (interpolated) shading
+    glShadeModel(GL_SMOOTH);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_NORMALIZE);
+    glEnable(GL_LIGHT_MODEL_TWO_SIDE);
+    
+    GLfloat lightZeroPosition[] = {10.0, 4.0, 100.0, 0.0};
+    GLfloat lightZeroColor[] = {0.6, 0.6, 0.6, 1.0}; //grey light
+    GLfloat lightOnePosition[] = {-1.0, -2.0, -100.0, 0.0};
+    GLfloat lightOneColor[] = {0.6, 0.6, 0.6, 1.0};  //grey light as well
+    
+    GLfloat light_ambient[] = {0.8, 0.8, 0.8, 1.0}; //Ambient lighting (grey)
+    GLfloat light_diffuse[] = {0.0, 0.0, 0.0, 1.0}; //Diffuse lighting (none)    
+    GLfloat light_position[] = {0.0, 0.0, 100.0, 1.0}; //light source far away
+    
+    glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, 1);
+    glLightfv(GL_LIGHT0, GL_POSITION, lightZeroPosition);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, lightZeroColor);
+    glLightfv(GL_LIGHT1, GL_POSITION, lightOnePosition);
+    glLightfv(GL_LIGHT1, GL_DIFFUSE, lightOneColor);
+    glEnable(GL_LIGHT0);    //enable light0
+    glEnable(GL_LIGHT1);    //enable light1
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+
+}//END of initGraphicsLighting
+
+
+//This is the main display looping function that is run and draws the 
+// screen continuously.
+//Currently this function draws one fixed sphere (with axes), one movable
+// sphere (with axes), and an arrow (representing the force).
+void MyGlutDisplay(void)
+{
+    //let the servo watchdog know the scene is still being updated
+    servoWatchdogFeedGraphics(gServoWatchdog);
+    //(the window may have been resized)
+    sceneViewSetWindow(gSceneView, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    presentFrameStart(gPresentEstimator, servoClockSeconds());
+
+    glMatrixMode(GL_MODELVIEW); // Setup model transformations.
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glLoadIdentity();
+    //need to enable "colour material" in order to see the
+    // different surfaces of objects having different colours (shades)
+    glEnable(GL_COLOR_MATERIAL);
+
+    //the camera turns the cube
+    double camera[16];
+    matIdentity(camera);
+    matRotate(camera, 15, 1, 1, 1);
+    matRotate(camera, CamRotationY, 0, 1, 0);
+    matRotate(camera, CamRotationX, 1, 0, 0);
+    matScale(camera, CamZoom, CamZoom, CamZoom);
+    sceneSetLocal(gScene, CUBE_NODE_ROOM, camera);
+
+   // drawHollowCube();
+    //Draw the end effector (sphere) and the arrow
+    // Get the current position/orientation of end effector and
+    // the current button state.
+    //A process for getting device data is sent to the scheduler
+    // (synchronously).
+    HapticDeviceState state;
+    hdScheduleSynchronous(GettingDeviceStateCallback, &state,
+                          HD_MIN_SCHEDULER_PRIORITY);
+    latencyFrameSnapshot(gLatencyProbe, state.sample_time);
+    GLUquadricObj* quadObj = gluNewQuadric();
+
+   //double forceMag = 400.0 * sqrt(state.force[0]*state.force[0] + 
+     //                             state.force[1]*state.force[1] + 
+       //                          state.force[2]*state.force[2]);
+    
+    //draw the stylus where it will be when this frame is seen
+    double drawTransform[16];
+    predictStylusTransform(state, drawTransform);
+
+    //grab/release and move the balls, then draw them (or the fluid)
+    // with the cube
+    if (!gFluidOn)
+    {
+        updateBalls(state);
+        poseBalls(state, drawTransform);
+    }
+    sceneSetVisible(gScene, CUBE_NODE_BALLS, !gFluidOn);
+    sceneUpdate(gScene);
+    drawScene(quadObj, gScene, gSceneView);
+    if (gFluidOn)
+        drawFluid();
+    else
+        drawWallHighlights();
+
+    //draw the sphere (tip of the stylus)
+    drawMovableSphere(quadObj, drawTransform, state.button);
+    //draw the force arrow
+    //drawForceVisualRepresentation(quadObj, state.position, forceMag);
+
+    // Always delete a Quadric (since you previouly dynamically allocated one)
+    gluDeleteQuadric(quadObj);
+
+    glDisable(GL_COLOR_MATERIAL);
+
+    // Double buffers are used to speed things up...
+    latencyFrameDrawn(gLatencyProbe);
+    glutSwapBuffers();
+    latencyFrameSwapped(gLatencyProbe);
+    presentFrameSwapped(gPresentEstimator, servoClockSeconds());
+}//END of MyGlutDisplay
+
+
+//--------------------------------------------------------
+// *** NOTE: The following are the utility functions that
+//   draw the individual objects in the scene. ***
+//--------------------------------------------------------
+
+//This procedure draws the X,Y,Z axis for the current coordinate frame.
+void drawAxes()
+{
+    //disable lighting and material when drawing axes.
+    glDisable(GL_LIGHTING);
+    glDisable(GL_COLOR_MATERIAL);
+    for(int i = 0; i < 3; i++) 
+    {               
+        glColor3fv(AXIS_COLOUR[ i ]);
+        glBegin(GL_LINES);  //draw a line - define two endpoints between
+                            // the "glBegin" and "glEnd" pair
+        glVertex3fv(AXIS_VERTEX[ i ]);
+        glVertex3fv(AXIS_VERTEX[ 3 ]);
+        glEnd();
+    }
+    glEnable(GL_LIGHTING);
+    glEnable(GL_COLOR_MATERIAL);
+
+}//END of drawAxes
+
+
+
+//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
+// of the current coordinate frame.
+void drawFixedSphere(GLUquadricObj* quadObj)
+{
+    //Display a sphere to show the static electric charge (greenish blue).
+    glColor4f(0.2, 0.8, 0.8, 0.8);
+
+    //Draw the center sphere.
+    drawLodSphere(quadObj, SPHERE_RADIUS, modelviewPixelsPerUnit(gSceneView));
+
+}//END of drawFixedSphere
+
+
+//This procedure draws the "movable sphere" that corresponds to the cursor
+// of the haptic device.
+void drawMovableSphere(GLUquadricObj* quadObj,
+                       const double transform[16],
+                       HDint button_state)
+
+{
+   //Display one sphere to represent the haptic cursor and the dynamic 
+   //    charge.
+    glPushMatrix();
+
+    glLoadIdentity();
+    glMultMatrixd(transform);   //transform the movable sphere
+                                // such that its location and orientation
+                                // correponds to those of the stylus of the device.
+
+    drawAxes();
+    if (button_state == 0)  //no button is pressed
+        glColor4f(0.8, 0.2, 0.2, 0.8);      //red colour
+    else if (button_state == 1) //the first (blue) button is pressed
+        glColor4f(0.2, 0.8, 0.2, 0.8);     //green colour
+    else if (button_state == 2) //the second (white) button is pressed
+        glColor4f(0.2, 0.2, 0.8, 0.8);      //blue colour
+
+    drawLodSphere(quadObj, SPHERE_RADIUS, modelviewPixelsPerUnit(gSceneView));
+
+    glPopMatrix();
+
+}//END of drawMovableSphere
+
+
+//This procedure computes the stylus transform to draw this frame: the
+// servo pose history extrapolated to when the frame will be seen.
+void predictStylusTransform(const HapticDeviceState& state, double transform[16])
+{
+    PoseSample samples[3];
+    int count = poseHistoryNewest(gPoseHistory, POSE_PREDICTION_SPAN, samples);
+    if (count == 0)
+    {   //the servo callback hasn't run yet
+        for (int i = 0; i < 16; i++)
+            transform[i] = state.transform_matrix[i];
+        return;
+    }
+    posePredict(samples, count, gPosePrediction, presentEstimate(gPresentEstimator), transform);
+}//END of predictStylusTransform
+
+
+//This procedure draws the visual representation (an arrow) that represents
+// the magnitude and direction of the Coulomb Force.
+void drawForceVisualRepresentation(GLUquadricObj* quadObj,
+                                   const double position[3],                       
+                                   const double strength)
+{
+    //Display the force vector, change the force magnitude/direction
+    // rotote the force vector first. 
+    hduVector3Dd ForceVectorAxis(position); 
+    ForceVectorAxis *= -1;  //points to the opposite direction of "position"
+
+    //normalize the force vector such that its length is 1.
+    hduVector3Dd UnitForceVectorAxis;
+    UnitForceVectorAxis = normalize(ForceVectorAxis);
+
+    //For calculation of rotation angle.
+    hduVector3Dd ZAxis;  //Z axis is chosen because when drawing a cylinder,
+                         // it is drawn along the Z-axis by default.
+    ZAxis.set(0.0, 0.0, 1.0);
+
+    hduVector3Dd ToolRotAxis; 
+    //the tool rotation axis points to direction perpendicular to 
+    // both Z axis and force vector axis
+    ToolRotAxis = crossProduct(ZAxis, ForceVectorAxis);
+        
+    //the angle around the "ToolRotAxis" that will rotate Z axis into 
+    // ForceVectorAxis 
+    double ToolRotAngle = acos(UnitForceVectorAxis[2]);
+    hduMatrix rotMatrix;    
+    //the overall rotation matrix for this force vector is...
+    //NOTE: defined using "equivalent angle axis" theorem.
+    // you don't need to worry about implementation details
+    // just find the axis and angle and use the following function (createRotation)
+    rotMatrix = hduMatrix::createRotation(ToolRotAxis, ToolRotAngle);
+
+    double rotVals[4][4];
+    rotMatrix.get(rotVals); //get the elements of matrix "rotMatrix" and save them
+                            // into a 4 by 4 array (something OpenGL understands)
+    glMultMatrixd((double*)rotVals);
+    double pixelsPerUnit = modelviewPixelsPerUnit(gSceneView);
+
+    //The force arrow: composed of a cylinder and a cone.
+    glDisable(GL_LIGHTING);
+    glColor3f(0.2, 0.7, 0.2);
+    //Draw the cylinder part 
+    // parameters are: object_name, base_radius, top_radius, height, slices, stacks)
+    drawLodCylinder(quadObj, SPHERE_RADIUS*0.1, SPHERE_RADIUS*0.1, strength, pixelsPerUnit);
+    glTranslatef(0, 0, strength);
+    glColor3f(0.2, 0.8, 0.3);
+    //Draw the cone part.
+    drawLodCylinder(quadObj, SPHERE_RADIUS*0.2, 0.0, strength*0.15, pixelsPerUnit);
+    glEnable(GL_LIGHTING);
+}//END of drawForceVisualRepresentation
+
+//This procedure grabs/releases the balls with the stylus, steps their
+// simulation and passes what the servo callback needs on to it.
+void updateBalls(const HapticDeviceState& state)
+{
+    //a button grabs the ball nearest the stylus, if it touches one;
+    // letting go of it throws the ball
+    if (state.button && gBalls.held < 0)
+    {
+        long ball = ballWorldPick(gBalls, state.position, SPHERE_RADIUS);
+        if (ball >= 0)
+            ballWorldHold(gBalls, ball, state.position);
+    }
+    else if (!state.button && gBalls.held >= 0)
+        ballWorldHold(gBalls, -1, state.position);
+
+    double now = servoClockSeconds();
+    double elapsed = (gLastBallStep > 0) ? now - gLastBallStep : 0;
+    gLastBallStep = now;
+    ballWorldStep(gBalls, elapsed, state.position, SPHERE_RADIUS);
+
+    //for the servo callback
+    if (gBalls.held >= 0)
+    {
+        const double* position = ballPosition(gBalls, gBalls.held);
+        for (int i = 0; i < 3; i++)
+            gHeldBallPosition[i] = position[i];
+        gHeldBallRadius = gBalls.radius[gBalls.held];
+    }
+    ballAttached = gBalls.held >= 0;
+    for (int i = 0; i < 3; i++)
+        gBallPushForce[i] = gBalls.pushForce[i];
+    gBallsTouching = gBalls.pushForce[0] != 0 || gBalls.pushForce[1] != 0 || gBalls.pushForce[2] != 0;
+}//END of updateBalls
+
+
+//This procedure adds "count" small balls at random places in the cube.
+void addBalls(long count)
+{
+    for (long n = 0; n < count; n++)
+    {
+        double position[3];
+        for (int i = 0; i < 3; i++)
+            position[i] = (rand() % 1000 / 1000.0 - 0.5) * (CUBE_SIZE - 2*SMALL_BALL_RADIUS);
+        if (ballWorldAdd(gBalls, position, SMALL_BALL_RADIUS) < 0)
+        {
+            printf("No more than %d balls\n", BALL_MAX);
+            break;
+        }
+    }
+}//END of addBalls
+
+
+//This procedure swaps the balls for the fluid, or back.  The fluid is
+// poured the first time, then kept (frozen while off).
+void toggleFluid()
+{
+    if (!gFluidOn)
+    {
+        if (!gFluidFilled)
+        {
+            sphFluidInit(gFluid, CUBE_SIZE, SPHERE_RADIUS, &startTaskPool());
+            sphFluidFill(gFluid, FLUID_PARTICLES, FLUID_WIDTH, FLUID_WIDTH);
+            gFluidFilled = true;
+        }
+        //let go of the balls
+        if (gBalls.held >= 0)
+            ballWorldHold(gBalls, -1, gBalls.stylus);
+        ballAttached = false;
+        gBallsTouching = false;
+        for (int i = 0; i < 3; i++)
+            gBallPushForce[i] = 0;
+        if (!sphFluidStart(gFluid))
+        {
+            fprintf(stderr, "Failed to start the fluid thread\n");
+            return;
+        }
+        gFluidOn = true;
+        printf("%ld fluid particles\n", gFluid.count);
+    }
+    else
+    {
+        gFluidOn = false;
+        sphFluidStop(gFluid);
+        gLastBallStep = 0;      //(the balls pick up from where they were)
+    }
+}//END of toggleFluid
+
+
+//This procedure draws the fluid particles (as its thread last left them;
+// a frame may mix two steps).
+void drawFluid()
+{
+    glPushMatrix();
+    glLoadIdentity();
+    glDisable(GL_LIGHTING);
+    glPointSize(4);
+    glColor4f(0.2, 0.4, 0.9, 0.8);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, gFluid.drawn);
+    glDrawArrays(GL_POINTS, 0, gFluid.count);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glEnable(GL_LIGHTING);
+    glPopMatrix();
+}//END of drawFluid
+
+
+//This procedure moves and colours the nodes of the balls (adding or
+// removing nodes as balls were).  "drawTransform" is the (predicted)
+// stylus transform the held ball is drawn with.
+void poseBalls(const HapticDeviceState& state, const double drawTransform[16])
+{
+    sceneTruncate(gScene, CUBE_NUM_NODES + gBalls.count);
+    while (gScene.count < CUBE_NUM_NODES + gBalls.count)
+        sceneAddNode(gScene, CUBE_NODE_BALLS);
+
+    //the ball a button would grab is drawn red
+    long reachable = (gBalls.held >= 0) ? gBalls.held :
+                     ballWorldPick(gBalls, state.position, SPHERE_RADIUS);
+
+    for (long k = 0; k < gBalls.count; k++)
+    {
+        int node = CUBE_NUM_NODES + k;
+        if (gScene.nodes[node].size[0] != gBalls.radius[k])     //(a new ball)
+            sceneSetShape(gScene, node, SCENE_SHAPE_SPHERE, gBalls.radius[k], 0, 0);
+        if (k == gBalls.held)
+        {   //with the stylus, where it will be when this frame is seen
+            double local[16];
+            memcpy(local, drawTransform, sizeof(local));
+            for (int i = 0; i < 3; i++)
+                local[12+i] -= gBalls.heldOffset[i];
+            sceneSetLocal(gScene, node, local);
+        }
+        else
+        {
+            const double* position = ballPosition(gBalls, k);
+            sceneSetTranslation(gScene, node, position[0], position[1], position[2]);
+        }
+
+        if (k == reachable)
+            sceneSetColour(gScene, node, 0.8, 0.2, 0.2, 0.8);
+        else if (k == 0)
+            sceneSetColour(gScene, node, 0.2, 0.8, 0.8, 0.8);     //default sphere color
+        else
+            sceneSetColour(gScene, node, 0.9, 0.8, 0.3, 0.8);
+    }
+
+    //the axes go with the original ball
+    sceneSetLocal(gScene, CUBE_NODE_BALL_AXES, gScene.nodes[CUBE_NUM_NODES].local);
+}//END of poseBalls
+
+
+//This procedure highlights the walls of the cube the held ball touches.
+void drawWallHighlights()
+{
+    if (!ballAttached)
+        return;
+    ConstraintContact contacts[CONSTRAINT_MAX_CONTACTS];
+    int touching = constraintContacts(gCubeWalls, gHeldBallPosition, gHeldBallRadius,
+                                      contacts, CONSTRAINT_MAX_CONTACTS);
+
+    //(in the frame of the cube) a square the size of the cube on each wall
+    // touched
+    glPushMatrix();
+    glMultMatrixd(sceneWorld(gScene, CUBE_NODE_ROOM));
+    glColor4f(0.3, 1, 1, 1);
+    glBegin(GL_QUADS);
+    for (int c = 0; c < touching; c++)
+    {
+        if (contacts[c].kind != CONSTRAINT_PLANE)
+            continue;
+        double point[3], u[3], v[3];
+        constraintPlaneFrame(gCubeWalls, contacts[c].index, point, u, v);
+        for (int corner = 0; corner < 4; corner++)
+        {
+            double a = (corner == 0 || corner == 3) ? -CUBE_SIZE/2 : CUBE_SIZE/2;
+            double b = (corner < 2) ? -CUBE_SIZE/2 : CUBE_SIZE/2;
+            glVertex3d(point[0] + a*u[0] + b*v[0], point[1] + a*u[1] + b*v[1], point[2] + a*u[2] + b*v[2]);
+        }
+    }
+    glEnd();
+    glPopMatrix();
+}//END of drawWallHighlights
+
+
+//This procedure builds the scene graph: the cube and the frame of the
+// balls (their nodes are added as they are).
+void buildScene()
+{
+    sceneInit(gScene, gSceneNodes, gSceneDrawList, CUBE_NUM_NODES + BALL_MAX);
+    sceneAddNode(gScene, -1);
+    sceneSetShape(gScene, CUBE_NODE_ROOM, SCENE_SHAPE_WIRE_CUBE, CUBE_SIZE, 0, 0);
+    sceneSetColour(gScene, CUBE_NODE_ROOM, 0, 0, 1, 1);
+    sceneAddNode(gScene, CUBE_NODE_ROOM);
+    sceneSetShape(gScene, CUBE_NODE_ROOM_AXES, SCENE_SHAPE_AXES, 0, 0, 0);
+    sceneAddNode(gScene, -1);
+    sceneAddNode(gScene, CUBE_NODE_BALLS);
+    sceneSetShape(gScene, CUBE_NODE_BALL_AXES, SCENE_SHAPE_AXES, 0, 0, 0);
+}//END of buildScene
+
+
+//This function returns the distance between the stylus tip and the centre
+// of the ball.
+double ballContactDistance(const double position[3], const double ballPosition[3])
+{
+    return sqrt(pow((position[0]-ballPosition[0]),2) + pow((position[1]
+        - ballPosition[1]),2) + pow((position[2]-ballPosition[2]),2));
+}//END of ballContactDistance
+
+
+
+//=====================================================================
+//    <BENCHMARK>: MICRO-BENCHMARKS OF THE HOT PATHS ("-bench" mode)
+//=====================================================================
+
+#define BENCH_NUM_SAMPLES 64    //number of sample positions to cycle through
+
+double gBenchPositions[BENCH_NUM_SAMPLES][3];   //stylus tip / ball positions
+
+//wall and gravity force with the ball attached to the stylus
+void benchCalculateForceAttached(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        hduVector3Dd forceVec = CalculateForce(gBenchPositions[n % BENCH_NUM_SAMPLES], BALL_RADIUS);
+        benchDoNotOptimize(forceVec[1]);
+    }
+}
+
+//the contacts of a small ball in a maze filling the cube: walls between
+// 16 x 16 cells (about 300 boxes, some turned), octahedral pillars and
+// the six walls of the cube, with SSE and one constraint at a time
+#define BENCH_MAZE_CELLS 16
+ConstraintSet gBenchMaze;
+void benchMazeSetup()
+{
+    const double cell = (double)CUBE_SIZE / BENCH_MAZE_CELLS;
+    const double turn = 0.5;    //(rad, about Y)
+    double turned[3][3] = { {cos(turn), 0, -sin(turn)}, {0, 1, 0}, {sin(turn), 0, cos(turn)} };
+    constraintSetInit(gBenchMaze, 0, 2);
+    for (int i = 0; i < gCubeWalls.planeCount; i++)
+    {
+        double normal[3] = { gCubeWalls.planeNormal[0][i], gCubeWalls.planeNormal[1][i], gCubeWalls.planeNormal[2][i] };
+        constraintAddPlane(gBenchMaze, normal, gCubeWalls.planeOffset[i]);
+    }
+    srand(488);
+    for (int a = 0; a < BENCH_MAZE_CELLS; a++)
+        for (int b = 1; b < BENCH_MAZE_CELLS; b++)
+            for (int across = 0; across < 2; across++)
+            {
+                if (rand() % 100 >= 60)
+                    continue;
+                double along = -CUBE_SIZE/2 + (a + 0.5) * cell, at = -CUBE_SIZE/2 + b * cell;
+                double centre[3] = { across ? at : along, 0, across ? along : at };
+                double half[3] = { across ? 0.5 : cell/2, CUBE_SIZE/2, across ? cell/2 : 0.5 };
+                constraintAddBox(gBenchMaze, centre, half, (rand() % 8 == 0) ? turned : NULL);
+            }
+    double normals[8][3], offsets[8];
+    for (int f = 0; f < 8; f++)
+        for (int k = 0; k < 3; k++)
+            normals[f][k] = (f & (1 << k)) ? 1 : -1;
+    for (int n = 0; n < 16; n++)
+    {
+        double centre[3];
+        for (int k = 0; k < 3; k++)
+            centre[k] = -CUBE_SIZE/2 + (rand() % BENCH_MAZE_CELLS + 0.5) * cell;
+        for (int f = 0; f < 8; f++)
+            offsets[f] = normals[f][0]*centre[0] + normals[f][1]*centre[1] + normals[f][2]*centre[2] + cell/3;
+        constraintAddPolytope(gBenchMaze, normals, offsets, 8);
+    }
+}
+void benchMazeContacts(long iterations)
+{
+    ConstraintContact contacts[CONSTRAINT_MAX_CONTACTS];
+    for (long n = 0; n < iterations; n++)
+    {
+        int found = constraintContacts(gBenchMaze, gBenchPositions[n % BENCH_NUM_SAMPLES], SMALL_BALL_RADIUS,
+                                       contacts, CONSTRAINT_MAX_CONTACTS);
+        benchDoNotOptimize(found);
+    }
+}
+void benchMazeContactsScalar(long iterations)
+{
+    ConstraintContact contacts[CONSTRAINT_MAX_CONTACTS];
+    for (long n = 0; n < iterations; n++)
+    {
+        int found = constraintContactsScalar(gBenchMaze, gBenchPositions[n % BENCH_NUM_SAMPLES], SMALL_BALL_RADIUS,
+                                             contacts, CONSTRAINT_MAX_CONTACTS);
+        benchDoNotOptimize(found);
+    }
+}
+
+
+//contact distance test between the stylus and a ball
+void benchBallContactDistance(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        double dist = ballContactDistance(gBenchPositions[n % BENCH_NUM_SAMPLES],
+                                          gBenchPositions[(n+1) % BENCH_NUM_SAMPLES]);
+        benchDoNotOptimize(dist);
+    }
+}
+
+
+//stylus pose prediction of one frame (constant acceleration + slerp)
+void benchPosePredict(long iterations)
+{
+    PoseSample samples[3];
+    for (int k = 0; k < 3; k++)
+    {
+        double angle = 0.02 * k;
+        double q[4] = { cos(angle), sin(angle), 0, 0 };
+        memset(samples[k].transform, 0, sizeof(samples[k].transform));
+        quatToMatrix(q, samples[k].transform);
+        samples[k].transform[15] = 1;
+        samples[k].time = 0.008 * k;
+    }
+    double transform[16];
+    for (long n = 0; n < iterations; n++)
+    {
+        const double* position = gBenchPositions[n % BENCH_NUM_SAMPLES];
+        for (int i = 0; i < 3; i++)
+            samples[2].transform[12 + i] = position[i];
+        posePredict(samples, 3, POSE_PREDICT_ACCELERATION, 0.04, transform);
+        benchDoNotOptimize(transform[12]);
+    }
+}
+
+
+//one substep of 2000 small balls settled at the bottom of the cube, the
+// stylus pushing through them, on the calling thread or on the pool
+#define BENCH_NUM_BALLS 2000
+BallWorld gBenchBalls;
+TaskPool gBenchTaskPool;
+void benchBallSetup(TaskPool* pool)
+{
+    ballWorldInit(gBenchBalls, CUBE_SIZE, SMALL_BALL_RADIUS, pool);
+    srand(488);
+    for (long n = 0; n < BENCH_NUM_BALLS; n++)
+    {
+        double position[3];
+        for (int i = 0; i < 3; i++)
+            position[i] = (rand() % 1000 / 1000.0 - 0.5) * (CUBE_SIZE - 2*SMALL_BALL_RADIUS);
+        ballWorldAdd(gBenchBalls, position, SMALL_BALL_RADIUS);
+    }
+    double stylus[3] = {0, -CUBE_SIZE/2 + 20, 0};
+    for (int n = 0; n < 250; n++)
+        ballWorldStep(gBenchBalls, BALL_SUBSTEP, stylus, SPHERE_RADIUS);
+}
+void benchBallSubstep(long iterations)
+{
+    double stylus[3] = {0, -CUBE_SIZE/2 + 20, 0};
+    for (long n = 0; n < iterations; n++)
+    {
+        stylus[0] = 50 * sin(n * 0.01);
+        ballWorldStep(gBenchBalls, BALL_SUBSTEP, stylus, SPHERE_RADIUS);
+        benchDoNotOptimize(gBenchBalls.pushForce[0]);
+    }
+}
+
+
+//one substep of 2000 fluid particles settled at the bottom of the cube,
+// the stylus stirring them, on the calling thread or on the pool
+SphFluid gBenchFluid;
+void benchFluidSetup(TaskPool* pool)
+{
+    sphFluidInit(gBenchFluid, CUBE_SIZE, SPHERE_RADIUS, pool);
+    sphFluidFill(gBenchFluid, FLUID_PARTICLES, FLUID_WIDTH, FLUID_WIDTH);
+    SphForceModel model;
+    for (int n = 0; n < 250; n++)
+        sphSubstep(gBenchFluid, model);
+}
+void benchFluidSubstep(long iterations)
+{
+    SphForceModel model;
+    gBenchFluid.ball[1] = -CUBE_SIZE/2 + 10;
+    for (long n = 0; n < iterations; n++)
+    {
+        gBenchFluid.ball[0] = 50 * sin(n * 0.01);
+        gBenchFluid.ballVelocity[0] = 500 * cos(n * 0.01);
+        sphSubstep(gBenchFluid, model);
+        benchDoNotOptimize(model.force[0]);
+    }
+}
+
+//the fluid force of one servo tick: a model published every 20 ticks,
+// blended in
+void benchFluidServoForce(long iterations)
+{
+    SphForceModel model;
+    memset(&model, 0, sizeof(model));
+    model.stiffness = 0.1;
+    model.damping = 0.001;
+    double force[3];
+    for (long n = 0; n < iterations; n++)
+    {
+        const double* position = gBenchPositions[n % BENCH_NUM_SAMPLES];
+        double now = 1 + n * 0.001;
+        if (n % 20 == 0)
+        {
+            model.time = now;
+            model.force[1] = sin(n * 0.01);
+            sphPublish(gBenchFluid.coupling, model);
+        }
+        sphServoForce(gBenchFluid.coupling, now, position, force);
+        benchDoNotOptimize(force[1]);
+    }
+}
+
+
+//one servo tick (with the ball attached and touching the walls)
+void benchServoTick(long iterations)
+{
+    hduVector3Dd forceVec;
+    for (long n = 0; n < iterations; n++)
+    {
+        hduVector3Dd pos(gBenchPositions[n % BENCH_NUM_SAMPLES]);
+        for (int i = 0; i < 3; i++)
+            gHeldBallPosition[i] = pos[i];
+        ServoTick(pos, forceVec);
+        benchDoNotOptimize(forceVec[1]);
+    }
+}
+
+
+//This function drives the tasks of the servo callback through many
+// simulated ticks and returns the number of heap allocations made inside
+// them (which must be zero).  Only the device is left out: the frame is
+// filled in here and the state is published to memory.
+long runServoAllocationCheck(long ticks)
+{
+    static DeviceStateShm memoryShm;
+    DeviceStateShm* publisherShm = gDeviceStatePublisher.shm;
+    gDeviceStatePublisher.shm = &memoryShm;
+    setupServoTasks();
+
+    long allocsBefore = gServoAllocCount;
+    ServoFrame& frame = gServoFrame;
+    for (long n = 0; n < ticks; n++)
+    {
+        //(the graphics loop keeps the watchdog fed)
+        if (n % 16 == 0)
+            servoWatchdogFeedGraphics(gServoWatchdog);
+
+        ServoAllocScope allocScope;
+
+        //the stylus sweeps the whole cube, grabbing and releasing the ball
+        double t = n * 0.001;   //1 kHz
+        frame.pos.set(CUBE_SIZE/2 * sin(1.3*t), CUBE_SIZE/2 * sin(1.7*t), CUBE_SIZE/2 * cos(1.1*t));
+        for (int k = 0; k < 16; k++)
+            frame.transform[k] = (k % 5 == 0) ? 1 : 0;
+        for (int i = 0; i < 3; i++)
+        {
+            frame.transform[12 + i] = frame.pos[i];
+            frame.jointAngles[i] = 0.5 * sin((1.1 + 0.2*i) * t);
+            frame.gimbalAngles[i] = 2 * sin((0.7 + 0.3*i) * t);
+        }
+        frame.buttons = (n / 500) % 2;
+        ballAttached = (n / 1000) % 2 == 0;
+        gFluidOn = (n / 2000) % 2 == 1;
+        for (int i = 0; i < 3; i++)
+            gHeldBallPosition[i] = frame.pos[i];
+
+        servoSchedulerRun(gServoScheduler, servoClockSeconds());
+
+        //and the callback reports device errors through the event log
+        if (n % 10000 == 0)
+            servoEventPost(SERVO_EVENT_NOTICE, NULL, "Allocation check: simulated servo event", (double)n);
+    }
+    long allocs = gServoAllocCount - allocsBefore;
+
+    ballAttached = false;
+    gFluidOn = false;
+    gPassivity.hasLast = false;
+    gDeviceStatePublisher.shm = publisherShm;
+    servoEventDrain(stdout);
+    return allocs;
+}//END of runServoAllocationCheck
+
+
+//This procedure times the force and contact detection kernels and
+// (optionally) writes the results as JSON.  It runs without the
+// haptic device and without opening a window.
+int runBenchmarks(const char* jsonPath, const char* executable)
+{
+    //fixed pseudo-random samples (inside the cube) so runs can be compared
+    srand(488);
+    for (int k = 0; k < BENCH_NUM_SAMPLES; k++)
+        for (int i = 0; i < 3; i++)
+            gBenchPositions[k][i] = rand() % CUBE_SIZE - CUBE_SIZE/2;
+
+    printf("ENSC488 - Assignment1 micro-benchmarks\n\n");
+
+    ballAttached = true;    //the wall forces are only felt with the ball attached
+    benchRun("A1/CalculateForce/attached", benchCalculateForceAttached);
+    ballAttached = false;
+    benchMazeSetup();
+    benchRun("A1/MazeContacts/simd", benchMazeContacts);
+    benchRun("A1/MazeContacts/scalar", benchMazeContactsScalar);
+    benchRun("A1/BallContactDistance", benchBallContactDistance);
+    benchRun("A1/PosePredict", benchPosePredict);
+    ballAttached = true;
+    benchRun("A1/ServoTick", benchServoTick);
+    ballAttached = false;
+    benchBallSetup(NULL);
+    benchRun("A1/BallSubstep/serial", benchBallSubstep);
+    taskPoolStart(gBenchTaskPool, 0, 0);
+    benchBallSetup(&gBenchTaskPool);
+    benchRun("A1/BallSubstep/pool", benchBallSubstep);
+    benchFluidSetup(NULL);
+    benchRun("A1/FluidSubstep/serial", benchFluidSubstep);
+    benchFluidSetup(&gBenchTaskPool);
+    benchRun("A1/FluidSubstep/pool", benchFluidSubstep);
+    benchRun("A1/FluidServoForce", benchFluidServoForce);
+    taskPoolStop(gBenchTaskPool);
+
+    //the servo callback must never touch the heap
+    printf("\n");
+    long servoAllocs = runServoAllocationCheck(100000);
+    servoAllocPrintCheck(stdout, 100000, servoAllocs);
+
+    if (jsonPath != NULL)
+    {
+        if (!benchWriteJson(jsonPath, executable))
+        {
+            fprintf(stderr, "Failed to write %s\n", jsonPath);
+            return -1;
+        }
+        printf("\nResults written to %s\n", jsonPath);
+    }
+    return (servoAllocs == 0) ? 0 : -1;
+}//END of runBenchmarks
+
+//******************************************************************************
+//           ~~~~~~  END OF main.cpp   ~~~~~~
 //******************************************************************************
\ No newline at end of file
@@ -1,948 +1,2810 @@
-/****************************************************************************
-                  (ENSC488 - PHANTOM Haptic Device Sample Code)
-
-Module Name: main.cpp
-
-Original Author: SensAble Technologies (c) 2004
-
-Modified and Commented by:  Chenjie Yao (chenjiey@sfu.ca)
-
-Last Update: 09/24/2004
-
-Description:
-
-  This sample code introduces the use of basic Phantom haptic device
-  operations, including initialization, setting forces, getting data,
-  and termination.
-
-  This program runs in a "multi-threaded" (multi-processing) fashion. 
-  Within an asynchronous callback, one process reads the stylus tip
-  position and sets the force to the device.  Within a synchronous
-  callback, another process gets the stylus tip position, orientation, forces, and 
-  button status, and the scene is redrawn accordingly..
-
-  This program has the following features:
-  - Two spheres, which represent a positive and negative charges, are drawn 
-    on the screen.
-  - The user moves/orients one of the spheres using Phantom's stylus.
-  - The user feels the attraction forces between the two spheres.
-  - An arrow is drawn to show the magnitude and direction of the attraction force.
-  - The user can rotate/scale the other sphere by dragging the LEFT/MIDDLE
-    buttons of the mouse.
-  - RIGHT-clicking the mouse brings up a popup menu.  Currently two items
-    are in the menu: "How to Play" and "About"
-
-******************************************************************************/
-
-//*****************************************************************************
-//                INCLUDED HEADER FILES       
-//*****************************************************************************
-#include <iostream>
-#include <stdio.h>
-#include <conio.h>
-#include <assert.h>
-
-#include <GL/glut.h>            //needed for graphics (OpenGL)
-#include <HDU/hduVector.h>      //useful utility (vector)
-#include <HDU/hduMath.h>
-#include <HDU/hduMatrix.h>      //useful utility (matrix)
-#include <HD/hd.h>              //needed for haptic device (general)
-#include <HDU/hduError.h>       //needed for haptic device (error handling)
-
-
-//*****************************************************************************
-//                GLOBAL CONSTANTS
-//*****************************************************************************
-#define SPHERE_RADIUS   12      //the initial radius of the two spheres to be drawn
-#define CUBE_SIZE 150			//the initial size of the space cube 
-#define SPHERE_MASS 5			//the mass of sphere
-#define PI 3.14159265354		//the value of Pi
-
-//the colours of the axes to be drawn
-//the columns are the colour vector (R, G, B, transparency).
-const float AXIS_COLOUR[ 4 ][ 3 ] = 
-{ 
-    { 1, 0, 0 },
-    { 0, 1, 0 },
-    { 0, 0, 1 },
-    { 1, 1, 1 }
-};
-
-//the vertices (endpoints) of the axes to be drawn
-const float AXIS_VERTEX[ 4 ][ 3 ] = 
-{          
-    { SPHERE_RADIUS*2, 0, 0 },
-    { 0, SPHERE_RADIUS*2, 0 },
-    { 0, 0, SPHERE_RADIUS*2 },
-    { 0, 0, 0 }
-};
-
-//*****************************************************************************
-//                USER-DEFINED DATA STRUCTURES
-//*****************************************************************************
-//storage for recording current data from the haptic device
-struct HapticDeviceState
-{
-    HHD m_hHD;						//handle of the haptic device
-    HDint button;					//button status: 0 (no press); 1 (blue button); 2 (white button)
-    double position[3];				//position of the stylus tip
-    double transform_matrix[16];    //transformation (position & orientation)
-                                    // of the stylus tip
-	HDdouble gimbal_angles[3];		//angles of the device gimbals
-	HDdouble joint_angles[3];		//angles of the device joints 
-    double force[3];				//output force vector (X,Y,Z) of the haptic device
-};
-
-
-//*****************************************************************************
-//                GLOBAL VARIABLES
-//*****************************************************************************
-//for the mouse
-int gLastMouseX, gLastMouseY;   //mouse position at previous time stamp
-const int MAXTRIANGLES  =   20; //max triabgles for polygon array
-int i,j;                    // Variable User as counter in the Loops
-double wallForce[3] = {0,0,0};
-
-//Camera Attributes (Rotation/Scaling on the centre sphere)
-double CamRotationY = 0;            //rotation (degrees)
-double CamRotationX = 0;
-double CamZoom = 1;                 //scale factor
-bool gIsRotatingCamera = false;     //flags to indicate which operation to perform
-bool gIsScalingCamera = false;      // according to different mouse clicks.
-bool gIsTranslatingCamera = false;
-
-//for the haptic device
-HHD ghHD = HD_INVALID_HANDLE;   //handle of the device
-HDSchedulerHandle gSchedulerCallback = HD_INVALID_HANDLE;   //handle of the scheduler
-
-//*****************************************************************************
-//                USER-DEFINED CLASS
-//*****************************************************************************
-
-//*****************************************************************************
-//                UTILITY FUNCTION PROTOTYPES
-//*****************************************************************************
-
-//=====================================================================
-//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
-//=====================================================================
-
-//This procedure intializes the GLUT setting.  It creates the graphics window
-// and assigns functions for display, mouse click, mouse movement, and popup menu.
-void initGlut(int argc, char* argv[]);
-
-//This procedure detects which mouse button is clicked and sets the
-// appropriate flags to indicate which event should occur.
-void MyGlutMouse(int button, int state, int x, int y);
-
-//This procedure detects the motion of the mouse (i.e. dragging"),
-// and performs operations depending on how the mouse is dragged
-// and which flag is set.
-void MyGlutMotion(int x, int y);
-
-//This function takes care of operations to perform when the program is idle.
-void MyGlutIdle(void);
-
-//This procedure sets up the functionalities of the menu items of the popup
-// menus when a mouse button is clicked.
-//For this example, both menu items display certain texts.
-void MyGlutMenu(int ID);
-
-// This handler gets automatically called when the program is exiting. 
-//  The program ensures that the haptic device and the scheduler are
-//  properly shutdown
-void __cdecl exitHandler();
-
-
-//=====================================================================
-//     <HAPTICS>:FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
-//=====================================================================
-
-//This procedure sends to the scheduler a task (i.e. a callback function)
-// that updates the force feedback of the device continuously.
-void ScheduleForceFeedback();
-
-//This is the callback function calculates the force (by calling 
-// "CalculateForce()" and SET the resulting forces to the device.
-//The callback function is scheduled to the scheduler in an "asynchronous"
-// fashion, and the function is called repeatedly each time it finishes.
-HDCallbackCode HDCALLBACK SettingForceCallback(void *data);
-
-//This callback function has the responsibility of GETTING haptic device data that is
-// constantly modified by the device. 
-//In the main graphics loop function, this callback function is scheduled 
-// to the scheduler in a "synchronous" fashion.  
-HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData);
-
-//This function calculates the force vector to be sent to the haptic device.
-//Currently, the force is calculated based on the current position of the 
-// device cursor and Coulomb's Law.
-hduVector3Dd CalculateForce(hduVector3Dd pos);
-
-//=====================================================================
-//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
-//=====================================================================
-
-//This procedure sets up the viewing condition for the scene to be drawn.
-//This procedure uses the haptic device coordinate space as model space 
-// of our scene.  An orthographic projection is defined to fit this space.
-//NOTE: LLB means Low, Left, Back point of device workspace.
-//      TRF means Top, Right, Front point of device workspace. 
-void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3]);
-
-//This procedure sets up the lighting (and shading) conditions 
-// for the scene to be drawn.
-void initGraphicsLighting();
-
-//This is the main display looping function that is run and draws the 
-// screen continuously.
-//Currently this function draws one fixed sphere (with axes), one movable
-// sphere (with axes), and an arrow (representing the force).
-void MyGlutDisplay(void);
-
-//This procedure draws the X,Y,Z axis for the current coordinate frame.
-void drawAxes();
-
-//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
-// of the current coordinate frame.
-void drawFixedSphere(GLUquadricObj* quadObj);
-
-//This procedure draws the "movable sphere" that corresponds to the cursor
-// of the haptic device.
-void drawMovableSphere(GLUquadricObj* quadObj,
-                       const double transform[16],
-                       HDint button_state);
-
-//This procedure draws the visual representation (an arrow) that represents
-// the magnitude and direction of the Coulomb Force.
-void drawForceVisualRepresentation(GLUquadricObj* quadObj,
-                                   const double position[3],                       
-                                   const double strength);
-
-void drawPhantonOmni(GLUquadricObj* quadObj, double joint_angles[3], double gimbal_angles[3], int button);
-//void drawHollowCube();
-//*****************************************************************************
-//                THE MAIN FUNCTION - (this is where things start...)
-//*****************************************************************************
-int main(int argc, char* argv[])
-{
-    HDErrorInfo error;
-
-    printf("ENSC488 - Assignment2 Chnejie Yao 301160093\n\n");
-    printf("Starting application\n");
-    
-    //Set up the TERMINATION procedures when program finishes.
-    //Things to take care of including shutting down the haptic device and scheduler.
-    atexit(exitHandler);
-
-    //Initialize the haptic device.  This needs to be called before any actions on 
-    // the device.
-    ghHD = hdInitDevice(HD_DEFAULT_DEVICE);
-    //Check for any initialization error.  If so, terminate the program.
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Failed to initialize haptic device");
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
-        return -1;
-    }
-
-    //Retrieve and display the model name of the haptic device.
-    printf("Found device %s\n",hdGetString(HD_DEVICE_MODEL_TYPE));
-    
-    //Enable haptic force feedback
-    hdEnable(HD_FORCE_OUTPUT);
-    hdEnable(HD_MAX_FORCE_CLAMPING);
-
-    //Find the workspace of the robotic links of the haptic device.
-    //The workspace is defined by two vertices: the Low Left Back point
-    // and the Top Right Front point.
-    printf("The workspace two corner vertices are:\n");
-    HDdouble maxWorkspace[6];
-    hdGetDoublev(HD_MAX_WORKSPACE_DIMENSIONS, maxWorkspace);
-    printf("%lf %lf %lf %lf %lf %lf\n", maxWorkspace[0],
-           maxWorkspace[1],
-           maxWorkspace[2],
-           maxWorkspace[3],
-           maxWorkspace[4],
-           maxWorkspace[5]);
-    printf("\n");
-
-    //Start the scheduler of the haptic device.
-    hdStartScheduler();
-    //Check if the scheduler is initialized properly.
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Failed to start scheduler");
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
-        return -1;
-    }
-    
-    //Initializes all GLUT related functions.
-    initGlut(argc, argv);
-
-    //Based on the workspace of the haptic device,
-    // set the viewing volumn of the scene to correspond
-    // to this workspace.
-    //Low, Left, Back point of device workspace.
-    hduVector3Dd LLB; 
-    LLB.set(maxWorkspace[0], maxWorkspace[1], maxWorkspace[2]);
-    //Top, Right, Front point of device workspace.
-    hduVector3Dd TRF;
-    TRF.set(maxWorkspace[3], maxWorkspace[4], maxWorkspace[5]);
-    //Initializes the viewing condition for the scene
-    initGraphicsViewing(LLB, TRF);
-
-    //Initializes the lighting condition for the scene
-    initGraphicsLighting();
-
-
-    //Schedule the force feedback process to the scheduler
-    std::cout << "Starting haptics callback..." << std::endl;
-    ScheduleForceFeedback();
-
-    //Enter the main loop for drawing the scene
-    std::cout << "Starting graphics callback..." << std::endl;
-    glutMainLoop(); //This is the "famous" GLUT infinite loop
-                    // that runs forever unless the program exits.
-
-    printf("Done\n");
-    return 0;
-}
-
-/******************************************************************************/
-
-
-//=====================================================================
-//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
-//=====================================================================
-
-//This procedure intializes the GLUT setting.  It creates the graphics window
-// and assigns functions for display, mouse click, mouse movement, and popup menu.
-void initGlut(int argc, char* argv[])
-{
-    glutInit(&argc, argv);          // Initialize GLUT.
-    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
-    glutInitWindowSize(500, 500);   //graphics window creation
-    glutCreateWindow("ENSC488 Assignment2 Chenjie Yao 301160093");
-
-    glutDisplayFunc(MyGlutDisplay);   //GLUT callback - display or draw scene
-    glutMouseFunc(MyGlutMouse);       //GLUT callback - mouse button detection
-    glutMotionFunc(MyGlutMotion);     //GLUT callback - mouse button movement
-    glutIdleFunc(MyGlutIdle);         //GLUT callback - idle operations
-
-    glutCreateMenu(MyGlutMenu);       //GLUT callback - Setup GLUT popup menu
-    glutAddMenuEntry("How to Play", 0);
-    glutAddMenuEntry("About", 1);
-    glutAttachMenu(GLUT_RIGHT_BUTTON);//Right click the mouse to launch the popup menu
-
-}//END of initGlut
-
-
-//This procedure detects which mouse button is clicked and sets the
-// appropriate flags to indicate which event should occur.
-void MyGlutMouse(int button, int state, int x, int y)
-{
-    if (state == GLUT_DOWN)
-    {   //some mouse button is pressed
-        if (button == GLUT_LEFT_BUTTON)
-        {   //Left click the mouse to rotate the centre sphere.
-            gIsRotatingCamera = true;            
-        }
-        else if (button == GLUT_MIDDLE_BUTTON)
-        {   //Click the centre button to scale the centre sphere.
-            gIsScalingCamera = true;            
-        }
-
-        //record the current mouse PIXEL location
-        gLastMouseX = x;
-        gLastMouseY = y;
-    }
-    else
-    {   //no mouse button is pressed...
-        gIsRotatingCamera = false;
-        gIsScalingCamera = false;
-        gIsTranslatingCamera = false;
-    }
-}//END of MyGlutMouse
-
-
-//This procedure detects the motion of the mouse (i.e. dragging"),
-// and performs operations depending on how the mouse is dragged
-// and which flag is set.
-void MyGlutMotion(int x, int y)
-{
-    if (gIsRotatingCamera)
-    {   
-        //rotate the centre sphere
-        //dragging the mouse horizontally rotates the object about Y axis
-        CamRotationY = CamRotationY + 0.1*(x - gLastMouseX);
-        //dragging the mouse vertically rotates the object about X axis
-        CamRotationX = CamRotationX + 0.1*(y - gLastMouseY);
-    }
-    else if (gIsScalingCamera)
-    {
-        //dragging the mouse vertically scales the object up or down.
-        CamZoom = CamZoom - 0.01*(y - gLastMouseY);
-    }
-
-    //record the current mouse PIXEL position.
-    gLastMouseX = x;
-    gLastMouseY = y;
-}//END of MyGlutMotion
-
-
-//This function takes care of operations to perform when the program is idle.
-void MyGlutIdle(void)
-{
-    //redisplay the scene
-    glutPostRedisplay();
-
-    //check if the scheduler has exited... if so, terminate program as well.
-    if (!hdWaitForCompletion(gSchedulerCallback, HD_WAIT_CHECK_STATUS))
-    {
-        printf("The main scheduler callback has exited\n");
-        printf("Press any key to quit.\n");
-        getch();
-        exit(-1);
-    }
-}//END of MyGlutIdle
-
-
-//This procedure sets up the functionalities of the menu items of the popup
-// menus when a mouse button is clicked.
-//For this example, both menu items display certain texts.
-void MyGlutMenu(int ID)
-{
-    switch(ID) 
-    {
-        case 0: //"How to Play" information in the popup menu.
-            
-            break;
-        case 1: //"About" information in the popup menu
-            
-            break;
-    }
-}//END of MyGlutMenu      
-
-
-// This handler gets automatically called when the program is exiting. 
-//  The program ensures that the haptic device and the scheduler are
-//  properly shutdown
-void __cdecl exitHandler()
-{
-    //stop the scheduler and cleans up any unfinished jobs on the scheduler.
-    hdStopScheduler();
-    hdUnschedule(gSchedulerCallback);
-
-    //if the haptic device hasn't been disabled yet, disable it now.
-    if (ghHD != HD_INVALID_HANDLE)
-    {
-        hdDisableDevice(ghHD);
-        ghHD = HD_INVALID_HANDLE;
-    }
-}//END of exitHandler
-
-
-
-//=====================================================================
-//   <HAPTICS>: FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
-//=====================================================================
-
-//This procedure sends to the scheduler a task (i.e. a callback function)
-// that updates the force feedback of the device continuously.
-void ScheduleForceFeedback()
-{
-    //schedule asynchronously to the scheduler a process for setting forces.
-    gSchedulerCallback = hdScheduleAsynchronous(
-        SettingForceCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY);
-
-    //checks if the process is scheduled successfully
-    HDErrorInfo error;
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Failed to initialize haptic device");
-        fprintf(stderr, "\nPress any key to quit.\n");
-        getch();
-        exit(-1);
-    }
-
-}//END of ScheduleForceFeedback
-
-
-
-//This is the callback function calculates the force (by calling 
-// "CalculateForce()" and SET the resulting forces to the device.
-//The callback function is scheduled to the scheduler in an "asynchronous"
-// fashion, and the function is called repeatedly each time it finishes.
-HDCallbackCode HDCALLBACK SettingForceCallback(void *data)
-{
-    //get a "handle" on the current haptic device
-    HHD hHD = hdGetCurrentDevice();
-
-    //NOTE: Setting forces must be in between the "hdBeginFrame()"
-    // and "hdEndFrame()".  Between these two lines, the haptic status
-    // (forces) is constant.
-    hdBeginFrame(hHD);
-
-    //Obtain the current position of the tip of the stylus
-    hduVector3Dd pos;
-    hdGetDoublev(HD_CURRENT_POSITION,pos);
-
-    //Calculate the force vector (using Coulomb's Law) and set the force
-    // vector to the haptic device.
-    hdSetDoublev(HD_CURRENT_FORCE, wallForce);
-        
-    hdEndFrame(hHD);
-
-    //Check if the scheduler returns any error when executing this process...
-    HDErrorInfo error;
-    if (HD_DEVICE_ERROR(error = hdGetError()))
-    {
-        hduPrintError(stderr, &error, "Error during scheduler callback");
-
-        if (hduIsSchedulerError(&error))
-        {
-            //if there is error in scheduler, terminates (by force) the current
-            // process
-            return HD_CALLBACK_DONE;
-        }
-    }
-
-    //continue executing the setting up of the force feedback
-    // by telling the scheduler to repeat on the process after it is completed
-    // each time.
-    //NOTE: this is how we can have a process to set up device forces that runs
-    // in parallel with other (graphics, getting data) processes.a
-    return HD_CALLBACK_CONTINUE;
-}//END of SettingForceCallback
-
-
-//This callback function has the responsibility of GETTING haptic device data that is
-// constantly modified by the device. 
-//In the main graphics loop function, this callback function is scheduled 
-// to the scheduler in a "synchronous" fashion.  
-HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData)
-{
-    //rename the variable and type cast it as the user
-    // defined data structure "HapticDeviceState"
-    HapticDeviceState *pDisplayState = 
-        static_cast<HapticDeviceState *>(pUserData);
-
-	hdGetDoublev(HD_CURRENT_GIMBAL_ANGLES, pDisplayState->gimbal_angles);
-	hdGetDoublev(HD_CURRENT_JOINT_ANGLES, pDisplayState->joint_angles); 
-
-    //Get current stylus tip position
-    hdGetDoublev(HD_CURRENT_POSITION, pDisplayState->position);
-    //Get the overal transformation matrix for the stylus tip.
-    hdGetDoublev(HD_CURRENT_TRANSFORM, pDisplayState->transform_matrix);
-    //Get the force vector that is currently set in the haptic device
-    hdGetDoublev(HD_CURRENT_FORCE, pDisplayState->force);
-    //Get the info on which button of the stylus is pressed.
-    hdGetIntegerv(HD_CURRENT_BUTTONS, &pDisplayState->button);
-
-    //Execute this only once - since we are already doing it repeatedly (inside
-    // the GlutDisplay function)
-    return HD_CALLBACK_DONE;
-
-}//END of GettingDeviceStateCallback
-
-
-
-//This function calculates the force vector to be sent to the haptic device.
-//Currently, the force is calculated based on the current position of the 
-// device cursor and Coulomb's Law.
-hduVector3Dd CalculateForce(hduVector3Dd pos)
-{
-    //square of the distance between two points (or square of the length of a vector)
-    double sqr_dist = pos[0]*pos[0]+pos[1]*pos[1]+pos[2]*pos[2];
-        
-    hduVector3Dd forceVec;
-    //Checks if the two charges overlap
-    if(sqr_dist < pow(SPHERE_RADIUS+CamZoom*SPHERE_RADIUS,2)) 
-    {
-        //Two charges overlap
-        if (CamZoom >= 1)
-            //the magnitude of the force is adjusted according to the scale 
-            // of the centre sphere accordingly.
-            forceVec =  -0.1*pos/(CamZoom);
-        else
-            forceVec = -0.1*pos;
-    }
-    else
-    {
-        //Two charges do not overlap
-        double scaleFactor;     //add some scale factor to the force
-                                //otherwise the force is too little to be felt.
-        if (CamZoom >= 1)
-            //the magnitude of the force is adjusted according to the scale 
-            // of the centre sphere accordingly.
-            scaleFactor = -400.0/(CamZoom);
-        else
-            scaleFactor = -400.0;
-
-        hduVector3Dd UnitPos; 
-        UnitPos = normalize(pos);
-        //charges do not overlap -> use the regular "inverse square of distance"
-        // Coulomb's Law to find force
-        forceVec = scaleFactor*UnitPos/sqr_dist;
-    }
-    return forceVec;
-}//END of CalculateForce
-
-
-
-
-//=====================================================================
-//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
-//=====================================================================
-
-//This procedure sets up the viewing condition for the scene to be drawn.
-//This procedure uses the haptic device coordinate space as model space 
-// of our scene.  An orthographic projection is defined to fit this space.
-//NOTE: LLB means Low, Left, Back point of device workspace.
-//      TRF means Top, Right, Front point of device workspace. 
-void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3])
-{
-    glMatrixMode(GL_PROJECTION); /* Setup perspective projection. */
-    glLoadIdentity();
-
-    //Find the (Cartesian) centre point of the device workspace.
-    HDdouble centerScreen[3];
-    centerScreen[0] = (TRF[0] + LLB[0])/2.0;
-    centerScreen[1] = (TRF[1] + LLB[1])/2.0;
-    centerScreen[2] = (TRF[2] + LLB[2])/2.0;
-
-    //According to the haptic device workspace, set the view volumn 
-    // (screen dimension).
-    HDdouble screenDims[3];
-    screenDims[0] = TRF[0] - LLB[0];
-    screenDims[1] = TRF[1] - LLB[1];
-    screenDims[2] = TRF[2] - LLB[2];
-
-    //find the dimension corresponding to the larger "range" 
-    // between the X and Y directions
-    HDdouble maxDimXY = (screenDims[0] > screenDims[1] ? screenDims[0]:screenDims[1]);
-    //find the dimension corresponding to the larger "range" 
-    // among the X, Y, and Z directions
-    HDdouble maxDim = (maxDimXY > screenDims[2] ? maxDimXY:screenDims[2]);
-    maxDim /= 2.0;
-
-    //orthographic projection (1st parameter has largest "range", and so on...)
-    glOrtho(centerScreen[0]-maxDim, centerScreen[0]+maxDim, 
-             centerScreen[1]-maxDim, centerScreen[1]+maxDim,
-             centerScreen[2]-maxDim, centerScreen[2]+maxDim);
-
-    glMatrixMode(GL_MODELVIEW); // Setup model transformations. 
-    glLoadIdentity();
-
-    glClearDepth(1.0); // Setup background colour. 
-    glClearColor(0.7, 0.7, 0.7, 0);
-    glDisable(GL_DEPTH_TEST);
-
-}//END of initGraphicsWorkspace
-
-
-//This procedure sets up the lighting (and shading) conditions 
-// for the scene to be drawn.
-void initGraphicsLighting()
-{
-    //smooth (interpolated) shading
-    glShadeModel(GL_SMOOTH);
-
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LIGHTING);
-    glEnable(GL_NORMALIZE);
-    glEnable(GL_LIGHT_MODEL_TWO_SIDE);
-    
-    GLfloat lightZeroPosition[] = {10.0, 4.0, 100.0, 0.0};
-    GLfloat lightZeroColor[] = {0.6, 0.6, 0.6, 1.0}; //grey light
-    GLfloat lightOnePosition[] = {-1.0, -2.0, -100.0, 0.0};
-    GLfloat lightOneColor[] = {0.6, 0.6, 0.6, 1.0};  //grey light as well
-    
-    GLfloat light_ambient[] = {0.8, 0.8, 0.8, 1.0}; //Ambient lighting (grey)
-    GLfloat light_diffuse[] = {0.0, 0.0, 0.0, 1.0}; //Diffuse lighting (none)    
-    GLfloat light_position[] = {0.0, 0.0, 100.0, 1.0}; //light source far away
-    
-    glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, 1);
-    glLightfv(GL_LIGHT0, GL_POSITION, lightZeroPosition);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, lightZeroColor);
-    glLightfv(GL_LIGHT1, GL_POSITION, lightOnePosition);
-    glLightfv(GL_LIGHT1, GL_DIFFUSE, lightOneColor);
-    glEnable(GL_LIGHT0);    //enable light0
-    glEnable(GL_LIGHT1);    //enable light1
-
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
-
-}//END of initGraphicsLighting
-
-
-//This is the main display looping function that is run and draws the 
-// screen continuously.
-//Currently this function draws one fixed sphere (with axes), one movable
-// sphere (with axes), and an arrow (representing the force).
-void MyGlutDisplay(void)
-{
-	// Get the current position/orientation of end effector and
-    // the current button state.
-    //A process for getting device data is sent to the scheduler
-    // (synchronously).
-    HapticDeviceState state;
-    hdScheduleSynchronous(GettingDeviceStateCallback, &state,
-                          HD_MIN_SCHEDULER_PRIORITY);
-    GLUquadricObj* quadObj = gluNewQuadric();
-    glMatrixMode(GL_MODELVIEW); // Setup model transformations.
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glLoadIdentity();
-    glPushMatrix();
-    //need to enable "colour material" in order to see the
-    // different surfaces of objects having different colours (shades)
-    glEnable(GL_COLOR_MATERIAL);
-	glRotatef(45,0,1,0);
-	glRotatef(CamRotationY, 0, 1, 0);
-	glRotatef(CamRotationX, 1, 0, 0);
-	glScalef(CamZoom, CamZoom, CamZoom);
-
-    drawAxes();
-	drawPhantonOmni(quadObj, state.joint_angles, state.gimbal_angles, state.button);
-	glPopMatrix();
-
-    // Always delete a Quadric (since you previouly dynamically allocated one)
-    gluDeleteQuadric(quadObj);
-
-    glDisable(GL_COLOR_MATERIAL);
-  
-    glPopMatrix();
-
-    // Double buffers are used to speed things up...
-    glutSwapBuffers();
-}//END of MyGlutDisplay
-
-
-//--------------------------------------------------------
-// *** NOTE: The following are the utility functions that
-//   draw the individual objects in the scene. ***
-//--------------------------------------------------------
-
-//This procedure draws the X,Y,Z axis for the current coordinate frame.
-void drawAxes()
-{
-    //disable lighting and material when drawing axes.
-    glDisable(GL_LIGHTING);
-    glDisable(GL_COLOR_MATERIAL);
-    for(int i = 0; i < 3; i++) 
-    {               
-        glColor3fv(AXIS_COLOUR[ i ]);
-        glBegin(GL_LINES);  //draw a line - define two endpoints between
-                            // the "glBegin" and "glEnd" pair
-        glVertex3fv(AXIS_VERTEX[ i ]);
-        glVertex3fv(AXIS_VERTEX[ 3 ]);
-        glEnd();
-    }
-    glEnable(GL_LIGHTING);
-    glEnable(GL_COLOR_MATERIAL);
-
-}//END of drawAxes
-
-
-
-//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
-// of the current coordinate frame.
-void drawFixedSphere(GLUquadricObj* quadObj)
-{
-    //Display a sphere to show the static electric charge (greenish blue).
-    glColor4f(0.2, 0.8, 0.8, 0.8);
-
-    //Draw the center sphere.
-    gluSphere(quadObj, SPHERE_RADIUS, 20, 20); 
-
-}//END of drawFixedSphere
-
-
-//This procedure draws the "movable sphere" that corresponds to the cursor
-// of the haptic device.
-void drawMovableSphere(GLUquadricObj* quadObj,
-                       const double transform[16],
-                       HDint button_state)
-
-{
-   //Display one sphere to represent the haptic cursor and the dynamic 
-   //    charge.
-    glPushMatrix();
-
-    glLoadIdentity();
-    glMultMatrixd(transform);   //transform the movable sphere
-                                // such that its location and orientation
-                                // correponds to those of the stylus of the device.
-
-    drawAxes();
-    if (button_state == 0)  //no button is pressed
-        glColor4f(0.8, 0.2, 0.2, 0.8);      //red colour
-    else if (button_state == 1) //the first (blue) button is pressed
-        glColor4f(0.2, 0.8, 0.2, 0.8);     //green colour
-    else if (button_state == 2) //the second (white) button is pressed
-        glColor4f(0.2, 0.2, 0.8, 0.8);      //blue colour
-
-    gluSphere(quadObj, SPHERE_RADIUS, 20, 20);  
-
-    glPopMatrix();
-
-}//END of drawMovableSphere
-
-
-//This procedure draws the visual representation (an arrow) that represents
-// the magnitude and direction of the Coulomb Force.
-void drawForceVisualRepresentation(GLUquadricObj* quadObj,
-                                   const double position[3],                       
-                                   const double strength)
-{
-    //Display the force vector, change the force magnitude/direction
-    // rotote the force vector first. 
-    hduVector3Dd ForceVectorAxis(position); 
-    ForceVectorAxis *= -1;  //points to the opposite direction of "position"
-
-    //normalize the force vector such that its length is 1.
-    hduVector3Dd UnitForceVectorAxis;
-    UnitForceVectorAxis = normalize(ForceVectorAxis);
-
-    //For calculation of rotation angle.
-    hduVector3Dd ZAxis;  //Z axis is chosen because when drawing a cylinder,
-                         // it is drawn along the Z-axis by default.
-    ZAxis.set(0.0, 0.0, 1.0);
-
-    hduVector3Dd ToolRotAxis; 
-    //the tool rotation axis points to direction perpendicular to 
-    // both Z axis and force vector axis
-    ToolRotAxis = crossProduct(ZAxis, ForceVectorAxis);
-        
-    //the angle around the "ToolRotAxis" that will rotate Z axis into 
-    // ForceVectorAxis 
-    double ToolRotAngle = acos(UnitForceVectorAxis[2]);
-    hduMatrix rotMatrix;    
-    //the overall rotation matrix for this force vector is...
-    //NOTE: defined using "equivalent angle axis" theorem.
-    // you don't need to worry about implementation details
-    // just find the axis and angle and use the following function (createRotation)
-    rotMatrix = hduMatrix::createRotation(ToolRotAxis, ToolRotAngle);
-
-    double rotVals[4][4];
-    rotMatrix.get(rotVals); //get the elements of matrix "rotMatrix" and save them
-                            // into a 4 by 4 array (something OpenGL understands)
-    glMultMatrixd((double*)rotVals);
-
-    //The force arrow: composed of a cylinder and a cone.
-    glDisable(GL_LIGHTING);
-    glColor3f(0.2, 0.7, 0.2);
-    //Draw the cylinder part 
-    // parameters are: object_name, base_radius, top_radius, height, slices, stacks)
-    gluCylinder(quadObj,SPHERE_RADIUS*0.1, SPHERE_RADIUS*0.1, strength, 16, 2); 
-    glTranslatef(0, 0, strength);
-    glColor3f(0.2, 0.8, 0.3);
-    //Draw the cone part.
-    gluCylinder(quadObj, SPHERE_RADIUS*0.2, 0.0, strength*0.15, 16, 2); 
-    glEnable(GL_LIGHTING);
-}//END of drawForceVisualRepresentation
- 
-void drawPhantonOmni(GLUquadricObj* quadObj, double joint_angles[3], double gimbal_angles[3], int button){
-
-	//gimbal_angles[0] = ;
-	for (int i = 0 ; i < 3 ; i++ ) {
-		gimbal_angles[i] = gimbal_angles[i] * 180 / PI;
-		joint_angles[i] = joint_angles[i] * 180 / PI;
-	}
-
-	// Draw the base
-    glColor4f(0.2, 0.8, 0.8, 0.8);
-	glRotatef(-90, 1, 0, 0);
-	gluCylinder(quadObj, 70, 30, 50, 20, 20);
-	gluDisk(quadObj, 0, 70, 20, 20);
-
-	//Draw the sphere body
-	glPushMatrix();
-	glColor4f(0.8, 0.2, 0.2, 0.8);
-	glTranslatef(0, 0, 80);
-
-	glRotatef(-joint_angles[0], 0, 0, 1);
-	gluSphere(quadObj, 45, 20, 20);
-
-	//Draw Link1
-	glColor4f(0.8, 0.8, 0.8, 0.8);
-	glRotatef(100, 1, 0, 0);
-	glRotatef(-joint_angles[1], 1, 0, 0);
-	gluCylinder(quadObj, 7, 7, 110, 20, 20);
-
-	//Draw Link1 cover
-	glPushMatrix();
-	glTranslatef(0,0,110);
-	gluDisk(quadObj, 0, 7, 20, 20);
-	glPopMatrix();
-
-	//Draw Link2
-	glColor4f(0.8, 0.2, 0.8, 0.2);
-	glTranslatef(0,0,110);
-	glRotatef(100, 1, 0, 0);
-	glRotatef(-(joint_angles[2]-joint_angles[1]), 1, 0, 0);
-	gluCylinder(quadObj, 7, 7, 60, 20, 20);
-
-	//Draw Link2 cover
-	glPushMatrix();
-	gluDisk(quadObj, 0, 7, 20, 20);
-	glPopMatrix();
-
-	//Draw Jimbal1
-	glTranslatef(0,0,60);
-	glRotatef(-gimbal_angles[0], 0, 0, 1);
-	glColor4f(0.8, 0.2, 0.2, 0.8);
-	gluCylinder(quadObj, 7, 7, 30, 20, 20);
-
-	//Draw Jimbal2
-	glColor4f(0.2, 0.2, 0.2, 0.8);
-	glTranslatef(0,0,30);
-	glRotatef(90, 1, 0, 0);
-	glRotatef(-gimbal_angles[1], 1, 0, 0);
-	gluCylinder(quadObj, 7, 7, 20, 20, 20);
-
-	//Draw Jimbal2 cover
-	glPushMatrix();
-	glTranslatef(0,0,20);
-	gluDisk(quadObj, 0, 7, 20, 20);
-	glPopMatrix();
-
-	//Draw Jimbal3
-	glColor4f(0.8, 0.8, 0.8, 0.8);
-	glTranslatef(0,0,-80);
-	glRotatef(gimbal_angles[2], 0, 0, 1);
-	gluCylinder(quadObj, 7, 7, 80, 20, 20);
-	
-	//Draw Jimbal3 cover
-	glPushMatrix();
-	glColor4f(0.8, 0.8, 1, 1);
-	gluDisk(quadObj, 0, 7, 20, 20);
-	glPopMatrix();
-
-	//Draw button
-	if (button == 2) 
-		glColor4f(0.2, 0.8, 0.8, 0.8);
-	else
-		glColor4f(0.3, 0.3, 1, 1);
-
-	glTranslatef(0,-7,50);
-	glutSolidCube(4);
-
-	if (button == 1) 
-		glColor4f(0.2, 0.8, 0.8, 0.8);
-	else
-		glColor4f(03, 1, 1, 1);
-
-	glTranslatef(0,0,5);
-	glutSolidCube(4);
-	glPopMatrix();
-
-
-}
-//******************************************************************************
-//           ~~~~~~  END OF main.cpp   ~~~~~~
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: main.cpp
+
+Original Author: SensAble Technologies (c) 2004
+
+Modified and Commented by:  Chenjie Yao (chenjiey@sfu.ca)
+
+Last Update: 09/24/2004
+
+Description:
+
+  This sample code introduces the use of basic Phantom haptic device
+  operations, including initialization, setting forces, getting data,
+  and termination.
+
+  This program runs in a "multi-threaded" (multi-processing) fashion. 
+  Within an asynchronous callback, one process reads the stylus tip
+  position and sets the force to the device.  Within a synchronous
+  callback, another process gets the stylus tip position, orientation, forces, and 
+  button status, and the scene is redrawn accordingly..
+
+  This program has the following features:
+  - Two spheres, which represent a positive and negative charges, are drawn 
+    on the screen.
+  - The user moves/orients one of the spheres using Phantom's stylus.
+  - The user feels the attraction forces between the two spheres.
+  - An arrow is drawn to show the magnitude and direction of the attraction force.
+  - The user can rotate/scale the other sphere by dragging the LEFT/MIDDLE
+    buttons of the mouse.
+  - RIGHT-clicking the mouse brings up a popup menu.  Currently two items
+    are in the menu: "How to Play" and "About"
+  - Running the program with "-bench [results.json]" times the force,
+    kinematics and contact detection kernels (no device needed) and writes
+    the results in Google Benchmark JSON format, after checking that 100000
+    simulated servo ticks make no heap allocation.  On Linux the
+    CMakeLists.txt at the top of the repository builds it.
+  - Every servo tick (pose, joint/gimbal angles, buttons and force) is
+    published to shared memory for external readers, see DeviceStateShm.h.
+  - The popup menu can add (random) charges to the fixed one and show the
+    whole field as field lines and a grid of glyphs; these are computed
+    on a pool of worker threads (TaskPool.h) whenever the charges or the
+    zoom change, see FieldLineCache.h.  It can also show equipotential surfaces, which
+    are extracted again only where the charges (that can be set moving)
+    or the isovalue have changed them, see Equipotential.h.
+  - With many charges the servo callback can take the force from a small
+    grid kept around the stylus by a background thread ("Toggle Force
+    Clipmap"), see ForceClipmap.h.
+  - Adding "-latency [frames.csv]" measures the motion-to-photon latency
+    of every frame and prints a breakdown on exit, see LatencyProbe.h.
+  - The field can also be felt through a (simulated) network link, with
+    wave-variable coupling so that delay doesn't destabilize it
+    (see WaveTeleop.h):
+      "-teleop-loopback <delay ms> <jitter ms>"  the field runs on a second
+                                                 thread behind a delayed link
+      "-teleop-sim <port>"           run only the field, serving a device over UDP
+      "-teleop-device <host> <port>" run the device against a remote "-teleop-sim"
+  - The servo callback runs its work as prioritized tasks with time
+    budgets (force, state publishing, event log); "Servo Task Costs"
+    prints what each costs, see ServoScheduler.h.
+  - "Run Experiment Protocol" runs a timed protocol (wait for a stylus
+    button, move a charge, record for 10 s, repeat) from the idle loop,
+    written as a script, see ExperimentScript.h.
+  - "Cycle Guidance Fixture" adds a virtual fixture along a knotted
+    spline path: first a spring toward the path, then a tube the stylus
+    moves freely in, then off again; the closest point of the path is
+    found at servo rate with a segment tree, see VirtualFixture.h.
+  - Adding "-realtime [cpu]" runs the servo callback as a real-time thread
+    pinned to one CPU, with the memory locked; "-rt-jitter [seconds]"
+    only measures the wake-up jitter of a 1 kHz loop with default and
+    with real-time scheduling, see ServoRealtime.h.
+  - The arm of the Omni model is tinted by the effort of its motors (the
+    share of their torque the force being sent takes), and "Toggle
+    Gravity Compensation" adds the force that holds the stylus and arm
+    up against their weight, from the joint angles and the Jacobian of
+    the arm, see OmniKinematics.h.
+  - The links of the Omni model are checked as capsules against each
+    other and the added charges every frame: a line from
+    yellow to red shows any two closer than PROXIMITY_MARGIN, and
+    "Toggle Arm Proximity Feedback" pushes the stylus back from them at
+    servo rate, see CapsuleProximity.h.
+  - The Omni model is a scene graph: every joint turns a node of its
+    own, only the links past a turning joint get new world matrices, and
+    the renderer draws a flat list of shapes.  The proximity checks read
+    the same world matrices, see SceneGraph.h.
+  - Spheres, cylinders and disks are tessellated by how large they are on
+    the screen (with the zoom), see TessellationLod.h and SceneDraw.h.
+
+******************************************************************************/
+
+//*****************************************************************************
+//                INCLUDED HEADER FILES       
+//*****************************************************************************
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <conio.h>
+#else
+#define getch getchar           //(no conio.h: waits for Enter instead of any key)
+#define __cdecl                 //(the only calling convention)
+#endif
+#include <assert.h>
+
+#include <GL/glut.h>            //needed for graphics (OpenGL)
+#include <HDU/hduVector.h>      //useful utility (vector)
+#include <HDU/hduMath.h>
+#include <HDU/hduMatrix.h>      //useful utility (matrix)
+#include <HD/hd.h>              //needed for haptic device (general)
+#include <HDU/hduError.h>       //needed for haptic device (error handling)
+
+#include "../../Common/HapticBench.h"   //micro-benchmark harness ("-bench" mode)
+#include "../../Common/ServoAllocTracker.h" //catches heap use inside the servo callback
+#include "../../Common/ServoEventLog.h"     //non-blocking error reporting from the servo thread
+#include "../../Common/ServoWatchdog.h"     //ramps the force down on overruns/stale state/NaN
+#include "../../Common/PassivityController.h" //time-domain passivity observer/controller
+#include "../../Common/DeviceStateShm.h"    //publishes the device state to other processes
+#include "../../Common/LatencyProbe.h"      //motion-to-photon latency ("-latency" mode)
+#include "../../Common/ChargeField.h"       //the fixed charges and their Coulomb field
+#include "../../Common/TaskPool.h"          //worker threads for the background computations
+#include "../../Common/FieldLineCache.h"    //field lines/glyphs built on the task pool
+#include "../../Common/Equipotential.h"     //equipotential surfaces built on the task pool
+#include "../../Common/ForceClipmap.h"      //grid of forces kept around the stylus
+#include "../../Common/PortableThread.h"    //thread for the loopback teleoperation link
+#include "../../Common/ServoRealtime.h"     //real-time servo thread ("-realtime", "-rt-jitter")
+#include "../../Common/ServoScheduler.h"    //the tasks of the servo callback, with time budgets
+#include "../../Common/ExperimentScript.h"  //timed experiment protocols run from the idle loop
+#include "../../Common/VirtualFixture.h"    //guidance along a spline path
+#include "../../Common/WaveTeleop.h"        //wave-variable teleoperation ("-teleop-*" modes)
+#include "../../Common/OmniKinematics.h"    //Jacobian and gravity torques of the Omni arm
+#include "../../Common/CapsuleProximity.h"  //how close the links come to each other
+#include "../../Common/SceneGraph.h"        //the nodes of the Omni model and their transforms
+#include "../../Common/SceneDraw.h"         //scene graphs drawn, shapes tessellated by their size on screen
+
+
+//*****************************************************************************
+//                GLOBAL CONSTANTS
+//*****************************************************************************
+#define SPHERE_RADIUS   12      //the initial radius of the two spheres to be drawn
+#define EXPERIMENT_TRIALS       3       //trials of the experiment protocol
+#define EXPERIMENT_RECORD_S     10.0    //recording time of a trial (s)
+#define EXPERIMENT_TIMEOUT_S    30.0    //wait for the button before skipping a trial (s)
+#define CUBE_SIZE 150			//the initial size of the space cube 
+#define SPHERE_MASS 5			//the mass of sphere
+#define PI 3.14159265354		//the value of Pi
+
+//how the force is produced (see the "-teleop-*" options)
+enum TeleopMode
+{
+    TELEOP_OFF = 0,         //locally, in the servo callback
+    TELEOP_LOOPBACK,        //by a simulation thread behind a delayed link
+    TELEOP_DEVICE,          //by a remote "-teleop-sim" process over UDP
+    TELEOP_SIMULATION       //this process is the remote simulation (no device)
+};
+
+//the nodes of the scene graph of the Phantom Omni model (see
+// "buildOmniScene"): first its coordinate frames, each under the one
+// before, then the nodes that only add a second shape to one of them
+enum OmniFrame
+{
+    OMNI_FRAME_BASE = 0,    //base, rotated so that Z points up
+    OMNI_FRAME_BODY,        //body sphere (turns with joint 0)
+    OMNI_FRAME_LINK1,       //first arm link (joint 1)
+    OMNI_FRAME_LINK2,       //second arm link (joint 2)
+    OMNI_FRAME_GIMBAL1,     //the three gimbals of the stylus
+    OMNI_FRAME_GIMBAL2,
+    OMNI_FRAME_GIMBAL3,
+    OMNI_FRAME_BUTTON1,     //the two stylus buttons
+    OMNI_FRAME_BUTTON2,
+    OMNI_NUM_FRAMES,
+    OMNI_NODE_BASE_DISK = OMNI_NUM_FRAMES,  //bottom of the base
+    OMNI_NODE_LINK1_COVER,                  //the ends of the links
+    OMNI_NODE_LINK2_COVER,
+    OMNI_NODE_GIMBAL2_COVER,
+    OMNI_NODE_GIMBAL3_COVER,
+    OMNI_NUM_NODES
+};
+
+//the scene graph of the Omni model, with room for its nodes
+struct OmniScene
+{
+    SceneGraph graph;
+    SceneNode nodes[OMNI_NUM_NODES];
+    int drawList[OMNI_NUM_NODES];
+    double joint[3], gimbal[3];     //the angles posed (radians)
+};
+
+//the links of the Omni model as capsules, for the proximity checks (see
+// "buildOmniCapsules"); the added charges follow them
+enum OmniShape
+{
+    OMNI_SHAPE_BASE = 0,    //(a sphere around the cone of the base)
+    OMNI_SHAPE_BODY,
+    OMNI_SHAPE_LINK1,
+    OMNI_SHAPE_LINK2,
+    OMNI_SHAPE_GIMBAL1,
+    OMNI_SHAPE_GIMBAL2,
+    OMNI_SHAPE_STYLUS,      //the third gimbal
+    OMNI_NUM_SHAPES
+};
+#define PROXIMITY_MARGIN 10         //closer than this (mm) warns and pushes back
+#define PROXIMITY_STIFFNESS 0.1     //of the push back (N/mm)
+#define PROXIMITY_MAX_FORCE 2.0     //(N)
+#define PROXIMITY_MAX_CONTACTS 16
+
+//the colours of the axes to be drawn
+//the columns are the colour vector (R, G, B, transparency).
+const float AXIS_COLOUR[ 4 ][ 3 ] = 
+{ 
+    { 1, 0, 0 },
+    { 0, 1, 0 },
+    { 0, 0, 1 },
+    { 1, 1, 1 }
+};
+
+//the vertices (endpoints) of the axes to be drawn
+const float AXIS_VERTEX[ 4 ][ 3 ] = 
+{          
+    { SPHERE_RADIUS*2, 0, 0 },
+    { 0, SPHERE_RADIUS*2, 0 },
+    { 0, 0, SPHERE_RADIUS*2 },
+    { 0, 0, 0 }
+};
+
+//*****************************************************************************
+//                USER-DEFINED DATA STRUCTURES
+//*****************************************************************************
+//storage for recording current data from the haptic device
+struct HapticDeviceState
+{
+    HHD m_hHD;						//handle of the haptic device
+    HDint button;					//button status: 0 (no press); 1 (blue button); 2 (white button)
+    double position[3];				//position of the stylus tip
+    double transform_matrix[16];    //transformation (position & orientation)
+                                    // of the stylus tip
+    double sample_time;             //when the servo callback read this state
+	HDdouble gimbal_angles[3];		//angles of the device gimbals
+	HDdouble joint_angles[3];		//angles of the device joints 
+    double force[3];				//output force vector (X,Y,Z) of the haptic device
+};
+
+
+//*****************************************************************************
+//                GLOBAL VARIABLES
+//*****************************************************************************
+//for the mouse
+int gLastMouseX, gLastMouseY;   //mouse position at previous time stamp
+const int MAXTRIANGLES  =   20; //max triabgles for polygon array
+int i,j;                    // Variable User as counter in the Loops
+double wallForce[3] = {0,0,0};
+bool gCoulombForceEnabled = false;  //render the fixed charge's field (menu)
+
+//the fixed charges: the centre sphere, plus any added from the menu
+ChargeSet gChargeSet = { 1, 0, SPHERE_RADIUS, { { {0, 0, 0}, 1 } } };
+bool gShowFieldLines = false;       //draw the field lines and glyphs (menu)
+TaskPool gTaskPool;                 //started the first time something needs it
+bool gTaskPoolStarted = false;
+FieldLineCache gFieldLineCache;     //started the first time they are shown
+bool gFieldLineCacheStarted = false;
+bool gShowEquipotentials = false;   //draw the equipotential surfaces (menu)
+EquiSurfaces gEquiSurfaces;         //started the first time they are shown
+bool gEquiSurfacesStarted = false;
+double gIsovalue = 3;               //potential of the outermost surfaces (mJ)
+bool gMoveCharges = false;          //the added charges orbit the centre one (menu)
+ForceClipmap gForceClipmap;         //forces around the stylus, for the servo callback
+bool gClipmapEnabled = false;       //the servo callback uses it (menu)
+bool gClipmapStarted = false;
+
+//for the guidance fixture (menu); its mode is FIXTURE_OFF until the path
+// is built, and the servo callback only reads the path
+#define FIXTURE_CONTROL_POINTS  48      //control points of the default path
+#define FIXTURE_SPAN_STEPS      80      //segments per span (3840 in all)
+#define FIXTURE_KNOT_SCALE      20.0    //size of the trefoil knot (mm)
+VirtualFixture gFixture;
+OmniMassModel gOmniMass;            //what gravity pulls on the arm
+bool gGravityCompensation = false;  //hold the stylus and arm up (menu)
+bool gProximityFeedback = false;    //push the stylus back near the limits (menu)
+OmniScene gOmniScene;               //the model drawn (graphics thread)
+OmniScene gServoOmniScene;          //the same, posed by the servo callback
+
+//for the experiment protocol (menu)
+struct ExperimentState
+{
+    int trial;
+    double charge[3];           //where the trial moved the charge
+    double recordStart;         //(s)
+    long recordTicks;           //servo tick count when recording started
+    long samples;               //frames recorded
+    double distanceSum;         //stylus to charge (mm)
+    double forceSum;            //force magnitude (N)
+    double forceMax;
+};
+Script gExperiment;
+ExperimentState gExperimentState;
+long gFrameCount = 0;               //frames drawn
+HapticDeviceState gFrameState;      //the device state of the last frame
+
+//the work of the servo callback (tasks set up in setupServoTasks): the
+// device state is read into the frame at the start of the tick and the
+// force sent from it at the end, so the tasks never talk to the device
+struct ServoFrame
+{
+    hduVector3Dd pos;           //stylus tip read at the start of the tick
+    double transform[16];       //and its transformation,
+    double jointAngles[3];      // the joint and gimbal angles
+    double gimbalAngles[3];
+    int buttons;                // and the buttons
+    hduVector3Dd forceVec;      //force sent to the device
+};
+ServoScheduler gServoScheduler;
+ServoFrame gServoFrame;                 //servo thread only
+
+//for the real-time servo thread ("-realtime")
+int gServoRealtimeCpu = -1;             //CPU to pin it to, -1: left as it is
+bool gServoRealtimeEntered = false;     //set up (by its first callback)
+
+//for teleoperation
+int gTeleopMode = TELEOP_OFF;
+WaveLoopbackQueue gTeleopQueues[2];     //the loopback link (both directions)
+WaveChannel gTeleopDeviceEnd;           //used by the servo callback
+WaveChannel gTeleopSimulationEnd;       //used by the simulation loop
+WaveMaster gWaveMaster;                 //device port of the coupling
+WaveSlave gWaveSlave;                   //simulation port (the proxy)
+volatile long gTeleopRunning = 0;       //cleared to stop the simulation thread
+ThreadHandle gTeleopThread;
+
+//Camera Attributes (Rotation/Scaling on the centre sphere)
+double CamRotationY = 0;            //rotation (degrees)
+double CamRotationX = 0;
+double CamZoom = 1;                 //scale factor
+SceneView gSceneView = { 1, 1, NULL };  //what the shapes are tessellated for
+bool gIsRotatingCamera = false;     //flags to indicate which operation to perform
+bool gIsScalingCamera = false;      // according to different mouse clicks.
+bool gIsTranslatingCamera = false;
+
+//for the haptic device
+HHD ghHD = HD_INVALID_HANDLE;   //handle of the device
+HDSchedulerHandle gSchedulerCallback = HD_INVALID_HANDLE;   //handle of the scheduler
+DeviceStateMapping gDeviceStatePublisher;   //shared memory the servo publishes to
+
+//*****************************************************************************
+//                USER-DEFINED CLASS
+//*****************************************************************************
+
+//*****************************************************************************
+//                UTILITY FUNCTION PROTOTYPES
+//*****************************************************************************
+
+//=====================================================================
+//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
+//=====================================================================
+
+//This procedure intializes the GLUT setting.  It creates the graphics window
+// and assigns functions for display, mouse click, mouse movement, and popup menu.
+void initGlut(int argc, char* argv[]);
+
+//This procedure detects which mouse button is clicked and sets the
+// appropriate flags to indicate which event should occur.
+void MyGlutMouse(int button, int state, int x, int y);
+
+//This procedure detects the motion of the mouse (i.e. dragging"),
+// and performs operations depending on how the mouse is dragged
+// and which flag is set.
+void MyGlutMotion(int x, int y);
+
+//This function takes care of operations to perform when the program is idle.
+void MyGlutIdle(void);
+
+//This procedure sets up the functionalities of the menu items of the popup
+// menus when a mouse button is clicked.
+//For this example, both menu items display certain texts.
+void MyGlutMenu(int ID);
+
+// This handler gets automatically called when the program is exiting. 
+//  The program ensures that the haptic device and the scheduler are
+//  properly shutdown
+void __cdecl exitHandler();
+
+//This function starts the worker threads of the background computations
+// the first time it is called, and returns their pool.
+TaskPool& startTaskPool();
+
+
+//=====================================================================
+//     <HAPTICS>:FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
+//=====================================================================
+
+//This procedure sends to the scheduler a task (i.e. a callback function)
+// that updates the force feedback of the device continuously.
+void ScheduleForceFeedback();
+
+//This procedure sets up the tasks of the servo callback, most important
+// first (also driven by "runServoAllocationCheck").
+void setupServoTasks();
+
+//This is the callback function calculates the force (by calling 
+// "CalculateForce()" and SET the resulting forces to the device.
+//The callback function is scheduled to the scheduler in an "asynchronous"
+// fashion, and the function is called repeatedly each time it finishes.
+HDCallbackCode HDCALLBACK SettingForceCallback(void *data);
+
+//This procedure reads the state of the device the servo tasks use into
+// "frame" (it must be called inside the haptic frame).
+void servoReadDevice(ServoFrame& frame);
+
+//This procedure performs the work of one servo tick: given the current
+// stylus tip position, it computes the force to be sent to the device.
+//It doesn't talk to the device, so it can also be driven by simulated ticks.
+void ServoTick(const hduVector3Dd& pos, hduVector3Dd& forceVec);
+
+//These procedures are the tasks of the servo callback (see ServoScheduler.h),
+// given the ServoFrame of the tick: the force (always run), publishing the device state (skipped when the
+// tick is late) and the event log (deferred when the tick is late).
+void servoForceTask(void* data, double now, double elapsed);
+void servoPublishTask(void* data, double now, double elapsed);
+void servoEventTask(void* data, double now, double elapsed);
+
+//This procedure publishes the device state of the current servo tick to
+// the shared memory.
+void publishDeviceState(double now, const ServoFrame& frame);
+
+//This callback function has the responsibility of GETTING haptic device data that is
+// constantly modified by the device. 
+//In the main graphics loop function, this callback function is scheduled 
+// to the scheduler in a "synchronous" fashion.  
+HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData);
+
+//This function calculates the force vector to be sent to the haptic device.
+//Currently, the force is calculated based on the current position of the 
+// device cursor and Coulomb's Law (summed over the fixed charges).
+hduVector3Dd CalculateForce(hduVector3Dd pos);
+
+//This procedure adds the force of the guidance fixture, if it is on.
+void addFixtureForce(const hduVector3Dd& pos, hduVector3Dd& forceVec);
+
+//This function builds the path of the guidance fixture: a trefoil knot
+// around the centre charge.  Returns false if out of memory.
+bool buildFixturePath();
+
+//This procedure adds the force that holds the stylus and arm up against
+// gravity at joint angles "jointAngles", if it is on.
+void addGravityCompensation(const double jointAngles[3], hduVector3Dd& forceVec);
+
+//This procedure computes the effort of each motor of the arm for the
+// tip force "force": its torque as a share of the most it gives.
+void computeJointEffort(const double jointAngles[3], const double force[3], double effort[3]);
+
+//This procedure fills "set" with the links of the (posed) Omni model
+// and the added charges.
+void buildOmniCapsules(const SceneGraph& omni, CapsuleSet& set);
+
+//This procedure adds the force that pushes the stylus back from where
+// the arm nears itself or a charge, if it is on.
+void addProximityForce(const double jointAngles[3], const double gimbalAngles[3], hduVector3Dd& forceVec);
+
+//This procedure is the environment of the teleoperation proxy: the
+// Coulomb force at "position".
+void teleopEnvironment(const double position[3], double force[3]);
+
+//This procedure runs the simulation side of the teleoperation link at
+// (about) 1 kHz until "gTeleopRunning" is cleared.
+void teleopSimulationLoop(void* data);
+
+//This function runs this process as the simulation side of a UDP link
+// ("-teleop-sim"), printing the link statistics once per second.
+int runTeleopSimulation(int port);
+
+//This function measures the wake-up jitter of a 1 kHz loop running the
+// servo tick, with default and with real-time scheduling ("-rt-jitter").
+int runJitterReport(double seconds);
+
+//This procedure prints the statistics of one end of the link.
+void printTeleopStatistics(const char* name, const WaveChannel& channel);
+
+//=====================================================================
+//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
+//=====================================================================
+
+//This procedure sets up the viewing condition for the scene to be drawn.
+//This procedure uses the haptic device coordinate space as model space 
+// of our scene.  An orthographic projection is defined to fit this space.
+//NOTE: LLB means Low, Left, Back point of device workspace.
+//      TRF means Top, Right, Front point of device workspace. 
+void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3]);
+
+//This procedure sets up the lighting (and shading) conditions 
+// for the scene to be drawn.
+void initGraphicsLighting();
+
+//This is the main display looping function that is run and draws the 
+// screen continuously.
+//Currently this function draws one fixed sphere (with axes), one movable
+// sphere (with axes), and an arrow (representing the force).
+void MyGlutDisplay(void);
+
+//This procedure draws the X,Y,Z axis for the current coordinate frame.
+void drawAxes();
+
+//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
+// of the current coordinate frame.
+void drawFixedSphere(GLUquadricObj* quadObj);
+
+//This procedure draws the fixed charges (red: attracting, blue: repelling).
+void drawCharges(GLUquadricObj* quadObj);
+
+//This procedure draws the latest field lines and glyphs built on the
+// task pool, and asks for a new build when the charges or the zoom changed.
+void drawFieldLines();
+
+//This procedure draws the equipotential surfaces (translucent, so last),
+// and asks for the blocks changed since the last frame to be rebuilt.
+void drawEquipotentials();
+
+//This procedure draws the path of the guidance fixture.
+void drawFixturePath();
+
+//This procedure turns the added charges around the centre one, at a rate
+// independent of the frame rate.
+void moveCharges();
+
+//This procedure is the experiment protocol (a script, see ExperimentScript.h).
+void experimentProtocol(Script& s, void* data);
+
+//This procedure adds the device state of a frame to the trial statistics.
+void recordExperimentSample(ExperimentState& e, const HapticDeviceState& state);
+
+//This procedure resumes the experiment protocol, if it is running.
+void resumeExperiment();
+
+//This procedure draws the "movable sphere" that corresponds to the cursor
+// of the haptic device.
+void drawMovableSphere(GLUquadricObj* quadObj,
+                       const double transform[16],
+                       HDint button_state);
+
+//This procedure draws the visual representation (an arrow) that represents
+// the magnitude and direction of the Coulomb Force.
+void drawForceVisualRepresentation(GLUquadricObj* quadObj,
+                                   const double position[3],                       
+                                   const double strength);
+
+//This procedure computes the rotation matrix (in OpenGL column-major order)
+// that turns the Z axis into the direction of the force arrow.
+void computeForceArrowRotation(const double position[3], double rotVals[4][4]);
+
+//This procedure draws the (posed) Omni model, its body and links tinted
+// by the effort of the motors that turn them (see "computeJointEffort").
+void drawPhantonOmni(GLUquadricObj* quadObj, int button, const double effort[3]);
+
+//This procedure sets the colour of a part of the arm: its own colour
+// turning yellow as "effort" goes from 0 to 1.
+void setEffortColour(SceneGraph& graph, int node, float red, float green, float blue, float alpha,
+                     double effort);
+
+//This procedure draws a line between the closest points of every two
+// shapes of the arm (or of the arm and a charge) nearer than
+// PROXIMITY_MARGIN, from yellow to red as they close in.
+void drawProximityWarnings(const SceneGraph& omni);
+
+//This procedure builds the scene graph of the Omni model: its frames,
+// their shapes and their colours, all joints at 0.
+void buildOmniScene(OmniScene& omni);
+
+//This procedure turns the joints of the Omni model to the given angles
+// (radians, as read from the device) and updates its world matrices,
+// relative to the frame the model is drawn in.
+void poseOmniScene(OmniScene& omni, const double joint_angles[3], const double gimbal_angles[3]);
+
+//=====================================================================
+//    <BENCHMARK>: MICRO-BENCHMARKS OF THE HOT PATHS ("-bench" mode)
+//=====================================================================
+
+
+//This procedure times the force, kinematics and drawing set-up kernels
+// and (optionally) writes the results as JSON.  It runs without the
+// haptic device and without opening a window.
+int runBenchmarks(const char* jsonPath, const char* executable);
+
+//This function drives the tasks of the servo callback through many
+// simulated ticks and returns the number of heap allocations made inside
+// them (which must be zero).
+long runServoAllocationCheck(long ticks);
+//void drawHollowCube();
+//*****************************************************************************
+//                THE MAIN FUNCTION - (this is where things start...)
+//*****************************************************************************
+int main(int argc, char* argv[])
+{
+    HDErrorInfo error;
+
+    //Count (or trap) any heap allocation made inside the servo callback.
+    servoAllocTrackerInstall();
+
+    //the (estimated) masses of the arm, for the gravity compensation
+    omniMassModelDefault(gOmniMass);
+    //the Omni model, drawn and for the proximity checks
+    buildOmniScene(gOmniScene);
+    buildOmniScene(gServoOmniScene);
+
+    //"assignment2 -bench [results.json]" only runs the micro-benchmarks
+    if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+        return runBenchmarks(argc > 2 ? argv[2] : NULL, argv[0]);
+
+    //"assignment2 -rt-jitter [seconds]" only measures the servo jitter
+    if (argc > 1 && strcmp(argv[1], "-rt-jitter") == 0)
+        return runJitterReport(argc > 2 ? atof(argv[2]) : 10);
+
+    //the teleoperation options only change where the force comes from
+    if (argc > 2 && strcmp(argv[1], "-teleop-sim") == 0)
+        return runTeleopSimulation(atoi(argv[2]));
+    if (argc > 3 && strcmp(argv[1], "-teleop-device") == 0)
+    {
+        if (!waveUdpOpen(gTeleopDeviceEnd, argv[2], atoi(argv[3])))
+            return -1;
+        gTeleopMode = TELEOP_DEVICE;
+        printf("Teleoperation: field served by %s:%s\n", argv[2], argv[3]);
+    }
+    else if (argc > 3 && strcmp(argv[1], "-teleop-loopback") == 0)
+    {
+        waveLoopbackOpen(gTeleopDeviceEnd, gTeleopSimulationEnd, gTeleopQueues,
+                         atof(argv[2]) / 1000, atof(argv[3]) / 1000);
+        gTeleopRunning = 1;
+        if (!threadStart(teleopSimulationLoop, NULL, &gTeleopThread))
+        {
+            fprintf(stderr, "Failed to start the simulation thread\n");
+            return -1;
+        }
+        gTeleopMode = TELEOP_LOOPBACK;
+        printf("Teleoperation: loopback link, %s ms delay + up to %s ms jitter\n",
+               argv[2], argv[3]);
+    }
+
+    printf("ENSC488 - Assignment2 Chnejie Yao 301160093\n\n");
+    printf("Starting application\n");
+
+    //"-latency [frames.csv]" (after any other option) measures the
+    // motion-to-photon latency of every frame
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-latency") != 0)
+            continue;
+        const char* csvPath = (a + 1 < argc && argv[a + 1][0] != '-') ? argv[a + 1] : NULL;
+        if (latencyProbeStart(gLatencyProbe, csvPath))
+            printf("Measuring motion-to-photon latency (reported on exit)\n");
+    }
+
+    //"-realtime [cpu]" (after any other option) sets the servo thread up
+    // as a real-time one
+    for (int a = 1; a < argc; a++)
+    {
+        if (strcmp(argv[a], "-realtime") != 0)
+            continue;
+        gServoRealtimeCpu = (a + 1 < argc && argv[a + 1][0] != '-') ? atoi(argv[a + 1])
+                                                                     : servoRealtimeChooseCpu();
+        threadServoCpu() = gServoRealtimeCpu;
+        if (!servoRealtimeLockMemory())
+            fprintf(stderr, "Warning: cannot lock the memory of the process\n");
+        printf("Real-time servo thread on CPU %d\n", gServoRealtimeCpu);
+    }
+    
+    //Set up the TERMINATION procedures when program finishes.
+    //Things to take care of including shutting down the haptic device and scheduler.
+    atexit(exitHandler);
+
+    //Initialize the haptic device.  This needs to be called before any actions on 
+    // the device.
+    ghHD = hdInitDevice(HD_DEFAULT_DEVICE);
+    //Check for any initialization error.  If so, terminate the program.
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to initialize haptic device");
+        fprintf(stderr, "\nPress any key to quit.\n");
+        getch();
+        return -1;
+    }
+
+    //Retrieve and display the model name of the haptic device.
+    printf("Found device %s\n",hdGetString(HD_DEVICE_MODEL_TYPE));
+    
+    //Enable haptic force feedback
+    hdEnable(HD_FORCE_OUTPUT);
+    hdEnable(HD_MAX_FORCE_CLAMPING);
+
+    //Find the workspace of the robotic links of the haptic device.
+    //The workspace is defined by two vertices: the Low Left Back point
+    // and the Top Right Front point.
+    printf("The workspace two corner vertices are:\n");
+    HDdouble maxWorkspace[6];
+    hdGetDoublev(HD_MAX_WORKSPACE_DIMENSIONS, maxWorkspace);
+    printf("%lf %lf %lf %lf %lf %lf\n", maxWorkspace[0],
+           maxWorkspace[1],
+           maxWorkspace[2],
+           maxWorkspace[3],
+           maxWorkspace[4],
+           maxWorkspace[5]);
+    printf("\n");
+
+    //Start the scheduler of the haptic device.
+    hdStartScheduler();
+    //Check if the scheduler is initialized properly.
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to start scheduler");
+        fprintf(stderr, "\nPress any key to quit.\n");
+        getch();
+        return -1;
+    }
+    
+    //Initializes all GLUT related functions.
+    initGlut(argc, argv);
+
+    //Based on the workspace of the haptic device,
+    // set the viewing volumn of the scene to correspond
+    // to this workspace.
+    //Low, Left, Back point of device workspace.
+    hduVector3Dd LLB; 
+    LLB.set(maxWorkspace[0], maxWorkspace[1], maxWorkspace[2]);
+    //Top, Right, Front point of device workspace.
+    hduVector3Dd TRF;
+    TRF.set(maxWorkspace[3], maxWorkspace[4], maxWorkspace[5]);
+    //Initializes the viewing condition for the scene
+    initGraphicsViewing(LLB, TRF);
+
+    //Initializes the lighting condition for the scene
+    initGraphicsLighting();
+
+
+    //Schedule the force feedback process to the scheduler
+    std::cout << "Starting haptics callback..." << std::endl;
+    //Publish the device state for other processes (loggers, dashboards).
+    if (deviceStateMap(&gDeviceStatePublisher, 1) != 0)
+        fprintf(stderr, "Warning: cannot publish the device state to shared memory\n");
+
+    ScheduleForceFeedback();
+
+    //Enter the main loop for drawing the scene
+    std::cout << "Starting graphics callback..." << std::endl;
+    glutMainLoop(); //This is the "famous" GLUT infinite loop
+                    // that runs forever unless the program exits.
+
+    printf("Done\n");
+    return 0;
+}
+
+/******************************************************************************/
+
+
+//=====================================================================
+//           FUNCTIONS FOR INITIALIZATION (OF GLUT) and TERMINATION
+//=====================================================================
+
+//This procedure intializes the GLUT setting.  It creates the graphics window
+// and assigns functions for display, mouse click, mouse movement, and popup menu.
+void initGlut(int argc, char* argv[])
+{
+    glutInit(&argc, argv);          // Initialize GLUT.
+    glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB | GLUT_DEPTH);
+    glutInitWindowSize(500, 500);   //graphics window creation
+    glutCreateWindow("ENSC488 Assignment2 Chenjie Yao 301160093");
+
+    glutDisplayFunc(MyGlutDisplay);   //GLUT callback - display or draw scene
+    glutMouseFunc(MyGlutMouse);       //GLUT callback - mouse button detection
+    glutMotionFunc(MyGlutMotion);     //GLUT callback - mouse button movement
+    glutIdleFunc(MyGlutIdle);         //GLUT callback - idle operations
+
+    glutCreateMenu(MyGlutMenu);       //GLUT callback - Setup GLUT popup menu
+    glutAddMenuEntry("How to Play", 0);
+    glutAddMenuEntry("About", 1);
+    glutAddMenuEntry("Toggle Coulomb Force", 2);
+    glutAddMenuEntry("Toggle Passivity Control", 3);
+    glutAddMenuEntry("Toggle Field Lines", 4);
+    glutAddMenuEntry("Add Charge", 5);
+    glutAddMenuEntry("Remove Added Charges", 6);
+    glutAddMenuEntry("Toggle Equipotentials", 7);
+    glutAddMenuEntry("Next Isovalue", 8);
+    glutAddMenuEntry("Toggle Charge Motion", 9);
+    glutAddMenuEntry("Toggle Force Clipmap", 10);
+    glutAddMenuEntry("Servo Task Costs", 11);
+    glutAddMenuEntry("Run Experiment Protocol", 12);
+    glutAddMenuEntry("Cycle Guidance Fixture", 13);
+    glutAddMenuEntry("Toggle Gravity Compensation", 14);
+    glutAddMenuEntry("Toggle Arm Proximity Feedback", 15);
+    glutAttachMenu(GLUT_RIGHT_BUTTON);//Right click the mouse to launch the popup menu
+
+}//END of initGlut
+
+
+//This procedure detects which mouse button is clicked and sets the
+// appropriate flags to indicate which event should occur.
+void MyGlutMouse(int button, int state, int x, int y)
+{
+    if (state == GLUT_DOWN)
+    {   //some mouse button is pressed
+        if (button == GLUT_LEFT_BUTTON)
+        {   //Left click the mouse to rotate the centre sphere.
+            gIsRotatingCamera = true;            
+        }
+        else if (button == GLUT_MIDDLE_BUTTON)
+        {   //Click the centre button to scale the centre sphere.
+            gIsScalingCamera = true;            
+        }
+
+        //record the current mouse PIXEL location
+        gLastMouseX = x;
+        gLastMouseY = y;
+    }
+    else
+    {   //no mouse button is pressed...
+        gIsRotatingCamera = false;
+        gIsScalingCamera = false;
+        gIsTranslatingCamera = false;
+    }
+}//END of MyGlutMouse
+
+
+//This procedure detects the motion of the mouse (i.e. dragging"),
+// and performs operations depending on how the mouse is dragged
+// and which flag is set.
+void MyGlutMotion(int x, int y)
+{
+    if (gIsRotatingCamera)
+    {   
+        //rotate the centre sphere
+        //dragging the mouse horizontally rotates the object about Y axis
+        CamRotationY = CamRotationY + 0.1*(x - gLastMouseX);
+        //dragging the mouse vertically rotates the object about X axis
+        CamRotationX = CamRotationX + 0.1*(y - gLastMouseY);
+    }
+    else if (gIsScalingCamera)
+    {
+        //dragging the mouse vertically scales the object up or down.
+        CamZoom = CamZoom - 0.01*(y - gLastMouseY);
+    }
+
+    //record the current mouse PIXEL position.
+    gLastMouseX = x;
+    gLastMouseY = y;
+}//END of MyGlutMotion
+
+
+//This function takes care of operations to perform when the program is idle.
+void MyGlutIdle(void)
+{
+    //move the added charges, if they are set moving
+    moveCharges();
+
+    //run the experiment protocol up to its next wait
+    resumeExperiment();
+
+    //redisplay the scene
+    glutPostRedisplay();
+
+    //print the errors/events queued by the servo callback
+    servoEventDrain(stderr);
+
+    //report any heap allocation the servo callback has made since last time
+    static long reportedServoAllocs = 0;
+    if (gServoAllocCount != reportedServoAllocs)
+    {
+        reportedServoAllocs = gServoAllocCount;
+        fprintf(stderr, "Warning: %ld heap allocation(s) inside the servo callback"
+                " (last one %ld bytes)\n", reportedServoAllocs, gServoAllocLastSize);
+    }
+
+    //check if the scheduler has exited... if so, terminate program as well.
+    if (!hdWaitForCompletion(gSchedulerCallback, HD_WAIT_CHECK_STATUS))
+    {
+        printf("The main scheduler callback has exited\n");
+        printf("Press any key to quit.\n");
+        getch();
+        exit(-1);
+    }
+}//END of MyGlutIdle
+
+
+//This procedure sets up the functionalities of the menu items of the popup
+// menus when a mouse button is clicked.
+//For this example, both menu items display certain texts.
+void MyGlutMenu(int ID)
+{
+    switch(ID) 
+    {
+        case 0: //"How to Play" information in the popup menu.
+            
+            break;
+        case 1: //"About" information in the popup menu
+            
+            break;
+        case 2: //feel the fixed charge (Coulomb's Law) or not
+            gCoulombForceEnabled = !gCoulombForceEnabled;
+            break;
+        case 3: //Passivity control on/off (the observer always runs)
+            gPassivity.enabled = !gPassivity.enabled;
+            printf("Passivity control %s (%.1f mJ dissipated so far)\n",
+                   gPassivity.enabled ? "on" : "off", gPassivity.dissipated);
+            break;
+        case 4: //field lines on/off (the cache starts the first time)
+            if (!gFieldLineCacheStarted)
+            {
+                gFieldLineCacheStarted = true;
+                if (!fieldLineCacheStart(gFieldLineCache, startTaskPool()))
+                    fprintf(stderr, "Failed to start the field line cache\n");
+            }
+            gShowFieldLines = !gShowFieldLines;
+            break;
+        case 5: //a random charge (either sign) somewhere in the workspace
+        {
+            double position[3];
+            for (int i = 0; i < 3; i++)
+                position[i] = rand() % 161 - 80;
+            if (!chargeSetAdd(gChargeSet, position, (rand() % 2) ? 1.0 : -1.0))
+                printf("No more than %d charges\n", CHARGE_MAX);
+            break;
+        }
+        case 6: //back to the centre charge alone
+            servoStoreRelease(&gChargeSet.count, 1);
+            gChargeSet.version++;
+            break;
+        case 7: //equipotentials on/off (the surfaces start the first time)
+            if (!gEquiSurfacesStarted)
+            {
+                gEquiSurfacesStarted = true;
+                if (!equiSurfacesStart(gEquiSurfaces, startTaskPool()))
+                    fprintf(stderr, "Failed to start the equipotential surfaces\n");
+            }
+            gShowEquipotentials = !gShowEquipotentials;
+            break;
+        case 8: //cycle through a few isovalues
+            gIsovalue = (gIsovalue >= 8) ? 2 : gIsovalue * 1.5;
+            printf("Equipotentials at +-%.1f, %.1f and %.1f mJ\n",
+                   gIsovalue, 2*gIsovalue, 4*gIsovalue);
+            break;
+        case 9: //the added charges orbit the centre one or stop
+            gMoveCharges = !gMoveCharges;
+            break;
+        case 10: //the servo callback takes the force from the clipmap or not
+            if (!gClipmapStarted)
+            {
+                gClipmapStarted = true;
+                if (!clipmapStart(gForceClipmap, gChargeSet))
+                {
+                    fprintf(stderr, "Failed to start the force clipmap thread\n");
+                    break;
+                }
+            }
+            gClipmapEnabled = !gClipmapEnabled;
+            if (!gClipmapEnabled && gForceClipmap.hits + gForceClipmap.misses > 0)
+                printf("Force clipmap off: %.1f%% of the ticks were served from the grid\n",
+                       100.0 * gForceClipmap.hits / (gForceClipmap.hits + gForceClipmap.misses));
+            break;
+        case 11: //what the tasks of the servo callback cost so far
+            servoSchedulerPrint(gServoScheduler, stdout);
+            break;
+        case 12: //(re)start the experiment protocol
+            memset(&gExperimentState, 0, sizeof(gExperimentState));
+            scriptStart(gExperiment, experimentProtocol, &gExperimentState);
+            break;
+        case 13: //guidance fixture: off -> guide -> tube -> off
+            if (gFixture.count == 0 && !buildFixturePath())
+            {
+                fprintf(stderr, "Failed to build the fixture path\n");
+                break;
+            }
+            gFixture.mode = (gFixture.mode + 1) % (FIXTURE_TUBE + 1);
+            printf("Guidance fixture: %s\n", (gFixture.mode == FIXTURE_GUIDE) ? "guide" :
+                   (gFixture.mode == FIXTURE_TUBE) ? "tube" : "off");
+            break;
+        case 14: //hold the stylus and arm up, or not
+            gGravityCompensation = !gGravityCompensation;
+            printf("Gravity compensation %s\n", gGravityCompensation ? "on" : "off");
+            break;
+        case 15: //push the stylus back near the limits of the arm, or not
+            gProximityFeedback = !gProximityFeedback;
+            printf("Arm proximity feedback %s\n", gProximityFeedback ? "on" : "off");
+            break;
+    }
+}//END of MyGlutMenu      
+
+
+// This handler gets automatically called when the program is exiting. 
+//  The program ensures that the haptic device and the scheduler are
+//  properly shutdown
+void __cdecl exitHandler()
+{
+    //stop the scheduler and cleans up any unfinished jobs on the scheduler.
+    hdStopScheduler();
+    hdUnschedule(gSchedulerCallback);
+
+    //let the field line and equipotential builds finish, then stop the
+    // workers
+    if (gFieldLineCacheStarted)
+        fieldLineCacheStop(gFieldLineCache);
+    if (gEquiSurfacesStarted)
+        equiSurfacesStop(gEquiSurfaces);
+    if (gTaskPoolStarted)
+        taskPoolStop(gTaskPool);
+    if (gClipmapStarted)
+        clipmapStop(gForceClipmap);
+
+    //the servo callback has stopped, so nothing publishes any more
+    deviceStateClose(&gDeviceStatePublisher);
+
+    //print whatever the servo callback reported last
+    servoEventDrain(stderr);
+
+    //report the latency measurements, if any
+    latencyProbeFinish(gLatencyProbe, stdout);
+
+    //and what the servo tasks cost
+    if (gServoScheduler.ticks > 0)
+        servoSchedulerPrint(gServoScheduler, stdout);
+
+    if (gTeleopMode == TELEOP_LOOPBACK)
+    {
+        servoStoreRelease(&gTeleopRunning, 0);
+        threadJoin(gTeleopThread);
+        printTeleopStatistics("simulation", gTeleopSimulationEnd);
+    }
+    if (gTeleopMode != TELEOP_OFF)
+        printTeleopStatistics("device", gTeleopDeviceEnd);
+
+    //if the haptic device hasn't been disabled yet, disable it now.
+    if (ghHD != HD_INVALID_HANDLE)
+    {
+        hdDisableDevice(ghHD);
+        ghHD = HD_INVALID_HANDLE;
+    }
+}//END of exitHandler
+
+
+//This function starts the worker threads of the background computations
+// the first time it is called, and returns their pool.  (If no thread
+// starts, the pool runs the tasks on the graphics thread.)
+TaskPool& startTaskPool()
+{
+    if (!gTaskPoolStarted)
+    {
+        gTaskPoolStarted = true;
+        if (taskPoolStart(gTaskPool, 0, 0))
+            printf("%d background worker(s), kept off CPU %d\n", gTaskPool.workerCount, threadServoCpu());
+        else
+            fprintf(stderr, "Failed to start the background workers\n");
+    }
+    return gTaskPool;
+}//END of startTaskPool
+
+
+
+//=====================================================================
+//   <HAPTICS>: FUNCTIONS RELATED TO HAPTIC DEVICE INTERACTION and FORCES
+//=====================================================================
+
+//This procedure sends to the scheduler a task (i.e. a callback function)
+// that updates the force feedback of the device continuously.
+void ScheduleForceFeedback()
+{
+    setupServoTasks();
+
+    //schedule asynchronously to the scheduler a process for setting forces.
+    gSchedulerCallback = hdScheduleAsynchronous(
+        SettingForceCallback, 0, HD_DEFAULT_SCHEDULER_PRIORITY);
+
+    //checks if the process is scheduled successfully
+    HDErrorInfo error;
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        hduPrintError(stderr, &error, "Failed to initialize haptic device");
+        fprintf(stderr, "\nPress any key to quit.\n");
+        getch();
+        exit(-1);
+    }
+
+}//END of ScheduleForceFeedback
+
+
+//This procedure sets up the tasks of the servo callback, most important
+// first (also driven by "runServoAllocationCheck").
+void setupServoTasks()
+{
+    servoSchedulerInit(gServoScheduler, SERVO_SCHED_TICK_BUDGET);
+    servoSchedulerAdd(gServoScheduler, "force", servoForceTask, &gServoFrame, 0, SERVO_TASK_ALWAYS, 200);
+    servoSchedulerAdd(gServoScheduler, "publish", servoPublishTask, &gServoFrame, 1, SERVO_TASK_SKIP, 20);
+    servoSchedulerAdd(gServoScheduler, "events", servoEventTask, NULL, 2, SERVO_TASK_DEFER, 10);
+}
+
+
+//This is the callback function calculates the force (by calling 
+// "CalculateForce()" and SET the resulting forces to the device.
+//The callback function is scheduled to the scheduler in an "asynchronous"
+// fashion, and the function is called repeatedly each time it finishes.
+HDCallbackCode HDCALLBACK SettingForceCallback(void *)
+{
+    //"-realtime": the first callback sets its thread up
+    if (gServoRealtimeCpu >= 0 && !gServoRealtimeEntered)
+    {
+        ServoRealtimeStatus status;
+        servoRealtimeEnterThread(gServoRealtimeCpu, status);
+        gServoRealtimeEntered = true;
+        if (status.cpu < 0)
+            servoEventPost(SERVO_EVENT_NOTICE, NULL, "Real-time servo: cannot pin the thread to CPU",
+                           gServoRealtimeCpu);
+        if (!status.priority)
+            servoEventPost(SERVO_EVENT_NOTICE, NULL,
+                           "Real-time servo: real-time priority refused (needs root/rtprio), priority",
+                           SERVO_RT_PRIORITY);
+    }
+
+    //the servo thread must not touch the heap (see ServoAllocTracker.h)
+    ServoAllocScope allocScope;
+
+    //get a "handle" on the current haptic device
+    HHD hHD = hdGetCurrentDevice();
+
+    //NOTE: Setting forces must be in between the "hdBeginFrame()"
+    // and "hdEndFrame()".  Between these two lines, the haptic status
+    // (forces) is constant.
+    hdBeginFrame(hHD);
+
+    //Obtain the current position of the tip of the stylus (and the rest
+    // of the device state)
+    servoReadDevice(gServoFrame);
+
+    //Calculate the force vector, then whatever else the tick has time for
+    // (see setupServoTasks), and set the force vector to the haptic device.
+    servoSchedulerRun(gServoScheduler, servoClockSeconds());
+    hdSetDoublev(HD_CURRENT_FORCE, gServoFrame.forceVec);
+
+    hdEndFrame(hHD);
+
+    //Check if the scheduler returns any error when executing this process...
+    //NOTE: the error is only queued here; printing it (blocking console I/O)
+    // is left to the graphics loop, see ServoEventLog.h
+    HDErrorInfo error;
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+        servoEventPostError(&error, "Error during scheduler callback");
+
+        if (hduIsSchedulerError(&error))
+        {
+            //if there is error in scheduler, terminates (by force) the current
+            // process
+            return HD_CALLBACK_DONE;
+        }
+    }
+
+    //continue executing the setting up of the force feedback
+    // by telling the scheduler to repeat on the process after it is completed
+    // each time.
+    //NOTE: this is how we can have a process to set up device forces that runs
+    // in parallel with other (graphics, getting data) processes.a
+    return HD_CALLBACK_CONTINUE;
+}//END of SettingForceCallback
+
+
+//This procedure reads the state of the device the servo tasks use into
+// "frame" (it must be called inside the haptic frame).
+void servoReadDevice(ServoFrame& frame)
+{
+    hdGetDoublev(HD_CURRENT_POSITION, frame.pos);
+    hdGetDoublev(HD_CURRENT_TRANSFORM, frame.transform);
+    hdGetDoublev(HD_CURRENT_JOINT_ANGLES, frame.jointAngles);
+    hdGetDoublev(HD_CURRENT_GIMBAL_ANGLES, frame.gimbalAngles);
+    hdGetIntegerv(HD_CURRENT_BUTTONS, &frame.buttons);
+}
+
+
+//This procedure performs the work of one servo tick: given the current
+// stylus tip position, it computes the force to be sent to the device.
+//It doesn't talk to the device, so it can also be driven by simulated ticks.
+void ServoTick(const hduVector3Dd& pos, hduVector3Dd& forceVec)
+{
+    //by default the Omni model only displays the arm, so the (constant) wall
+    // force is sent to the device; the menu turns on the Coulomb field.
+    //When teleoperating, the field is felt through the wave coupling.
+    if (gTeleopMode != TELEOP_OFF)
+        waveMasterUpdate(gWaveMaster, gTeleopDeviceEnd, servoClockSeconds(), pos, forceVec);
+    else if (gCoulombForceEnabled)
+    {
+        //from the grid around the stylus when it covers it
+        if (!gClipmapEnabled || !clipmapForce(gForceClipmap, gChargeSet, CamZoom, pos, forceVec))
+            forceVec = CalculateForce(pos);
+        else
+            addFixtureForce(pos, forceVec);
+    }
+    else if (gFixture.mode != FIXTURE_OFF)
+    {
+        //the guidance alone
+        forceVec.set(0, 0, 0);
+        addFixtureForce(pos, forceVec);
+    }
+    else
+        forceVec.set(wallForce[0], wallForce[1], wallForce[2]);
+
+    //the weight of the stylus and arm is felt here, whatever the force
+    // (the remote field has no such weight)
+    if (gTeleopMode == TELEOP_OFF)
+        addGravityCompensation(gServoFrame.jointAngles, forceVec);
+
+    //and so are the limits of the arm
+    addProximityForce(gServoFrame.jointAngles, gServoFrame.gimbalAngles, forceVec);
+}//END of ServoTick
+
+
+//This procedure is the force task of the servo callback: computes the
+// force and filters it (the callback sends it to the device).
+void servoForceTask(void* data, double now, double)
+{
+    ServoFrame& frame = *static_cast<ServoFrame*>(data);
+    ServoTick(frame.pos, frame.forceVec);
+    servoWatchdogFilter(gServoWatchdog, now, frame.forceVec, false);
+    //remove any energy the (inverse-square) field has injected, last, so
+    // the observer sees the force actually sent
+    passivityFilter(gPassivity, now, frame.pos, frame.forceVec);
+}//END of servoForceTask
+
+
+//This procedure is the publishing task of the servo callback.
+void servoPublishTask(void* data, double now, double)
+{
+    ServoFrame& frame = *static_cast<ServoFrame*>(data);
+    if (gDeviceStatePublisher.shm != NULL)
+        publishDeviceState(now, frame);
+}
+
+
+//This procedure is the event log task of the servo callback.
+void servoEventTask(void*, double, double)
+{
+    servoEventPoll();
+}
+
+
+//This procedure publishes the device state of the current servo tick to
+// the shared memory.
+void publishDeviceState(double now, const ServoFrame& frame)
+{
+    DeviceStateRecord record;
+    record.time = now;
+    for (int i = 0; i < 3; i++)
+    {
+        record.position[i] = frame.pos[i];
+        record.jointAngles[i] = frame.jointAngles[i];
+        record.gimbalAngles[i] = frame.gimbalAngles[i];
+        record.force[i] = frame.forceVec[i];
+    }
+    memcpy(record.transform, frame.transform, sizeof(record.transform));
+    record.buttons = frame.buttons;
+    record.reserved = 0;
+
+    //the readers never hold the servo up, see DeviceStateShm.h
+    deviceStatePublish(gDeviceStatePublisher.shm, &record);
+}//END of publishDeviceState
+
+
+//This callback function has the responsibility of GETTING haptic device data that is
+// constantly modified by the device. 
+//In the main graphics loop function, this callback function is scheduled 
+// to the scheduler in a "synchronous" fashion.  
+HDCallbackCode HDCALLBACK GettingDeviceStateCallback(void *pUserData)
+{
+    //rename the variable and type cast it as the user
+    // defined data structure "HapticDeviceState"
+    HapticDeviceState *pDisplayState = 
+        static_cast<HapticDeviceState *>(pUserData);
+    pDisplayState->sample_time = servoClockSeconds();
+
+	hdGetDoublev(HD_CURRENT_GIMBAL_ANGLES, pDisplayState->gimbal_angles);
+	hdGetDoublev(HD_CURRENT_JOINT_ANGLES, pDisplayState->joint_angles); 
+
+    //Get current stylus tip position
+    hdGetDoublev(HD_CURRENT_POSITION, pDisplayState->position);
+    //Get the overal transformation matrix for the stylus tip.
+    hdGetDoublev(HD_CURRENT_TRANSFORM, pDisplayState->transform_matrix);
+    //Get the force vector that is currently set in the haptic device
+    hdGetDoublev(HD_CURRENT_FORCE, pDisplayState->force);
+    //Get the info on which button of the stylus is pressed.
+    hdGetIntegerv(HD_CURRENT_BUTTONS, &pDisplayState->button);
+
+    //Execute this only once - since we are already doing it repeatedly (inside
+    // the GlutDisplay function)
+    return HD_CALLBACK_DONE;
+
+}//END of GettingDeviceStateCallback
+
+
+
+//This function calculates the force vector to be sent to the haptic device.
+//Currently, the force is calculated based on the current position of the 
+// device cursor and Coulomb's Law.
+hduVector3Dd CalculateForce(hduVector3Dd pos)
+{
+    //Each charge pulls (or pushes) with the regular "inverse square of
+    // distance" Coulomb's Law, or with a soft spring when the spheres
+    // overlap; the force is scaled down with the zoom of the centre sphere.
+    //(With the centre charge alone this is the original two-sphere force.)
+    hduVector3Dd forceVec;
+    chargeFieldForce(gChargeSet, CamZoom, pos, forceVec);
+
+    //plus the pull of the guidance fixture, if it is on
+    addFixtureForce(pos, forceVec);
+    return forceVec;
+}//END of CalculateForce
+
+
+//This procedure adds the force of the guidance fixture, if it is on.
+void addFixtureForce(const hduVector3Dd& pos, hduVector3Dd& forceVec)
+{
+    if (gFixture.mode == FIXTURE_OFF)
+        return;
+    double p[3] = { pos[0], pos[1], pos[2] };
+    double force[3] = { 0, 0, 0 };
+    fixtureForce(gFixture, p, force);
+    forceVec[0] += force[0];
+    forceVec[1] += force[1];
+    forceVec[2] += force[2];
+}//END of addFixtureForce
+
+
+//This procedure adds the force that holds the stylus and arm up against
+// gravity at joint angles "jointAngles", if it is on.
+void addGravityCompensation(const double jointAngles[3], hduVector3Dd& forceVec)
+{
+    if (!gGravityCompensation)
+        return;
+    double force[3];
+    omniGravityCompensation(gOmniMass, jointAngles, force);
+    forceVec[0] += force[0];
+    forceVec[1] += force[1];
+    forceVec[2] += force[2];
+}//END of addGravityCompensation
+
+
+//This procedure computes the effort of each motor of the arm for the
+// tip force "force": its torque as a share of the most it gives.
+void computeJointEffort(const double jointAngles[3], const double force[3], double effort[3])
+{
+    double position[3], J[3][3], torque[3];
+    omniKinematics(jointAngles, position, J);
+    omniForceToTorques(J, force, torque);
+    for (int i = 0; i < 3; i++)
+        effort[i] = fabs(torque[i]) / OMNI_MAX_JOINT_TORQUE;
+}//END of computeJointEffort
+
+
+//This procedure fills "set" with the links of the (posed) Omni model
+// and the added charges.
+void buildOmniCapsules(const SceneGraph& omni, CapsuleSet& set)
+{
+    //each link along the Z axis of its frame, as "buildOmniScene" draws it
+    static const struct { int frame; double from, to, radius; } links[OMNI_NUM_SHAPES] =
+    {
+        { OMNI_FRAME_BASE,    10, 10,  45 },
+        { OMNI_FRAME_BODY,     0,  0,  45 },
+        { OMNI_FRAME_LINK1,    0, 110, 7 },
+        { OMNI_FRAME_LINK2,    0, 60,  7 },
+        { OMNI_FRAME_GIMBAL1,  0, 30,  7 },
+        { OMNI_FRAME_GIMBAL2,  0, 20,  7 },
+        { OMNI_FRAME_GIMBAL3,  0, 80,  7 }
+    };
+    int k;
+    for (k = 0; k < OMNI_NUM_SHAPES; k++)
+    {
+        Capsule& shape = set.shapes[k];
+        const double* frame = sceneWorld(omni, links[k].frame);
+        matTransformPoint(frame, 0, 0, links[k].from, shape.a);
+        matTransformPoint(frame, 0, 0, links[k].to, shape.b);
+        shape.radius = links[k].radius;
+        set.ignore[k] = 0;
+    }
+    set.count = OMNI_NUM_SHAPES;
+
+    //the links joined to each other (the first link leaves the body from
+    // its centre, through the base's sphere)
+    capsuleIgnorePair(set, OMNI_SHAPE_BASE, OMNI_SHAPE_BODY);
+    capsuleIgnorePair(set, OMNI_SHAPE_BASE, OMNI_SHAPE_LINK1);
+    capsuleIgnorePair(set, OMNI_SHAPE_BODY, OMNI_SHAPE_LINK1);
+    capsuleIgnorePair(set, OMNI_SHAPE_LINK1, OMNI_SHAPE_LINK2);
+    capsuleIgnorePair(set, OMNI_SHAPE_LINK2, OMNI_SHAPE_GIMBAL1);
+    capsuleIgnorePair(set, OMNI_SHAPE_GIMBAL1, OMNI_SHAPE_GIMBAL2);
+    capsuleIgnorePair(set, OMNI_SHAPE_GIMBAL1, OMNI_SHAPE_STYLUS);
+    capsuleIgnorePair(set, OMNI_SHAPE_GIMBAL2, OMNI_SHAPE_STYLUS);
+
+    //the added charges (the centre one sits inside the base), not tested
+    // with each other
+    unsigned long charges = 0;
+    for (long c = 1; c < gChargeSet.count && set.count < CAPSULE_MAX_SHAPES; c++)
+    {
+        Capsule& shape = set.shapes[set.count];
+        for (k = 0; k < 3; k++)
+            shape.a[k] = shape.b[k] = gChargeSet.charges[c].position[k];
+        shape.radius = SPHERE_RADIUS;
+        charges |= 1UL << set.count;
+        set.count++;
+    }
+    for (k = OMNI_NUM_SHAPES; k < set.count; k++)
+        set.ignore[k] = charges;
+}//END of buildOmniCapsules
+
+
+//This procedure adds the force that pushes the stylus back from where
+// the arm nears itself or a charge, if it is on.
+//The push of every close pair is felt at the tip, along the direction
+// that separates them, moving the later link of the chain (or the link,
+// from a charge).
+void addProximityForce(const double jointAngles[3], const double gimbalAngles[3], hduVector3Dd& forceVec)
+{
+    if (!gProximityFeedback)
+        return;
+    poseOmniScene(gServoOmniScene, jointAngles, gimbalAngles);
+    CapsuleSet set;
+    buildOmniCapsules(gServoOmniScene.graph, set);
+    double clearance[CAPSULE_MAX_SHAPES];
+    CapsuleContact contacts[PROXIMITY_MAX_CONTACTS];
+    int found = capsuleProximity(set, PROXIMITY_MARGIN, clearance, contacts, PROXIMITY_MAX_CONTACTS);
+
+    double force[3] = { 0, 0, 0 };
+    for (int n = 0; n < found; n++)
+    {
+        const CapsuleContact& contact = contacts[n];
+        double push = PROXIMITY_STIFFNESS * (PROXIMITY_MARGIN - contact.clearance);
+        //(the normal points from the second shape to the first)
+        if (contact.second < OMNI_NUM_SHAPES)
+            push = -push;
+        for (int k = 0; k < 3; k++)
+            force[k] += push * contact.normal[k];
+    }
+    double magnitude = sqrt(force[0] * force[0] + force[1] * force[1] + force[2] * force[2]);
+    double scale = (magnitude > PROXIMITY_MAX_FORCE) ? PROXIMITY_MAX_FORCE / magnitude : 1;
+    forceVec[0] += scale * force[0];
+    forceVec[1] += scale * force[1];
+    forceVec[2] += scale * force[2];
+}//END of addProximityForce
+
+
+//This function builds the path of the guidance fixture: a trefoil knot
+// around the centre charge.  Returns false if out of memory.
+bool buildFixturePath()
+{
+    double control[FIXTURE_CONTROL_POINTS][3];
+    for (int k = 0; k < FIXTURE_CONTROL_POINTS; k++)
+    {
+        double t = 2 * PI * k / FIXTURE_CONTROL_POINTS;
+        control[k][0] = FIXTURE_KNOT_SCALE * (sin(t) + 2 * sin(2*t));
+        control[k][1] = FIXTURE_KNOT_SCALE * (cos(t) - 2 * cos(2*t));
+        control[k][2] = FIXTURE_KNOT_SCALE * -sin(3*t);
+    }
+    gFixture.mode = FIXTURE_OFF;
+    gFixture.stiffness = 0.2;       //N/mm
+    gFixture.radius = 5;            //mm
+    gFixture.influence = 15;        //mm
+    gFixture.maxForce = 3;          //N
+    return fixtureBuildSpline(gFixture, control, FIXTURE_CONTROL_POINTS, FIXTURE_SPAN_STEPS, true);
+}//END of buildFixturePath
+
+
+//This procedure is the environment of the teleoperation proxy: the
+// Coulomb force at "position".
+void teleopEnvironment(const double position[3], double force[3])
+{
+    hduVector3Dd forceVec = CalculateForce(hduVector3Dd(position[0], position[1], position[2]));
+    force[0] = forceVec[0];
+    force[1] = forceVec[1];
+    force[2] = forceVec[2];
+}//END of teleopEnvironment
+
+
+//This procedure runs the simulation side of the teleoperation link at
+// (about) 1 kHz until "gTeleopRunning" is cleared.
+void teleopSimulationLoop(void*)
+{
+    //the proxy integrates with the measured tick, so a late wake-up makes
+    // one longer step rather than losing time
+    ServoDeadline deadline;
+    servoDeadlineStart(deadline, SERVO_PERIOD_S);
+    while (servoLoadAcquire(&gTeleopRunning))
+    {
+        waveSlaveUpdate(gWaveSlave, gTeleopSimulationEnd, servoClockSeconds(),
+                        teleopEnvironment);
+        servoDeadlineWait(deadline);
+    }
+}//END of teleopSimulationLoop
+
+
+//This function runs this process as the simulation side of a UDP link
+// ("-teleop-sim"), printing the link statistics once per second.
+int runTeleopSimulation(int port)
+{
+    if (!waveUdpOpen(gTeleopSimulationEnd, NULL, port))
+        return -1;
+    gTeleopMode = TELEOP_SIMULATION;
+    printf("Teleoperation: serving the field on UDP port %d (Ctrl+C to quit)\n", port);
+
+    double nextReport = servoClockSeconds() + 1;
+    ServoDeadline deadline;
+    servoDeadlineStart(deadline, SERVO_PERIOD_S);
+    for (;;)
+    {
+        bool connected = waveSlaveUpdate(gWaveSlave, gTeleopSimulationEnd,
+                                         servoClockSeconds(), teleopEnvironment);
+        servoDeadlineWait(deadline);
+
+        if (servoClockSeconds() >= nextReport)
+        {
+            nextReport += 1;
+            if (connected)
+                printf("proxy at (%.1f, %.1f, %.1f) mm, ", gWaveSlave.position[0],
+                       gWaveSlave.position[1], gWaveSlave.position[2]);
+            printTeleopStatistics("simulation", gTeleopSimulationEnd);
+            fflush(stdout);
+        }
+    }
+}//END of runTeleopSimulation
+
+
+//This procedure is the work of one tick of the jitter report: a servo
+// tick at a simulated stylus position.
+void jitterServoTick(void* data)
+{
+    long& tick = *static_cast<long*>(data);
+    double t = 0.001 * tick++;
+    hduVector3Dd pos(80 * sin(1.3*t), 80 * sin(1.7*t), 80 * cos(1.1*t)), forceVec;
+    ServoTick(pos, forceVec);
+}
+
+
+//This function measures the wake-up jitter of a 1 kHz loop running the
+// servo tick, with default and with real-time scheduling ("-rt-jitter").
+int runJitterReport(double seconds)
+{
+    int cpu = servoRealtimeChooseCpu();
+    bool locked = servoRealtimeLockMemory();
+    printf("ENSC488 - Assignment2 servo jitter, %.0f s per run, %d CPU(s)\n\n",
+           seconds, threadCpuCount());
+    printf("Scheduling        mean (us)  median   99%%    99.9%%   max    missed  tick (us)\n");
+    printf("--------------------------------------------------------------------------\n");
+
+    for (int realtime = 0; realtime < 2; realtime++)
+    {
+        long tick = 0;
+        ServoJitterRun run;
+        memset(&run, 0, sizeof(run));
+        run.realtime = realtime != 0;
+        run.cpu = cpu;
+        run.ticks = (long)(seconds / SERVO_PERIOD_S);
+        run.work = jitterServoTick;
+        run.workData = &tick;
+        ServoJitterStats stats;
+        if (!servoJitterMeasure(run, stats))
+        {
+            fprintf(stderr, "Failed to start the measuring thread\n");
+            return -1;
+        }
+        printf("%-16s %9.1f %8.1f %7.1f %7.1f %7.1f %7ld %9.2f\n",
+               realtime ? "real-time" : "default", stats.mean, stats.median, stats.p99,
+               stats.p999, stats.maximum, stats.missed,
+               (run.ticks > 0) ? 1e6 * run.workTime / run.ticks : 0.0);
+        if (realtime)
+        {
+            if (run.status.cpu < 0)
+                printf("  (not pinned: CPU %d refused)\n", cpu);
+            else
+                printf("  (pinned to CPU %d)\n", run.status.cpu);
+            if (!run.status.priority)
+                printf("  (real-time priority refused: run as root or raise the rtprio limit)\n");
+        }
+    }
+    if (!locked)
+        printf("  (memory not locked)\n");
+    return 0;
+}//END of runJitterReport
+
+
+//This procedure prints the statistics of one end of the link.
+void printTeleopStatistics(const char* name, const WaveChannel& channel)
+{
+    printf("%s end: %ld packets received, %ld lost, %ld waves energy limited\n",
+           name, channel.receiveSequence + 1, channel.packetsLost, channel.wavesLimited);
+}//END of printTeleopStatistics
+
+
+
+
+//=====================================================================
+//    <GRAPHICS>: FUNCTIONS RELATED TO SETTING UP/DRAWING THE SCENE
+//=====================================================================
+
+//This procedure sets up the viewing condition for the scene to be drawn.
+//This procedure uses the haptic device coordinate space as model space 
+// of our scene.  An orthographic projection is defined to fit this space.
+//NOTE: LLB means Low, Left, Back point of device workspace.
+//      TRF means Top, Right, Front point of device workspace. 
+void initGraphicsViewing(const HDdouble LLB[3], const HDdouble TRF[3])
+{
+    glMatrixMode(GL_PROJECTION); /* Setup perspective projection. */
+    glLoadIdentity();
+
+    //Find the (Cartesian) centre point of the device workspace.
+    HDdouble centerScreen[3];
+    centerScreen[0] = (TRF[0] + LLB[0])/2.0;
+    centerScreen[1] = (TRF[1] + LLB[1])/2.0;
+    centerScreen[2] = (TRF[2] + LLB[2])/2.0;
+
+    //According to the haptic device workspace, set the view volumn 
+    // (screen dimension).
+    HDdouble screenDims[3];
+    screenDims[0] = TRF[0] - LLB[0];
+    screenDims[1] = TRF[1] - LLB[1];
+    screenDims[2] = TRF[2] - LLB[2];
+
+    //find the dimension corresponding to the larger "range" 
+    // between the X and Y directions
+    HDdouble maxDimXY = (screenDims[0] > screenDims[1] ? screenDims[0]:screenDims[1]);
+    //find the dimension corresponding to the larger "range" 
+    // among the X, Y, and Z directions
+    HDdouble maxDim = (maxDimXY > screenDims[2] ? maxDimXY:screenDims[2]);
+    maxDim /= 2.0;
+
+    //orthographic projection (1st parameter has largest "range", and so on...)
+    glOrtho(centerScreen[0]-maxDim, centerScreen[0]+maxDim, 
+             centerScreen[1]-maxDim, centerScreen[1]+maxDim,
+             centerScreen[2]-maxDim, centerScreen[2]+maxDim);
+    sceneViewInit(gSceneView, 2 * maxDim, drawAxes);
+
+    glMatrixMode(GL_MODELVIEW); // Setup model transformations. 
+    glLoadIdentity();
+
+    glClearDepth(1.0); // Setup background colour. 
+    glClearColor(0.7, 0.7, 0.7, 0);
+    glDisable(GL_DEPTH_TEST);
+
+}//END of initGraphicsWorkspace
+
+
+//This procedure sets up the lighting (and shading) conditions 
+// for the scene to be drawn.
+void initGraphicsLighting()
+{
+    //smooth (interpolated) shading
+    glShadeModel(GL_SMOOTH);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+    glEnable(GL_NORMALIZE);
+    glEnable(GL_LIGHT_MODEL_TWO_SIDE);
+    
+    GLfloat lightZeroPosition[] = {10.0, 4.0, 100.0, 0.0};
+    GLfloat lightZeroColor[] = {0.6, 0.6, 0.6, 1.0}; //grey light
+    GLfloat lightOnePosition[] = {-1.0, -2.0, -100.0, 0.0};
+    GLfloat lightOneColor[] = {0.6, 0.6, 0.6, 1.0};  //grey light as well
+    
+    GLfloat light_ambient[] = {0.8, 0.8, 0.8, 1.0}; //Ambient lighting (grey)
+    GLfloat light_diffuse[] = {0.0, 0.0, 0.0, 1.0}; //Diffuse lighting (none)    
+    GLfloat light_position[] = {0.0, 0.0, 100.0, 1.0}; //light source far away
+    
+    glLightModeli(GL_LIGHT_MODEL_LOCAL_VIEWER, 1);
+    glLightfv(GL_LIGHT0, GL_POSITION, lightZeroPosition);
+    glLightfv(GL_LIGHT0, GL_DIFFUSE, lightZeroColor);
+    glLightfv(GL_LIGHT1, GL_POSITION, lightOnePosition);
+    glLightfv(GL_LIGHT1, GL_DIFFUSE, lightOneColor);
+    glEnable(GL_LIGHT0);    //enable light0
+    glEnable(GL_LIGHT1);    //enable light1
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+
+}//END of initGraphicsLighting
+
+
+//This is the main display looping function that is run and draws the 
+// screen continuously.
+//Currently this function draws one fixed sphere (with axes), one movable
+// sphere (with axes), and an arrow (representing the force).
+void MyGlutDisplay(void)
+{
+    //let the servo watchdog know the scene is still being updated
+    servoWatchdogFeedGraphics(gServoWatchdog);
+    //(the window may have been resized)
+    sceneViewSetWindow(gSceneView, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+
+	// Get the current position/orientation of end effector and
+    // the current button state.
+    //A process for getting device data is sent to the scheduler
+    // (synchronously).
+    HapticDeviceState state;
+    hdScheduleSynchronous(GettingDeviceStateCallback, &state,
+                          HD_MIN_SCHEDULER_PRIORITY);
+    latencyFrameSnapshot(gLatencyProbe, state.sample_time);
+    gFrameState = state;
+    gFrameCount++;
+    GLUquadricObj* quadObj = gluNewQuadric();
+    glMatrixMode(GL_MODELVIEW); // Setup model transformations.
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    glLoadIdentity();
+    glPushMatrix();
+    //need to enable "colour material" in order to see the
+    // different surfaces of objects having different colours (shades)
+    glEnable(GL_COLOR_MATERIAL);
+	glRotatef(45,0,1,0);
+	glRotatef(CamRotationY, 0, 1, 0);
+	glRotatef(CamRotationX, 1, 0, 0);
+	glScalef(CamZoom, CamZoom, CamZoom);
+
+    drawAxes();
+	if (gShowFieldLines || gCoulombForceEnabled)
+		drawCharges(quadObj);
+	if (gShowFieldLines)
+		drawFieldLines();
+	double effort[3];
+	computeJointEffort(state.joint_angles, state.force, effort);
+	poseOmniScene(gOmniScene, state.joint_angles, state.gimbal_angles);
+	drawProximityWarnings(gOmniScene.graph);
+	drawPhantonOmni(quadObj, state.button, effort);
+	if (gFixture.mode != FIXTURE_OFF)
+		drawFixturePath();
+	if (gShowEquipotentials)
+		drawEquipotentials();
+	glPopMatrix();
+
+    // Always delete a Quadric (since you previouly dynamically allocated one)
+    gluDeleteQuadric(quadObj);
+
+    glDisable(GL_COLOR_MATERIAL);
+
+    // Double buffers are used to speed things up...
+    latencyFrameDrawn(gLatencyProbe);
+    glutSwapBuffers();
+    latencyFrameSwapped(gLatencyProbe);
+}//END of MyGlutDisplay
+
+
+//--------------------------------------------------------
+// *** NOTE: The following are the utility functions that
+//   draw the individual objects in the scene. ***
+//--------------------------------------------------------
+
+//This procedure draws the X,Y,Z axis for the current coordinate frame.
+void drawAxes()
+{
+    //disable lighting and material when drawing axes.
+    glDisable(GL_LIGHTING);
+    glDisable(GL_COLOR_MATERIAL);
+    for(int i = 0; i < 3; i++) 
+    {               
+        glColor3fv(AXIS_COLOUR[ i ]);
+        glBegin(GL_LINES);  //draw a line - define two endpoints between
+                            // the "glBegin" and "glEnd" pair
+        glVertex3fv(AXIS_VERTEX[ i ]);
+        glVertex3fv(AXIS_VERTEX[ 3 ]);
+        glEnd();
+    }
+    glEnable(GL_LIGHTING);
+    glEnable(GL_COLOR_MATERIAL);
+
+}//END of drawAxes
+
+
+
+//This procedure draws a sphere with radius "SPHERE_RADIUS" centred at the origin
+// of the current coordinate frame.
+void drawFixedSphere(GLUquadricObj* quadObj)
+{
+    //Display a sphere to show the static electric charge (greenish blue).
+    glColor4f(0.2, 0.8, 0.8, 0.8);
+
+    //Draw the center sphere.
+    drawLodSphere(quadObj, SPHERE_RADIUS, modelviewPixelsPerUnit(gSceneView));
+
+}//END of drawFixedSphere
+
+
+//This procedure draws the fixed charges (red: attracting, blue: repelling).
+void drawCharges(GLUquadricObj* quadObj)
+{
+    double pixelsPerUnit = modelviewPixelsPerUnit(gSceneView);
+    for (long k = 0; k < gChargeSet.count; k++)
+    {
+        const Charge& charge = gChargeSet.charges[k];
+        glPushMatrix();
+        glTranslated(charge.position[0], charge.position[1], charge.position[2]);
+        if (charge.strength > 0)
+            glColor4f(0.8, 0.3, 0.2, 0.8);
+        else
+            glColor4f(0.2, 0.3, 0.8, 0.8);
+        drawLodSphere(quadObj, SPHERE_RADIUS, pixelsPerUnit);
+        glPopMatrix();
+    }
+}//END of drawCharges
+
+
+//This procedure draws the latest field lines and glyphs built on the
+// task pool, and asks for a new build when the charges or the zoom changed.
+void drawFieldLines()
+{
+    const FieldLineBuffer* buffer = fieldLineCacheUpdate(gFieldLineCache, gChargeSet, CamZoom);
+    if (buffer == NULL)
+        return;     //the first build isn't ready yet
+
+    glDisable(GL_LIGHTING);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    for (int t = 0; t < FIELD_TASKS; t++)
+    {
+        glVertexPointer(3, GL_FLOAT, 0, buffer->lineVertices[t]);
+        glColorPointer(3, GL_FLOAT, 0, buffer->lineColours[t]);
+        glDrawArrays(GL_LINES, 0, buffer->lineCount[t]);
+        glVertexPointer(3, GL_FLOAT, 0, buffer->glyphVertices[t]);
+        glColorPointer(3, GL_FLOAT, 0, buffer->glyphColours[t]);
+        glDrawArrays(GL_LINES, 0, buffer->glyphCount[t]);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glEnable(GL_LIGHTING);
+}//END of drawFieldLines
+
+
+//This procedure draws the path of the guidance fixture.
+void drawFixturePath()
+{
+    glDisable(GL_LIGHTING);
+    glColor3f(0.9, 0.8, 0.2);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_DOUBLE, 0, gFixture.points);
+    glDrawArrays(GL_LINE_STRIP, 0, gFixture.count);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glEnable(GL_LIGHTING);
+}//END of drawFixturePath
+
+
+//This procedure draws the equipotential surfaces (translucent, so last),
+// and asks for the blocks changed since the last frame to be rebuilt.
+void drawEquipotentials()
+{
+    if (!equiSurfacesUpdate(gEquiSurfaces, gChargeSet, CamZoom, gIsovalue))
+        return;     //the first build isn't ready yet
+
+    //both sides lit, and the surfaces don't hide each other
+    glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, 1);
+    glDepthMask(GL_FALSE);
+    for (int b = 0; b < EQUI_NUM_BLOCKS; b++)
+    {
+        const EquiBlock& block = gEquiSurfaces.blocks[b];
+        const EquiMesh& mesh = block.meshes[block.front];
+        if (mesh.count == 0)
+            continue;
+        glInterleavedArrays(GL_C4F_N3F_V3F, 0, mesh.vertices);
+        glDrawArrays(GL_TRIANGLES, 0, mesh.count);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDepthMask(GL_TRUE);
+    glLightModeli(GL_LIGHT_MODEL_TWO_SIDE, 0);
+}//END of drawEquipotentials
+
+
+//This procedure turns the added charges around the centre one, at a rate
+// independent of the frame rate.
+void moveCharges()
+{
+    static double lastTime = 0;
+    double now = servoClockSeconds();
+    double dt = (lastTime > 0) ? now - lastTime : 0;
+    lastTime = now;
+    if (!gMoveCharges || gChargeSet.count <= 1)
+        return;
+    if (dt > 0.1)
+        dt = 0.1;   //don't jump after a stall
+
+    //about the vertical axis, at 0.5 rad/s (the servo callback may see a
+    // charge half moved for one tick, which it can't feel)
+    double c = cos(0.5 * dt), s = sin(0.5 * dt);
+    for (long k = 1; k < gChargeSet.count; k++)
+    {
+        double* p = gChargeSet.charges[k].position;
+        double x = c*p[0] + s*p[2];
+        double z = -s*p[0] + c*p[2];
+        p[0] = x;
+        p[2] = z;
+    }
+    gChargeSet.version++;
+}//END of moveCharges
+
+
+//This procedure adds the device state of a frame to the trial statistics.
+void recordExperimentSample(ExperimentState& e, const HapticDeviceState& state)
+{
+    const double* p = state.position;
+    const double* f = state.force;
+    double force = sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+    e.distanceSum += sqrt((p[0]-e.charge[0])*(p[0]-e.charge[0]) + (p[1]-e.charge[1])*(p[1]-e.charge[1]) +
+                          (p[2]-e.charge[2])*(p[2]-e.charge[2]));
+    e.forceSum += force;
+    if (force > e.forceMax)
+        e.forceMax = force;
+    e.samples++;
+}
+
+
+//This procedure is the experiment protocol (a script, see ExperimentScript.h):
+// for every trial, wait for a stylus button, move a charge to a random
+// place, record the stylus for EXPERIMENT_RECORD_S seconds and print a
+// summary.  Its state is kept in "data" (an ExperimentState), as local
+// variables don't last across the waits.
+void experimentProtocol(Script& s, void* data)
+{
+    ExperimentState& e = *static_cast<ExperimentState*>(data);
+    SCRIPT_BEGIN(s);
+    printf("Experiment: %d trial(s) of %.0f s\n", EXPERIMENT_TRIALS, EXPERIMENT_RECORD_S);
+    gCoulombForceEnabled = true;
+
+    for (e.trial = 1; e.trial <= EXPERIMENT_TRIALS; e.trial++)
+    {
+        printf("Trial %d: press a stylus button to start\n", e.trial);
+        SCRIPT_WAIT_BUTTON(s, HD_DEVICE_BUTTON_1 | HD_DEVICE_BUTTON_2, EXPERIMENT_TIMEOUT_S);
+        if (s.timedOut)
+        {
+            printf("Trial %d: no button pressed, skipped\n", e.trial);
+            continue;
+        }
+
+        //the centre charge and one more, somewhere else every trial
+        servoStoreRelease(&gChargeSet.count, 1);
+        gChargeSet.version++;
+        for (int i = 0; i < 3; i++)
+            e.charge[i] = rand() % 161 - 80;
+        chargeSetAdd(gChargeSet, e.charge, (e.trial % 2) ? 1.0 : -1.0);
+
+        printf("Trial %d: recording\n", e.trial);
+        e.recordStart = s.in.now;
+        e.recordTicks = s.in.servoTicks;
+        e.samples = 0;
+        e.distanceSum = e.forceSum = e.forceMax = 0;
+        while (s.in.now - e.recordStart < EXPERIMENT_RECORD_S)
+        {
+            recordExperimentSample(e, gFrameState);
+            SCRIPT_NEXT_FRAME(s);
+        }
+        printf("Trial %d: %ld frames, %ld servo ticks, mean distance to the charge %.1f mm,"
+               " force %.2f N (max %.2f N)\n", e.trial, e.samples, s.in.servoTicks - e.recordTicks,
+               e.distanceSum / e.samples, e.forceSum / e.samples, e.forceMax);
+        SCRIPT_WAIT_SECONDS(s, 2);
+    }
+    printf("Experiment done\n");
+    SCRIPT_END(s);
+}//END of experimentProtocol
+
+
+//This procedure resumes the experiment protocol, if it is running.
+void resumeExperiment()
+{
+    ScriptInputs in;
+    in.now = servoClockSeconds();
+    in.frame = gFrameCount;
+    in.servoTicks = gServoScheduler.ticks;
+    in.buttons = gFrameState.button;
+    scriptResume(gExperiment, in);
+}
+
+
+//This procedure draws the "movable sphere" that corresponds to the cursor
+// of the haptic device.
+void drawMovableSphere(GLUquadricObj* quadObj,
+                       const double transform[16],
+                       HDint button_state)
+
+{
+   //Display one sphere to represent the haptic cursor and the dynamic 
+   //    charge.
+    glPushMatrix();
+
+    glLoadIdentity();
+    glMultMatrixd(transform);   //transform the movable sphere
+                                // such that its location and orientation
+                                // correponds to those of the stylus of the device.
+
+    drawAxes();
+    if (button_state == 0)  //no button is pressed
+        glColor4f(0.8, 0.2, 0.2, 0.8);      //red colour
+    else if (button_state == 1) //the first (blue) button is pressed
+        glColor4f(0.2, 0.8, 0.2, 0.8);     //green colour
+    else if (button_state == 2) //the second (white) button is pressed
+        glColor4f(0.2, 0.2, 0.8, 0.8);      //blue colour
+
+    drawLodSphere(quadObj, SPHERE_RADIUS, modelviewPixelsPerUnit(gSceneView));
+
+    glPopMatrix();
+
+}//END of drawMovableSphere
+
+
+//This procedure draws the visual representation (an arrow) that represents
+// the magnitude and direction of the Coulomb Force.
+void drawForceVisualRepresentation(GLUquadricObj* quadObj,
+                                   const double position[3],                       
+                                   const double strength)
+{
+    //Display the force vector, change the force magnitude/direction
+    // rotote the force vector first. 
+    double rotVals[4][4];
+    computeForceArrowRotation(position, rotVals);
+    glMultMatrixd((double*)rotVals);
+    double pixelsPerUnit = modelviewPixelsPerUnit(gSceneView);
+
+    //The force arrow: composed of a cylinder and a cone.
+    glDisable(GL_LIGHTING);
+    glColor3f(0.2, 0.7, 0.2);
+    //Draw the cylinder part 
+    // parameters are: object_name, base_radius, top_radius, height, slices, stacks)
+    drawLodCylinder(quadObj, SPHERE_RADIUS*0.1, SPHERE_RADIUS*0.1, strength, pixelsPerUnit);
+    glTranslatef(0, 0, strength);
+    glColor3f(0.2, 0.8, 0.3);
+    //Draw the cone part.
+    drawLodCylinder(quadObj, SPHERE_RADIUS*0.2, 0.0, strength*0.15, pixelsPerUnit);
+    glEnable(GL_LIGHTING);
+}//END of drawForceVisualRepresentation
+
+
+//This procedure computes the rotation matrix (in OpenGL column-major order)
+// that turns the Z axis into the direction of the force arrow.
+void computeForceArrowRotation(const double position[3], double rotVals[4][4])
+{
+    hduVector3Dd ForceVectorAxis(position); 
+    ForceVectorAxis *= -1;  //points to the opposite direction of "position"
+
+    //normalize the force vector such that its length is 1.
+    hduVector3Dd UnitForceVectorAxis;
+    UnitForceVectorAxis = normalize(ForceVectorAxis);
+
+    //For calculation of rotation angle.
+    hduVector3Dd ZAxis;  //Z axis is chosen because when drawing a cylinder,
+                         // it is drawn along the Z-axis by default.
+    ZAxis.set(0.0, 0.0, 1.0);
+
+    hduVector3Dd ToolRotAxis; 
+    //the tool rotation axis points to direction perpendicular to 
+    // both Z axis and force vector axis
+    ToolRotAxis = crossProduct(ZAxis, ForceVectorAxis);
+        
+    //the angle around the "ToolRotAxis" that will rotate Z axis into 
+    // ForceVectorAxis 
+    double ToolRotAngle = acos(UnitForceVectorAxis[2]);
+    hduMatrix rotMatrix;    
+    //the overall rotation matrix for this force vector is...
+    //NOTE: defined using "equivalent angle axis" theorem.
+    // you don't need to worry about implementation details
+    // just find the axis and angle and use the following function (createRotation)
+    rotMatrix = hduMatrix::createRotation(ToolRotAxis, ToolRotAngle);
+
+    rotMatrix.get(rotVals); //get the elements of matrix "rotMatrix" and save them
+                            // into a 4 by 4 array (something OpenGL understands)
+}//END of computeForceArrowRotation
+ 
+//This procedure draws the (posed) Omni model, its body and links tinted
+// by the effort of the motors that turn them (see "computeJointEffort").
+void drawPhantonOmni(GLUquadricObj* quadObj, int button, const double effort[3])
+{
+    SceneGraph& graph = gOmniScene.graph;
+    setEffortColour(graph, OMNI_FRAME_BODY, 0.8, 0.2, 0.2, 0.8, effort[0]);
+    setEffortColour(graph, OMNI_FRAME_LINK1, 0.8, 0.8, 0.8, 0.8, effort[1]);
+    setEffortColour(graph, OMNI_NODE_LINK1_COVER, 0.8, 0.8, 0.8, 0.8, effort[1]);
+    setEffortColour(graph, OMNI_FRAME_LINK2, 0.8, 0.2, 0.8, 0.2, effort[2]);
+    setEffortColour(graph, OMNI_NODE_LINK2_COVER, 0.8, 0.2, 0.8, 0.2, effort[2]);
+
+    //the buttons light up when pressed
+    if (button == 2)
+        sceneSetColour(graph, OMNI_FRAME_BUTTON1, 0.2, 0.8, 0.8, 0.8);
+    else
+        sceneSetColour(graph, OMNI_FRAME_BUTTON1, 0.3, 0.3, 1, 1);
+    if (button == 1)
+        sceneSetColour(graph, OMNI_FRAME_BUTTON2, 0.2, 0.8, 0.8, 0.8);
+    else
+        sceneSetColour(graph, OMNI_FRAME_BUTTON2, 1, 1, 1, 1);
+
+    drawScene(quadObj, graph, gSceneView);
+}//END of drawPhantonOmni
+
+
+//This procedure sets the colour of a part of the arm: its own colour
+// turning yellow as "effort" goes from 0 to 1.
+void setEffortColour(SceneGraph& graph, int node, float red, float green, float blue, float alpha,
+                     double effort)
+{
+    float t = (effort < 1) ? (float)effort : 1;
+    sceneSetColour(graph, node, red + t * (1 - red), green + t * (1 - green), blue * (1 - t),
+                   alpha + t * (1 - alpha));
+}//END of setEffortColour
+
+
+//This procedure draws a line between the closest points of every two
+// shapes of the arm (or of the arm and a charge) nearer than
+// PROXIMITY_MARGIN, from yellow to red as they close in.
+void drawProximityWarnings(const SceneGraph& omni)
+{
+    CapsuleSet set;
+    buildOmniCapsules(omni, set);
+    double clearance[CAPSULE_MAX_SHAPES];
+    CapsuleContact contacts[PROXIMITY_MAX_CONTACTS];
+    int found = capsuleProximity(set, PROXIMITY_MARGIN, clearance, contacts, PROXIMITY_MAX_CONTACTS);
+    if (found == 0)
+        return;
+
+    glDisable(GL_LIGHTING);
+    glLineWidth(3);
+    glBegin(GL_LINES);
+    for (int n = 0; n < found; n++)
+    {
+        double closeness = 1 - contacts[n].clearance / PROXIMITY_MARGIN;
+        if (closeness > 1)
+            closeness = 1;
+        glColor4f(1, 1 - closeness, 0, 1);
+        glVertex3dv(contacts[n].pointFirst);
+        glVertex3dv(contacts[n].pointSecond);
+    }
+    glEnd();
+    glLineWidth(1);
+    glEnable(GL_LIGHTING);
+}//END of drawProximityWarnings
+
+
+//This procedure builds the scene graph of the Omni model: its frames,
+// their shapes and their colours, all joints at 0.
+void buildOmniScene(OmniScene& omni)
+{
+    SceneGraph& graph = omni.graph;
+    sceneInit(graph, omni.nodes, omni.drawList, OMNI_NUM_NODES);
+
+    //the frames, each under the one before (in OmniFrame order)
+    for (int k = 0; k < OMNI_NUM_FRAMES; k++)
+        sceneAddNode(graph, k - 1);
+    sceneAddNode(graph, OMNI_FRAME_BASE);
+    sceneAddNode(graph, OMNI_FRAME_LINK1);
+    sceneAddNode(graph, OMNI_FRAME_LINK2);
+    sceneAddNode(graph, OMNI_FRAME_GIMBAL2);
+    sceneAddNode(graph, OMNI_FRAME_GIMBAL3);
+
+    //the base, rotated so that Z points up
+    double m[16];
+    matIdentity(m);
+    matRotate(m, -90, 1, 0, 0);
+    sceneSetLocal(graph, OMNI_FRAME_BASE, m);
+    sceneSetShape(graph, OMNI_FRAME_BASE, SCENE_SHAPE_CYLINDER, 70, 30, 50);
+    sceneSetColour(graph, OMNI_FRAME_BASE, 0.2, 0.8, 0.8, 0.8);
+    sceneSetShape(graph, OMNI_NODE_BASE_DISK, SCENE_SHAPE_DISK, 0, 70, 0);
+    sceneSetColour(graph, OMNI_NODE_BASE_DISK, 0.2, 0.8, 0.8, 0.8);
+
+    //the sphere body and the links (coloured by "drawPhantonOmni")
+    sceneSetShape(graph, OMNI_FRAME_BODY, SCENE_SHAPE_SPHERE, 45, 0, 0);
+    sceneSetShape(graph, OMNI_FRAME_LINK1, SCENE_SHAPE_CYLINDER, 7, 7, 110);
+    sceneSetTranslation(graph, OMNI_NODE_LINK1_COVER, 0, 0, 110);
+    sceneSetShape(graph, OMNI_NODE_LINK1_COVER, SCENE_SHAPE_DISK, 0, 7, 0);
+    sceneSetShape(graph, OMNI_FRAME_LINK2, SCENE_SHAPE_CYLINDER, 7, 7, 60);
+    sceneSetShape(graph, OMNI_NODE_LINK2_COVER, SCENE_SHAPE_DISK, 0, 7, 0);
+
+    //the gimbals
+    sceneSetShape(graph, OMNI_FRAME_GIMBAL1, SCENE_SHAPE_CYLINDER, 7, 7, 30);
+    sceneSetColour(graph, OMNI_FRAME_GIMBAL1, 0.8, 0.2, 0.2, 0.8);
+    sceneSetShape(graph, OMNI_FRAME_GIMBAL2, SCENE_SHAPE_CYLINDER, 7, 7, 20);
+    sceneSetColour(graph, OMNI_FRAME_GIMBAL2, 0.2, 0.2, 0.2, 0.8);
+    sceneSetTranslation(graph, OMNI_NODE_GIMBAL2_COVER, 0, 0, 20);
+    sceneSetShape(graph, OMNI_NODE_GIMBAL2_COVER, SCENE_SHAPE_DISK, 0, 7, 0);
+    sceneSetColour(graph, OMNI_NODE_GIMBAL2_COVER, 0.2, 0.2, 0.2, 0.8);
+    sceneSetShape(graph, OMNI_FRAME_GIMBAL3, SCENE_SHAPE_CYLINDER, 7, 7, 80);
+    sceneSetColour(graph, OMNI_FRAME_GIMBAL3, 0.8, 0.8, 0.8, 0.8);
+    sceneSetShape(graph, OMNI_NODE_GIMBAL3_COVER, SCENE_SHAPE_DISK, 0, 7, 0);
+    sceneSetColour(graph, OMNI_NODE_GIMBAL3_COVER, 0.8, 0.8, 1, 1);
+
+    //the buttons on the stylus (coloured by "drawPhantonOmni")
+    sceneSetTranslation(graph, OMNI_FRAME_BUTTON1, 0, -7, 50);
+    sceneSetShape(graph, OMNI_FRAME_BUTTON1, SCENE_SHAPE_CUBE, 4, 0, 0);
+    sceneSetTranslation(graph, OMNI_FRAME_BUTTON2, 0, 0, 5);
+    sceneSetShape(graph, OMNI_FRAME_BUTTON2, SCENE_SHAPE_CUBE, 4, 0, 0);
+
+    //(every joint turns from an angle no device gives)
+    for (int i = 0; i < 3; i++)
+        omni.joint[i] = omni.gimbal[i] = HUGE_VAL;
+    double zero[3] = { 0, 0, 0 };
+    poseOmniScene(omni, zero, zero);
+}//END of buildOmniScene
+
+
+//This procedure turns the joints of the Omni model to the given angles
+// (radians, as read from the device) and updates its world matrices,
+// relative to the frame the model is drawn in.
+//A joint that hasn't turned leaves its node clean, so only the links
+// past the joints that did are recomputed.
+void poseOmniScene(OmniScene& omni, const double joint_angles[3], const double gimbal_angles[3])
+{
+    SceneGraph& graph = omni.graph;
+    bool jointTurned[3], gimbalTurned[3];
+    for (int i = 0; i < 3; i++)
+    {
+        jointTurned[i] = joint_angles[i] != omni.joint[i];
+        gimbalTurned[i] = gimbal_angles[i] != omni.gimbal[i];
+        omni.joint[i] = joint_angles[i];
+        omni.gimbal[i] = gimbal_angles[i];
+    }
+    double joint[3], gimbal[3];     //angles in degrees
+    for (int i = 0; i < 3; i++)
+    {
+        joint[i] = joint_angles[i] * 180 / PI;
+        gimbal[i] = gimbal_angles[i] * 180 / PI;
+    }
+    double m[16];
+
+    //sphere body
+    if (jointTurned[0])
+    {
+        matIdentity(m);
+        matTranslate(m, 0, 0, 80);
+        matRotate(m, -joint[0], 0, 0, 1);
+        sceneSetLocal(graph, OMNI_FRAME_BODY, m);
+    }
+
+    //Link1
+    if (jointTurned[1])
+    {
+        matIdentity(m);
+        matRotate(m, 100, 1, 0, 0);
+        matRotate(m, -joint[1], 1, 0, 0);
+        sceneSetLocal(graph, OMNI_FRAME_LINK1, m);
+    }
+
+    //Link2 (relative to link1)
+    if (jointTurned[1] || jointTurned[2])
+    {
+        matIdentity(m);
+        matTranslate(m, 0, 0, 110);
+        matRotate(m, 100, 1, 0, 0);
+        matRotate(m, -(joint[2]-joint[1]), 1, 0, 0);
+        sceneSetLocal(graph, OMNI_FRAME_LINK2, m);
+    }
+
+    //Jimbal1
+    if (gimbalTurned[0])
+    {
+        matIdentity(m);
+        matTranslate(m, 0, 0, 60);
+        matRotate(m, -gimbal[0], 0, 0, 1);
+        sceneSetLocal(graph, OMNI_FRAME_GIMBAL1, m);
+    }
+
+    //Jimbal2
+    if (gimbalTurned[1])
+    {
+        matIdentity(m);
+        matTranslate(m, 0, 0, 30);
+        matRotate(m, 90, 1, 0, 0);
+        matRotate(m, -gimbal[1], 1, 0, 0);
+        sceneSetLocal(graph, OMNI_FRAME_GIMBAL2, m);
+    }
+
+    //Jimbal3
+    if (gimbalTurned[2])
+    {
+        matIdentity(m);
+        matTranslate(m, 0, 0, -80);
+        matRotate(m, gimbal[2], 0, 0, 1);
+        sceneSetLocal(graph, OMNI_FRAME_GIMBAL3, m);
+    }
+
+    sceneUpdate(graph);
+}//END of poseOmniScene
+
+
+
+//=====================================================================
+//    <BENCHMARK>: MICRO-BENCHMARKS OF THE HOT PATHS ("-bench" mode)
+//=====================================================================
+
+#define BENCH_NUM_SAMPLES 64    //number of sample stylus poses to cycle through
+
+double gBenchPositions[BENCH_NUM_SAMPLES][3];       //stylus tip positions
+double gBenchJointAngles[BENCH_NUM_SAMPLES][3];     //joint angles (radians)
+double gBenchGimbalAngles[BENCH_NUM_SAMPLES][3];    //gimbal angles (radians)
+
+//one streamline of the field line cache (a charge pair)
+void benchFieldLineTrace(long iterations)
+{
+    ChargeSet charges = { 2, 0, SPHERE_RADIUS, { { {0, 0, 0}, 1 }, { {60, 20, 0}, -1 } } };
+    float* vertices = (float*)malloc(sizeof(float) * 3 * FIELD_LINE_STEPS * 2);
+    float* colours = (float*)malloc(sizeof(float) * 3 * FIELD_LINE_STEPS * 2);
+    for (long n = 0; n < iterations; n++)
+    {
+        long count = 0;
+        fieldTraceLine(charges, 1.0, (int)(n % (2 * FIELD_SEEDS_PER_CHARGE)), vertices, colours, count);
+        benchDoNotOptimize(vertices[0] + count);
+    }
+    free(vertices);
+    free(colours);
+}
+
+//one block of the equipotentials, sampled and extracted (six charges)
+void benchEquiBlockBuild(long iterations)
+{
+    ChargeSet charges;
+    memset(&charges, 0, sizeof(charges));
+    charges.radius = SPHERE_RADIUS;
+    for (int k = 0; k < 6; k++)
+    {
+        double position[3] = { 40.0 * cos(k * 1.0472), 20.0 * (k % 2), 40.0 * sin(k * 1.0472) };
+        chargeSetAdd(charges, position, (k % 2) ? -1.0 : 1.0);
+    }
+    equiTablesInit();
+    EquiBlock* block = (EquiBlock*)calloc(1, sizeof(EquiBlock));
+    int index = (EQUI_NUM_BLOCKS + EQUI_BLOCKS * EQUI_BLOCKS + EQUI_BLOCKS) / 2;  //near the centre
+    for (long n = 0; n < iterations; n++)
+    {
+        block->resample = true;
+        equiBuildBlock(charges, 1.0, 3.0, index, *block);
+        benchDoNotOptimize(block->meshes[1].count);
+    }
+    free(block->meshes[1].vertices);
+    free(block);
+}
+
+//a full set of charges on a ring, around the stylus positions near the
+// centre used by the clipmap benchmarks
+void benchChargeRing(ChargeSet& charges)
+{
+    charges.count = 0;
+    charges.version = 0;
+    charges.radius = SPHERE_RADIUS;
+    for (int k = 0; k < CHARGE_MAX; k++)
+    {
+        double angle = k * 2 * 3.14159265358979 / CHARGE_MAX;
+        double position[3] = { 70 * cos(angle), 10.0 * (k % 3 - 1), 70 * sin(angle) };
+        chargeSetAdd(charges, position, (k % 2) ? -1.0 : 1.0);
+    }
+}
+
+//Coulomb force of a full set of charges, evaluated directly
+void benchChargeFieldForceFull(long iterations)
+{
+    ChargeSet charges;
+    benchChargeRing(charges);
+    double force[3];
+    for (long n = 0; n < iterations; n++)
+    {
+        const double* p = gBenchPositions[n % BENCH_NUM_SAMPLES];
+        double position[3] = { p[0] * 0.04, p[1] * 0.04, p[2] * 0.04 };
+        chargeFieldForce(charges, 1.0, position, force);
+        benchDoNotOptimize(force[0]);
+    }
+}
+
+//the same force, sampled from the clipmap (filled beforehand)
+void benchClipmapForce(long iterations)
+{
+    static ChargeSet charges;
+    static ForceClipmap clipmap;
+    benchChargeRing(charges);
+    clipmapReset(clipmap, charges);
+    clipmapRefresh(clipmap);
+    double force[3];
+    for (long n = 0; n < iterations; n++)
+    {
+        const double* p = gBenchPositions[n % BENCH_NUM_SAMPLES];
+        double position[3] = { p[0] * 0.04, p[1] * 0.04, p[2] * 0.04 };
+        if (!clipmapForce(clipmap, charges, 1.0, position, force))
+            chargeFieldForce(charges, 1.0, position, force);
+        benchDoNotOptimize(force[0]);
+    }
+}
+
+//a task that does nothing, to time the pool itself
+void benchEmptyTask(void* data)
+{
+    (void)data;     //(called through a pointer: not optimized away)
+}
+
+//four empty tasks and a continuation submitted to the task pool, polled
+// until ready as the graphics loop does (the overhead of a build)
+TaskPool gBenchTaskPool;
+void benchTaskRoundTrip(long iterations)
+{
+    if (gBenchTaskPool.workerCount == 0)
+        taskPoolStart(gBenchTaskPool, 0, 0);
+    TaskFuture future;
+    for (long n = 0; n < iterations; n++)
+    {
+        taskFutureReset(future);
+        for (int t = 0; t < 4; t++)
+            taskSubmit(gBenchTaskPool, benchEmptyTask, &future, TASK_PRIORITY_NORMAL, &future);
+        taskFutureThen(gBenchTaskPool, future, benchEmptyTask, &future, TASK_PRIORITY_HIGH);
+        while (!taskFutureReady(future))
+            threadYield();
+    }
+}
+
+//Coulomb force with the stylus outside the fixed charge
+void benchCalculateForceField(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        hduVector3Dd pos(gBenchPositions[n % BENCH_NUM_SAMPLES]);
+        hduVector3Dd forceVec = CalculateForce(pos);
+        benchDoNotOptimize(forceVec[0]);
+    }
+}
+
+//Coulomb force with the two charges overlapping
+void benchCalculateForceOverlap(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        hduVector3Dd pos(gBenchPositions[n % BENCH_NUM_SAMPLES]);
+        pos *= 0.05;    //pulls every sample inside the fixed charge
+        hduVector3Dd forceVec = CalculateForce(pos);
+        benchDoNotOptimize(forceVec[0]);
+    }
+}
+
+//the force of the centre charge as CalculateForce first computed it, with
+// hduVector3Dd temporaries (the reference for the SmallVector.h versions)
+hduVector3Dd calculateForceHduVector(hduVector3Dd pos, double zoom)
+{
+    double sqr_dist = pos[0]*pos[0]+pos[1]*pos[1]+pos[2]*pos[2];
+    hduVector3Dd forceVec;
+    if (sqr_dist < pow(SPHERE_RADIUS+zoom*SPHERE_RADIUS,2))
+    {
+        if (zoom >= 1)
+            forceVec = -0.1*pos/(zoom);
+        else
+            forceVec = -0.1*pos;
+    }
+    else
+    {
+        double scaleFactor;
+        if (zoom >= 1)
+            scaleFactor = -400.0/(zoom);
+        else
+            scaleFactor = -400.0;
+        hduVector3Dd UnitPos;
+        UnitPos = normalize(pos);
+        forceVec = scaleFactor*UnitPos/sqr_dist;
+    }
+    return forceVec;
+}
+
+//the same force with SmallVector.h expressions (double or float)
+template <class T>
+Vec3<T> calculateForceSmallVector(const Vec3<T>& pos, double zoom)
+{
+    T sqrDist = vecSqrNorm(pos);
+    double contact = SPHERE_RADIUS + zoom*SPHERE_RADIUS;
+    double scale = (zoom >= 1) ? 1.0/zoom : 1.0;
+    if (sqrDist < contact*contact)
+        return -0.1*scale*pos;
+    return (-400.0*scale/sqrDist) * vecNormalize(pos);
+}
+
+void benchForceHduVector(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        hduVector3Dd pos(gBenchPositions[n % BENCH_NUM_SAMPLES]);
+        hduVector3Dd forceVec = calculateForceHduVector(pos, CamZoom);
+        benchDoNotOptimize(forceVec[0]);
+    }
+}
+
+void benchForceVec3d(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        Vec3d pos(gBenchPositions[n % BENCH_NUM_SAMPLES]);
+        Vec3d forceVec = calculateForceSmallVector(pos, CamZoom);
+        benchDoNotOptimize(forceVec[0]);
+    }
+}
+
+void benchForceVec3f(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        const double* p = gBenchPositions[n % BENCH_NUM_SAMPLES];
+        Vec3f pos((float)p[0], (float)p[1], (float)p[2]);
+        Vec3f forceVec = calculateForceSmallVector(pos, CamZoom);
+        benchDoNotOptimize(forceVec[0]);
+    }
+}
+
+//rotation matrix set-up of "drawForceVisualRepresentation"
+void benchForceArrowRotation(long iterations)
+{
+    double rotVals[4][4];
+    for (long n = 0; n < iterations; n++)
+    {
+        computeForceArrowRotation(gBenchPositions[n % BENCH_NUM_SAMPLES], rotVals);
+        benchDoNotOptimize(rotVals[2][2]);
+    }
+}
+
+//posing the scene graph of the Omni model, every joint turning (the
+// local matrices and all the world matrices)
+OmniScene gBenchOmniScene;
+void benchOmniScenePose(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        int k = n % BENCH_NUM_SAMPLES;
+        poseOmniScene(gBenchOmniScene, gBenchJointAngles[k], gBenchGimbalAngles[k]);
+        benchDoNotOptimize(sceneWorld(gBenchOmniScene.graph, OMNI_FRAME_BUTTON2)[12]);
+    }
+}
+
+//the same with only the last gimbal turning (the stylus rolling)
+void benchOmniSceneRoll(long iterations)
+{
+    double joint[3] = { 0.1, 0.2, 0.3 };
+    double gimbal[3] = { 0.4, 0.5, 0 };
+    for (long n = 0; n < iterations; n++)
+    {
+        gimbal[2] = gBenchGimbalAngles[n % BENCH_NUM_SAMPLES][2];
+        poseOmniScene(gBenchOmniScene, joint, gimbal);
+        benchDoNotOptimize(sceneWorld(gBenchOmniScene.graph, OMNI_FRAME_BUTTON2)[12]);
+    }
+}
+
+
+//gravity compensation of one servo tick (Jacobian, torques, damped solve)
+void benchGravityCompensation(long iterations)
+{
+    double force[3];
+    for (long n = 0; n < iterations; n++)
+    {
+        omniGravityCompensation(gOmniMass, gBenchJointAngles[n % BENCH_NUM_SAMPLES], force);
+        benchDoNotOptimize(force[1]);
+    }
+}
+
+//position, torques and manipulability of 1024 poses (offline analysis),
+// four at a time with SSE or one by one
+#define BENCH_BATCH_POSES 1024
+float gBenchBatchIn[6][BENCH_BATCH_POSES];      //joint angles, then forces
+float gBenchBatchOut[7][BENCH_BATCH_POSES];     //position, torques, manipulability
+OmniBatch gBenchBatch;
+void benchOmniBatchSetup()
+{
+    for (long n = 0; n < BENCH_BATCH_POSES; n++)
+        for (int i = 0; i < 6; i++)
+            gBenchBatchIn[i][n] = (rand() % 1000) / 1000.0f - 0.5f;
+    gBenchBatch.count = BENCH_BATCH_POSES;
+    for (int i = 0; i < 3; i++)
+    {
+        gBenchBatch.joint[i] = gBenchBatchIn[i];
+        gBenchBatch.force[i] = gBenchBatchIn[3 + i];
+        gBenchBatch.position[i] = gBenchBatchOut[i];
+        gBenchBatch.torque[i] = gBenchBatchOut[3 + i];
+    }
+    gBenchBatch.manipulability = gBenchBatchOut[6];
+}
+void benchOmniBatch(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        omniAnalyzeBatch(gOmniMass, gBenchBatch);
+        benchDoNotOptimize(gBenchBatchOut[3][n % BENCH_BATCH_POSES]);
+    }
+}
+void benchOmniBatchScalar(long iterations)
+{
+    for (long n = 0; n < iterations; n++)
+    {
+        omniAnalyzeScalar(gOmniMass, gBenchBatch, 0, gBenchBatch.count);
+        benchDoNotOptimize(gBenchBatchOut[3][n % BENCH_BATCH_POSES]);
+    }
+}
+
+
+//proximity of the links of the Omni model (transform chain, capsules
+// and every pair), with four charges added
+void benchOmniProximity(long iterations)
+{
+    CapsuleSet set;
+    double clearance[CAPSULE_MAX_SHAPES];
+    CapsuleContact contacts[PROXIMITY_MAX_CONTACTS];
+    for (long n = 0; n < iterations; n++)
+    {
+        int k = n % BENCH_NUM_SAMPLES;
+        poseOmniScene(gBenchOmniScene, gBenchJointAngles[k], gBenchGimbalAngles[k]);
+        buildOmniCapsules(gBenchOmniScene.graph, set);
+        int found = capsuleProximity(set, PROXIMITY_MARGIN, clearance, contacts, PROXIMITY_MAX_CONTACTS);
+        benchDoNotOptimize(found);
+    }
+}
+
+
+//passivity observer/controller of one servo tick
+void benchPassivityFilter(long iterations)
+{
+    PassivityController pc = { true, false, {0, 0, 0}, {0, 0, 0}, 0, 0, 0, 0 };
+    for (long n = 0; n < iterations; n++)
+    {
+        double forceVec[3] = { 1, -1, 0.5 };
+        passivityFilter(pc, n * 0.001, gBenchPositions[n % BENCH_NUM_SAMPLES], forceVec);
+        benchDoNotOptimize(forceVec[0]);
+    }
+}
+
+//the tasks of a servo tick run by the scheduler (the force task without
+// the device), to time the scheduler itself against "A2/ServoTick"
+void benchForceTask(void* data, double, double)
+{
+    ServoFrame& frame = *static_cast<ServoFrame*>(data);
+    ServoTick(frame.pos, frame.forceVec);
+}
+void benchEmptyServoTask(void*, double, double)
+{
+}
+void benchServoScheduler(long iterations)
+{
+    static ServoScheduler scheduler;
+    static ServoFrame frame;
+    servoSchedulerInit(scheduler, SERVO_SCHED_TICK_BUDGET);
+    servoSchedulerAdd(scheduler, "force", benchForceTask, &frame, 0, SERVO_TASK_ALWAYS, 200);
+    servoSchedulerAdd(scheduler, "publish", benchEmptyServoTask, NULL, 1, SERVO_TASK_SKIP, 20);
+    servoSchedulerAdd(scheduler, "events", benchEmptyServoTask, NULL, 2, SERVO_TASK_DEFER, 10);
+    for (long n = 0; n < iterations; n++)
+    {
+        const double* p = gBenchPositions[n % BENCH_NUM_SAMPLES];
+        frame.pos.set(p[0], p[1], p[2]);
+        servoSchedulerRun(scheduler, servoClockSeconds());
+        benchDoNotOptimize(frame.forceVec[0]);
+    }
+}
+
+//closest point of the fixture path to a stylus moving along near it (as
+// at servo rate), with the tree and by testing every segment
+void benchFixturePosition(long n, double position[3])
+{
+    double t = n * 0.0005;
+    position[0] = FIXTURE_KNOT_SCALE * (sin(t) + 2 * sin(2*t)) + 6 * sin(37*t);
+    position[1] = FIXTURE_KNOT_SCALE * (cos(t) - 2 * cos(2*t)) + 6 * cos(29*t);
+    position[2] = FIXTURE_KNOT_SCALE * -sin(3*t) + 6 * sin(23*t);
+}
+void benchFixtureClosestTree(long iterations)
+{
+    double position[3], closest[3];
+    for (long n = 0; n < iterations; n++)
+    {
+        benchFixturePosition(n, position);
+        benchDoNotOptimize(fixtureClosest(gFixture, position, closest));
+    }
+}
+void benchFixtureClosestBrute(long iterations)
+{
+    double position[3], closest[3];
+    for (long n = 0; n < iterations; n++)
+    {
+        benchFixturePosition(n, position);
+        benchDoNotOptimize(fixtureClosestBrute(gFixture, position, closest));
+    }
+}
+
+//one servo tick
+void benchServoTick(long iterations)
+{
+    hduVector3Dd forceVec;
+    for (long n = 0; n < iterations; n++)
+    {
+        hduVector3Dd pos(gBenchPositions[n % BENCH_NUM_SAMPLES]);
+        ServoTick(pos, forceVec);
+        benchDoNotOptimize(forceVec[0]);
+    }
+}
+
+
+//This function drives the tasks of the servo callback through many
+// simulated ticks and returns the number of heap allocations made inside
+// them (which must be zero).  Only the device is left out: the frame is
+// filled in here and the state is published to memory.
+long runServoAllocationCheck(long ticks)
+{
+    static DeviceStateShm memoryShm;
+    DeviceStateShm* publisherShm = gDeviceStatePublisher.shm;
+    gDeviceStatePublisher.shm = &memoryShm;
+    setupServoTasks();
+    if (!gClipmapStarted)
+        clipmapReset(gForceClipmap, gChargeSet);
+
+    long allocsBefore = gServoAllocCount;
+    ServoFrame& frame = gServoFrame;
+    for (long n = 0; n < ticks; n++)
+    {
+        //(the graphics loop keeps the watchdog fed, and the clipmap thread
+        // the grid around the stylus)
+        if (n % 16 == 0)
+            servoWatchdogFeedGraphics(gServoWatchdog);
+        if (!gClipmapStarted && n % 1000 == 0)
+            clipmapRefresh(gForceClipmap);
+
+        ServoAllocScope allocScope;
+
+        //the stylus sweeps the workspace, in and out of the fixed charge,
+        // with the Coulomb field (from the clipmap or not) on every other
+        // second
+        double t = n * 0.001;   //1 kHz
+        frame.pos.set(80 * sin(1.3*t), 80 * sin(1.7*t), 80 * cos(1.1*t));
+        for (int k = 0; k < 16; k++)
+            frame.transform[k] = (k % 5 == 0) ? 1 : 0;
+        for (int i = 0; i < 3; i++)
+        {
+            frame.transform[12 + i] = frame.pos[i];
+            frame.jointAngles[i] = 0.5 * sin((1.1 + 0.2*i) * t);
+            frame.gimbalAngles[i] = 2 * sin((0.7 + 0.3*i) * t);
+        }
+        frame.buttons = (n / 500) % 2;
+        gCoulombForceEnabled = (n / 1000) % 2 == 1;
+        gGravityCompensation = (n / 2000) % 2 == 1;
+        gProximityFeedback = (n / 4000) % 2 == 1;
+        gClipmapEnabled = (n / 8000) % 2 == 1;
+
+        servoSchedulerRun(gServoScheduler, servoClockSeconds());
+
+        //and the callback reports device errors through the event log
+        if (n % 10000 == 0)
+            servoEventPost(SERVO_EVENT_NOTICE, NULL, "Allocation check: simulated servo event", (double)n);
+    }
+    long allocs = gServoAllocCount - allocsBefore;
+
+    gCoulombForceEnabled = false;
+    gGravityCompensation = false;
+    gProximityFeedback = false;
+    gClipmapEnabled = false;
+    gPassivity.hasLast = false;
+    gDeviceStatePublisher.shm = publisherShm;
+    servoEventDrain(stdout);
+    return allocs;
+}//END of runServoAllocationCheck
+
+
+//This procedure times the force, kinematics and drawing set-up kernels
+// and (optionally) writes the results as JSON.  It runs without the
+// haptic device and without opening a window.
+int runBenchmarks(const char* jsonPath, const char* executable)
+{
+    //fixed pseudo-random samples so runs can be compared with each other
+    srand(488);
+    for (int k = 0; k < BENCH_NUM_SAMPLES; k++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            gBenchPositions[k][i] = 40.0 + rand() % 100;
+            if (rand() % 2)
+                gBenchPositions[k][i] = -gBenchPositions[k][i];
+            gBenchJointAngles[k][i] = (rand() % 1000) / 1000.0 - 0.5;
+            gBenchGimbalAngles[k][i] = (rand() % 1000) / 1000.0 * PI - PI/2;
+        }
+    }
+
+    printf("ENSC488 - Assignment2 micro-benchmarks\n\n");
+    benchRun("A2/CalculateForce/field", benchCalculateForceField);
+    benchRun("A2/CalculateForce/overlap", benchCalculateForceOverlap);
+    benchRun("A2/CentreForce/hduVector", benchForceHduVector);
+    benchRun("A2/CentreForce/Vec3d", benchForceVec3d);
+    benchRun("A2/CentreForce/Vec3f", benchForceVec3f);
+    benchRun("A2/ForceArrowRotation", benchForceArrowRotation);
+    buildOmniScene(gBenchOmniScene);
+    benchRun("A2/OmniScenePose", benchOmniScenePose);
+    benchRun("A2/OmniSceneRoll", benchOmniSceneRoll);
+    benchRun("A2/GravityCompensation", benchGravityCompensation);
+    for (int k = 0; k < 4; k++)
+    {
+        double position[3] = { 40.0 * (k - 1.5), 120.0 + 20 * k, 60 };
+        chargeSetAdd(gChargeSet, position, 1.0);
+    }
+    benchRun("A2/OmniProximity", benchOmniProximity);
+    gChargeSet.count = 1;
+    benchOmniBatchSetup();
+    benchRun("A2/OmniBatch/simd", benchOmniBatch);
+    benchRun("A2/OmniBatch/scalar", benchOmniBatchScalar);
+    benchRun("A2/ServoTick", benchServoTick);
+    benchRun("A2/ServoScheduler", benchServoScheduler);
+    benchRun("A2/PassivityFilter", benchPassivityFilter);
+    benchRun("A2/FieldLineTrace", benchFieldLineTrace);
+    benchRun("A2/EquiBlockBuild", benchEquiBlockBuild);
+    benchRun("A2/ChargeFieldForce/full", benchChargeFieldForceFull);
+    benchRun("A2/ClipmapForce", benchClipmapForce);
+    benchRun("A2/TaskRoundTrip", benchTaskRoundTrip);
+    if (buildFixturePath())
+    {
+        benchRun("A2/FixtureClosest/tree", benchFixtureClosestTree);
+        benchRun("A2/FixtureClosest/brute", benchFixtureClosestBrute);
+        fixtureFree(gFixture);
+    }
+    taskPoolStop(gBenchTaskPool);
+
+    //the servo callback must never touch the heap
+    printf("\n");
+    long servoAllocs = runServoAllocationCheck(100000);
+    servoAllocPrintCheck(stdout, 100000, servoAllocs);
+
+    if (jsonPath != NULL)
+    {
+        if (!benchWriteJson(jsonPath, executable))
+        {
+            fprintf(stderr, "Failed to write %s\n", jsonPath);
+            return -1;
+        }
+        printf("\nResults written to %s\n", jsonPath);
+    }
+    return (servoAllocs == 0) ? 0 : -1;
+}//END of runBenchmarks
+
+//******************************************************************************
+//           ~~~~~~  END OF main.cpp   ~~~~~~
 //******************************************************************************
\ No newline at end of file
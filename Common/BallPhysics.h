@@ -0,0 +1,504 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: BallPhysics.h
+
+Description:
+
+  Hundreds to thousands of balls in a box, colliding with each other,
+  with the walls and with the stylus, stepped by the graphics loop.
+
+  - Every step is made of fixed substeps (BALL_SUBSTEP).  Each predicts
+    the positions (gravity), then moves the balls apart until they no
+    longer overlap (position-based dynamics), and takes the velocities
+    from how far the balls actually moved.  Unlike spring contacts this
+    can't gain energy, whatever the number of balls stacked.
+  - Broad phase: a uniform grid of cells one small ball across, rebuilt
+    every substep by a counting sort.  A small ball only looks at the 27
+    cells around its own.  Balls wider than a cell ("large") are kept out
+    of the grid: every ball checks them directly, and they check the
+    cells their box covers.
+  - The overlaps are resolved BALL_ITERATIONS times per substep, "Jacobi"
+    style: every ball computes its own correction from the positions of
+    the previous iteration and writes only its own new position.  So the
+    balls can be split in chunks of BALL_CHUNK run in parallel on the
+    task pool (TaskPool.h) with no lock; the graphics loop waits for each
+    phase and runs chunks itself meanwhile.
+  - The stylus is a kinematic sphere the balls are pushed out of; a ball
+    grabbed with the stylus becomes kinematic too and follows it.  What
+    the balls still overlap the stylus (or the held ball) by after the
+    last iteration gives the force pushing back on the stylus
+    ("pushForce"), for the servo callback.
+
+  Units are mm, s, and the mass of a ball goes with its volume.
+
+******************************************************************************/
+#ifndef BALL_PHYSICS_H
+#define BALL_PHYSICS_H
+
+#include <math.h>
+#include <string.h>
+#include "TaskPool.h"
+
+#define BALL_MAX            4096        //most balls
+#define BALL_MAX_LARGE      16          //most balls wider than a grid cell
+#define BALL_GRID_MAX       32          //grid cells per side at most
+#define BALL_CHUNK          256         //balls per task
+#define BALL_SUBSTEP        0.002       //(s)
+#define BALL_MAX_SUBSTEPS   10          //per step; a longer frame is dropped
+#define BALL_ITERATIONS     4           //overlap corrections per substep
+#define BALL_OVER_RELAX     1.5         //weight of the averaged corrections
+#define BALL_GRAVITY        9810.0      //(mm/s^2, along -Y)
+#define BALL_DAMPING        0.999       //velocity kept per substep
+#define BALL_PUSH_STIFFNESS 0.3         //stylus force per mm of overlap (N/mm)
+#define BALL_PUSH_MAX       4.0         //(N)
+
+enum BallPhase
+{
+    BALL_PHASE_PREDICT = 0,
+    BALL_PHASE_SOLVE,
+    BALL_PHASE_VELOCITY
+};
+
+struct BallWorld;
+
+//one chunk of balls (a task)
+struct BallChunk
+{
+    BallWorld* world;
+    long begin, end;
+    double push[3];             //force on the stylus from these balls (N)
+};
+
+struct BallWorld
+{
+    long count;
+    double radius[BALL_MAX];
+    double invMass[BALL_MAX];           //0: kinematic (the held ball)
+    double position[2][BALL_MAX][3];    //this iteration's and the next one's
+    int current;                        //which of the two is this iteration's
+    double previous[BALL_MAX][3];       //at the start of the substep
+    double velocity[BALL_MAX][3];       //(mm/s)
+    double halfSize;                    //the box is +-halfSize on every axis
+
+    //broad phase
+    double cellSize;
+    int cellsPerSide;
+    long cellStart[BALL_GRID_MAX * BALL_GRID_MAX * BALL_GRID_MAX + 1];
+    long cellBalls[BALL_MAX];           //ball indices, by cell
+    long ballCell[BALL_MAX];            //cell of every ball (-1: large)
+    long large[BALL_MAX_LARGE];
+    int largeCount;
+
+    //the stylus: set every frame by the graphics loop
+    double stylus[3], stylusFrom[3], stylusTo[3];
+    double stylusRadius;
+    long held;                          //ball held by the stylus, -1: none
+    double heldOffset[3];               //stylus - held ball
+    double pushForce[3];                //force on the stylus (N)
+    double accumulator;                 //time not simulated yet (s)
+
+    //parallel chunks
+    TaskPool* pool;                     //NULL: run on the calling thread
+    TaskFuture phaseDone;
+    BallChunk chunks[BALL_MAX / BALL_CHUNK];
+    int phase;                          //BallPhase of the chunks
+};
+
+
+//This procedure empties the world: a box "size" wide, where balls of up
+// to "smallRadius" go in the grid.  "pool" may be NULL.
+inline void ballWorldInit(BallWorld& world, double size, double smallRadius, TaskPool* pool)
+{
+    memset(&world, 0, sizeof(world));
+    world.halfSize = size / 2;
+    world.cellSize = 2 * smallRadius;
+    world.cellsPerSide = (int)ceil(size / world.cellSize);
+    if (world.cellsPerSide > BALL_GRID_MAX)
+    {
+        world.cellsPerSide = BALL_GRID_MAX;
+        world.cellSize = size / BALL_GRID_MAX;
+    }
+    world.held = -1;
+    world.pool = pool;
+}
+
+
+//This function adds a ball at rest; returns its index, or -1 when there
+// is no room left.
+inline long ballWorldAdd(BallWorld& world, const double position[3], double radius)
+{
+    bool large = radius > world.cellSize / 2;
+    if (world.count >= BALL_MAX || (large && world.largeCount >= BALL_MAX_LARGE))
+        return -1;
+    long i = world.count++;
+    world.radius[i] = radius;
+    world.invMass[i] = 1.0 / (radius * radius * radius);
+    for (int k = 0; k < 3; k++)
+    {
+        world.position[world.current][i][k] = position[k];
+        world.previous[i][k] = position[k];
+        world.velocity[i][k] = 0;
+    }
+    if (large)
+        world.large[world.largeCount++] = i;
+    return i;
+}//END of ballWorldAdd
+
+
+//This procedure removes the balls from "first" on.
+inline void ballWorldTruncate(BallWorld& world, long first)
+{
+    if (first >= world.count)
+        return;
+    world.count = first;
+    if (world.held >= first)
+        world.held = -1;
+    int kept = 0;
+    for (int k = 0; k < world.largeCount; k++)
+        if (world.large[k] < first)
+            world.large[kept++] = world.large[k];
+    world.largeCount = kept;
+}
+
+
+//--------------------------------------------------------
+// *** Broad phase ***
+//--------------------------------------------------------
+
+inline int ballCellCoordinate(const BallWorld& world, double x)
+{
+    int c = (int)((x + world.halfSize) / world.cellSize);
+    return (c < 0) ? 0 : (c >= world.cellsPerSide) ? world.cellsPerSide - 1 : c;
+}
+
+
+//This procedure sorts the small balls by cell (counting sort).
+inline void ballBuildGrid(BallWorld& world)
+{
+    const double (*p)[3] = world.position[world.current];
+    long n = world.cellsPerSide;
+    long cells = n * n * n;
+    memset(world.cellStart, 0, sizeof(long) * (cells + 1));
+    for (long i = 0; i < world.count; i++)
+    {
+        if (world.radius[i] > world.cellSize / 2)
+        {
+            world.ballCell[i] = -1;
+            continue;
+        }
+        long cell = (ballCellCoordinate(world, p[i][0]) * n +
+                     ballCellCoordinate(world, p[i][1])) * n + ballCellCoordinate(world, p[i][2]);
+        world.ballCell[i] = cell;
+        world.cellStart[cell + 1]++;
+    }
+    for (long c = 0; c < cells; c++)
+        world.cellStart[c + 1] += world.cellStart[c];
+    //(cellStart[c] is used as the fill point of cell c, then shifted back)
+    for (long i = 0; i < world.count; i++)
+        if (world.ballCell[i] >= 0)
+            world.cellBalls[world.cellStart[world.ballCell[i]]++] = i;
+    for (long c = cells; c > 0; c--)
+        world.cellStart[c] = world.cellStart[c - 1];
+    world.cellStart[0] = 0;
+}//END of ballBuildGrid
+
+
+//--------------------------------------------------------
+// *** Narrow phase and solver ***
+//--------------------------------------------------------
+
+//This procedure adds to "delta" the correction of ball i out of ball j
+// (weighted by their masses), and counts the contact.
+inline void ballContact(const BallWorld& world, const double (*p)[3], long i, long j,
+                        double delta[3], int& contacts)
+{
+    double d[3] = { p[i][0] - p[j][0], p[i][1] - p[j][1], p[i][2] - p[j][2] };
+    double reach = world.radius[i] + world.radius[j];
+    double distance2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+    if (distance2 >= reach * reach)
+        return;
+    double weight = world.invMass[i] + world.invMass[j];
+    if (weight <= 0)
+        return;     //(two kinematic balls)
+    double distance = sqrt(distance2);
+    double share = (reach - distance) * world.invMass[i] / weight;
+    if (distance > 1e-9)
+    {
+        double scale = share / distance;
+        delta[0] += scale * d[0];
+        delta[1] += scale * d[1];
+        delta[2] += scale * d[2];
+    }
+    else
+        delta[1] += share;  //(exactly on top of each other: lift it)
+    contacts++;
+}//END of ballContact
+
+
+//This procedure computes the next position of ball i (one iteration).
+inline void ballSolveOne(BallWorld& world, long i)
+{
+    const double (*p)[3] = world.position[world.current];
+    double* next = world.position[1 - world.current][i];
+    if (world.invMass[i] <= 0)
+    {
+        next[0] = p[i][0]; next[1] = p[i][1]; next[2] = p[i][2];
+        return;
+    }
+
+    double delta[3] = { 0, 0, 0 };
+    int contacts = 0;
+    double r = world.radius[i];
+
+    //the balls in the cells around it (all the cells its box covers for a
+    // large ball), then the large balls
+    double reach = r + world.cellSize / 2;
+    int lo[3], hi[3];
+    for (int k = 0; k < 3; k++)
+    {
+        lo[k] = ballCellCoordinate(world, p[i][k] - reach);
+        hi[k] = ballCellCoordinate(world, p[i][k] + reach);
+    }
+    long n = world.cellsPerSide;
+    for (int cx = lo[0]; cx <= hi[0]; cx++)
+        for (int cy = lo[1]; cy <= hi[1]; cy++)
+        {
+            long row = (cx * n + cy) * n;
+            for (long b = world.cellStart[row + lo[2]]; b < world.cellStart[row + hi[2] + 1]; b++)
+                if (world.cellBalls[b] != i)
+                    ballContact(world, p, i, world.cellBalls[b], delta, contacts);
+        }
+    for (int k = 0; k < world.largeCount; k++)
+        if (world.large[k] != i)
+            ballContact(world, p, i, world.large[k], delta, contacts);
+
+    //the stylus, unless it holds a ball (which is then a kinematic ball)
+    if (world.held < 0)
+    {
+        double d[3] = { p[i][0] - world.stylus[0], p[i][1] - world.stylus[1], p[i][2] - world.stylus[2] };
+        double touch = r + world.stylusRadius;
+        double distance2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+        if (distance2 < touch * touch && distance2 > 1e-18)
+        {
+            double distance = sqrt(distance2);
+            for (int k = 0; k < 3; k++)
+                delta[k] += (touch - distance) * d[k] / distance;
+            contacts++;
+        }
+    }
+
+    double weight = (contacts > 1) ? BALL_OVER_RELAX / contacts : 1;
+    if (weight > 1)
+        weight = 1;
+    for (int k = 0; k < 3; k++)
+    {
+        double x = p[i][k] + weight * delta[k];
+        //the walls
+        if (x < -world.halfSize + r) x = -world.halfSize + r;
+        if (x > world.halfSize - r) x = world.halfSize - r;
+        next[k] = x;
+    }
+}//END of ballSolveOne
+
+
+//This procedure runs one phase of a substep on a chunk of balls.
+inline void ballChunkPhase(BallChunk& chunk)
+{
+    BallWorld& world = *chunk.world;
+    double (*p)[3] = world.position[world.current];
+    double h = BALL_SUBSTEP;
+    switch (world.phase)
+    {
+        case BALL_PHASE_PREDICT:
+            for (long i = chunk.begin; i < chunk.end; i++)
+            {
+                for (int k = 0; k < 3; k++)
+                    world.previous[i][k] = p[i][k];
+                if (world.invMass[i] <= 0)
+                {   //the held ball follows the stylus
+                    for (int k = 0; k < 3; k++)
+                        p[i][k] = world.stylus[k] - world.heldOffset[k];
+                    continue;
+                }
+                world.velocity[i][1] -= BALL_GRAVITY * h;
+                //no ball moves more than its radius in a substep (nothing
+                // can go through it)
+                double step2 = 0, limit = world.radius[i] / h;
+                for (int k = 0; k < 3; k++)
+                    step2 += world.velocity[i][k] * world.velocity[i][k];
+                double scale = (step2 > limit * limit) ? limit / sqrt(step2) : 1;
+                for (int k = 0; k < 3; k++)
+                    p[i][k] += scale * world.velocity[i][k] * h;
+            }
+            break;
+
+        case BALL_PHASE_SOLVE:
+            for (long i = chunk.begin; i < chunk.end; i++)
+                ballSolveOne(world, i);
+            break;
+
+        case BALL_PHASE_VELOCITY:
+        {
+            chunk.push[0] = chunk.push[1] = chunk.push[2] = 0;
+            const double* probe = (world.held >= 0) ? p[world.held] : world.stylus;
+            double probeRadius = (world.held >= 0) ? world.radius[world.held] : world.stylusRadius;
+            for (long i = chunk.begin; i < chunk.end; i++)
+            {
+                for (int k = 0; k < 3; k++)
+                    world.velocity[i][k] = BALL_DAMPING * (p[i][k] - world.previous[i][k]) / h;
+                if (i == world.held)
+                    continue;
+
+                //what is left of the overlap with the stylus pushes it back
+                double d[3] = { probe[0] - p[i][0], probe[1] - p[i][1], probe[2] - p[i][2] };
+                double touch = world.radius[i] + probeRadius;
+                double distance2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+                if (distance2 < touch * touch && distance2 > 1e-18)
+                {
+                    double distance = sqrt(distance2);
+                    for (int k = 0; k < 3; k++)
+                        chunk.push[k] += BALL_PUSH_STIFFNESS * (touch - distance) * d[k] / distance;
+                }
+            }
+            break;
+        }
+    }
+}//END of ballChunkPhase
+
+
+inline void ballChunkTask(void* data)
+{
+    ballChunkPhase(*static_cast<BallChunk*>(data));
+}
+
+
+//This procedure runs a phase on every chunk, in parallel when there is
+// more than one, and returns once they have all finished.
+inline void ballRunPhase(BallWorld& world, int phase)
+{
+    world.phase = phase;
+    long chunks = (world.count + BALL_CHUNK - 1) / BALL_CHUNK;
+    for (long c = 0; c < chunks; c++)
+    {
+        world.chunks[c].world = &world;
+        world.chunks[c].begin = c * BALL_CHUNK;
+        world.chunks[c].end = (c + 1 < chunks) ? (c + 1) * BALL_CHUNK : world.count;
+    }
+    if (world.pool == NULL || chunks <= 1)
+    {
+        for (long c = 0; c < chunks; c++)
+            ballChunkPhase(world.chunks[c]);
+        return;
+    }
+    taskFutureReset(world.phaseDone);
+    for (long c = 0; c < chunks; c++)
+        taskSubmit(*world.pool, ballChunkTask, &world.chunks[c], TASK_PRIORITY_HIGH, &world.phaseDone);
+    taskFutureWait(*world.pool, world.phaseDone);
+}//END of ballRunPhase
+
+
+//This procedure runs one substep.
+inline void ballSubstep(BallWorld& world)
+{
+    ballRunPhase(world, BALL_PHASE_PREDICT);
+    ballBuildGrid(world);
+    for (int n = 0; n < BALL_ITERATIONS; n++)
+    {
+        ballRunPhase(world, BALL_PHASE_SOLVE);
+        world.current = 1 - world.current;
+    }
+    ballRunPhase(world, BALL_PHASE_VELOCITY);
+
+    long chunks = (world.count + BALL_CHUNK - 1) / BALL_CHUNK;
+    double push[3] = { 0, 0, 0 };
+    for (long c = 0; c < chunks; c++)
+        for (int k = 0; k < 3; k++)
+            push[k] += world.chunks[c].push[k];
+    double magnitude = sqrt(push[0]*push[0] + push[1]*push[1] + push[2]*push[2]);
+    double scale = (magnitude > BALL_PUSH_MAX) ? BALL_PUSH_MAX / magnitude : 1;
+    for (int k = 0; k < 3; k++)
+        world.pushForce[k] = scale * push[k];
+}//END of ballSubstep
+
+
+//This procedure advances the world by "elapsed" seconds, the stylus
+// (radius "stylusRadius") having moved to "stylus" since the last step.
+inline void ballWorldStep(BallWorld& world, double elapsed, const double stylus[3], double stylusRadius)
+{
+    world.stylusRadius = stylusRadius;
+    for (int k = 0; k < 3; k++)
+    {
+        world.stylusFrom[k] = world.stylus[k];
+        world.stylusTo[k] = stylus[k];
+    }
+    world.accumulator += elapsed;
+    int substeps = (int)(world.accumulator / BALL_SUBSTEP);
+    if (substeps > BALL_MAX_SUBSTEPS)
+    {
+        substeps = BALL_MAX_SUBSTEPS;
+        world.accumulator = substeps * BALL_SUBSTEP;
+    }
+    world.accumulator -= substeps * BALL_SUBSTEP;
+
+    //the stylus moves in even steps over the substeps
+    for (int s = 1; s <= substeps; s++)
+    {
+        for (int k = 0; k < 3; k++)
+            world.stylus[k] = world.stylusFrom[k] + (world.stylusTo[k] - world.stylusFrom[k]) * s / substeps;
+        ballSubstep(world);
+    }
+    for (int k = 0; k < 3; k++)
+        world.stylus[k] = stylus[k];
+}//END of ballWorldStep
+
+
+//--------------------------------------------------------
+// *** Grabbing ***
+//--------------------------------------------------------
+
+//This function returns the ball whose surface is nearest the stylus,
+// among those within "reach" of it, or -1.
+inline long ballWorldPick(const BallWorld& world, const double stylus[3], double reach)
+{
+    const double (*p)[3] = world.position[world.current];
+    long best = -1;
+    double bestGap = reach;
+    for (long i = 0; i < world.count; i++)
+    {
+        double d[3] = { p[i][0] - stylus[0], p[i][1] - stylus[1], p[i][2] - stylus[2] };
+        double gap = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]) - world.radius[i];
+        if (gap <= bestGap)
+        {
+            bestGap = gap;
+            best = i;
+        }
+    }
+    return best;
+}//END of ballWorldPick
+
+
+//This procedure makes ball "i" follow the stylus (-1: releases the held
+// ball, which keeps the stylus's velocity).
+inline void ballWorldHold(BallWorld& world, long i, const double stylus[3])
+{
+    if (world.held >= 0)
+        world.invMass[world.held] = 1.0 / (world.radius[world.held] * world.radius[world.held] *
+                                            world.radius[world.held]);
+    world.held = i;
+    if (i < 0)
+        return;
+    const double* p = world.position[world.current][i];
+    for (int k = 0; k < 3; k++)
+        world.heldOffset[k] = stylus[k] - p[k];
+    world.invMass[i] = 0;
+}//END of ballWorldHold
+
+
+//This function returns the position of ball "i".
+inline const double* ballPosition(const BallWorld& world, long i)
+{
+    return world.position[world.current][i];
+}
+
+#endif //BALL_PHYSICS_H
@@ -0,0 +1,196 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: CapsuleProximity.h
+
+Description:
+
+  How close a set of capsules come to each other: for every shape the
+  smallest clearance to any other, and the pairs closer than a margin
+  with the closest points on both.
+
+  - A capsule is a segment swept by a sphere (a cylinder with round
+    ends); with both ends at the same point it is a sphere.  The
+    clearance of two capsules is the distance between their segments
+    less both radii, negative when they overlap.
+  - Shapes joined to each other (two links at a joint always touch) are
+    left out with a bit mask per shape ("ignore").  At most
+    CAPSULE_MAX_SHAPES shapes (the bits of a mask).
+  - Every pair is tested exactly, with the closest points of the two
+    segments (Ericson, "Real-Time Collision Detection", 5.1.9): with the
+    dozen or so shapes of an arm and its surroundings that is a couple of
+    hundred nanoseconds to a few microseconds, with no allocation.
+
+******************************************************************************/
+#ifndef CAPSULE_PROXIMITY_H
+#define CAPSULE_PROXIMITY_H
+
+#include <math.h>
+
+#define CAPSULE_MAX_SHAPES 32
+
+struct Capsule
+{
+    double a[3], b[3];          //ends of the segment (a == b: a sphere)
+    double radius;
+};
+
+//two shapes closer than the margin
+struct CapsuleContact
+{
+    int first, second;
+    double clearance;
+    double pointFirst[3];       //closest points, on the surfaces
+    double pointSecond[3];
+    double normal[3];           //unit, from the second shape to the first
+};
+
+struct CapsuleSet
+{
+    int count;
+    Capsule shapes[CAPSULE_MAX_SHAPES];
+    unsigned long ignore[CAPSULE_MAX_SHAPES];  //bit j of ignore[i]: don't test i with j
+};
+
+
+//This procedure sets shapes i and j not to be tested with each other.
+inline void capsuleIgnorePair(CapsuleSet& set, int i, int j)
+{
+    set.ignore[i] |= 1UL << j;
+    set.ignore[j] |= 1UL << i;
+}
+
+
+inline double capsuleClamp01(double t)
+{
+    return (t < 0) ? 0 : (t > 1) ? 1 : t;
+}
+
+
+//This function gives the squared distance between segments p1-q1 and
+// p2-q2, and their closest points c1 and c2.
+inline double capsuleSegmentDistance2(const double p1[3], const double q1[3],
+                                      const double p2[3], const double q2[3],
+                                      double c1[3], double c2[3])
+{
+    double d1[3], d2[3], r[3];
+    int k;
+    for (k = 0; k < 3; k++)
+    {
+        d1[k] = q1[k] - p1[k];
+        d2[k] = q2[k] - p2[k];
+        r[k] = p1[k] - p2[k];
+    }
+    double a = d1[0]*d1[0] + d1[1]*d1[1] + d1[2]*d1[2];
+    double e = d2[0]*d2[0] + d2[1]*d2[1] + d2[2]*d2[2];
+    double f = d2[0]*r[0] + d2[1]*r[1] + d2[2]*r[2];
+    double s, t;
+    const double tiny = 1e-12;
+
+    if (a <= tiny && e <= tiny)
+        s = t = 0;                                  //two points
+    else if (a <= tiny)
+    {
+        s = 0;                                      //a point and a segment
+        t = capsuleClamp01(f / e);
+    }
+    else
+    {
+        double c = d1[0]*r[0] + d1[1]*r[1] + d1[2]*r[2];
+        if (e <= tiny)
+        {
+            t = 0;                                  //a segment and a point
+            s = capsuleClamp01(-c / a);
+        }
+        else
+        {
+            double b = d1[0]*d2[0] + d1[1]*d2[1] + d1[2]*d2[2];
+            double denominator = a * e - b * b;     //0 when parallel
+            s = (denominator > tiny) ? capsuleClamp01((b * f - c * e) / denominator) : 0;
+            t = (b * s + f) / e;
+            if (t < 0)
+            {
+                t = 0;
+                s = capsuleClamp01(-c / a);
+            }
+            else if (t > 1)
+            {
+                t = 1;
+                s = capsuleClamp01((b - c) / a);
+            }
+        }
+    }
+
+    double distance2 = 0;
+    for (k = 0; k < 3; k++)
+    {
+        c1[k] = p1[k] + d1[k] * s;
+        c2[k] = p2[k] + d2[k] * t;
+        distance2 += (c1[k] - c2[k]) * (c1[k] - c2[k]);
+    }
+    return distance2;
+}//END of capsuleSegmentDistance2
+
+
+//This function gives the clearance of two capsules, filling in "contact"
+// (but not its shape numbers).
+inline double capsuleClearance(const Capsule& first, const Capsule& second, CapsuleContact& contact)
+{
+    double c1[3], c2[3];
+    double distance = sqrt(capsuleSegmentDistance2(first.a, first.b, second.a, second.b, c1, c2));
+    int k;
+    if (distance > 1e-9)
+        for (k = 0; k < 3; k++)
+            contact.normal[k] = (c1[k] - c2[k]) / distance;
+    else
+    {
+        //(the segments cross: any direction will do)
+        contact.normal[0] = 0;
+        contact.normal[1] = 1;
+        contact.normal[2] = 0;
+    }
+    for (k = 0; k < 3; k++)
+    {
+        contact.pointFirst[k] = c1[k] - first.radius * contact.normal[k];
+        contact.pointSecond[k] = c2[k] + second.radius * contact.normal[k];
+    }
+    contact.clearance = distance - first.radius - second.radius;
+    return contact.clearance;
+}//END of capsuleClearance
+
+
+//This function tests every pair of the set: "clearance[i]" gets the
+// smallest clearance of shape i (or "margin" if nothing is that close),
+// and the pairs closer than "margin" go into "contacts", "maxContacts" at
+// most.
+//Returns the number of contacts.
+inline int capsuleProximity(const CapsuleSet& set, double margin, double clearance[],
+                            CapsuleContact contacts[], int maxContacts)
+{
+    int i, j, found = 0;
+    for (i = 0; i < set.count; i++)
+        clearance[i] = margin;
+
+    CapsuleContact contact;
+    for (i = 0; i < set.count; i++)
+        for (j = i + 1; j < set.count; j++)
+        {
+            if (set.ignore[i] & (1UL << j))
+                continue;
+            double c = capsuleClearance(set.shapes[i], set.shapes[j], contact);
+            if (c >= margin)
+                continue;
+            if (c < clearance[i]) clearance[i] = c;
+            if (c < clearance[j]) clearance[j] = c;
+            if (found < maxContacts)
+            {
+                contacts[found] = contact;
+                contacts[found].first = i;
+                contacts[found].second = j;
+                found++;
+            }
+        }
+    return found;
+}//END of capsuleProximity
+
+#endif //CAPSULE_PROXIMITY_H
@@ -0,0 +1,116 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ChargeField.h
+
+Description:
+
+  A set of fixed point charges and the Coulomb force/potential they put
+  on the charge carried by the stylus.  With one unit charge at the
+  origin this is exactly the field of Assignment2's centre sphere:
+
+  - outside the contact radius (the charge radius grown by the zoom, as
+    the scaled sphere and the stylus sphere touch) the inverse-square
+    law, -400 q r/|r|^3,
+  - inside it a soft spring, -0.1 q r, so the spheres can overlap,
+
+  both divided by the zoom when it is above one.  Positive charges
+  attract the stylus, negative ones repel it.
+
+  The graphics loop owns the set; it bumps "version" on every change so
+  caches built from the field (see FieldLineCache.h) know when to
+  rebuild.  The servo callback reads it as is: a charge being added is
+  written before "count" is raised.
+
+******************************************************************************/
+#ifndef CHARGE_FIELD_H
+#define CHARGE_FIELD_H
+
+#include <math.h>
+#include "ServoAtomic.h"
+#include "SmallVector.h"
+
+#define CHARGE_MAX          32      //most charges in a set
+#define CHARGE_FORCE_GAIN   400.0   //inverse-square gain (N.mm^2 per unit charge)
+#define CHARGE_SPRING_GAIN  0.1     //overlap spring (N/mm per unit charge)
+
+struct Charge
+{
+    double position[3];     //(mm, device coordinates)
+    double strength;        //1 = the original centre charge; < 0 repels
+};
+
+struct ChargeSet
+{
+    long count;             //charges in use
+    long version;           //changes whenever the set changes
+    double radius;          //radius of each charge sphere at zoom 1 (mm)
+    Charge charges[CHARGE_MAX];
+};
+
+
+//This function adds a charge; returns false when the set is full.
+inline bool chargeSetAdd(ChargeSet& set, const double position[3], double strength)
+{
+    if (set.count >= CHARGE_MAX)
+        return false;
+    Charge& charge = set.charges[set.count];
+    charge.position[0] = position[0];
+    charge.position[1] = position[1];
+    charge.position[2] = position[2];
+    charge.strength = strength;
+    servoStoreRelease(&set.count, set.count + 1);
+    set.version++;
+    return true;
+}
+
+
+//This procedure computes the force on the stylus charge at "position".
+inline void chargeFieldForce(const ChargeSet& set, double zoom, const double position[3],
+                             double force[3])
+{
+    double scale = (zoom >= 1) ? 1.0 / zoom : 1.0;
+    double contact = set.radius + zoom * set.radius;
+    Vec3d p(position), sum(0, 0, 0);
+    for (long k = 0; k < set.count; k++)
+    {
+        const Charge& charge = set.charges[k];
+        Vec3d r = p - Vec3d(charge.position);
+        double sqrDist = vecSqrNorm(r);
+        double gain;
+        if (sqrDist < contact*contact)
+            gain = -CHARGE_SPRING_GAIN * charge.strength * scale;   //overlap
+        else
+            gain = -CHARGE_FORCE_GAIN * charge.strength * scale / (sqrDist * sqrt(sqrDist));
+        sum += gain * r;
+    }
+    sum.store(force);
+}//END of chargeFieldForce
+
+
+//This function returns the potential energy (mJ) of the stylus charge at
+// "position"; the force above is minus its gradient.  Inside the contact
+// radius it continues as the potential of the overlap spring.
+inline double chargeFieldPotential(const ChargeSet& set, double zoom, const double position[3])
+{
+    double scale = (zoom >= 1) ? 1.0 / zoom : 1.0;
+    double contact = set.radius + zoom * set.radius;
+    double potential = 0;
+    for (long k = 0; k < set.count; k++)
+    {
+        const Charge& charge = set.charges[k];
+        double r[3] = { position[0] - charge.position[0],
+                        position[1] - charge.position[1],
+                        position[2] - charge.position[2] };
+        double sqrDist = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+        double u;
+        if (sqrDist < contact*contact)
+            u = 0.5*CHARGE_SPRING_GAIN*(sqrDist - contact*contact) - CHARGE_FORCE_GAIN/contact;
+        else
+            u = -CHARGE_FORCE_GAIN / sqrt(sqrDist);
+        potential += u * charge.strength * scale;
+    }
+    return potential;
+}//END of chargeFieldPotential
+
+#endif //CHARGE_FIELD_H
@@ -0,0 +1,515 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ConstraintSet.h
+
+Description:
+
+  The walls a sphere (the ball held by the stylus) is kept out of, as
+  data: oriented planes, boxes and convex polytopes, and the contacts
+  and the force of a sphere against all of them.
+
+  - A plane is a half-space the sphere stays in, free where
+    normal . x >= offset (the walls of a room face inwards).  A box
+    (centre, three unit axes, half sizes) and a polytope (outward faces,
+    solid where normal . x <= offset for every face) are solids the
+    sphere stays out of.
+  - The sphere touches a constraint when its centre is no further than
+    its radius from it; each contact pushes along its normal with
+    pushForce plus stiffness times how far the sphere went in, and the
+    contacts add up (in a corner, two walls push).
+  - The distance to a box is exact (from the box's corners and edges
+    too); the distance to a polytope is that of its nearest face plane,
+    exact over the faces, a little short near the edges and corners.
+  - The shapes are stored structure-of-arrays in floats, so that
+    constraintContacts() tests four planes, boxes or faces at a time
+    with SSE, and works out the contact (in doubles) only for the few
+    that touch.  The arrays are filled up to a multiple of four with
+    entries nothing touches (and the faces of each polytope with copies
+    of its last face), so there is no remainder to test one by one.
+    A maze of a few hundred walls takes a microsecond or two of the
+    millisecond of a servo tick, with no allocation.  Without SSE2 (or with
+    CONSTRAINT_SET_NO_SSE) it falls back on the scalar version,
+    constraintContactsScalar(), which gives the same contacts.
+  - A set is built before the servo callback reads it and not changed
+    after; the servo and graphics threads may then both query it.
+
+******************************************************************************/
+#ifndef CONSTRAINT_SET_H
+#define CONSTRAINT_SET_H
+
+#include <math.h>
+#include <float.h>
+
+#if !defined(CONSTRAINT_SET_NO_SSE) && \
+    (defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CONSTRAINT_SET_SSE
+#include <emmintrin.h>
+#endif
+
+#define CONSTRAINT_MAX_PLANES       256
+#define CONSTRAINT_MAX_BOXES        1024
+#define CONSTRAINT_MAX_POLYTOPES    128
+#define CONSTRAINT_MAX_FACES        1024    //of all the polytopes
+#define CONSTRAINT_MAX_CONTACTS     16      //a sphere touches at once, at most
+#define CONSTRAINT_ROUND4(n)        (((n) + 3) & ~3)
+
+enum ConstraintKind
+{
+    CONSTRAINT_PLANE = 0,
+    CONSTRAINT_BOX,
+    CONSTRAINT_POLYTOPE
+};
+
+//a constraint the sphere touches
+struct ConstraintContact
+{
+    int kind;                   //ConstraintKind
+    int index;                  //of the plane, box or polytope
+    double distance;            //from the centre to the surface (negative inside it)
+    double normal[3];           //unit, the way the sphere is pushed
+};
+
+struct ConstraintSet
+{
+    double pushForce;           //felt as soon as the sphere touches (N)
+    double stiffness;           //and for every mm it goes in (N/mm)
+
+    //half-spaces, free where normal . x >= offset
+    int planeCount;
+    float planeNormal[3][CONSTRAINT_MAX_PLANES];
+    float planeOffset[CONSTRAINT_MAX_PLANES];
+
+    //solid boxes: axis[k] is the unit vector of the box's k-th axis
+    int boxCount;
+    float boxCentre[3][CONSTRAINT_MAX_BOXES];
+    float boxAxis[3][3][CONSTRAINT_MAX_BOXES];     //[axis][component]
+    float boxHalf[3][CONSTRAINT_MAX_BOXES];
+
+    //solid convex polytopes: faces polytopeFirst[i] on, polytopeFaces[i] of them
+    // (then copies of the last up to a multiple of four)
+    int polytopeCount;
+    int polytopeFirst[CONSTRAINT_MAX_POLYTOPES];
+    int polytopeFaces[CONSTRAINT_MAX_POLYTOPES];
+    int faceCount;
+    float faceNormal[3][CONSTRAINT_MAX_FACES];     //outwards
+    float faceOffset[CONSTRAINT_MAX_FACES];
+};
+
+
+//--------------------------------------------------------
+// Building the set
+//--------------------------------------------------------
+
+//This procedure empties the set and sets how hard its contacts push.
+inline void constraintSetInit(ConstraintSet& set, double pushForce, double stiffness)
+{
+    set.pushForce = pushForce;
+    set.stiffness = stiffness;
+    set.planeCount = 0;
+    set.boxCount = 0;
+    set.polytopeCount = 0;
+    set.faceCount = 0;
+}
+
+
+//This function adds the half-space normal . x >= offset (the normal need
+// not be unit length).
+//Returns the plane, or -1 if the set is full (or the normal is 0).
+inline int constraintAddPlane(ConstraintSet& set, const double normal[3], double offset)
+{
+    double length = sqrt(normal[0]*normal[0] + normal[1]*normal[1] + normal[2]*normal[2]);
+    if (set.planeCount == CONSTRAINT_MAX_PLANES || length == 0)
+        return -1;
+    int index = set.planeCount++;
+    int k;
+    if (index % 4 == 0)
+        for (int pad = index; pad < index + 4; pad++)
+        {
+            //(0 . x >= -FLT_MAX: never touched)
+            for (k = 0; k < 3; k++)
+                set.planeNormal[k][pad] = 0;
+            set.planeOffset[pad] = -FLT_MAX;
+        }
+    for (k = 0; k < 3; k++)
+        set.planeNormal[k][index] = (float)(normal[k] / length);
+    set.planeOffset[index] = (float)(offset / length);
+    return index;
+}//END of constraintAddPlane
+
+
+//This function adds a solid box of the given half sizes around "centre";
+// "axes" are the unit axes of the box (axes[k] along half[k]), or NULL
+// for a box aligned with X, Y and Z.
+//Returns the box, or -1 if the set is full.
+inline int constraintAddBox(ConstraintSet& set, const double centre[3], const double half[3],
+                            const double axes[3][3])
+{
+    if (set.boxCount == CONSTRAINT_MAX_BOXES)
+        return -1;
+    int index = set.boxCount++;
+    int k;
+    if (index % 4 == 0)
+        for (int pad = index; pad < index + 4; pad++)
+            for (k = 0; k < 3; k++)
+            {
+                //(a box of size -FLT_MAX: infinitely far)
+                set.boxCentre[k][pad] = 0;
+                set.boxHalf[k][pad] = -FLT_MAX;
+                set.boxAxis[k][0][pad] = set.boxAxis[k][1][pad] = set.boxAxis[k][2][pad] = 0;
+            }
+    for (k = 0; k < 3; k++)
+    {
+        set.boxCentre[k][index] = (float)centre[k];
+        set.boxHalf[k][index] = (float)half[k];
+        for (int c = 0; c < 3; c++)
+            set.boxAxis[k][c][index] = (float)(axes ? axes[k][c] : (k == c) ? 1 : 0);
+    }
+    return index;
+}//END of constraintAddBox
+
+
+//This function adds a solid convex polytope: the points x with
+// normals[f] . x <= offsets[f] for every face f (the normals pointing
+// out, of any length).
+//Returns the polytope, or -1 if the set is full.
+inline int constraintAddPolytope(ConstraintSet& set, const double normals[][3], const double offsets[],
+                                 int faces)
+{
+    if (set.polytopeCount == CONSTRAINT_MAX_POLYTOPES || faces < 1 ||
+        set.faceCount + CONSTRAINT_ROUND4(faces) > CONSTRAINT_MAX_FACES)
+        return -1;
+    int index = set.polytopeCount++;
+    set.polytopeFirst[index] = set.faceCount;
+    set.polytopeFaces[index] = faces;
+    for (int f = 0; f < CONSTRAINT_ROUND4(faces); f++)
+    {
+        int from = (f < faces) ? f : faces - 1;
+        double length = sqrt(normals[from][0]*normals[from][0] + normals[from][1]*normals[from][1] +
+                             normals[from][2]*normals[from][2]);
+        if (length == 0)
+            length = 1;
+        int face = set.faceCount++;
+        for (int k = 0; k < 3; k++)
+            set.faceNormal[k][face] = (float)(normals[from][k] / length);
+        set.faceOffset[face] = (float)(offsets[from] / length);
+    }
+    return index;
+}//END of constraintAddPolytope
+
+
+//This procedure gives the point of a plane nearest the origin and two unit
+// vectors along the plane (to draw it).
+inline void constraintPlaneFrame(const ConstraintSet& set, int index, double point[3],
+                                 double u[3], double v[3])
+{
+    double n[3];
+    int k, smallest = 0;
+    for (k = 0; k < 3; k++)
+    {
+        n[k] = set.planeNormal[k][index];
+        point[k] = n[k] * set.planeOffset[index];
+        if (fabs(n[k]) < fabs(n[smallest]))
+            smallest = k;
+    }
+
+    //u: across the normal and the axis it is furthest from
+    double axis[3] = { 0, 0, 0 };
+    axis[smallest] = 1;
+    u[0] = n[1]*axis[2] - n[2]*axis[1];
+    u[1] = n[2]*axis[0] - n[0]*axis[2];
+    u[2] = n[0]*axis[1] - n[1]*axis[0];
+    double length = sqrt(u[0]*u[0] + u[1]*u[1] + u[2]*u[2]);
+    for (k = 0; k < 3; k++)
+        u[k] /= length;
+    v[0] = n[1]*u[2] - n[2]*u[1];
+    v[1] = n[2]*u[0] - n[0]*u[2];
+    v[2] = n[0]*u[1] - n[1]*u[0];
+}//END of constraintPlaneFrame
+
+
+//--------------------------------------------------------
+// One constraint (scalar)
+//--------------------------------------------------------
+
+//This function gives the distance from "p" to plane "index" (negative
+// past it), in floats as the batched version computes it.
+inline float constraintPlaneDistance(const ConstraintSet& set, int index, const float p[3])
+{
+    return set.planeNormal[0][index] * p[0] + set.planeNormal[1][index] * p[1] +
+           set.planeNormal[2][index] * p[2] - set.planeOffset[index];
+}
+
+
+//This function gives the distance from "p" to box "index" (negative
+// inside it), in floats as the batched version computes it.
+inline float constraintBoxDistance(const ConstraintSet& set, int index, const float p[3])
+{
+    float d[3], outside = 0, inside = -FLT_MAX;
+    int k;
+    for (k = 0; k < 3; k++)
+        d[k] = p[k] - set.boxCentre[k][index];
+    for (k = 0; k < 3; k++)
+    {
+        float local = set.boxAxis[k][0][index] * d[0] + set.boxAxis[k][1][index] * d[1] +
+                      set.boxAxis[k][2][index] * d[2];
+        float q = fabsf(local) - set.boxHalf[k][index];
+        if (q > 0)
+            outside += q * q;
+        if (q > inside)
+            inside = q;
+    }
+    return sqrtf(outside) + ((inside < 0) ? inside : 0);
+}//END of constraintBoxDistance
+
+
+//This function gives the distance from "p" to polytope "index" (that of
+// its nearest face plane, negative inside it), in floats as the batched
+// version computes it.
+inline float constraintPolytopeDistance(const ConstraintSet& set, int index, const float p[3])
+{
+    float largest = -FLT_MAX;
+    int end = set.polytopeFirst[index] + set.polytopeFaces[index];
+    for (int f = set.polytopeFirst[index]; f < end; f++)
+    {
+        float s = set.faceNormal[0][f] * p[0] + set.faceNormal[1][f] * p[1] +
+                  set.faceNormal[2][f] * p[2] - set.faceOffset[f];
+        if (s > largest)
+            largest = s;
+    }
+    return largest;
+}
+
+
+//This procedure fills in the contact of "centre" with a constraint it
+// touches (in doubles: the distance and the normal).
+inline void constraintMakeContact(const ConstraintSet& set, int kind, int index, const double centre[3],
+                                  ConstraintContact& contact)
+{
+    int k;
+    contact.kind = kind;
+    contact.index = index;
+    if (kind == CONSTRAINT_PLANE)
+    {
+        contact.distance = -set.planeOffset[index];
+        for (k = 0; k < 3; k++)
+        {
+            contact.normal[k] = set.planeNormal[k][index];
+            contact.distance += contact.normal[k] * centre[k];
+        }
+    }
+    else if (kind == CONSTRAINT_BOX)
+    {
+        //the centre in the axes of the box
+        double d[3], local[3], q[3], outside = 0;
+        int deepest = 0;
+        for (k = 0; k < 3; k++)
+            d[k] = centre[k] - set.boxCentre[k][index];
+        for (k = 0; k < 3; k++)
+        {
+            local[k] = set.boxAxis[k][0][index] * d[0] + set.boxAxis[k][1][index] * d[1] +
+                       set.boxAxis[k][2][index] * d[2];
+            q[k] = fabs(local[k]) - set.boxHalf[k][index];
+            if (q[k] > 0)
+                outside += q[k] * q[k];
+            if (q[k] > q[deepest])
+                deepest = k;
+        }
+        outside = sqrt(outside);
+
+        //outside: from the nearest point of the box; inside: out of the
+        // nearest side
+        double n[3] = { 0, 0, 0 };
+        if (outside > 1e-9)
+        {
+            for (k = 0; k < 3; k++)
+                n[k] = (q[k] > 0) ? ((local[k] < 0) ? -q[k] : q[k]) / outside : 0;
+            contact.distance = outside;
+        }
+        else
+        {
+            n[deepest] = (local[deepest] < 0) ? -1 : 1;
+            contact.distance = q[deepest];
+        }
+        for (int c = 0; c < 3; c++)
+            contact.normal[c] = n[0] * set.boxAxis[0][c][index] + n[1] * set.boxAxis[1][c][index] +
+                                n[2] * set.boxAxis[2][c][index];
+    }
+    else
+    {
+        //out of the nearest face
+        int end = set.polytopeFirst[index] + set.polytopeFaces[index];
+        contact.distance = -DBL_MAX;
+        for (int f = set.polytopeFirst[index]; f < end; f++)
+        {
+            double s = set.faceNormal[0][f] * centre[0] + set.faceNormal[1][f] * centre[1] +
+                       set.faceNormal[2][f] * centre[2] - set.faceOffset[f];
+            if (s <= contact.distance)
+                continue;
+            contact.distance = s;
+            for (k = 0; k < 3; k++)
+                contact.normal[k] = set.faceNormal[k][f];
+        }
+    }
+}//END of constraintMakeContact
+
+
+//--------------------------------------------------------
+// The whole set
+//--------------------------------------------------------
+
+//This function adds a contact to "contacts" if there is room.
+//Returns the new number of contacts.
+inline int constraintAddContact(const ConstraintSet& set, int kind, int index, const double centre[3],
+                                ConstraintContact contacts[], int found, int maxContacts)
+{
+    if (found == maxContacts)
+        return found;
+    constraintMakeContact(set, kind, index, centre, contacts[found]);
+    return found + 1;
+}
+
+
+//This function finds the constraints a sphere touches, one by one:
+// planes first, then boxes, then polytopes, each in order, "maxContacts"
+// at most.
+//Returns the number of contacts.
+inline int constraintContactsScalar(const ConstraintSet& set, const double centre[3], double radius,
+                                    ConstraintContact contacts[], int maxContacts)
+{
+    float p[3] = { (float)centre[0], (float)centre[1], (float)centre[2] };
+    float r = (float)radius;
+    int i, found = 0;
+    for (i = 0; i < set.planeCount; i++)
+        if (constraintPlaneDistance(set, i, p) <= r)
+            found = constraintAddContact(set, CONSTRAINT_PLANE, i, centre, contacts, found, maxContacts);
+    for (i = 0; i < set.boxCount; i++)
+        if (constraintBoxDistance(set, i, p) <= r)
+            found = constraintAddContact(set, CONSTRAINT_BOX, i, centre, contacts, found, maxContacts);
+    for (i = 0; i < set.polytopeCount; i++)
+        if (constraintPolytopeDistance(set, i, p) <= r)
+            found = constraintAddContact(set, CONSTRAINT_POLYTOPE, i, centre, contacts, found, maxContacts);
+    return found;
+}//END of constraintContactsScalar
+
+
+#ifdef CONSTRAINT_SET_SSE
+//This procedure adds the contacts of the lanes set in "touching" (bits of
+// _mm_movemask_ps), constraints "first" to "first"+3.
+inline int constraintAddLanes(const ConstraintSet& set, int kind, int first, int touching,
+                              const double centre[3], ConstraintContact contacts[], int found,
+                              int maxContacts)
+{
+    for (int lane = 0; touching != 0; lane++, touching >>= 1)
+        if (touching & 1)
+            found = constraintAddContact(set, kind, first + lane, centre, contacts, found, maxContacts);
+    return found;
+}
+
+
+//This function gives the largest of the four floats of "x".
+inline float constraintMax4(__m128 x)
+{
+    x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 0, 3, 2)));
+    x = _mm_max_ps(x, _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(x);
+}
+#endif
+
+
+//This function finds the constraints a sphere touches, as
+// constraintContactsScalar() does, four at a time with SSE.
+//Returns the number of contacts.
+inline int constraintContacts(const ConstraintSet& set, const double centre[3], double radius,
+                              ConstraintContact contacts[], int maxContacts)
+{
+#ifdef CONSTRAINT_SET_SSE
+    int found = 0;
+    const __m128 px = _mm_set1_ps((float)centre[0]);
+    const __m128 py = _mm_set1_ps((float)centre[1]);
+    const __m128 pz = _mm_set1_ps((float)centre[2]);
+    const __m128 r = _mm_set1_ps((float)radius);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    //planes
+    for (int plane = 0; plane < set.planeCount; plane += 4)
+    {
+        __m128 s = _mm_sub_ps(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(set.planeNormal[0] + plane), px),
+                                  _mm_mul_ps(_mm_loadu_ps(set.planeNormal[1] + plane), py)),
+                       _mm_mul_ps(_mm_loadu_ps(set.planeNormal[2] + plane), pz)),
+            _mm_loadu_ps(set.planeOffset + plane));
+        int touching = _mm_movemask_ps(_mm_cmple_ps(s, r));
+        if (touching)
+            found = constraintAddLanes(set, CONSTRAINT_PLANE, plane, touching, centre,
+                                       contacts, found, maxContacts);
+    }
+
+    //boxes: the centre in the axes of each box, then how far out of it
+    for (int box = 0; box < set.boxCount; box += 4)
+    {
+        __m128 dx = _mm_sub_ps(px, _mm_loadu_ps(set.boxCentre[0] + box));
+        __m128 dy = _mm_sub_ps(py, _mm_loadu_ps(set.boxCentre[1] + box));
+        __m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(set.boxCentre[2] + box));
+        __m128 outside = zero, inside = _mm_set1_ps(-FLT_MAX);
+        for (int k = 0; k < 3; k++)
+        {
+            __m128 local = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(set.boxAxis[k][0] + box), dx),
+                                                 _mm_mul_ps(_mm_loadu_ps(set.boxAxis[k][1] + box), dy)),
+                                      _mm_mul_ps(_mm_loadu_ps(set.boxAxis[k][2] + box), dz));
+            __m128 q = _mm_sub_ps(_mm_and_ps(local, absMask), _mm_loadu_ps(set.boxHalf[k] + box));
+            __m128 out = _mm_max_ps(q, zero);
+            outside = _mm_add_ps(outside, _mm_mul_ps(out, out));
+            inside = _mm_max_ps(inside, q);
+        }
+        __m128 s = _mm_add_ps(_mm_sqrt_ps(outside), _mm_min_ps(inside, zero));
+        int touching = _mm_movemask_ps(_mm_cmple_ps(s, r));
+        if (touching)
+            found = constraintAddLanes(set, CONSTRAINT_BOX, box, touching, centre,
+                                       contacts, found, maxContacts);
+    }
+
+    //polytopes: the nearest face plane, four faces at a time
+    for (int polytope = 0; polytope < set.polytopeCount; polytope++)
+    {
+        int f = set.polytopeFirst[polytope];
+        int end = f + set.polytopeFaces[polytope];
+        __m128 largest = _mm_set1_ps(-FLT_MAX);
+        for (; f < end; f += 4)
+            largest = _mm_max_ps(largest, _mm_sub_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(set.faceNormal[0] + f), px),
+                                      _mm_mul_ps(_mm_loadu_ps(set.faceNormal[1] + f), py)),
+                           _mm_mul_ps(_mm_loadu_ps(set.faceNormal[2] + f), pz)),
+                _mm_loadu_ps(set.faceOffset + f)));
+        if (_mm_comile_ss(_mm_set_ss(constraintMax4(largest)), r))
+            found = constraintAddContact(set, CONSTRAINT_POLYTOPE, polytope, centre,
+                                         contacts, found, maxContacts);
+    }
+    return found;
+#else
+    return constraintContactsScalar(set, centre, radius, contacts, maxContacts);
+#endif
+}//END of constraintContacts
+
+
+//This function gives the force of the set on a sphere: every contact
+// pushes along its normal with pushForce, plus stiffness for every mm
+// the sphere is in.
+//Returns the number of contacts.
+inline int constraintForce(const ConstraintSet& set, const double centre[3], double radius, double force[3])
+{
+    ConstraintContact contacts[CONSTRAINT_MAX_CONTACTS];
+    int found = constraintContacts(set, centre, radius, contacts, CONSTRAINT_MAX_CONTACTS);
+    force[0] = force[1] = force[2] = 0;
+    for (int i = 0; i < found; i++)
+    {
+        double depth = radius - contacts[i].distance;
+        double push = set.pushForce + set.stiffness * ((depth > 0) ? depth : 0);
+        for (int k = 0; k < 3; k++)
+            force[k] += push * contacts[i].normal[k];
+    }
+    return found;
+}//END of constraintForce
+
+#endif //CONSTRAINT_SET_H
@@ -0,0 +1,312 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: DeviceStateShm.h
+
+Description:
+
+  Publishes the device state (stylus pose, joint/gimbal angles, buttons
+  and the force sent) from the servo callback into a named shared-memory
+  ring buffer, so that other processes (loggers, dashboards, analysis
+  tools) can follow it live without ever talking to the servo thread.
+
+  The servo callback is the only writer and never waits: each record
+  goes into the next slot of the ring, guarded by a per-slot sequence
+  number (a "seqlock").  The sequence is odd while the slot is being
+  written and 2*(n+1) once record n is complete, so a reader copies the
+  slot and keeps the copy only if the sequence was the expected even
+  value both before and after.  Readers never write to the shared
+  memory, so any number of them can attach and detach at any time.
+
+  This header is plain C so external tools can use it as the reader
+  library (link with -lrt on older Linux systems):
+
+      DeviceStateMapping mapping;
+      DeviceStateRecord record;
+      unsigned int cursor;
+      if (deviceStateOpen(&mapping) == 0)
+      {
+          cursor = deviceStateCursor(mapping.shm);
+          for (;;)
+          {
+              int got = deviceStateReadNext(mapping.shm, &cursor, &record);
+              if (got > 0)       ...record...      (every record, in order)
+              else if (got < 0)  ...fell behind, records were lost...
+              else               ...nothing new, sleep a little...
+          }
+          deviceStateClose(&mapping);
+      }
+
+  deviceStateReadLatest() returns only the newest record (for displays).
+
+******************************************************************************/
+#ifndef DEVICE_STATE_SHM_H
+#define DEVICE_STATE_SHM_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#define DEVICE_STATE_SHM_NAME   "Local\\ENSC488DeviceState"
+#else
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200112L     /* ftruncate, shm_open under -std=c99 */
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define DEVICE_STATE_SHM_NAME   "/ensc488_device_state"
+#endif
+
+#include <string.h>
+
+#if defined(_MSC_VER)
+#define DEVICE_STATE_INLINE static __inline     /* MSVC compiles C as C89 */
+#elif defined(__GNUC__)
+#define DEVICE_STATE_INLINE static __inline__
+#else
+#define DEVICE_STATE_INLINE static inline
+#endif
+
+#define DEVICE_STATE_MAGIC      0x45534D48u     /* marks an initialized buffer */
+#define DEVICE_STATE_VERSION    1u              /* bumped when the layout changes */
+#define DEVICE_STATE_SLOTS      1024u           /* ring size, about 1 s at 1 kHz (power of 2) */
+#define DEVICE_STATE_RETRIES    4               /* attempts to read a slot being rewritten */
+
+/* one sample of the device, as seen by the servo callback */
+typedef struct DeviceStateRecord
+{
+    double time;                /* servo clock (s), see ServoClock.h */
+    double position[3];         /* stylus tip position (mm) */
+    double transform[16];       /* stylus tip transformation (column-major) */
+    double jointAngles[3];      /* angles of the device joints (radians) */
+    double gimbalAngles[3];     /* angles of the device gimbals (radians) */
+    double force[3];            /* force sent to the device (N) */
+    int buttons;                /* button bits, as HD_CURRENT_BUTTONS */
+    int reserved;
+} DeviceStateRecord;
+
+typedef struct DeviceStateSlot
+{
+    volatile unsigned int sequence;     /* odd: being written; 2*(n+1): holds record n */
+    unsigned int reserved;
+    DeviceStateRecord record;
+} DeviceStateSlot;
+
+/* the layout of the shared memory */
+typedef struct DeviceStateShm
+{
+    volatile unsigned int magic;        /* DEVICE_STATE_MAGIC once initialized */
+    unsigned int version;
+    unsigned int slotCount;
+    unsigned int recordSize;
+    volatile unsigned int published;    /* number of records published so far */
+    unsigned int reserved[3];
+    DeviceStateSlot slots[DEVICE_STATE_SLOTS];
+} DeviceStateShm;
+
+/* a mapped view of the shared memory */
+typedef struct DeviceStateMapping
+{
+    DeviceStateShm* shm;
+    int isWriter;
+#ifdef _WIN32
+    HANDLE handle;
+#endif
+} DeviceStateMapping;
+
+
+/* Full memory barrier (the readers may be compiled as C, so this doesn't
+   use ServoAtomic.h). */
+DEVICE_STATE_INLINE void deviceStateBarrier(void)
+{
+#ifdef _WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+
+/* This procedure unmaps the shared memory.  The writer also removes the
+   name, so a new publisher starts from a fresh buffer. */
+DEVICE_STATE_INLINE void deviceStateClose(DeviceStateMapping* mapping)
+{
+    if (mapping->shm == NULL)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(mapping->shm);
+    CloseHandle(mapping->handle);
+#else
+    munmap(mapping->shm, sizeof(DeviceStateShm));
+    if (mapping->isWriter)
+        shm_unlink(DEVICE_STATE_SHM_NAME);
+#endif
+    mapping->shm = NULL;
+}
+
+
+/* This function maps the shared memory; "isWriter" creates it (servo side)
+   while readers open it read-only.  Returns 0 on success, -1 if it can't
+   be created or if no (compatible) publisher is running. */
+DEVICE_STATE_INLINE int deviceStateMap(DeviceStateMapping* mapping, int isWriter)
+{
+    DeviceStateShm* shm;
+#ifndef _WIN32
+    int fd;
+    void* view;
+#endif
+    mapping->shm = NULL;
+    mapping->isWriter = isWriter;
+#ifdef _WIN32
+    if (isWriter)
+        mapping->handle = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                             0, sizeof(DeviceStateShm), DEVICE_STATE_SHM_NAME);
+    else
+        mapping->handle = OpenFileMappingA(FILE_MAP_READ, FALSE, DEVICE_STATE_SHM_NAME);
+    if (mapping->handle == NULL)
+        return -1;
+    shm = (DeviceStateShm*)MapViewOfFile(mapping->handle,
+                                         isWriter ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ,
+                                         0, 0, sizeof(DeviceStateShm));
+    if (shm == NULL)
+    {
+        CloseHandle(mapping->handle);
+        return -1;
+    }
+#else
+    fd = isWriter ? shm_open(DEVICE_STATE_SHM_NAME, O_CREAT | O_RDWR, 0644)
+                  : shm_open(DEVICE_STATE_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0)
+        return -1;
+    if (isWriter && ftruncate(fd, sizeof(DeviceStateShm)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    view = mmap(NULL, sizeof(DeviceStateShm), isWriter ? PROT_READ | PROT_WRITE : PROT_READ,
+                MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return -1;
+    shm = (DeviceStateShm*)view;
+#endif
+
+    if (isWriter)
+    {   /* (re)initialize; a reader seeing "published" go back resynchronizes */
+        shm->magic = 0;
+        deviceStateBarrier();
+        shm->version = DEVICE_STATE_VERSION;
+        shm->slotCount = DEVICE_STATE_SLOTS;
+        shm->recordSize = sizeof(DeviceStateRecord);
+        shm->published = 0;
+        memset((void*)shm->slots, 0, sizeof(shm->slots));
+        deviceStateBarrier();
+        shm->magic = DEVICE_STATE_MAGIC;
+    }
+    else if (shm->magic != DEVICE_STATE_MAGIC || shm->version != DEVICE_STATE_VERSION ||
+             shm->slotCount != DEVICE_STATE_SLOTS || shm->recordSize != sizeof(DeviceStateRecord))
+    {
+        mapping->shm = shm;
+        deviceStateClose(mapping);
+        return -1;
+    }
+    mapping->shm = shm;
+    return 0;
+}
+
+
+/* This function opens the shared memory for reading (see the example above). */
+DEVICE_STATE_INLINE int deviceStateOpen(DeviceStateMapping* mapping)
+{
+    return deviceStateMap(mapping, 0);
+}
+
+
+/* This procedure publishes one record (writer only).  It runs in constant
+   time and never waits for the readers. */
+DEVICE_STATE_INLINE void deviceStatePublish(DeviceStateShm* shm, const DeviceStateRecord* record)
+{
+    unsigned int index = shm->published;
+    DeviceStateSlot* slot = &shm->slots[index & (DEVICE_STATE_SLOTS - 1)];
+
+    slot->sequence = 2*index + 1;
+    deviceStateBarrier();
+    slot->record = *record;
+    deviceStateBarrier();
+    slot->sequence = 2*index + 2;
+    shm->published = index + 1;
+}
+
+
+/* This function copies record "index" if it is still in its slot and was
+   not being rewritten while it was copied.  Returns 1 on success. */
+DEVICE_STATE_INLINE int deviceStateReadSlot(const DeviceStateShm* shm, unsigned int index,
+                                            DeviceStateRecord* record)
+{
+    const DeviceStateSlot* slot = &shm->slots[index & (DEVICE_STATE_SLOTS - 1)];
+    unsigned int before = slot->sequence;
+    deviceStateBarrier();
+    if (before != 2*index + 2)
+        return 0;
+    *record = slot->record;
+    deviceStateBarrier();
+    return slot->sequence == before;
+}
+
+
+/* This function returns the cursor that makes deviceStateReadNext() start
+   with the next record published. */
+DEVICE_STATE_INLINE unsigned int deviceStateCursor(const DeviceStateShm* shm)
+{
+    return shm->published;
+}
+
+
+/* This function copies the newest record.  Returns 1 on success, 0 if
+   nothing has been published yet. */
+DEVICE_STATE_INLINE int deviceStateReadLatest(const DeviceStateShm* shm, DeviceStateRecord* record)
+{
+    int attempt;
+    for (attempt = 0; attempt < DEVICE_STATE_RETRIES; attempt++)
+    {
+        unsigned int published = shm->published;
+        deviceStateBarrier();
+        if (published == 0)
+            return 0;
+        if (deviceStateReadSlot(shm, published - 1, record))
+            return 1;
+    }
+    return 0;
+}
+
+
+/* This function copies the record at "cursor" and advances it.  Returns 1
+   on success, 0 if there is no new record yet, and -1 if the reader fell
+   more than a ring behind (or the publisher restarted); the cursor is then
+   moved to the oldest record still available. */
+DEVICE_STATE_INLINE int deviceStateReadNext(const DeviceStateShm* shm, unsigned int* cursor,
+                                            DeviceStateRecord* record)
+{
+    unsigned int published = shm->published;
+    unsigned int behind = published - *cursor;
+    deviceStateBarrier();
+    if (behind == 0)
+        return 0;
+    /* the next slot written drops record "published - DEVICE_STATE_SLOTS" */
+    if (behind < DEVICE_STATE_SLOTS && deviceStateReadSlot(shm, *cursor, record))
+    {
+        (*cursor)++;
+        return 1;
+    }
+    published = shm->published;
+    *cursor = (published > DEVICE_STATE_SLOTS - 1) ? published - (DEVICE_STATE_SLOTS - 1) : 0;
+    return -1;
+}
+
+#endif /* DEVICE_STATE_SHM_H */
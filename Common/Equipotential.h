@@ -0,0 +1,493 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: Equipotential.h
+
+Description:
+
+  Equipotential surfaces of a ChargeSet, extracted with marching cubes on
+  the task pool (TaskPool.h) into per-block meshes that the graphics loop draws with
+  glDrawArrays.
+
+  The potential (ChargeField.h) is sampled on a grid of EQUI_CELLS^3
+  cells covering +-EQUI_EXTENT, split into EQUI_BLOCKS^3 blocks.  Each
+  block keeps its own samples and its own mesh, holding every level
+  (+-isovalue x 1, 2, 4) that crosses it, so a change only costs the
+  blocks it reaches:
+
+  - when charges are added, removed or moved, the change of the
+    potential over each block is bounded from the distances to the
+    charges that changed (the potential is ~1/r).  The bound adds up in
+    "drift", and a block is resampled and extracted again only once its
+    drift passes EQUI_TOLERANCE of the isovalue.  Far away blocks hardly
+    ever are;
+  - when the isovalue changes, only the blocks whose range of samples
+    holds an old or a new level are extracted again (from the samples
+    they already have);
+  - a zoom change scales the whole field, so every block is rebuilt.
+
+  As for the field lines (FieldLineCache.h) the graphics loop calls
+  equiSurfacesUpdate() every frame: it swaps in the blocks of a finished
+  build and starts the next one.  Every block to rebuild is a task of its
+  own, as their cost varies a lot, and writes the back mesh of the block,
+  so the meshes drawn are never written.  The mesh buffers
+  only ever grow, and are reused from one build to the next.
+
+  The marching cubes triangle table is generated at start-up by walking
+  the faces of the cube: on every face the crossing edges are paired so
+  that the corners above the level are cut off one by one, which is the
+  same choice on both sides of a face, so neighbouring cells (and
+  blocks) always meet without cracks.  The normals are the gradient of
+  the trilinear interpolation of the samples.
+
+******************************************************************************/
+#ifndef EQUIPOTENTIAL_H
+#define EQUIPOTENTIAL_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ChargeField.h"
+#include "TaskPool.h"
+
+#define EQUI_EXTENT         150.0   //the grid covers +-EQUI_EXTENT (mm)
+#define EQUI_BLOCK_CELLS    8       //cells along each side of a block
+#define EQUI_BLOCKS         6       //blocks along each axis
+#define EQUI_LEVELS         6       //-4, -2, -1, +1, +2, +4 times the isovalue
+#define EQUI_TOLERANCE      0.05    //potential drift allowed in a block (fraction of the isovalue)
+#define EQUI_FLOATS         10      //floats per vertex (GL_C4F_N3F_V3F)
+
+#define EQUI_CELLS          (EQUI_BLOCKS * EQUI_BLOCK_CELLS)
+#define EQUI_SPACING        (2 * EQUI_EXTENT / EQUI_CELLS)
+#define EQUI_NUM_BLOCKS     (EQUI_BLOCKS * EQUI_BLOCKS * EQUI_BLOCKS)
+#define EQUI_BLOCK_POINTS   (EQUI_BLOCK_CELLS + 1)
+#define EQUI_BLOCK_SAMPLES  (EQUI_BLOCK_POINTS * EQUI_BLOCK_POINTS * EQUI_BLOCK_POINTS)
+
+//triangles of one block, ready for glInterleavedArrays(GL_C4F_N3F_V3F)
+struct EquiMesh
+{
+    float* vertices;
+    long count;             //vertices written
+    long capacity;          //vertices allocated
+};
+
+struct EquiBlock
+{
+    float samples[EQUI_BLOCK_SAMPLES];  //potential at the grid points
+    float minimum, maximum;             //range of the samples
+    double drift;           //bound on the change of the potential since sampled
+    bool resample;          //the build in progress samples the block again
+    EquiMesh meshes[2];
+    int front;              //mesh drawn
+};
+
+struct EquiSurfaces;
+
+//what the task rebuilding a block is given
+struct EquiBlockTask
+{
+    EquiSurfaces* surfaces;
+    int index;
+};
+
+struct EquiSurfaces
+{
+    EquiBlock* blocks;
+    long dirty[EQUI_NUM_BLOCKS];    //blocks rebuilt by the build in progress
+    long dirtyCount;
+    bool hasBuild;                  //every block has a front mesh
+    bool building;
+
+    //the build being run (written by the graphics loop only between builds)
+    ChargeSet charges;
+    double zoom;
+    double isovalue;
+    long builtVersion;              //charges.version of the last build started
+
+    TaskPool* pool;                 //NULL until started
+    TaskFuture build;
+    EquiBlockTask tasks[EQUI_NUM_BLOCKS];
+};
+
+
+//--------------------------------------------------------
+// *** Marching cubes table ***
+//--------------------------------------------------------
+
+//corners of a cell (x, y, z offsets)
+static const int equiCorner[8][3] =
+    { {0,0,0}, {1,0,0}, {1,1,0}, {0,1,0}, {0,0,1}, {1,0,1}, {1,1,1}, {0,1,1} };
+//edges of a cell (pairs of corners)
+static const int equiEdge[12][2] =
+    { {0,1}, {1,2}, {2,3}, {3,0}, {4,5}, {5,6}, {6,7}, {7,4}, {0,4}, {1,5}, {2,6}, {3,7} };
+//faces of a cell, corners counter-clockwise seen from outside
+static const int equiFace[6][4] =
+    { {0,3,2,1}, {4,5,6,7}, {0,1,5,4}, {3,7,6,2}, {0,4,7,3}, {1,2,6,5} };
+
+//edges of the triangles of each case (bit k set: corner k above the
+// level), -1 terminated
+static signed char equiTriangles[256][16];
+
+
+//This function returns the edge joining two corners.
+inline int equiEdgeBetween(int a, int b)
+{
+    for (int e = 0; e < 12; e++)
+        if ((equiEdge[e][0] == a && equiEdge[e][1] == b) ||
+            (equiEdge[e][0] == b && equiEdge[e][1] == a))
+            return e;
+    return -1;
+}
+
+
+//This procedure fills in equiTriangles (once).
+inline void equiTablesInit()
+{
+    static bool done = false;
+    if (done)
+        return;
+    for (int c = 0; c < 256; c++)
+    {
+        //on each face, every edge leaving the corners above the level is
+        // joined to the edge entering the run of them before it; these
+        // segments chain into closed loops around the cell
+        int next[12];
+        int e, f, k;
+        for (e = 0; e < 12; e++)
+            next[e] = -1;
+        for (f = 0; f < 6; f++)
+            for (k = 0; k < 4; k++)
+            {
+                int a = equiFace[f][k], b = equiFace[f][(k + 1) % 4];
+                if (!(c & (1 << a)) || (c & (1 << b)))
+                    continue;
+                int j = k;
+                while (c & (1 << equiFace[f][j]))
+                    j = (j + 3) % 4;
+                next[equiEdgeBetween(a, b)] = equiEdgeBetween(equiFace[f][j], equiFace[f][(j + 1) % 4]);
+            }
+
+        //each loop becomes a fan of triangles
+        bool visited[12] = { false };
+        int n = 0;
+        for (e = 0; e < 12; e++)
+        {
+            if (next[e] < 0 || visited[e])
+                continue;
+            int loop[12], length = 0;
+            for (int x = e; !visited[x]; x = next[x])
+            {
+                visited[x] = true;
+                loop[length++] = x;
+            }
+            for (k = 1; k + 1 < length && n + 3 < 16; k++)
+            {
+                equiTriangles[c][n++] = (signed char)loop[0];
+                equiTriangles[c][n++] = (signed char)loop[k];
+                equiTriangles[c][n++] = (signed char)loop[k + 1];
+            }
+        }
+        while (n < 16)
+            equiTriangles[c][n++] = -1;
+    }
+    done = true;
+}//END of equiTablesInit
+
+
+//--------------------------------------------------------
+// *** Blocks ***
+//--------------------------------------------------------
+
+//This function returns level "index" for the isovalue.
+inline double equiLevel(double isovalue, int index)
+{
+    double level = isovalue * (1 << (index % 3));
+    return (index < 3) ? -level : level;
+}
+
+
+//This procedure gives the corner of block "index" with the lowest
+// coordinates (mm).
+inline void equiBlockOrigin(int index, double origin[3])
+{
+    const double size = EQUI_BLOCK_CELLS * EQUI_SPACING;
+    origin[0] = -EQUI_EXTENT + size * (index % EQUI_BLOCKS);
+    origin[1] = -EQUI_EXTENT + size * ((index / EQUI_BLOCKS) % EQUI_BLOCKS);
+    origin[2] = -EQUI_EXTENT + size * (index / (EQUI_BLOCKS * EQUI_BLOCKS));
+}
+
+
+//This function returns the distance from a point to block "index".
+inline double equiBlockDistance(int index, const double p[3])
+{
+    const double size = EQUI_BLOCK_CELLS * EQUI_SPACING;
+    double origin[3], sqrDist = 0;
+    equiBlockOrigin(index, origin);
+    for (int i = 0; i < 3; i++)
+    {
+        double d = 0;
+        if (p[i] < origin[i])
+            d = origin[i] - p[i];
+        else if (p[i] > origin[i] + size)
+            d = p[i] - origin[i] - size;
+        sqrDist += d*d;
+    }
+    return sqrt(sqrDist);
+}
+
+
+//This function bounds how much the potential over block "index" changes
+// from charge set "before" to "after".
+inline double equiDriftBound(const ChargeSet& before, const ChargeSet& after, double zoom, int index)
+{
+    double scale = (zoom >= 1) ? 1.0 / zoom : 1.0;
+    double contact = before.radius + zoom * before.radius;
+    long count = (before.count > after.count) ? before.count : after.count;
+    double bound = 0;
+    for (long k = 0; k < count; k++)
+    {
+        double qa = (k < before.count) ? before.charges[k].strength : 0;
+        double qb = (k < after.count) ? after.charges[k].strength : 0;
+        const double* a = before.charges[k].position;
+        const double* b = after.charges[k].position;
+        if (qa == qb && a[0] == b[0] && a[1] == b[1] && a[2] == b[2])
+            continue;
+        //(inside the contact radius the potential is flatter than 1/r)
+        double da = equiBlockDistance(index, a), db = equiBlockDistance(index, b);
+        if (da < contact) da = contact;
+        if (db < contact) db = contact;
+        if (qa == 0 || qb == 0)
+            bound += fabs(qa) / da + fabs(qb) / db;
+        else
+        {   //|qb/rb - qa/ra| <= |qb - qa|/rb + |qa| |a - b|/(ra rb)
+            double move = sqrt((a[0]-b[0])*(a[0]-b[0]) + (a[1]-b[1])*(a[1]-b[1]) + (a[2]-b[2])*(a[2]-b[2]));
+            bound += fabs(qb - qa) / db + fabs(qa) * move / (da * db);
+        }
+    }
+    return CHARGE_FORCE_GAIN * scale * bound;
+}//END of equiDriftBound
+
+
+//This function makes room for "extra" more vertices.  Returns false if
+// the memory has run out.
+inline bool equiMeshReserve(EquiMesh& mesh, long extra)
+{
+    if (mesh.count + extra <= mesh.capacity)
+        return true;
+    long capacity = (mesh.capacity > 0) ? 2 * mesh.capacity : 3072;
+    while (capacity < mesh.count + extra)
+        capacity *= 2;
+    float* vertices = (float*)realloc(mesh.vertices, sizeof(float) * EQUI_FLOATS * capacity);
+    if (vertices == NULL)
+        return false;
+    mesh.vertices = vertices;
+    mesh.capacity = capacity;
+    return true;
+}
+
+
+//This procedure rebuilds block "index" into its back mesh, sampling the
+// potential first if block.resample is set.
+inline void equiBuildBlock(const ChargeSet& charges, double zoom, double isovalue,
+                           int index, EquiBlock& block)
+{
+    const int n = EQUI_BLOCK_POINTS;
+    double origin[3];
+    int x, y, z, i;
+    equiBlockOrigin(index, origin);
+
+    if (block.resample)
+    {
+        float minimum = 1e30f, maximum = -1e30f;
+        for (z = 0; z < n; z++)
+            for (y = 0; y < n; y++)
+                for (x = 0; x < n; x++)
+                {
+                    double p[3] = { origin[0] + x*EQUI_SPACING, origin[1] + y*EQUI_SPACING,
+                                    origin[2] + z*EQUI_SPACING };
+                    float u = (float)chargeFieldPotential(charges, zoom, p);
+                    block.samples[x + n*(y + n*z)] = u;
+                    if (u < minimum) minimum = u;
+                    if (u > maximum) maximum = u;
+                }
+        block.minimum = minimum;
+        block.maximum = maximum;
+    }
+
+    EquiMesh& mesh = block.meshes[1 - block.front];
+    mesh.count = 0;
+    for (int l = 0; l < EQUI_LEVELS; l++)
+    {
+        double level = equiLevel(isovalue, l);
+        if (level < block.minimum || level > block.maximum)
+            continue;
+        //attracting (negative potential) levels red, repelling ones blue,
+        // the closer to the charges the more opaque
+        float colour[4] = { (level < 0) ? 0.9f : 0.2f, 0.4f, (level < 0) ? 0.2f : 0.9f,
+                            0.15f + 0.1f * (l % 3) };
+
+        for (z = 0; z < EQUI_BLOCK_CELLS; z++)
+            for (y = 0; y < EQUI_BLOCK_CELLS; y++)
+                for (x = 0; x < EQUI_BLOCK_CELLS; x++)
+                {
+                    double value[8];
+                    int c = 0;
+                    for (i = 0; i < 8; i++)
+                    {
+                        value[i] = block.samples[(x + equiCorner[i][0]) +
+                                                 n*((y + equiCorner[i][1]) + n*(z + equiCorner[i][2]))];
+                        if (value[i] > level)
+                            c |= 1 << i;
+                    }
+                    const signed char* triangles = equiTriangles[c];
+                    if (triangles[0] < 0)
+                        continue;
+                    if (!equiMeshReserve(mesh, 15))
+                        return;     //out of memory: keep what fits
+
+                    for (int t = 0; triangles[t] >= 0; t++)
+                    {
+                        //the crossing on the edge, and the gradient of the
+                        // trilinear interpolation there
+                        const int* edge = equiEdge[triangles[t]];
+                        double s = (level - value[edge[0]]) / (value[edge[1]] - value[edge[0]]);
+                        double local[3], gradient[3] = { 0, 0, 0 };
+                        for (i = 0; i < 3; i++)
+                            local[i] = equiCorner[edge[0]][i] +
+                                       s * (equiCorner[edge[1]][i] - equiCorner[edge[0]][i]);
+                        for (int k = 0; k < 8; k++)
+                        {
+                            double w[3], d[3];
+                            for (i = 0; i < 3; i++)
+                            {
+                                w[i] = equiCorner[k][i] ? local[i] : 1 - local[i];
+                                d[i] = equiCorner[k][i] ? 1.0 : -1.0;
+                            }
+                            gradient[0] += value[k] * d[0] * w[1] * w[2];
+                            gradient[1] += value[k] * w[0] * d[1] * w[2];
+                            gradient[2] += value[k] * w[0] * w[1] * d[2];
+                        }
+
+                        float* v = mesh.vertices + EQUI_FLOATS * mesh.count++;
+                        for (i = 0; i < 4; i++)
+                            v[i] = colour[i];
+                        v[4] = (float)gradient[0];
+                        v[5] = (float)gradient[1];
+                        v[6] = (float)gradient[2];
+                        v[7] = (float)(origin[0] + (x + local[0]) * EQUI_SPACING);
+                        v[8] = (float)(origin[1] + (y + local[1]) * EQUI_SPACING);
+                        v[9] = (float)(origin[2] + (z + local[2]) * EQUI_SPACING);
+                    }
+                }
+    }
+}//END of equiBuildBlock
+
+
+//--------------------------------------------------------
+// *** Builds ***
+//--------------------------------------------------------
+
+//This procedure is the task rebuilding one block.
+inline void equiBlockTask(void* data)
+{
+    EquiBlockTask* task = static_cast<EquiBlockTask*>(data);
+    EquiSurfaces& surfaces = *task->surfaces;
+    equiBuildBlock(surfaces.charges, surfaces.zoom, surfaces.isovalue,
+                   task->index, surfaces.blocks[task->index]);
+}
+
+
+//This function allocates the blocks; the builds will run on "pool".
+// Returns false (and leaves the surfaces unusable) on failure.
+inline bool equiSurfacesStart(EquiSurfaces& surfaces, TaskPool& pool)
+{
+    equiTablesInit();
+    memset(&surfaces, 0, sizeof(surfaces));
+    surfaces.blocks = (EquiBlock*)calloc(EQUI_NUM_BLOCKS, sizeof(EquiBlock));
+    if (surfaces.blocks == NULL)
+        return false;
+    for (int b = 0; b < EQUI_NUM_BLOCKS; b++)
+    {
+        surfaces.tasks[b].surfaces = &surfaces;
+        surfaces.tasks[b].index = b;
+    }
+    surfaces.pool = &pool;
+    return true;
+}//END of equiSurfacesStart
+
+
+//This procedure waits for the build in progress (at exit).
+inline void equiSurfacesStop(EquiSurfaces& surfaces)
+{
+    if (surfaces.pool == NULL)
+        return;
+    taskFutureWait(*surfaces.pool, surfaces.build);
+    surfaces.pool = NULL;
+}
+
+
+//This function is called by the graphics loop once per frame.  It swaps
+// in the blocks of a finished build and starts rebuilding the blocks that
+// a change of the charges, the zoom or the isovalue has reached.  Returns
+// true once there is something to draw.
+inline bool equiSurfacesUpdate(EquiSurfaces& surfaces, const ChargeSet& charges,
+                               double zoom, double isovalue)
+{
+    if (surfaces.pool == NULL)
+        return false;
+    long k;
+    if (surfaces.building)
+    {
+        if (!taskFutureReady(surfaces.build))
+            return surfaces.hasBuild;
+        for (k = 0; k < surfaces.dirtyCount; k++)
+        {
+            EquiBlock& block = surfaces.blocks[surfaces.dirty[k]];
+            block.front = 1 - block.front;
+        }
+        surfaces.hasBuild = true;
+        surfaces.building = false;
+    }
+    bool everything = !surfaces.hasBuild || zoom != surfaces.zoom;
+    if (!everything && charges.version == surfaces.builtVersion && isovalue == surfaces.isovalue)
+        return true;
+
+    surfaces.dirtyCount = 0;
+    for (int b = 0; b < EQUI_NUM_BLOCKS; b++)
+    {
+        EquiBlock& block = surfaces.blocks[b];
+        block.resample = everything;
+        if (!everything)
+        {
+            block.drift += equiDriftBound(surfaces.charges, charges, zoom, b);
+            block.resample = block.drift > EQUI_TOLERANCE * isovalue;
+        }
+        bool extract = block.resample;
+        for (int l = 0; l < EQUI_LEVELS && !extract && isovalue != surfaces.isovalue; l++)
+        {
+            double before = equiLevel(surfaces.isovalue, l), after = equiLevel(isovalue, l);
+            extract = (before >= block.minimum - block.drift && before <= block.maximum + block.drift) ||
+                      (after >= block.minimum - block.drift && after <= block.maximum + block.drift);
+        }
+        if (block.resample)
+            block.drift = 0;
+        if (extract)
+            surfaces.dirty[surfaces.dirtyCount++] = b;
+    }
+
+    surfaces.charges = charges;
+    surfaces.zoom = zoom;
+    surfaces.isovalue = isovalue;
+    surfaces.builtVersion = charges.version;
+    if (surfaces.dirtyCount > 0)
+    {
+        surfaces.building = true;
+        taskFutureReset(surfaces.build);
+        for (k = 0; k < surfaces.dirtyCount; k++)
+            taskSubmit(*surfaces.pool, equiBlockTask, &surfaces.tasks[surfaces.dirty[k]],
+                       TASK_PRIORITY_NORMAL, &surfaces.build);
+    }
+    return surfaces.hasBuild;
+}//END of equiSurfacesUpdate
+
+#endif //EQUIPOTENTIAL_H
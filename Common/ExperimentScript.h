@@ -0,0 +1,190 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ExperimentScript.h
+
+Description:
+
+  Timed experiment protocols (show a scene, wait for a stylus button,
+  move a charge, record for 10 s, repeat...) written as one straight
+  function, but run a step at a time from the GLUT idle loop: no thread,
+  and nothing added to the servo callback.
+
+  A script is a function that can suspend itself on one of these waits
+  and is resumed where it stopped once the wait is over:
+
+      SCRIPT_NEXT_FRAME(s)                  the next frame
+      SCRIPT_WAIT_FRAMES(s, n)              n frames
+      SCRIPT_WAIT_TICKS(s, n)               n servo ticks
+      SCRIPT_WAIT_SECONDS(s, t)             t seconds
+      SCRIPT_WAIT_BUTTON(s, mask, timeout)  a press (rising edge) of a
+                                            button in "mask"; s.timedOut
+                                            tells if "timeout" s (0: none)
+                                            passed first
+
+  between SCRIPT_BEGIN(s) and SCRIPT_END(s).  The idle loop calls
+  scriptResume() with the current frame count, servo tick count, time
+  and buttons; while the wait isn't over that is a few comparisons, and
+  the script function isn't even called.
+
+  C++20 coroutines would keep the local variables across the waits;
+  Visual Studio 2010 has none, so this is the "protothread" technique: a
+  switch on the resume point, whose case labels the wait macros place
+  after their "return".  Hence:
+
+  - local variables are NOT kept across a wait: keep the state of the
+    protocol in the structure passed as "data";
+  - the script must not use "switch" statements of its own around a
+    wait (loops and ifs are fine), nor declare initialized variables in
+    a block that holds a wait (the resume jumps over them);
+  - the resume points are numbered with __COUNTER__ (not __LINE__, which
+    isn't a constant with Visual Studio's Edit and Continue).
+
+******************************************************************************/
+#ifndef EXPERIMENT_SCRIPT_H
+#define EXPERIMENT_SCRIPT_H
+
+#include <string.h>
+
+enum ScriptWait
+{
+    SCRIPT_WAIT_NONE = 0,
+    SCRIPT_WAIT_FRAME,
+    SCRIPT_WAIT_TICK,
+    SCRIPT_WAIT_TIME,
+    SCRIPT_WAIT_PRESS
+};
+
+//what the idle loop resumes a script with
+struct ScriptInputs
+{
+    double now;             //(s, ServoClock.h)
+    long frame;             //frames drawn
+    long servoTicks;        //servo ticks run
+    int buttons;            //stylus buttons held (HD_CURRENT_BUTTONS)
+};
+
+struct Script;
+typedef void (*ScriptProc)(Script& script, void* data);
+
+struct Script
+{
+    ScriptProc proc;        //NULL when no script is running
+    void* data;
+    int resume;             //resume point (0: the start)
+    bool finished;
+
+    //the wait in progress
+    int wait;               //ScriptWait
+    long untilCount;        //frame or tick count waited for
+    double untilTime;       //time waited for (or timeout of a button wait, 0: none)
+    int buttonMask;
+    int lastButtons;        //buttons at the previous resume (edge detection)
+    bool timedOut;          //the last button wait timed out
+
+    ScriptInputs in;        //the inputs it was last resumed with
+    double started;         //when it started (s)
+};
+
+
+//--------------------------------------------------------
+// *** The script macros ***
+//--------------------------------------------------------
+
+#define SCRIPT_BEGIN(s)         switch ((s).resume) { case 0:
+#define SCRIPT_END(s)           } (s).finished = true; return
+
+//suspends at a new resume point (n: its number)
+#define SCRIPT_SUSPEND_AT(s, n) (s).resume = (n); return; case (n):
+#define SCRIPT_SUSPEND(s)       SCRIPT_SUSPEND_AT(s, __COUNTER__ + 1)
+
+#define SCRIPT_NEXT_FRAME(s)                    SCRIPT_WAIT_FRAMES(s, 1)
+#define SCRIPT_WAIT_FRAMES(s, n)                do { scriptWaitCount(s, SCRIPT_WAIT_FRAME, (s).in.frame + (n)); SCRIPT_SUSPEND(s); } while (0)
+#define SCRIPT_WAIT_TICKS(s, n)                 do { scriptWaitCount(s, SCRIPT_WAIT_TICK, (s).in.servoTicks + (n)); SCRIPT_SUSPEND(s); } while (0)
+#define SCRIPT_WAIT_SECONDS(s, t)               do { scriptWaitTime(s, (s).in.now + (t)); SCRIPT_SUSPEND(s); } while (0)
+#define SCRIPT_WAIT_BUTTON(s, mask, timeout)    do { scriptWaitButton(s, mask, timeout); SCRIPT_SUSPEND(s); } while (0)
+
+
+inline void scriptWaitCount(Script& script, int wait, long until)
+{
+    script.wait = wait;
+    script.untilCount = until;
+}
+
+inline void scriptWaitTime(Script& script, double until)
+{
+    script.wait = SCRIPT_WAIT_TIME;
+    script.untilTime = until;
+}
+
+inline void scriptWaitButton(Script& script, int mask, double timeout)
+{
+    script.wait = SCRIPT_WAIT_PRESS;
+    script.buttonMask = mask;
+    script.untilTime = (timeout > 0) ? script.in.now + timeout : 0;
+    script.timedOut = false;
+}
+
+
+//--------------------------------------------------------
+// *** Running scripts ***
+//--------------------------------------------------------
+
+//This procedure starts "proc(data)"; it first runs at the next resume.
+inline void scriptStart(Script& script, ScriptProc proc, void* data)
+{
+    memset(&script, 0, sizeof(script));
+    script.proc = proc;
+    script.data = data;
+}
+
+
+//This function tells whether the wait of a script is over.
+inline bool scriptWaitOver(Script& script, const ScriptInputs& in)
+{
+    switch (script.wait)
+    {
+        case SCRIPT_WAIT_FRAME:
+            return in.frame >= script.untilCount;
+        case SCRIPT_WAIT_TICK:
+            return in.servoTicks >= script.untilCount;
+        case SCRIPT_WAIT_TIME:
+            return in.now >= script.untilTime;
+        case SCRIPT_WAIT_PRESS:
+            if (in.buttons & ~script.lastButtons & script.buttonMask)
+                return true;
+            script.timedOut = script.untilTime > 0 && in.now >= script.untilTime;
+            return script.timedOut;
+    }
+    return true;
+}//END of scriptWaitOver
+
+
+//This function runs the script up to its next wait, if the current one
+// is over (GLUT idle loop).  Returns false once it has finished (or when
+// none was started).
+inline bool scriptResume(Script& script, const ScriptInputs& in)
+{
+    if (script.proc == NULL || script.finished)
+        return false;
+    bool over = scriptWaitOver(script, in);
+    script.lastButtons = in.buttons;
+    if (!over)
+        return true;
+
+    if (script.resume == 0)
+        script.started = in.now;
+    script.in = in;
+    script.wait = SCRIPT_WAIT_NONE;
+    script.proc(script, script.data);
+    return !script.finished;
+}//END of scriptResume
+
+
+//This procedure stops a script where it is.
+inline void scriptStop(Script& script)
+{
+    script.finished = true;
+}
+
+#endif //EXPERIMENT_SCRIPT_H
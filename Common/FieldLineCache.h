@@ -0,0 +1,328 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: FieldLineCache.h
+
+Description:
+
+  Field lines (streamlines traced from every charge) and a 3D grid of
+  direction glyphs for a ChargeSet, computed on the task pool
+  (TaskPool.h) into cached vertex/colour arrays that the graphics loop draws with
+  glDrawArrays.
+
+  Tracing a few hundred streamlines takes far longer than a frame, so:
+
+  - the graphics loop calls fieldLineCacheUpdate() every frame.  When the
+    charge set or the zoom has changed since the last build (and no
+    build is running) it submits a build of a copy of them;
+  - the build is split in FIELD_TASKS tasks that share the seeds and the
+    glyph grid, each writing its own part of the back buffer;
+  - once the future of the build is ready, at the next update the back
+    buffer becomes the one drawn.
+
+  Until then the last completed build keeps being drawn, so the frame
+  rate doesn't depend on the cost of the field.  Only the graphics loop
+  starts builds and swaps buffers, so two buffers are enough: a build
+  never writes the buffer being drawn.
+
+  The arrays are plain client-side vertex arrays (OpenGL 1.1), as the
+  Windows OpenGL headers don't declare buffer objects without an
+  extension loader.
+
+******************************************************************************/
+#ifndef FIELD_LINE_CACHE_H
+#define FIELD_LINE_CACHE_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ChargeField.h"
+#include "TaskPool.h"
+
+#define FIELD_TASKS             6       //tasks a build is split in
+#define FIELD_SEEDS_PER_CHARGE  12      //streamlines started around each charge
+#define FIELD_LINE_STEPS        120     //most steps along one streamline
+#define FIELD_LINE_STEP         2.0     //streamline step (mm)
+#define FIELD_EXTENT            150.0   //streamlines stop outside this box (+-mm)
+#define FIELD_GLYPH_GRID        9       //glyphs along each axis
+#define FIELD_GLYPH_LENGTH      10.0    //glyph length (mm)
+
+#define FIELD_MAX_SEEDS         (CHARGE_MAX * FIELD_SEEDS_PER_CHARGE)
+#define FIELD_NUM_GLYPHS        (FIELD_GLYPH_GRID * FIELD_GLYPH_GRID * FIELD_GLYPH_GRID)
+//vertices one task may write (its share of the seeds and of the glyphs)
+#define FIELD_LINE_VERTICES     (((FIELD_MAX_SEEDS + FIELD_TASKS - 1) / FIELD_TASKS) * FIELD_LINE_STEPS * 2)
+#define FIELD_GLYPH_VERTICES    (((FIELD_NUM_GLYPHS + FIELD_TASKS - 1) / FIELD_TASKS) * 6)
+
+//one complete build: each task's part is a run of GL_LINES vertices
+struct FieldLineBuffer
+{
+    float* lineVertices[FIELD_TASKS];     //x, y, z per vertex
+    float* lineColours[FIELD_TASKS];      //r, g, b per vertex
+    long lineCount[FIELD_TASKS];          //vertices written
+    float* glyphVertices[FIELD_TASKS];
+    float* glyphColours[FIELD_TASKS];
+    long glyphCount[FIELD_TASKS];
+};
+
+struct FieldLineCache;
+
+//what each task of a build is given
+struct FieldLineTask
+{
+    FieldLineCache* cache;
+    int index;                  //which share of the work it does
+};
+
+struct FieldLineCache
+{
+    FieldLineBuffer buffers[2];
+    int front;                  //buffer drawn
+    bool hasBuild;              //"front" holds a completed build
+    bool building;              //a build into buffers[1 - front] is running
+
+    //the build being run (written by the graphics loop only between builds)
+    ChargeSet charges;
+    double zoom;
+    long builtVersion;          //what the last build started from
+    double builtZoom;
+
+    TaskPool* pool;             //NULL until started
+    TaskFuture build;
+    FieldLineTask tasks[FIELD_TASKS];
+};
+
+
+//This procedure maps the force magnitude (N) to a colour, blue (weak)
+// through green to red (strong), on a log scale from 0.01 to 10 N.
+inline void fieldColour(double magnitude, float colour[3])
+{
+    double t = (magnitude > 0) ? (log10(magnitude) + 2) / 3 : 0;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    colour[0] = (float)((t > 0.5) ? 2*t - 1 : 0);
+    colour[1] = (float)((t < 0.5) ? 2*t : 2 - 2*t);
+    colour[2] = (float)((t < 0.5) ? 1 - 2*t : 0);
+}
+
+
+//This procedure appends one line segment to a vertex/colour array.
+inline void fieldAppendSegment(float* vertices, float* colours, long& count,
+                               const double a[3], const double b[3], const float colour[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        vertices[3*count + i] = (float)a[i];
+        vertices[3*count + 3 + i] = (float)b[i];
+        colours[3*count + i] = colour[i];
+        colours[3*count + 3 + i] = colour[i];
+    }
+    count += 2;
+}
+
+
+//This procedure traces streamline "seed" (charge seed / FIELD_SEEDS_PER_CHARGE)
+// with midpoint (RK2) steps, away from a positive charge / towards a
+// negative one, until it leaves the box or reaches another charge.
+inline void fieldTraceLine(const ChargeSet& set, double zoom, int seed,
+                           float* vertices, float* colours, long& count)
+{
+    const Charge& charge = set.charges[seed / FIELD_SEEDS_PER_CHARGE];
+    double contact = set.radius + zoom * set.radius;
+
+    //seeds spread over the sphere around the charge (golden spiral)
+    int k = seed % FIELD_SEEDS_PER_CHARGE;
+    double z = 1 - (2*k + 1.0) / FIELD_SEEDS_PER_CHARGE;
+    double ring = sqrt(1 - z*z);
+    double angle = k * 2.39996322972865;
+    double p[3] = { charge.position[0] + contact * ring * cos(angle),
+                    charge.position[1] + contact * ring * sin(angle),
+                    charge.position[2] + contact * z };
+    //the force attracts the stylus to positive charges: go against it
+    double direction = (charge.strength > 0) ? -1.0 : 1.0;
+
+    for (int step = 0; step < FIELD_LINE_STEPS; step++)
+    {
+        double f[3], mid[3], next[3];
+        chargeFieldForce(set, zoom, p, f);
+        double magnitude = sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+        if (magnitude < 1e-9)
+            return;
+        int i;
+        for (i = 0; i < 3; i++)
+            mid[i] = p[i] + direction * 0.5 * FIELD_LINE_STEP * f[i] / magnitude;
+        chargeFieldForce(set, zoom, mid, f);
+        double midMagnitude = sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+        if (midMagnitude < 1e-9)
+            return;
+        for (i = 0; i < 3; i++)
+            next[i] = p[i] + direction * FIELD_LINE_STEP * f[i] / midMagnitude;
+
+        float colour[3];
+        fieldColour(magnitude, colour);
+        fieldAppendSegment(vertices, colours, count, p, next, colour);
+        for (i = 0; i < 3; i++)
+            p[i] = next[i];
+
+        if (fabs(p[0]) > FIELD_EXTENT || fabs(p[1]) > FIELD_EXTENT || fabs(p[2]) > FIELD_EXTENT)
+            return;
+        for (long c = 0; c < set.count; c++)
+        {
+            const double* q = set.charges[c].position;
+            double d2 = (p[0]-q[0])*(p[0]-q[0]) + (p[1]-q[1])*(p[1]-q[1]) + (p[2]-q[2])*(p[2]-q[2]);
+            if (d2 < contact*contact)
+                return;
+        }
+    }
+}//END of fieldTraceLine
+
+
+//This procedure writes glyph "index" of the grid: a short line along the
+// force with a two-line arrow head, coloured by the magnitude.
+inline void fieldGlyph(const ChargeSet& set, double zoom, int index,
+                       float* vertices, float* colours, long& count)
+{
+    const double spacing = 2 * FIELD_EXTENT / (FIELD_GLYPH_GRID - 1);
+    double p[3] = { -FIELD_EXTENT + spacing * (index % FIELD_GLYPH_GRID),
+                    -FIELD_EXTENT + spacing * ((index / FIELD_GLYPH_GRID) % FIELD_GLYPH_GRID),
+                    -FIELD_EXTENT + spacing * (index / (FIELD_GLYPH_GRID * FIELD_GLYPH_GRID)) };
+    double f[3];
+    chargeFieldForce(set, zoom, p, f);
+    double magnitude = sqrt(f[0]*f[0] + f[1]*f[1] + f[2]*f[2]);
+    if (magnitude < 1e-9)
+        return;
+
+    double d[3], tip[3], side[3], head[3];
+    int i;
+    for (i = 0; i < 3; i++)
+    {
+        d[i] = f[i] / magnitude;
+        tip[i] = p[i] + FIELD_GLYPH_LENGTH * d[i];
+    }
+    //any direction across the glyph, for the arrow head
+    if (fabs(d[0]) < 0.9) { side[0] = 0; side[1] = d[2]; side[2] = -d[1]; }
+    else                  { side[0] = -d[2]; side[1] = 0; side[2] = d[0]; }
+    double sideLength = sqrt(side[0]*side[0] + side[1]*side[1] + side[2]*side[2]);
+
+    float colour[3];
+    fieldColour(magnitude, colour);
+    fieldAppendSegment(vertices, colours, count, p, tip, colour);
+    for (int s = -1; s <= 1; s += 2)
+    {
+        for (i = 0; i < 3; i++)
+            head[i] = tip[i] - 0.3*FIELD_GLYPH_LENGTH*d[i] + s*0.15*FIELD_GLYPH_LENGTH*side[i]/sideLength;
+        fieldAppendSegment(vertices, colours, count, tip, head, colour);
+    }
+}//END of fieldGlyph
+
+
+//This procedure is one task of a build: its share of the work (every
+// FIELD_TASKS-th seed and glyph).
+inline void fieldLineTask(void* data)
+{
+    FieldLineTask* task = static_cast<FieldLineTask*>(data);
+    FieldLineCache& cache = *task->cache;
+    int index = task->index;
+
+    FieldLineBuffer& buffer = cache.buffers[1 - cache.front];
+    long lines = 0, glyphs = 0;
+    int seeds = (int)cache.charges.count * FIELD_SEEDS_PER_CHARGE;
+    int k;
+    for (k = index; k < seeds; k += FIELD_TASKS)
+        fieldTraceLine(cache.charges, cache.zoom, k,
+                       buffer.lineVertices[index], buffer.lineColours[index], lines);
+    for (k = index; k < FIELD_NUM_GLYPHS; k += FIELD_TASKS)
+        fieldGlyph(cache.charges, cache.zoom, k,
+                   buffer.glyphVertices[index], buffer.glyphColours[index], glyphs);
+    buffer.lineCount[index] = lines;
+    buffer.glyphCount[index] = glyphs;
+}//END of fieldLineTask
+
+
+//This procedure frees the buffers (those not allocated are NULL).
+inline void fieldLineCacheFree(FieldLineCache& cache)
+{
+    for (int b = 0; b < 2; b++)
+        for (int t = 0; t < FIELD_TASKS; t++)
+        {
+            FieldLineBuffer& buffer = cache.buffers[b];
+            free(buffer.lineVertices[t]);
+            free(buffer.lineColours[t]);
+            free(buffer.glyphVertices[t]);
+            free(buffer.glyphColours[t]);
+            buffer.lineVertices[t] = buffer.lineColours[t] = NULL;
+            buffer.glyphVertices[t] = buffer.glyphColours[t] = NULL;
+        }
+}
+
+
+//This function allocates the buffers; the builds will run on "pool".
+// Returns false (and leaves the cache unusable) on failure.
+inline bool fieldLineCacheStart(FieldLineCache& cache, TaskPool& pool)
+{
+    int b, t;
+    memset(&cache, 0, sizeof(cache));
+    for (b = 0; b < 2; b++)
+        for (t = 0; t < FIELD_TASKS; t++)
+        {
+            FieldLineBuffer& buffer = cache.buffers[b];
+            buffer.lineVertices[t] = (float*)malloc(sizeof(float) * 3 * FIELD_LINE_VERTICES);
+            buffer.lineColours[t] = (float*)malloc(sizeof(float) * 3 * FIELD_LINE_VERTICES);
+            buffer.glyphVertices[t] = (float*)malloc(sizeof(float) * 3 * FIELD_GLYPH_VERTICES);
+            buffer.glyphColours[t] = (float*)malloc(sizeof(float) * 3 * FIELD_GLYPH_VERTICES);
+            if (!buffer.lineVertices[t] || !buffer.lineColours[t] ||
+                !buffer.glyphVertices[t] || !buffer.glyphColours[t])
+            {
+                fieldLineCacheFree(cache);
+                return false;
+            }
+        }
+    for (t = 0; t < FIELD_TASKS; t++)
+    {
+        cache.tasks[t].cache = &cache;
+        cache.tasks[t].index = t;
+    }
+    cache.pool = &pool;
+    return true;
+}//END of fieldLineCacheStart
+
+
+//This procedure waits for the build in progress (at exit).
+inline void fieldLineCacheStop(FieldLineCache& cache)
+{
+    if (cache.pool == NULL)
+        return;
+    taskFutureWait(*cache.pool, cache.build);
+    cache.pool = NULL;
+}
+
+
+//This function is called by the graphics loop once per frame.  It picks
+// up a finished build and starts a new one if the field has changed.
+// Returns the buffer to draw, or NULL before the first build completes.
+inline const FieldLineBuffer* fieldLineCacheUpdate(FieldLineCache& cache,
+                                                   const ChargeSet& charges, double zoom)
+{
+    if (cache.pool == NULL)
+        return NULL;
+    if (cache.building && taskFutureReady(cache.build))
+    {
+        cache.front = 1 - cache.front;
+        cache.hasBuild = true;
+        cache.building = false;
+    }
+    if (!cache.building && (!cache.hasBuild || charges.version != cache.builtVersion ||
+                            zoom != cache.builtZoom))
+    {
+        cache.charges = charges;
+        cache.zoom = zoom;
+        cache.builtVersion = charges.version;
+        cache.builtZoom = zoom;
+        cache.building = true;
+        taskFutureReset(cache.build);
+        for (int t = 0; t < FIELD_TASKS; t++)
+            taskSubmit(*cache.pool, fieldLineTask, &cache.tasks[t], TASK_PRIORITY_NORMAL, &cache.build);
+    }
+    return cache.hasBuild ? &cache.buffers[cache.front] : NULL;
+}//END of fieldLineCacheUpdate
+
+#endif //FIELD_LINE_CACHE_H
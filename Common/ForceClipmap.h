@@ -0,0 +1,268 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ForceClipmap.h
+
+Description:
+
+  A small grid of precomputed Coulomb forces that follows the stylus, so
+  that the servo callback pays the same small cost per tick however
+  many charges there are.
+
+  - A background thread keeps CLIPMAP_SIZE^3 grid points, CLIPMAP_SPACING
+    apart, computed around the last stylus position the servo callback
+    reported.  The grid is addressed modulo its size (a "clipmap"), so
+    when the stylus moves by one spacing only the slab of points that
+    comes into range is computed; the points closest to the stylus are
+    done first.
+  - The servo callback (clipmapForce) blends the 8 grid points around the
+    stylus (trilinear interpolation).  It evaluates the field directly
+    instead when any of them isn't ready: outside the grid, not yet
+    computed for the current charges and zoom, being rewritten, or next
+    to a contact surface, where the force jumps and must not be
+    smoothed.
+
+  Each grid point carries the grid coordinates, charge set version and
+  zoom it was computed for, under a per-point sequence number (odd while
+  it is written), so the servo callback never waits and never blends a
+  stale or torn value.
+
+  The thread copies the charge set between rounds, retrying if its
+  version changes during the copy.
+
+******************************************************************************/
+#ifndef FORCE_CLIPMAP_H
+#define FORCE_CLIPMAP_H
+
+#include <math.h>
+#include <string.h>
+#include "ChargeField.h"
+#include "PortableThread.h"
+#include "ServoAtomic.h"
+
+#define CLIPMAP_SIZE        16      //grid points along each axis (power of 2)
+#define CLIPMAP_SPACING     1.0     //distance between grid points (mm)
+#define CLIPMAP_PERIOD_MS   1       //pause between rounds of the thread (ms)
+
+#define CLIPMAP_NUM_NODES   (CLIPMAP_SIZE * CLIPMAP_SIZE * CLIPMAP_SIZE)
+
+//one grid point
+struct ClipmapNode
+{
+    volatile long sequence;     //odd while written
+    int cell[3];                //grid coordinates (position / CLIPMAP_SPACING)
+    long version;               //ChargeSet version the force was computed for
+    double zoom;                //and the zoom
+    bool direct;                //a contact surface passes nearby
+    float force[3];             //(N)
+};
+
+struct ForceClipmap
+{
+    ClipmapNode nodes[CLIPMAP_NUM_NODES];
+
+    //written by the servo callback, read by the thread
+    volatile double stylus[3];  //last stylus position (mm)
+    volatile double zoom;       //last zoom
+    long hits;                  //ticks served from the grid
+    long misses;                //ticks evaluated directly
+
+    //the thread
+    const ChargeSet* source;    //the charges (owned by the graphics loop)
+    ChargeSet charges;          //copy used by the current round
+    long computed;              //grid points computed so far
+    volatile long running;      //cleared to stop the thread
+    ThreadHandle thread;
+};
+
+
+//This function returns the slot of grid point "cell" (the grid wraps around).
+inline int clipmapSlot(const int cell[3])
+{
+    const int mask = CLIPMAP_SIZE - 1;
+    return (cell[0] & mask) + CLIPMAP_SIZE * ((cell[1] & mask) + CLIPMAP_SIZE * (cell[2] & mask));
+}
+
+
+//This procedure computes grid point "cell" into its slot, unless it
+// already holds it for these charges and zoom.  Returns true if computed.
+inline bool clipmapComputeNode(ForceClipmap& clipmap, const int cell[3], double zoom)
+{
+    ClipmapNode& node = clipmap.nodes[clipmapSlot(cell)];
+    if (node.cell[0] == cell[0] && node.cell[1] == cell[1] && node.cell[2] == cell[2] &&
+        node.version == clipmap.charges.version && node.zoom == zoom)
+        return false;
+
+    double p[3] = { cell[0] * CLIPMAP_SPACING, cell[1] * CLIPMAP_SPACING, cell[2] * CLIPMAP_SPACING };
+    double f[3];
+    chargeFieldForce(clipmap.charges, zoom, p, f);
+
+    //the cells around this point reach sqrt(3) spacings away
+    const ChargeSet& set = clipmap.charges;
+    double contact = set.radius + zoom * set.radius;
+    double reach = 1.7321 * CLIPMAP_SPACING;
+    bool direct = false;
+    for (long k = 0; k < set.count && !direct; k++)
+    {
+        const double* q = set.charges[k].position;
+        double d = sqrt((p[0]-q[0])*(p[0]-q[0]) + (p[1]-q[1])*(p[1]-q[1]) + (p[2]-q[2])*(p[2]-q[2]));
+        direct = fabs(d - contact) < reach;
+    }
+
+    long sequence = node.sequence;
+    servoStoreRelease(&node.sequence, sequence + 1);
+    servoMemoryBarrier();
+    node.cell[0] = cell[0];
+    node.cell[1] = cell[1];
+    node.cell[2] = cell[2];
+    node.version = set.version;
+    node.zoom = zoom;
+    node.direct = direct;
+    node.force[0] = (float)f[0];
+    node.force[1] = (float)f[1];
+    node.force[2] = (float)f[2];
+    servoStoreRelease(&node.sequence, sequence + 2);
+    return true;
+}//END of clipmapComputeNode
+
+
+//This procedure brings the grid up to date around the last stylus
+// position: first the inner half, then the rest.
+inline void clipmapRefresh(ForceClipmap& clipmap)
+{
+    //a consistent copy of the charges
+    for (int attempt = 0; attempt < 8; attempt++)
+    {
+        long version = servoLoadAcquire(const_cast<volatile long*>(&clipmap.source->version));
+        clipmap.charges = *clipmap.source;
+        if (servoLoadAcquire(const_cast<volatile long*>(&clipmap.source->version)) == version)
+            break;
+    }
+    double zoom = clipmap.zoom;
+    int centre[3], cell[3];
+    for (int i = 0; i < 3; i++)
+        centre[i] = (int)floor(clipmap.stylus[i] / CLIPMAP_SPACING + 0.5);
+
+    for (int half = CLIPMAP_SIZE / 4; half <= CLIPMAP_SIZE / 2; half += CLIPMAP_SIZE / 4)
+        for (cell[2] = centre[2] - half; cell[2] < centre[2] + half; cell[2]++)
+            for (cell[1] = centre[1] - half; cell[1] < centre[1] + half; cell[1]++)
+                for (cell[0] = centre[0] - half; cell[0] < centre[0] + half; cell[0]++)
+                    if (clipmapComputeNode(clipmap, cell, zoom))
+                        clipmap.computed++;
+}//END of clipmapRefresh
+
+
+//This procedure is the body of the thread.
+inline void clipmapThread(void* data)
+{
+    ForceClipmap& clipmap = *static_cast<ForceClipmap*>(data);
+    while (servoLoadAcquire(&clipmap.running))
+    {
+        clipmapRefresh(clipmap);
+        threadSleepMs(CLIPMAP_PERIOD_MS);
+    }
+}
+
+
+//This procedure empties the grid, so that nothing is read from it before
+// it is computed.
+inline void clipmapReset(ForceClipmap& clipmap, const ChargeSet& source)
+{
+    memset(&clipmap, 0, sizeof(clipmap));
+    for (int n = 0; n < CLIPMAP_NUM_NODES; n++)
+        clipmap.nodes[n].zoom = -1;     //no zoom is negative
+    clipmap.source = &source;
+    clipmap.zoom = 1;
+}
+
+
+//This function starts the thread, keeping the grid for the charges in
+// "source".  (It has a thread of its own rather than tasks on the pool:
+// the servo callback needs it every millisecond, even while the pool is
+// busy with a build.)  Returns false if the thread can't be created.
+inline bool clipmapStart(ForceClipmap& clipmap, const ChargeSet& source)
+{
+    clipmapReset(clipmap, source);
+    clipmap.running = 1;
+    if (!threadStart(clipmapThread, &clipmap, &clipmap.thread))
+    {
+        clipmap.running = 0;
+        return false;
+    }
+    threadSetAffinity(clipmap.thread, threadBackgroundAffinity());
+    return true;
+}
+
+
+//This procedure stops the thread.
+inline void clipmapStop(ForceClipmap& clipmap)
+{
+    if (!clipmap.running)
+        return;
+    servoStoreRelease(&clipmap.running, 0);
+    threadJoin(clipmap.thread);
+}
+
+
+//This function gives the force at "position" from the grid (servo thread
+// only), and tells the thread where the stylus is.  Returns false when
+// the grid can't be used there; the caller then evaluates the field.
+inline bool clipmapForce(ForceClipmap& clipmap, const ChargeSet& charges, double zoom,
+                         const double position[3], double force[3])
+{
+    int base[3], i;
+    double t[3];
+    for (i = 0; i < 3; i++)
+    {
+        clipmap.stylus[i] = position[i];
+        double g = position[i] / CLIPMAP_SPACING;
+        base[i] = (int)floor(g);
+        t[i] = g - base[i];
+    }
+    clipmap.zoom = zoom;
+
+    //the 8 grid points around the stylus: sequence numbers, then the
+    // points, then the sequence numbers again
+    ClipmapNode* nodes[8];
+    long sequences[8];
+    int k;
+    for (k = 0; k < 8; k++)
+    {
+        int cell[3] = { base[0] + (k & 1), base[1] + ((k >> 1) & 1), base[2] + ((k >> 2) & 1) };
+        nodes[k] = &clipmap.nodes[clipmapSlot(cell)];
+        sequences[k] = nodes[k]->sequence;
+    }
+    servoReadBarrier();
+
+    double sum[3] = { 0, 0, 0 };
+    for (k = 0; k < 8; k++)
+    {
+        const ClipmapNode& node = *nodes[k];
+        if ((sequences[k] & 1) || node.direct || node.version != charges.version || node.zoom != zoom ||
+            node.cell[0] != base[0] + (k & 1) || node.cell[1] != base[1] + ((k >> 1) & 1) ||
+            node.cell[2] != base[2] + ((k >> 2) & 1))
+        {
+            clipmap.misses++;
+            return false;
+        }
+        double w = ((k & 1) ? t[0] : 1 - t[0]) * (((k >> 1) & 1) ? t[1] : 1 - t[1]) *
+                   (((k >> 2) & 1) ? t[2] : 1 - t[2]);
+        for (i = 0; i < 3; i++)
+            sum[i] += w * node.force[i];
+    }
+
+    servoReadBarrier();
+    for (k = 0; k < 8; k++)
+        if (nodes[k]->sequence != sequences[k])
+        {
+            clipmap.misses++;
+            return false;
+        }
+    force[0] = sum[0];
+    force[1] = sum[1];
+    force[2] = sum[2];
+    clipmap.hits++;
+    return true;
+}//END of clipmapForce
+
+#endif //FORCE_CLIPMAP_H
@@ -0,0 +1,151 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: HapticBench.h
+
+Description:
+
+  A small, dependency free micro-benchmark harness in the style of
+  Google Benchmark.  Each kernel is a plain function that runs its
+  workload "iterations" times.  The harness grows the iteration count
+  until the measurement lasts long enough, prints a console table and
+  can write the results in Google Benchmark's JSON format, so runs can
+  be compared over time with the usual tools (e.g. compare.py).
+
+  The harness only needs ServoClock.h and the C library; it does not
+  touch the haptic device or OpenGL.
+
+  Usage:
+      benchRun("Group/Kernel", kernelFunction);
+      ...
+      benchWriteJson("results.json", argv[0]);
+
+******************************************************************************/
+#ifndef HAPTIC_BENCH_H
+#define HAPTIC_BENCH_H
+
+#include <stdio.h>
+#include <time.h>
+#include "ServoClock.h"
+
+#define BENCH_MAX_RESULTS       64      //max number of kernels per run
+#define BENCH_MIN_TIME          0.2     //seconds each kernel should run for
+#define BENCH_MAX_ITERATIONS    1000000000L
+
+//a kernel runs its workload "iterations" times
+typedef void (*BenchKernel)(long iterations);
+
+//the result of timing one kernel
+struct BenchResult
+{
+    const char* name;       //name of the kernel ("Group/Kernel")
+    long iterations;        //iterations of the final (reported) run
+    double nsPerIteration;  //wall time per iteration (nanoseconds)
+};
+
+static BenchResult gBenchResults[BENCH_MAX_RESULTS];
+static int gBenchNumResults = 0;
+
+//Kernels feed their results into this sink so the optimizer can't
+// remove the work being measured.
+static volatile double gBenchSink = 0;
+
+inline void benchDoNotOptimize(double value)
+{
+    gBenchSink = gBenchSink + value;
+}
+
+
+//This function times one kernel, prints its row of the console table
+// and stores the result for "benchWriteJson".
+inline void benchRun(const char* name, BenchKernel kernel)
+{
+    if (gBenchNumResults == 0)
+    {
+        printf("%-44s %14s %14s\n", "Benchmark", "Time (ns)", "Iterations");
+        printf("--------------------------------------------------------------------------\n");
+    }
+
+    //warm up the caches and the branch predictors
+    kernel(1);
+
+    //grow the iteration count until the run is long enough to trust
+    long iterations = 1;
+    double elapsed = 0;
+    for (;;)
+    {
+        double start = servoClockSeconds();
+        kernel(iterations);
+        elapsed = servoClockSeconds() - start;
+
+        if (elapsed >= BENCH_MIN_TIME || iterations >= BENCH_MAX_ITERATIONS)
+            break;
+
+        //predict the count needed (with some margin), but grow at most 10x
+        double multiplier = (elapsed > 0) ? 1.4*BENCH_MIN_TIME/elapsed : 10.0;
+        if (multiplier > 10.0)
+            multiplier = 10.0;
+        long next = (long)(iterations*multiplier) + 1;
+        iterations = (next < BENCH_MAX_ITERATIONS) ? next : BENCH_MAX_ITERATIONS;
+    }
+
+    double nsPerIteration = elapsed*1e9/(double)iterations;
+    printf("%-44s %14.2f %14ld\n", name, nsPerIteration, iterations);
+
+    if (gBenchNumResults < BENCH_MAX_RESULTS)
+    {
+        BenchResult& result = gBenchResults[gBenchNumResults++];
+        result.name = name;
+        result.iterations = iterations;
+        result.nsPerIteration = nsPerIteration;
+    }
+}//END of benchRun
+
+
+//This function writes all results collected so far in the Google Benchmark
+// JSON format.  Returns false if the file can't be written.
+inline bool benchWriteJson(const char* path, const char* executable)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+
+    char date[64];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    fprintf(file, "{\n  \"context\": {\n");
+    fprintf(file, "    \"date\": \"%s\",\n", date);
+    fprintf(file, "    \"executable\": \"");
+    for (const char* c = executable; *c; c++)
+    {   //paths on Windows contain backslashes, which must be escaped
+        if (*c == '\\' || *c == '"')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fprintf(file, "\",\n");
+#ifdef _DEBUG
+    fprintf(file, "    \"library_build_type\": \"debug\"\n");
+#else
+    fprintf(file, "    \"library_build_type\": \"release\"\n");
+#endif
+    fprintf(file, "  },\n  \"benchmarks\": [\n");
+    for (int i = 0; i < gBenchNumResults; i++)
+    {
+        const BenchResult& result = gBenchResults[i];
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"name\": \"%s\",\n", result.name);
+        fprintf(file, "      \"run_name\": \"%s\",\n", result.name);
+        fprintf(file, "      \"run_type\": \"iteration\",\n");
+        fprintf(file, "      \"iterations\": %ld,\n", result.iterations);
+        fprintf(file, "      \"real_time\": %.4f,\n", result.nsPerIteration);
+        fprintf(file, "      \"cpu_time\": %.4f,\n", result.nsPerIteration);
+        fprintf(file, "      \"time_unit\": \"ns\"\n");
+        fprintf(file, "    }%s\n", (i + 1 < gBenchNumResults) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}//END of benchWriteJson
+
+#endif //HAPTIC_BENCH_H
@@ -0,0 +1,226 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: LatencyProbe.h
+
+Description:
+
+  Motion-to-photon latency measurement ("-latency [frames.csv]").  Every
+  frame carries the time stamp of the servo sample it draws and is
+  stamped again at each stage of the graphics loop:
+
+      sample    the servo callback read the device state (servo thread)
+      snapshot  the graphics loop got that state back
+      drawn     the scene was drawn (just before glutSwapBuffers)
+      swapped   glutSwapBuffers returned
+      vblank    the next vertical blank after the swap (Windows with the
+                desktop compositor only), i.e. when scan-out starts
+
+  On exit the per-frame breakdown (servo->snapshot, snapshot->draw,
+  draw->swap, swap->vblank and the total) is written as CSV and a summary
+  (mean, median, 95th percentile, maximum in ms) is printed.  All times
+  come from ServoClock.h, so they are comparable across threads.
+
+  Nothing here runs in the servo thread; the frame buffer is allocated
+  once at start-up.
+
+******************************************************************************/
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ServoClock.h"
+
+#ifdef _WIN32
+#include <dwmapi.h>
+#pragma comment(lib, "dwmapi.lib")  //DwmGetCompositionTimingInfo
+#endif
+
+#define LATENCY_MAX_FRAMES      100000  //frames recorded (about 28 min at 60 Hz)
+#define LATENCY_NUM_STAGES      5
+
+//time stamps of one frame (s, ServoClock.h)
+struct LatencyFrame
+{
+    double sample;
+    double snapshot;
+    double drawn;
+    double swapped;
+    double vblank;      //0 when the display timing isn't available
+};
+
+struct LatencyProbe
+{
+    bool enabled;
+    const char* csvPath;        //per-frame output, NULL for the summary only
+    LatencyFrame* frames;
+    long count;                 //frames recorded
+    long dropped;               //frames not recorded (buffer full)
+    LatencyFrame current;       //frame being drawn
+};
+
+//the probe of this program (graphics loop only)
+static LatencyProbe gLatencyProbe = { false, NULL, NULL, 0, 0, { 0, 0, 0, 0, 0 } };
+
+
+//This function starts recording.  Returns false if the buffer can't be
+// allocated.
+inline bool latencyProbeStart(LatencyProbe& probe, const char* csvPath)
+{
+    probe.frames = (LatencyFrame*)malloc(sizeof(LatencyFrame) * LATENCY_MAX_FRAMES);
+    if (probe.frames == NULL)
+        return false;
+    probe.csvPath = csvPath;
+    probe.count = 0;
+    probe.dropped = 0;
+    probe.enabled = true;
+    return true;
+}
+
+
+//This procedure records that the graphics loop got the state the servo
+// callback sampled at "sampleTime".
+inline void latencyFrameSnapshot(LatencyProbe& probe, double sampleTime)
+{
+    if (!probe.enabled)
+        return;
+    probe.current.snapshot = servoClockSeconds();
+    probe.current.sample = sampleTime;
+}
+
+
+//This procedure records that the scene has been drawn (before the swap).
+inline void latencyFrameDrawn(LatencyProbe& probe)
+{
+    if (probe.enabled)
+        probe.current.drawn = servoClockSeconds();
+}
+
+
+//This function returns the time of the first vertical blank at or after
+// "time", or 0 if the display timing isn't available.
+inline double latencyNextVBlank(double time)
+{
+#ifdef _WIN32
+    DWM_TIMING_INFO info;
+    memset(&info, 0, sizeof(info));
+    info.cbSize = sizeof(info);
+    if (FAILED(DwmGetCompositionTimingInfo(NULL, &info)) || info.qpcRefreshPeriod == 0)
+        return 0;
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    double period = (double)info.qpcRefreshPeriod / frequency.QuadPart;
+    double vblank = (double)info.qpcVBlank / frequency.QuadPart;
+    if (vblank < time)
+        vblank += ceil((time - vblank) / period) * period;
+    return vblank;
+#else
+    (void)time;
+    return 0;
+#endif
+}
+
+
+//This procedure records that glutSwapBuffers has returned and stores the
+// frame.
+inline void latencyFrameSwapped(LatencyProbe& probe)
+{
+    if (!probe.enabled)
+        return;
+    probe.current.swapped = servoClockSeconds();
+    probe.current.vblank = latencyNextVBlank(probe.current.swapped);
+    if (probe.count < LATENCY_MAX_FRAMES)
+        probe.frames[probe.count++] = probe.current;
+    else
+        probe.dropped++;
+}
+
+
+//This procedure fills in the stage durations of a frame (ms): servo->
+// snapshot, snapshot->draw, draw->swap, swap->vblank and total.
+inline void latencyFrameStages(const LatencyFrame& frame, double stages[LATENCY_NUM_STAGES])
+{
+    double photon = (frame.vblank != 0) ? frame.vblank : frame.swapped;
+    stages[0] = (frame.snapshot - frame.sample) * 1000;
+    stages[1] = (frame.drawn - frame.snapshot) * 1000;
+    stages[2] = (frame.swapped - frame.drawn) * 1000;
+    stages[3] = (photon - frame.swapped) * 1000;
+    stages[4] = (photon - frame.sample) * 1000;
+}
+
+
+//qsort comparison of two doubles
+inline int latencyCompare(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+
+//This procedure stops recording, writes the CSV file (if any) and prints
+// the summary to "out".
+inline void latencyProbeFinish(LatencyProbe& probe, FILE* out)
+{
+    static const char* stageNames[LATENCY_NUM_STAGES] =
+        { "servo->snapshot", "snapshot->draw", "draw->swap", "swap->vblank", "total" };
+    if (!probe.enabled)
+        return;
+    probe.enabled = false;
+
+    long n = probe.count;
+    double stages[LATENCY_NUM_STAGES];
+    int s;
+    if (probe.csvPath != NULL)
+    {
+        FILE* csv = fopen(probe.csvPath, "w");
+        if (csv == NULL)
+            fprintf(out, "Failed to write %s\n", probe.csvPath);
+        else
+        {
+            fprintf(csv, "frame,sample_s,servo_to_snapshot_ms,snapshot_to_draw_ms,"
+                         "draw_to_swap_ms,swap_to_vblank_ms,total_ms\n");
+            for (long k = 0; k < n; k++)
+            {
+                latencyFrameStages(probe.frames[k], stages);
+                fprintf(csv, "%ld,%.6f", k, probe.frames[k].sample);
+                for (s = 0; s < LATENCY_NUM_STAGES; s++)
+                    fprintf(csv, ",%.3f", stages[s]);
+                fprintf(csv, "\n");
+            }
+            fclose(csv);
+            fprintf(out, "Per-frame latency written to %s\n", probe.csvPath);
+        }
+    }
+
+    fprintf(out, "Motion-to-photon latency over %ld frames (ms)%s:\n", n,
+            (n > 0 && probe.frames[0].vblank == 0) ? ", up to the swap (no vblank timing)" : "");
+    double* values = (n > 0) ? (double*)malloc(sizeof(double) * n) : NULL;
+    if (values != NULL)
+    {
+        fprintf(out, "  %-16s %8s %8s %8s %8s\n", "stage", "mean", "median", "p95", "max");
+        for (s = 0; s < LATENCY_NUM_STAGES; s++)
+        {
+            double sum = 0;
+            for (long k = 0; k < n; k++)
+            {
+                latencyFrameStages(probe.frames[k], stages);
+                values[k] = stages[s];
+                sum += stages[s];
+            }
+            qsort(values, n, sizeof(double), latencyCompare);
+            fprintf(out, "  %-16s %8.2f %8.2f %8.2f %8.2f\n", stageNames[s], sum / n,
+                    values[n / 2], values[(long)(0.95 * (n - 1))], values[n - 1]);
+        }
+        free(values);
+    }
+    if (probe.dropped > 0)
+        fprintf(out, "  (%ld later frames not recorded)\n", probe.dropped);
+
+    free(probe.frames);
+    probe.frames = NULL;
+}//END of latencyProbeFinish
+
+#endif //LATENCY_PROBE_H
@@ -0,0 +1,298 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: OmniKinematics.h
+
+Description:
+
+  The arm of the Phantom Omni as a 3-joint manipulator: where the stylus
+  tip is for given joint angles, its Jacobian, the joint torques gravity
+  puts on the arm, and the mapping between a force at the tip and the
+  torques of the three motors.
+
+  - The joint angles are the ones the device reports
+    (HD_CURRENT_JOINT_ANGLES, radians): q1 turns the base about the
+    vertical, q2 raises the upper arm, q3 is the angle of the forearm
+    from the vertical (not from the upper arm).  Both links are
+    OMNI_LINK_LENGTH long.  Positions are relative to the shoulder (where
+    the axes of q1 and q2 cross), in the axes of the device (Y up, Z
+    towards the user); the device origin is a fixed offset from it, which
+    the Jacobian doesn't depend on.
+
+        reach = L cos q2 + L sin q3
+        tip   = ( -sin q1 reach,  L sin q2 - L cos q3,  cos q1 reach )
+
+  - A tip force F takes the motor torques J^T F (N mm, for N and mm).
+    Going back, F = J^-T tau is solved damped (OMNI_DAMPING) so that it
+    stays bounded where the arm is stretched out or folded.
+  - Gravity: the mass model (OmniMassModel) puts each link's mass at a
+    fraction of its length and the stylus (with the gimbals) at the tip.
+    omniGravityCompensation gives the tip force whose torques hold the
+    arm up: with the stylus alone that is just its weight, upwards; the
+    links add what their counterweights don't balance.  The masses are
+    estimates, to be tuned on the device.
+  - omniAnalyzeBatch runs the same computations for many poses at once,
+    four at a time with SSE (floats, structure-of-arrays), for offline
+    analysis such as effort maps of the workspace; the sines and cosines
+    are computed in the SIMD registers too (Cephes polynomials, about
+    1e-7 off).  Without SSE2 it falls back on the scalar version.
+
+******************************************************************************/
+#ifndef OMNI_KINEMATICS_H
+#define OMNI_KINEMATICS_H
+
+#include <math.h>
+
+#if !defined(OMNI_KINEMATICS_NO_SSE) && \
+    (defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define OMNI_KINEMATICS_SSE
+#include <emmintrin.h>
+#endif
+
+#define OMNI_LINK_LENGTH      133.35    //both arm links (mm)
+#define OMNI_GRAVITY          9.81      //(m/s^2, along -Y)
+#define OMNI_DAMPING          3.0       //of the torque to force solve (mm)
+#define OMNI_MAX_JOINT_TORQUE 440.0     //about the most a motor gives (N mm)
+#define OMNI_MAX_COMPENSATION 1.0       //gravity compensation force at most (N)
+
+//the masses gravity pulls on (kg), at fractions of the link lengths
+struct OmniMassModel
+{
+    double link1Mass, link1Centre;      //upper arm (beyond its counterweight)
+    double link2Mass, link2Centre;      //forearm
+    double stylusMass;                  //stylus and gimbals, at the tip
+};
+
+
+//This procedure fills in the estimated masses of the Omni.
+inline void omniMassModelDefault(OmniMassModel& model)
+{
+    model.link1Mass = 0.020;
+    model.link1Centre = 0.5;
+    model.link2Mass = 0.030;
+    model.link2Centre = 0.4;
+    model.stylusMass = 0.045;
+}
+
+
+//This procedure computes the tip position (relative to the shoulder, mm)
+// and the Jacobian (mm/rad, J[row][joint]) for the joint angles "q".
+inline void omniKinematics(const double q[3], double position[3], double J[3][3])
+{
+    double s1 = sin(q[0]), c1 = cos(q[0]);
+    double s2 = sin(q[1]), c2 = cos(q[1]);
+    double s3 = sin(q[2]), c3 = cos(q[2]);
+    double L = OMNI_LINK_LENGTH;
+    double reach = L * (c2 + s3);
+
+    position[0] = -s1 * reach;
+    position[1] = L * (s2 - c3);
+    position[2] = c1 * reach;
+
+    J[0][0] = -c1 * reach;  J[0][1] = s1 * L * s2;  J[0][2] = -s1 * L * c3;
+    J[1][0] = 0;            J[1][1] = L * c2;       J[1][2] = L * s3;
+    J[2][0] = -s1 * reach;  J[2][1] = -c1 * L * s2; J[2][2] = c1 * L * c3;
+}//END of omniKinematics
+
+
+//This procedure computes the joint torques (N mm) that hold the arm up
+// against gravity at joint angles "q".
+inline void omniGravityTorques(const OmniMassModel& model, const double q[3], double torque[3])
+{
+    double L = OMNI_LINK_LENGTH;
+    //(the base turns about the vertical: no torque there)
+    torque[0] = 0;
+    torque[1] = OMNI_GRAVITY * L * cos(q[1]) *
+                (model.link1Mass * model.link1Centre + model.link2Mass + model.stylusMass);
+    torque[2] = OMNI_GRAVITY * L * sin(q[2]) * (model.link2Mass * model.link2Centre + model.stylusMass);
+}
+
+
+//This procedure maps a force at the tip (N) to the motor torques (N mm).
+inline void omniForceToTorques(const double J[3][3], const double force[3], double torque[3])
+{
+    for (int j = 0; j < 3; j++)
+        torque[j] = J[0][j] * force[0] + J[1][j] * force[1] + J[2][j] * force[2];
+}
+
+
+//This procedure maps motor torques (N mm) to the force at the tip (N):
+// F = J (J^T J + d^2 I)^-1 tau, the damped solution of J^T F = tau.
+inline void omniTorquesToForce(const double J[3][3], const double torque[3], double force[3])
+{
+    //A = J^T J + d^2 I (symmetric)
+    double A[3][3];
+    int i, j;
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 3; j++)
+            A[i][j] = J[0][i] * J[0][j] + J[1][i] * J[1][j] + J[2][i] * J[2][j] +
+                      ((i == j) ? OMNI_DAMPING * OMNI_DAMPING : 0);
+
+    //x = A^-1 tau (by cofactors; A is positive definite)
+    double c00 = A[1][1] * A[2][2] - A[1][2] * A[2][1];
+    double c01 = A[1][2] * A[2][0] - A[1][0] * A[2][2];
+    double c02 = A[1][0] * A[2][1] - A[1][1] * A[2][0];
+    double c11 = A[0][0] * A[2][2] - A[0][2] * A[2][0];
+    double c12 = A[0][1] * A[2][0] - A[0][0] * A[2][1];
+    double c22 = A[0][0] * A[1][1] - A[0][1] * A[1][0];
+    double inverseDet = 1 / (A[0][0] * c00 + A[0][1] * c01 + A[0][2] * c02);
+    double x[3];
+    x[0] = (c00 * torque[0] + c01 * torque[1] + c02 * torque[2]) * inverseDet;
+    x[1] = (c01 * torque[0] + c11 * torque[1] + c12 * torque[2]) * inverseDet;
+    x[2] = (c02 * torque[0] + c12 * torque[1] + c22 * torque[2]) * inverseDet;
+
+    for (i = 0; i < 3; i++)
+        force[i] = J[i][0] * x[0] + J[i][1] * x[1] + J[i][2] * x[2];
+}//END of omniTorquesToForce
+
+
+//This procedure gives the tip force (N) that holds the arm up at joint
+// angles "q", OMNI_MAX_COMPENSATION at most.
+inline void omniGravityCompensation(const OmniMassModel& model, const double q[3], double force[3])
+{
+    double position[3], J[3][3], torque[3];
+    omniKinematics(q, position, J);
+    omniGravityTorques(model, q, torque);
+    omniTorquesToForce(J, torque, force);
+    double magnitude = sqrt(force[0] * force[0] + force[1] * force[1] + force[2] * force[2]);
+    if (magnitude > OMNI_MAX_COMPENSATION)
+        for (int i = 0; i < 3; i++)
+            force[i] *= OMNI_MAX_COMPENSATION / magnitude;
+}//END of omniGravityCompensation
+
+
+//--------------------------------------------------------
+// *** Batches of poses (offline analysis) ***
+//--------------------------------------------------------
+
+//the poses of a batch and what is computed for them, one array per
+// component (structure of arrays)
+struct OmniBatch
+{
+    long count;
+    const float* joint[3];          //joint angles (rad)
+    const float* force[3];          //force at the tip (N)
+    float* position[3];             //tip, relative to the shoulder (mm)
+    float* torque[3];               //motor torques: J^T F plus gravity (N mm)
+    float* manipulability;          //|det J| (mm^3), 0 at the singularities
+};
+
+
+//This procedure computes the poses "begin" to "end" of a batch, one by one.
+inline void omniAnalyzeScalar(const OmniMassModel& model, const OmniBatch& batch, long begin, long end)
+{
+    for (long n = begin; n < end; n++)
+    {
+        double q[3], force[3], position[3], J[3][3], torque[3], gravity[3];
+        int i;
+        for (i = 0; i < 3; i++)
+        {
+            q[i] = batch.joint[i][n];
+            force[i] = batch.force[i][n];
+        }
+        omniKinematics(q, position, J);
+        omniForceToTorques(J, force, torque);
+        omniGravityTorques(model, q, gravity);
+        for (i = 0; i < 3; i++)
+        {
+            batch.position[i][n] = (float)position[i];
+            batch.torque[i][n] = (float)(torque[i] + gravity[i]);
+        }
+        double det = J[0][0] * (J[1][1] * J[2][2] - J[1][2] * J[2][1]) -
+                     J[0][1] * (J[1][0] * J[2][2] - J[1][2] * J[2][0]) +
+                     J[0][2] * (J[1][0] * J[2][1] - J[1][1] * J[2][0]);
+        batch.manipulability[n] = (float)fabs(det);
+    }
+}//END of omniAnalyzeScalar
+
+
+#ifdef OMNI_KINEMATICS_SSE
+//This procedure computes the sines and cosines of four angles (Cephes
+// sinf/cosf: reduced to [-pi/4, pi/4] by quarter turns, then polynomials).
+inline void omniSinCos4(__m128 x, __m128& sine, __m128& cosine)
+{
+    __m128i quarter = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.636619772367581f)));  //(rounded)
+    __m128 y = _mm_cvtepi32_ps(quarter);
+    //x - y pi/2, with pi/2 in three parts to keep the bits
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(1.5703125f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(4.837512969970703125e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(7.54978995489188216e-8f)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 s = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(-1.9515295891e-4f)), _mm_set1_ps(8.3321608736e-3f));
+    s = _mm_add_ps(_mm_mul_ps(s, z), _mm_set1_ps(-1.6666654611e-1f));
+    s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, z), x), x);
+    __m128 c = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(2.443315711809948e-5f)), _mm_set1_ps(-1.388731625493765e-3f));
+    c = _mm_add_ps(_mm_mul_ps(c, z), _mm_set1_ps(4.166664568298827e-2f));
+    c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, z), z), _mm_sub_ps(_mm_set1_ps(1), _mm_mul_ps(z, _mm_set1_ps(0.5f))));
+
+    //odd quarters swap sine and cosine; the sine is negative in quarters
+    // 2 and 3, the cosine in 1 and 2
+    __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quarter, one), one));
+    __m128 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quarter, two), 30));
+    __m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quarter, one), two), 30));
+    sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sineSign);
+    cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosineSign);
+}//END of omniSinCos4
+#endif
+
+
+//This procedure computes every pose of a batch: four at a time with SSE,
+// the rest one by one.
+inline void omniAnalyzeBatch(const OmniMassModel& model, const OmniBatch& batch)
+{
+    long n = 0;
+#ifdef OMNI_KINEMATICS_SSE
+    const __m128 L = _mm_set1_ps((float)OMNI_LINK_LENGTH);
+    const __m128 gravity2 = _mm_set1_ps((float)(OMNI_GRAVITY * OMNI_LINK_LENGTH *
+        (model.link1Mass * model.link1Centre + model.link2Mass + model.stylusMass)));
+    const __m128 gravity3 = _mm_set1_ps((float)(OMNI_GRAVITY * OMNI_LINK_LENGTH *
+        (model.link2Mass * model.link2Centre + model.stylusMass)));
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    for (; n + 4 <= batch.count; n += 4)
+    {
+        __m128 s1, c1, s2, c2, s3, c3;
+        omniSinCos4(_mm_loadu_ps(batch.joint[0] + n), s1, c1);
+        omniSinCos4(_mm_loadu_ps(batch.joint[1] + n), s2, c2);
+        omniSinCos4(_mm_loadu_ps(batch.joint[2] + n), s3, c3);
+        __m128 reach = _mm_mul_ps(L, _mm_add_ps(c2, s3));
+        __m128 Ls2 = _mm_mul_ps(L, s2), Lc3 = _mm_mul_ps(L, c3);
+
+        _mm_storeu_ps(batch.position[0] + n, _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(s1, reach)));
+        _mm_storeu_ps(batch.position[1] + n, _mm_sub_ps(Ls2, Lc3));
+        _mm_storeu_ps(batch.position[2] + n, _mm_mul_ps(c1, reach));
+
+        //the Jacobian (J10 = 0)
+        __m128 J00 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(c1, reach));
+        __m128 J01 = _mm_mul_ps(s1, Ls2);
+        __m128 J02 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(s1, Lc3));
+        __m128 J11 = _mm_mul_ps(L, c2);
+        __m128 J12 = _mm_mul_ps(L, s3);
+        __m128 J20 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(s1, reach));
+        __m128 J21 = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(c1, Ls2));
+        __m128 J22 = _mm_mul_ps(c1, Lc3);
+
+        //J^T F plus gravity
+        __m128 fx = _mm_loadu_ps(batch.force[0] + n);
+        __m128 fy = _mm_loadu_ps(batch.force[1] + n);
+        __m128 fz = _mm_loadu_ps(batch.force[2] + n);
+        _mm_storeu_ps(batch.torque[0] + n, _mm_add_ps(_mm_mul_ps(J00, fx), _mm_mul_ps(J20, fz)));
+        _mm_storeu_ps(batch.torque[1] + n,
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(J01, fx), _mm_mul_ps(J11, fy)),
+                       _mm_add_ps(_mm_mul_ps(J21, fz), _mm_mul_ps(gravity2, c2))));
+        _mm_storeu_ps(batch.torque[2] + n,
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(J02, fx), _mm_mul_ps(J12, fy)),
+                       _mm_add_ps(_mm_mul_ps(J22, fz), _mm_mul_ps(gravity3, s3))));
+
+        //det J, expanded along the first column (J10 = 0)
+        __m128 det = _mm_add_ps(
+            _mm_mul_ps(J00, _mm_sub_ps(_mm_mul_ps(J11, J22), _mm_mul_ps(J12, J21))),
+            _mm_mul_ps(J20, _mm_sub_ps(_mm_mul_ps(J01, J12), _mm_mul_ps(J02, J11))));
+        _mm_storeu_ps(batch.manipulability + n, _mm_and_ps(det, absMask));
+    }
+#endif
+    omniAnalyzeScalar(model, batch, n, batch.count);
+}//END of omniAnalyzeBatch
+
+#endif //OMNI_KINEMATICS_H
@@ -0,0 +1,122 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: PassivityController.h
+
+Description:
+
+  Time-domain passivity observer (PO) and controller (PC) for the force
+  sent to the haptic device (Hannaford & Ryu).
+
+  A virtual environment rendered at a finite rate - a wall that switches
+  on in one step, or the inverse-square Coulomb field near the charge -
+  can give back more energy than the user put in, and then it feels
+  "live" or goes unstable.  Each servo tick the observer integrates the
+  energy the environment has absorbed,
+
+      E(n) = E(n-1) - f(n-1).(x(n) - x(n-1)),
+
+  (the force sent at the previous tick was held while the device moved
+  from x(n-1) to x(n), so this is exact).  E stays positive while the
+  environment behaves passively.  When it becomes negative the controller
+  adds just enough damping, f' = f - alpha v, to dissipate the excess
+  over the next tick; a passive environment is left untouched.  The work
+  per tick is constant.
+
+  f(n-1) must be the force the device really held, so passivityFilter()
+  is the last step before the force is sent (after the watchdog, which
+  may scale it).
+
+  Units follow the device: positions in mm, forces in N (energy in mJ).
+
+******************************************************************************/
+#ifndef PASSIVITY_CONTROLLER_H
+#define PASSIVITY_CONTROLLER_H
+
+#define PASSIVITY_MAX_DAMPING   0.002   //upper limit of the added damping (N.s/mm)
+#define PASSIVITY_MAX_STORED    50.0    //energy the observer may bank (mJ)
+#define PASSIVITY_MIN_SPEED     1e-3    //below this (mm/s) no damping is added
+
+struct PassivityController
+{
+    bool enabled;           //false: observe only, leave the force alone
+    bool hasLast;           //"lastPosition"/"lastTime" are valid
+    double lastPosition[3]; //device position at the previous tick (mm)
+    double lastForce[3];    //force sent at the previous tick (N)
+    double lastTime;        //time of the previous tick (s)
+    double energy;          //observed energy absorbed by the environment (mJ)
+    double damping;         //damping added at the latest tick (N.s/mm)
+    double dissipated;      //total energy removed by the controller (mJ)
+};
+
+//the passivity controller of this program (servo thread only)
+static PassivityController gPassivity = { true, false, {0, 0, 0}, {0, 0, 0}, 0, 0, 0, 0 };
+
+
+//This procedure runs the passivity observer and controller for one servo
+// tick.  "position" is the current device position; "force" is the force
+// the environment wants to send and is corrected in place.
+inline void passivityFilter(PassivityController& pc, double now,
+                            const double position[3], double force[3])
+{
+    int i;
+    if (!pc.hasLast || now <= pc.lastTime)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            pc.lastPosition[i] = position[i];
+            pc.lastForce[i] = force[i];
+        }
+        pc.lastTime = now;
+        pc.hasLast = true;
+        pc.damping = 0;
+        return;
+    }
+
+    double dt = now - pc.lastTime;
+    double displacement[3], velocity[3];
+    for (i = 0; i < 3; i++)
+    {
+        displacement[i] = position[i] - pc.lastPosition[i];
+        velocity[i] = displacement[i] / dt;
+        pc.lastPosition[i] = position[i];
+    }
+    pc.lastTime = now;
+
+    //passivity observer: energy absorbed by the environment
+    pc.energy -= pc.lastForce[0]*displacement[0] + pc.lastForce[1]*displacement[1] +
+                 pc.lastForce[2]*displacement[2];
+
+    //passivity controller: dissipate only the energy that was generated
+    pc.damping = 0;
+    double speedSquared = velocity[0]*velocity[0] + velocity[1]*velocity[1] +
+                          velocity[2]*velocity[2];
+    if (pc.enabled && pc.energy < 0 &&
+        speedSquared > PASSIVITY_MIN_SPEED*PASSIVITY_MIN_SPEED)
+    {
+        double alpha = -pc.energy / (speedSquared * dt);
+        if (alpha > PASSIVITY_MAX_DAMPING)
+            alpha = PASSIVITY_MAX_DAMPING;
+
+        for (i = 0; i < 3; i++)
+            force[i] -= alpha * velocity[i];
+
+        //(the observer sees the actual effect at the next tick)
+        pc.dissipated += alpha * speedSquared * dt;
+        pc.damping = alpha;
+    }
+
+    //don't let a long passive stretch bank enough energy to hide a later
+    // unstable one
+    if (pc.energy > PASSIVITY_MAX_STORED)
+        pc.energy = PASSIVITY_MAX_STORED;
+    //observing only: don't run up a debt that would be paid back all at
+    // once when the controller is turned on
+    if (!pc.enabled && pc.energy < 0)
+        pc.energy = 0;
+
+    for (i = 0; i < 3; i++)
+        pc.lastForce[i] = force[i];
+}//END of passivityFilter
+
+#endif //PASSIVITY_CONTROLLER_H
@@ -0,0 +1,208 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: PortableThread.h
+
+Description:
+
+  Minimal thread helpers (start, join, sleep, yield, CPU affinity) for
+  the background work that must run outside the servo (haptic) thread
+  and the GLUT loop.  They map onto the Win32 API with MSVC and onto
+  pthreads elsewhere.
+
+  Background threads are kept off the core left to the servo thread
+  (threadServoCpu, THREAD_SERVO_CPU unless the real-time set-up of
+  ServoRealtime.h pins the servo thread elsewhere).
+
+******************************************************************************/
+#ifndef PORTABLE_THREAD_H
+#define PORTABLE_THREAD_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <process.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")   //timeBeginPeriod
+typedef HANDLE ThreadHandle;
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+typedef pthread_t ThreadHandle;
+#endif
+
+#define THREAD_SERVO_CPU    0       //the core left to the servo thread (default)
+
+//the body of a thread
+typedef void (*ThreadProc)(void* userData);
+
+//start-up record handed to the new thread
+struct ThreadStart
+{
+    ThreadProc proc;
+    void* userData;
+};
+
+#ifdef _WIN32
+static unsigned __stdcall threadTrampoline(void* start)
+{
+    ThreadStart* threadStart = static_cast<ThreadStart*>(start);
+    ThreadStart copy = *threadStart;
+    delete threadStart;
+    copy.proc(copy.userData);
+    return 0;
+}
+#else
+static void* threadTrampoline(void* start)
+{
+    ThreadStart* threadStart = static_cast<ThreadStart*>(start);
+    ThreadStart copy = *threadStart;
+    delete threadStart;
+    copy.proc(copy.userData);
+    return NULL;
+}
+#endif
+
+
+//This function starts "proc(userData)" on a new thread.  Returns false if
+// the thread can't be created.
+inline bool threadStart(ThreadProc proc, void* userData, ThreadHandle* handle)
+{
+    ThreadStart* start = new ThreadStart;
+    start->proc = proc;
+    start->userData = userData;
+#ifdef _WIN32
+    *handle = (HANDLE)_beginthreadex(NULL, 0, threadTrampoline, start, 0, NULL);
+    if (*handle == 0)
+#else
+    if (pthread_create(handle, NULL, threadTrampoline, start) != 0)
+#endif
+    {
+        delete start;
+        return false;
+    }
+    return true;
+}//END of threadStart
+
+
+//This procedure waits for a thread to finish and releases its handle.
+inline void threadJoin(ThreadHandle handle)
+{
+#ifdef _WIN32
+    WaitForSingleObject(handle, INFINITE);
+    CloseHandle(handle);
+#else
+    pthread_join(handle, NULL);
+#endif
+}//END of threadJoin
+
+
+//This procedure puts the calling thread to sleep for (about) "ms"
+// milliseconds.  On Windows the timer resolution is raised to 1 ms the
+// first time, otherwise Sleep(1) can last a whole 15.6 ms tick.
+inline void threadSleepMs(int ms)
+{
+#ifdef _WIN32
+    static bool timerResolutionSet = false;
+    if (!timerResolutionSet)
+    {
+        timeBeginPeriod(1);
+        timerResolutionSet = true;
+    }
+    Sleep(ms);
+#else
+    struct timespec duration;
+    duration.tv_sec = ms / 1000;
+    duration.tv_nsec = (ms % 1000) * 1000000L;
+    nanosleep(&duration, NULL);
+#endif
+}//END of threadSleepMs
+
+
+//This procedure gives the rest of the calling thread's time slice to
+// another ready thread, if there is one.
+inline void threadYield()
+{
+#ifdef _WIN32
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+
+//This function returns the calling thread (only valid for use by it).
+inline ThreadHandle threadCurrent()
+{
+#ifdef _WIN32
+    return GetCurrentThread();
+#else
+    return pthread_self();
+#endif
+}
+
+
+//This function returns (a reference to) the CPU left to the servo thread.
+inline int& threadServoCpu()
+{
+    static int cpu = THREAD_SERVO_CPU;
+    return cpu;
+}
+
+
+//This function returns the number of logical CPUs.
+inline int threadCpuCount()
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return (count > 0) ? (int)count : 1;
+#endif
+}
+
+
+//This function returns the mask of the CPUs background threads may use:
+// all but the servo thread's (all of them on a single-CPU machine).
+inline unsigned long long threadBackgroundAffinity()
+{
+    int count = threadCpuCount();
+    if (count > 64)
+        count = 64;
+    unsigned long long all = (count == 64) ? ~0ULL : (1ULL << count) - 1;
+    int servo = threadServoCpu();
+    unsigned long long mask = (servo >= 0 && servo < 64) ? all & ~(1ULL << servo) : all;
+    return (mask != 0) ? mask : all;
+}
+
+
+//This function restricts a thread to the CPUs in "mask" (bit n = CPU n).
+// Returns false if the system refuses it or doesn't support it.
+inline bool threadSetAffinity(ThreadHandle handle, unsigned long long mask)
+{
+#ifdef _WIN32
+    return SetThreadAffinityMask(handle, (DWORD_PTR)mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < 64; cpu++)
+        if (mask & (1ULL << cpu))
+            CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(handle, sizeof(set), &set) == 0;
+#else
+    (void)handle;
+    (void)mask;
+    return false;
+#endif
+}//END of threadSetAffinity
+
+#endif //PORTABLE_THREAD_H
@@ -0,0 +1,290 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: PosePredictor.h
+
+Description:
+
+  Predicts where the stylus will be when the frame being drawn actually
+  reaches the screen.  The pose read at the start of a frame is already
+  one draw + swap (and usually part of a refresh) old when it is seen, so
+  a fast moving stylus visibly trails the hand.
+
+  - The servo callback pushes every stylus transform, with its time
+    stamp, into a small lock-free history (PoseHistory).  It is the only
+    writer and never waits.
+  - The graphics loop estimates when the frame will be presented
+    (PresentEstimator: start of the frame plus the average time from the
+    start of a frame to the return of glutSwapBuffers) and extrapolates
+    the newest poses to that moment:
+      position:     linear (constant velocity) or constant acceleration,
+      orientation:  quaternion slerp continued past the newest sample.
+
+  The samples used are POSE_PREDICTION_SPAN servo ticks apart, which
+  averages out the quantization noise of the encoders, and the horizon is
+  limited to POSE_MAX_HORIZON so a stall can't fling the cursor away.
+
+******************************************************************************/
+#ifndef POSE_PREDICTOR_H
+#define POSE_PREDICTOR_H
+
+#include <math.h>
+#include <string.h>
+#include "ServoAtomic.h"
+
+#define POSE_HISTORY_SIZE       64      //servo samples kept (power of 2)
+#define POSE_PREDICTION_SPAN    8       //ticks between the samples used
+#define POSE_MAX_HORIZON        0.05    //longest extrapolation (s)
+#define POSE_DISPLAY_LATENCY    0.0     //extra delay of the display itself (s)
+#define POSE_ESTIMATE_WEIGHT    0.1     //weight of the newest frame timing
+
+//prediction modes (menu)
+enum PosePredictionMode
+{
+    POSE_PREDICT_OFF = 0,       //draw the newest sample as it is
+    POSE_PREDICT_LINEAR,        //constant velocity
+    POSE_PREDICT_ACCELERATION,  //constant acceleration
+    POSE_PREDICT_NUM_MODES
+};
+
+//one stylus pose from the servo callback
+struct PoseSample
+{
+    double time;            //servo clock (s)
+    double transform[16];   //column-major, as HD_CURRENT_TRANSFORM
+};
+
+//poses written by the servo callback, read by the graphics loop
+struct PoseHistory
+{
+    PoseSample samples[POSE_HISTORY_SIZE];
+    volatile long sequence[POSE_HISTORY_SIZE];  //odd while the sample is written
+    volatile long count;                        //samples pushed so far
+};
+
+//when the frames reach the screen (graphics loop only)
+struct PresentEstimator
+{
+    double frameStart;      //start of the current frame (s)
+    double drawToSwap;      //average start of frame -> swap returned (s)
+};
+
+//the history of this program
+static PoseHistory gPoseHistory;
+
+
+//This procedure adds a pose to the history (servo thread only).
+inline void poseHistoryPush(PoseHistory& history, double time, const double transform[16])
+{
+    long index = history.count;
+    long slot = index & (POSE_HISTORY_SIZE - 1);
+    servoStoreRelease(&history.sequence[slot], 2*index + 1);
+    history.samples[slot].time = time;
+    memcpy(history.samples[slot].transform, transform, sizeof(double) * 16);
+    servoStoreRelease(&history.sequence[slot], 2*index + 2);
+    servoStoreRelease(&history.count, index + 1);
+}//END of poseHistoryPush
+
+
+//This function copies sample "index" if it is still in the history and
+// wasn't being written while copied.
+inline bool poseHistoryRead(const PoseHistory& history, long index, PoseSample& sample)
+{
+    long slot = index & (POSE_HISTORY_SIZE - 1);
+    volatile long* sequence = const_cast<volatile long*>(&history.sequence[slot]);
+    if (servoLoadAcquire(sequence) != 2*index + 2)
+        return false;
+    sample = history.samples[slot];
+    return servoLoadAcquire(sequence) == 2*index + 2;
+}
+
+
+//This function copies the newest sample and the samples "span" and
+// 2*"span" ticks before it (oldest first).  Returns how many it got (3, or
+// fewer at start-up, when only the newest is filled in).
+inline int poseHistoryNewest(const PoseHistory& history, int span, PoseSample samples[3])
+{
+    for (int attempt = 0; attempt < 4; attempt++)
+    {
+        long count = servoLoadAcquire(const_cast<volatile long*>(&history.count));
+        if (count == 0)
+            return 0;
+        if (!poseHistoryRead(history, count - 1, samples[2]))
+            continue;
+        if (count - 1 < 2*span)
+            return 1;
+        if (poseHistoryRead(history, count - 1 - span, samples[1]) &&
+            poseHistoryRead(history, count - 1 - 2*span, samples[0]))
+            return 3;
+    }
+    return 0;
+}//END of poseHistoryNewest
+
+
+//--------------------------------------------------------
+// *** Quaternions (w, x, y, z) ***
+//--------------------------------------------------------
+
+//This procedure converts the rotation part of a column-major transform.
+inline void quatFromMatrix(const double m[16], double q[4])
+{
+    //m[col*4 + row]
+    double trace = m[0] + m[5] + m[10];
+    if (trace > 0)
+    {
+        double s = 2 * sqrt(trace + 1);
+        q[0] = 0.25 * s;
+        q[1] = (m[6] - m[9]) / s;
+        q[2] = (m[8] - m[2]) / s;
+        q[3] = (m[1] - m[4]) / s;
+    }
+    else if (m[0] > m[5] && m[0] > m[10])
+    {
+        double s = 2 * sqrt(1 + m[0] - m[5] - m[10]);
+        q[0] = (m[6] - m[9]) / s;
+        q[1] = 0.25 * s;
+        q[2] = (m[4] + m[1]) / s;
+        q[3] = (m[8] + m[2]) / s;
+    }
+    else if (m[5] > m[10])
+    {
+        double s = 2 * sqrt(1 + m[5] - m[0] - m[10]);
+        q[0] = (m[8] - m[2]) / s;
+        q[1] = (m[4] + m[1]) / s;
+        q[2] = 0.25 * s;
+        q[3] = (m[9] + m[6]) / s;
+    }
+    else
+    {
+        double s = 2 * sqrt(1 + m[10] - m[0] - m[5]);
+        q[0] = (m[1] - m[4]) / s;
+        q[1] = (m[8] + m[2]) / s;
+        q[2] = (m[9] + m[6]) / s;
+        q[3] = 0.25 * s;
+    }
+}//END of quatFromMatrix
+
+
+//This procedure writes a (unit) quaternion into the rotation part of a
+// column-major transform.
+inline void quatToMatrix(const double q[4], double m[16])
+{
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    m[0] = 1 - 2*(y*y + z*z);  m[4] = 2*(x*y - w*z);      m[8]  = 2*(x*z + w*y);
+    m[1] = 2*(x*y + w*z);      m[5] = 1 - 2*(x*x + z*z);  m[9]  = 2*(y*z - w*x);
+    m[2] = 2*(x*z - w*y);      m[6] = 2*(y*z + w*x);      m[10] = 1 - 2*(x*x + y*y);
+}
+
+
+//This procedure interpolates from "a" (t = 0) to "b" (t = 1) along the
+// shortest arc; t > 1 continues the rotation past "b".
+inline void quatSlerp(const double a[4], const double b[4], double t, double q[4])
+{
+    double cosAngle = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+    double sign = 1;
+    if (cosAngle < 0)
+    {   //q and -q are the same rotation; take the short way
+        cosAngle = -cosAngle;
+        sign = -1;
+    }
+
+    double wa, wb;
+    if (cosAngle > 0.9999)
+    {   //nearly the same orientation: linear is exact enough
+        wa = 1 - t;
+        wb = t;
+    }
+    else
+    {
+        double angle = acos(cosAngle);
+        double sinAngle = sin(angle);
+        wa = sin((1 - t) * angle) / sinAngle;
+        wb = sin(t * angle) / sinAngle;
+    }
+
+    double length = 0;
+    int i;
+    for (i = 0; i < 4; i++)
+    {
+        q[i] = wa*a[i] + wb*sign*b[i];
+        length += q[i]*q[i];
+    }
+    length = sqrt(length);
+    for (i = 0; i < 4; i++)
+        q[i] /= length;
+}//END of quatSlerp
+
+
+//--------------------------------------------------------
+// *** Prediction ***
+//--------------------------------------------------------
+
+//This procedure extrapolates the poses (oldest first, equally spaced) to
+// time "when" and writes the predicted transform.  With one sample (or
+// POSE_PREDICT_OFF) the newest pose is returned unchanged.
+inline void posePredict(const PoseSample samples[3], int count, int mode, double when,
+                        double transform[16])
+{
+    const PoseSample& newest = samples[count - 1];
+    memcpy(transform, newest.transform, sizeof(double) * 16);
+    if (mode == POSE_PREDICT_OFF || count < 3)
+        return;
+
+    double horizon = when - newest.time;
+    if (horizon <= 0)
+        return;
+    if (horizon > POSE_MAX_HORIZON)
+        horizon = POSE_MAX_HORIZON;
+    double h = newest.time - samples[1].time;
+    if (h <= 0)
+        return;
+
+    //position (column 3)
+    for (int i = 12; i < 15; i++)
+    {
+        double p0 = samples[0].transform[i], p1 = samples[1].transform[i], p2 = newest.transform[i];
+        double velocity = (p2 - p1) / h;
+        if (mode == POSE_PREDICT_ACCELERATION)
+        {
+            double acceleration = (p2 - 2*p1 + p0) / (h*h);
+            velocity += 0.5 * acceleration * h;     //at the newest sample
+            transform[i] = p2 + velocity*horizon + 0.5*acceleration*horizon*horizon;
+        }
+        else
+            transform[i] = p2 + velocity*horizon;
+    }
+
+    //orientation: keep turning at the latest rate
+    double q1[4], q2[4], q[4];
+    quatFromMatrix(samples[1].transform, q1);
+    quatFromMatrix(newest.transform, q2);
+    quatSlerp(q1, q2, 1 + horizon / h, q);
+    quatToMatrix(q, transform);
+}//END of posePredict
+
+
+//This procedure is called at the start of each frame.
+inline void presentFrameStart(PresentEstimator& estimator, double now)
+{
+    estimator.frameStart = now;
+}
+
+
+//This procedure is called when glutSwapBuffers has returned.
+inline void presentFrameSwapped(PresentEstimator& estimator, double now)
+{
+    double duration = now - estimator.frameStart;
+    if (estimator.drawToSwap == 0)
+        estimator.drawToSwap = duration;
+    else
+        estimator.drawToSwap += POSE_ESTIMATE_WEIGHT * (duration - estimator.drawToSwap);
+}
+
+
+//This function returns when the frame started last is expected to be seen.
+inline double presentEstimate(const PresentEstimator& estimator)
+{
+    return estimator.frameStart + estimator.drawToSwap + POSE_DISPLAY_LATENCY;
+}
+
+#endif //POSE_PREDICTOR_H
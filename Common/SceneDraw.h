@@ -0,0 +1,128 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: SceneDraw.h
+
+Description:
+
+  The OpenGL side of SceneGraph.h and TessellationLod.h, shared by both
+  programs: drawing the shapes of a scene graph, and GLU spheres,
+  cylinders and disks tessellated by their size on the screen.
+
+  - A SceneView holds what the tessellation needs to know of the view:
+    the width of the glOrtho volume (set with the projection) and the
+    pixels a unit of it covers (set every frame from the window size,
+    which may have changed).  It also holds the program's procedure for
+    drawing the axes of a frame.
+  - modelviewPixelsPerUnit() scales that by the current modelview
+    matrix, for shapes drawn outside a scene graph; drawScene() scales
+    it by the world matrix of each node.
+
+******************************************************************************/
+#ifndef SCENE_DRAW_H
+#define SCENE_DRAW_H
+
+#include <GL/glut.h>
+#include "SceneGraph.h"
+#include "TessellationLod.h"
+
+struct SceneView
+{
+    double extent;              //width of the glOrtho volume (mm)
+    double pixelsPerUnit;       //pixels a mm of it covers (this frame)
+    void (*drawAxes)();         //draws the X, Y, Z axes of the current frame
+};
+
+
+//This procedure sets up a view of "extent" mm, drawing axes with
+// "drawAxes".
+inline void sceneViewInit(SceneView& view, double extent, void (*drawAxes)())
+{
+    view.extent = extent;
+    view.pixelsPerUnit = 1;
+    view.drawAxes = drawAxes;
+}
+
+
+//This procedure sets the pixels per unit from the size of the window
+// (in pixels), once per frame.
+inline void sceneViewSetWindow(SceneView& view, int width, int height)
+{
+    view.pixelsPerUnit = ((width > height) ? width : height) / view.extent;
+}
+
+
+//This function gives how many pixels a unit of the current (modelview)
+// frame covers on the screen, at most.
+inline double modelviewPixelsPerUnit(const SceneView& view)
+{
+    double modelview[16];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    return view.pixelsPerUnit * lodMatrixScale(modelview);
+}
+
+
+//These procedures draw a GLU sphere, cylinder or disk tessellated by
+// its size on the screen; "pixelsPerUnit" is that of the current frame.
+inline void drawLodSphere(GLUquadricObj* quadObj, double radius, double pixelsPerUnit)
+{
+    int slices, stacks;
+    lodSphere(radius * pixelsPerUnit, slices, stacks);
+    gluSphere(quadObj, radius, slices, stacks);
+}
+
+inline void drawLodCylinder(GLUquadricObj* quadObj, double baseRadius, double topRadius, double height,
+                            double pixelsPerUnit)
+{
+    int slices, stacks;
+    lodCylinder(baseRadius * pixelsPerUnit, topRadius * pixelsPerUnit, height * pixelsPerUnit,
+                slices, stacks);
+    gluCylinder(quadObj, baseRadius, topRadius, height, slices, stacks);
+}
+
+inline void drawLodDisk(GLUquadricObj* quadObj, double innerRadius, double outerRadius, double pixelsPerUnit)
+{
+    int slices, loops;
+    lodDisk(outerRadius * pixelsPerUnit, slices, loops);
+    gluDisk(quadObj, innerRadius, outerRadius, slices, loops);
+}
+
+
+//This procedure draws the shapes of a scene graph (as of its last update).
+inline void drawScene(GLUquadricObj* quadObj, const SceneGraph& graph, const SceneView& view)
+{
+    double pixelsPerUnit = modelviewPixelsPerUnit(view);   //(of the roots)
+    for (int n = 0; n < graph.drawCount; n++)
+    {
+        const SceneNode& node = graph.nodes[graph.drawList[n]];
+        double nodePixels = pixelsPerUnit * lodMatrixScale(node.world);
+        glPushMatrix();
+        glMultMatrixd(node.world);
+        glColor4fv(node.colour);
+        switch (node.shape)
+        {
+        case SCENE_SHAPE_AXES:
+            if (view.drawAxes != NULL)
+                view.drawAxes();
+            break;
+        case SCENE_SHAPE_SPHERE:
+            drawLodSphere(quadObj, node.size[0], nodePixels);
+            break;
+        case SCENE_SHAPE_CYLINDER:
+            drawLodCylinder(quadObj, node.size[0], node.size[1], node.size[2], nodePixels);
+            break;
+        case SCENE_SHAPE_DISK:
+            drawLodDisk(quadObj, node.size[0], node.size[1], nodePixels);
+            break;
+        case SCENE_SHAPE_CUBE:
+            glutSolidCube(node.size[0]);
+            break;
+        case SCENE_SHAPE_WIRE_CUBE:
+            glutWireCube(node.size[0]);
+            break;
+        }
+        glPopMatrix();
+    }
+}//END of drawScene
+
+#endif //SCENE_DRAW_H
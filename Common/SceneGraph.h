@@ -0,0 +1,310 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: SceneGraph.h
+
+Description:
+
+  A small scene graph: a tree of nodes, each with a transform relative
+  to its parent and at most one shape (sphere, cylinder, disk, cube,
+  axes) to draw in its frame.
+
+  - The nodes live in an array the caller gives (no allocation), a
+    parent always before its children, so one pass in order brings every
+    world matrix up to date; no recursion and no matrix stack.
+  - sceneSetLocal() marks a node dirty only if its transform really
+    changed, and sceneUpdate() recomputes the world matrices of the
+    dirty nodes and of the nodes below them only: an arm with one joint
+    turning costs the links past that joint, a room of resting balls
+    nothing.  "moved" tells which world matrices changed.
+  - The update also keeps a flat list of the nodes to draw (a shape,
+    and every node up to the root visible), in the order of the nodes.
+    The renderer walks it with glMultMatrixd on each world matrix, so
+    its pushes and pops always pair up.
+  - The world matrices are plain data: physics and collision code read
+    them with sceneWorld() (from a graph of their own when they run on
+    another thread).
+
+  Matrices are 4x4, column-major (the layout OpenGL uses); matTranslate
+  and matRotate post-multiply exactly like glTranslated and glRotated.
+  The transforms of the nodes are affine (no projection).
+
+******************************************************************************/
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <math.h>
+#include <string.h>
+
+//what a node draws in its frame (the renderer's business: this header
+// knows no OpenGL)
+enum SceneShape
+{
+    SCENE_SHAPE_NONE = 0,       //a frame only
+    SCENE_SHAPE_AXES,           //the X, Y, Z axes
+    SCENE_SHAPE_SPHERE,         //size: radius
+    SCENE_SHAPE_CYLINDER,       //size: base radius, top radius, height (along Z)
+    SCENE_SHAPE_DISK,           //size: inner radius, outer radius
+    SCENE_SHAPE_CUBE,           //size: side
+    SCENE_SHAPE_WIRE_CUBE       //size: side
+};
+
+struct SceneNode
+{
+    int parent;                 //-1 for a root
+    double local[16];           //relative to the parent
+    double world[16];           //relative to the roots (kept by sceneUpdate)
+    bool dirty;                 //"local" changed since the last update
+    bool moved;                 //"world" changed in the last update
+    bool visible;               //(hides the nodes below it too)
+    bool shown;                 //it and every node up to its root visible
+    int shape;
+    double size[3];             //(tessellated by the renderer, see TessellationLod.h)
+    float colour[4];
+};
+
+struct SceneGraph
+{
+    int count, capacity;
+    SceneNode* nodes;
+    int* drawList;              //the nodes to draw, in order
+    int drawCount;
+    bool listDirty;             //a shape or "visible" changed
+    int updated;                //world matrices the last update recomputed
+};
+
+
+//--------------------------------------------------------
+// Matrix helpers
+//--------------------------------------------------------
+
+inline void matIdentity(double m[16])
+{
+    for (int i = 0; i < 16; i++)
+        m[i] = (i % 5 == 0) ? 1.0 : 0.0;
+}//END of matIdentity
+
+
+//m = m * T(x,y,z), the same as glTranslated(x,y,z)
+inline void matTranslate(double m[16], double x, double y, double z)
+{
+    for (int row = 0; row < 4; row++)
+        m[12+row] += m[row]*x + m[4+row]*y + m[8+row]*z;
+}//END of matTranslate
+
+
+//m = m * R(angle,x,y,z), the same as glRotated(angle,x,y,z)
+//The angle is in degrees.
+inline void matRotate(double m[16], double angle, double x, double y, double z)
+{
+    double length = sqrt(x*x + y*y + z*z);
+    if (length == 0)
+        return;
+    x /= length; y /= length; z /= length;
+
+    double radians = angle * (3.14159265358979323846 / 180);
+    double c = cos(radians);
+    double s = sin(radians);
+    double t = 1 - c;
+
+    //the 3x3 rotation, r[column][row]
+    double r[3][3] =
+    {
+        { t*x*x + c,   t*x*y + s*z, t*x*z - s*y },
+        { t*x*y - s*z, t*y*y + c,   t*y*z + s*x },
+        { t*x*z + s*y, t*y*z - s*x, t*z*z + c   }
+    };
+
+    double result[12];
+    for (int col = 0; col < 3; col++)
+        for (int row = 0; row < 4; row++)
+            result[col*4+row] = m[row]*r[col][0] + m[4+row]*r[col][1] + m[8+row]*r[col][2];
+    memcpy(m, result, sizeof(result));
+}//END of matRotate
+
+
+//m = m * S(x,y,z), the same as glScaled(x,y,z)
+inline void matScale(double m[16], double x, double y, double z)
+{
+    for (int row = 0; row < 4; row++)
+    {
+        m[row] *= x;
+        m[4+row] *= y;
+        m[8+row] *= z;
+    }
+}//END of matScale
+
+
+//result = a * b for two affine transforms (bottom rows 0 0 0 1), as
+// the transforms of the nodes are ("result" may not be "a" or "b")
+inline void matMultiplyAffine(const double a[16], const double b[16], double result[16])
+{
+    for (int col = 0; col < 4; col++)
+        for (int row = 0; row < 3; row++)
+            result[col*4+row] = a[row]*b[col*4] + a[4+row]*b[col*4+1] + a[8+row]*b[col*4+2];
+    for (int row = 0; row < 3; row++)
+        result[12+row] += a[12+row];
+    result[3] = result[7] = result[11] = 0;
+    result[15] = 1;
+}//END of matMultiplyAffine
+
+
+//point = m * (x, y, z, 1)
+inline void matTransformPoint(const double m[16], double x, double y, double z, double point[3])
+{
+    for (int row = 0; row < 3; row++)
+        point[row] = m[row]*x + m[4+row]*y + m[8+row]*z + m[12+row];
+}//END of matTransformPoint
+
+
+//--------------------------------------------------------
+// Scene graph
+//--------------------------------------------------------
+
+//This procedure sets up an empty graph on "nodes" and "drawList", room
+// for "capacity" nodes each.
+inline void sceneInit(SceneGraph& graph, SceneNode nodes[], int drawList[], int capacity)
+{
+    graph.count = 0;
+    graph.capacity = capacity;
+    graph.nodes = nodes;
+    graph.drawList = drawList;
+    graph.drawCount = 0;
+    graph.listDirty = false;
+    graph.updated = 0;
+}
+
+
+//This function adds a node under "parent" (-1: a new root), with no
+// transform and no shape.
+//Returns the node, or -1 if the graph is full.
+inline int sceneAddNode(SceneGraph& graph, int parent)
+{
+    if (graph.count == graph.capacity || parent >= graph.count)
+        return -1;
+    int index = graph.count++;
+    SceneNode& node = graph.nodes[index];
+    node.parent = parent;
+    matIdentity(node.local);
+    node.dirty = true;
+    node.moved = false;
+    node.visible = true;
+    node.shown = false;
+    node.shape = SCENE_SHAPE_NONE;
+    node.size[0] = node.size[1] = node.size[2] = 0;
+    node.colour[0] = node.colour[1] = node.colour[2] = node.colour[3] = 1;
+    graph.listDirty = true;
+    return index;
+}//END of sceneAddNode
+
+
+//This procedure removes the nodes from "first" on (with a parent before
+// its children, that is whole subtrees).
+inline void sceneTruncate(SceneGraph& graph, int first)
+{
+    if (first >= graph.count)
+        return;
+    graph.count = first;
+    graph.listDirty = true;
+}
+
+
+//This procedure gives a node a shape to draw (the sizes as listed in
+// SceneShape; the ones the shape doesn't use are 0).
+inline void sceneSetShape(SceneGraph& graph, int index, int shape,
+                          double size0, double size1, double size2)
+{
+    SceneNode& node = graph.nodes[index];
+    node.shape = shape;
+    node.size[0] = size0;
+    node.size[1] = size1;
+    node.size[2] = size2;
+    graph.listDirty = true;
+}
+
+
+inline void sceneSetColour(SceneGraph& graph, int index, float red, float green, float blue, float alpha)
+{
+    float* colour = graph.nodes[index].colour;
+    colour[0] = red;
+    colour[1] = green;
+    colour[2] = blue;
+    colour[3] = alpha;
+}
+
+
+inline void sceneSetVisible(SceneGraph& graph, int index, bool visible)
+{
+    if (graph.nodes[index].visible == visible)
+        return;
+    graph.nodes[index].visible = visible;
+    graph.listDirty = true;
+}
+
+
+//This procedure sets the transform of a node relative to its parent;
+// the node is dirty only if it changed.
+inline void sceneSetLocal(SceneGraph& graph, int index, const double local[16])
+{
+    SceneNode& node = graph.nodes[index];
+    if (memcmp(node.local, local, sizeof(node.local)) == 0)
+        return;
+    memcpy(node.local, local, sizeof(node.local));
+    node.dirty = true;
+}
+
+
+//This procedure sets the transform of a node to a translation.
+inline void sceneSetTranslation(SceneGraph& graph, int index, double x, double y, double z)
+{
+    double local[16];
+    matIdentity(local);
+    local[12] = x;
+    local[13] = y;
+    local[14] = z;
+    sceneSetLocal(graph, index, local);
+}
+
+
+//This procedure brings the world matrices of the dirty nodes (and of
+// the nodes below them) up to date, and the draw list if it changed.
+inline void sceneUpdate(SceneGraph& graph)
+{
+    int updated = 0;
+    for (int i = 0; i < graph.count; i++)
+    {
+        SceneNode& node = graph.nodes[i];
+        const SceneNode* parent = (node.parent >= 0) ? &graph.nodes[node.parent] : 0;
+        node.moved = node.dirty || (parent && parent->moved);
+        node.dirty = false;
+        if (!node.moved)
+            continue;
+        if (parent)
+            matMultiplyAffine(parent->world, node.local, node.world);
+        else
+            memcpy(node.world, node.local, sizeof(node.world));
+        updated++;
+    }
+    graph.updated = updated;
+
+    if (!graph.listDirty)
+        return;
+    graph.drawCount = 0;
+    for (int i = 0; i < graph.count; i++)
+    {
+        SceneNode& node = graph.nodes[i];
+        node.shown = node.visible && (node.parent < 0 || graph.nodes[node.parent].shown);
+        if (node.shown && node.shape != SCENE_SHAPE_NONE)
+            graph.drawList[graph.drawCount++] = i;
+    }
+    graph.listDirty = false;
+}//END of sceneUpdate
+
+
+//This function gives the world matrix of a node (as of the last update).
+inline const double* sceneWorld(const SceneGraph& graph, int index)
+{
+    return graph.nodes[index].world;
+}
+
+#endif //SCENE_GRAPH_H
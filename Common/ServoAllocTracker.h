@@ -0,0 +1,196 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ServoAllocTracker.h
+
+Description:
+
+  The servo (haptic) callback must never touch the heap: an allocation
+  can take a lock or page in memory and stretch a 1 kHz tick.  This
+  module replaces the global operator new/delete (and, with the debug
+  CRT, hooks malloc/realloc/free) and counts every allocation made by a
+  thread while it is inside a "ServoAllocScope".
+
+  - SettingForceCallback opens a ServoAllocScope for its whole body.
+  - gServoAllocCount holds the number of allocations seen inside servo
+    scopes so far; the graphics loop reports it when it changes.
+  - Defining SERVO_ALLOC_FAIL_FAST makes the first such allocation print
+    a message and abort, so a debugger stops right at the culprit.
+  - Defining SERVO_ALLOC_TRACKING_DISABLED compiles the hooks out.
+  - servoAllocTrackerCoverage() tells what the count covers: without
+    the debug CRT only operator new is seen (not malloc), and with the
+    tracking compiled out nothing is; servoAllocPrintCheck() reports a
+    count so that "0" is never claimed for what was not checked.
+
+  NOTE: this header defines the replacement operator new/delete, so it
+  must be included by exactly one source file of the program.
+
+******************************************************************************/
+#ifndef SERVO_ALLOC_TRACKER_H
+#define SERVO_ALLOC_TRACKER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+#ifdef _MSC_VER
+#define SERVO_THREAD_LOCAL __declspec(thread)
+#else
+#define SERVO_THREAD_LOCAL __thread
+#endif
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+
+//number of nested servo scopes open on the calling thread
+static SERVO_THREAD_LOCAL int tServoAllocDepth = 0;
+
+//allocations seen inside servo scopes (only the servo thread writes these)
+static volatile long gServoAllocCount = 0;
+static volatile long gServoAllocLastSize = 0;   //size of the latest one (bytes)
+#ifndef SERVO_ALLOC_TRACKING_DISABLED
+static bool gServoAllocHookInstalled = false;   //malloc is seen too
+#endif
+
+//what the count covers, see servoAllocTrackerCoverage()
+enum ServoAllocCoverage
+{
+    SERVO_ALLOC_UNCHECKED = 0,  //nothing (tracking compiled out)
+    SERVO_ALLOC_NEW_ONLY,       //operator new only
+    SERVO_ALLOC_ALL             //operator new and malloc (debug CRT hook)
+};
+
+//Marks the lifetime of a servo tick: any allocation by this thread while
+// the scope is open is counted (or aborts, with SERVO_ALLOC_FAIL_FAST).
+struct ServoAllocScope
+{
+    ServoAllocScope()  { ++tServoAllocDepth; }
+    ~ServoAllocScope() { --tServoAllocDepth; }
+};
+
+
+//This procedure records one allocation made by the calling thread.
+inline void servoAllocNote(size_t size)
+{
+    if (tServoAllocDepth == 0)
+        return;
+
+    gServoAllocCount = gServoAllocCount + 1;
+    gServoAllocLastSize = (long)size;
+
+#ifdef SERVO_ALLOC_FAIL_FAST
+    //don't recurse into the allocator while reporting
+    tServoAllocDepth = 0;
+    fprintf(stderr, "Heap allocation of %ld bytes inside the servo callback\n",
+            (long)size);
+    abort();
+#endif
+}//END of servoAllocNote
+
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+//Debug CRT hook: sees malloc/calloc/realloc (including the ones made by the
+// C library and the device SDK), not just operator new.
+static int __cdecl servoCrtAllocHook(int allocType, void* userData, size_t size,
+                                     int blockType, long requestNumber,
+                                     const unsigned char* fileName, int lineNumber)
+{
+    //the CRT's own blocks and frees are not of interest
+    if (blockType != _CRT_BLOCK && allocType != _HOOK_FREE)
+        servoAllocNote(size);
+    return TRUE;
+}
+#endif
+
+
+//This procedure installs the malloc hook where the C runtime offers one
+// (the MSVC debug CRT).  operator new is always tracked.
+inline void servoAllocTrackerInstall()
+{
+#if defined(_MSC_VER) && defined(_DEBUG) && !defined(SERVO_ALLOC_TRACKING_DISABLED)
+    _CrtSetAllocHook(servoCrtAllocHook);
+    gServoAllocHookInstalled = true;
+#endif
+}//END of servoAllocTrackerInstall
+
+
+//This function tells which allocations gServoAllocCount counts.
+inline int servoAllocTrackerCoverage()
+{
+#ifdef SERVO_ALLOC_TRACKING_DISABLED
+    return SERVO_ALLOC_UNCHECKED;
+#else
+    return gServoAllocHookInstalled ? SERVO_ALLOC_ALL : SERVO_ALLOC_NEW_ONLY;
+#endif
+}
+
+
+//This procedure prints the result of a check that ran "ticks" servo ticks
+// and saw "allocs" allocations, saying what was not checked.
+inline void servoAllocPrintCheck(FILE* file, long ticks, long allocs)
+{
+    switch (servoAllocTrackerCoverage())
+    {
+    case SERVO_ALLOC_ALL:
+        fprintf(file, "%ld simulated servo ticks: %ld heap allocation(s)\n", ticks, allocs);
+        break;
+    case SERVO_ALLOC_NEW_ONLY:
+        fprintf(file, "%ld simulated servo ticks: %ld operator new allocation(s), "
+                "malloc not checked (needs the MSVC debug CRT)\n", ticks, allocs);
+        break;
+    default:
+        fprintf(file, "%ld simulated servo ticks: heap allocations not checked "
+                "(SERVO_ALLOC_TRACKING_DISABLED)\n", ticks);
+        break;
+    }
+}//END of servoAllocPrintCheck
+
+
+#ifndef SERVO_ALLOC_TRACKING_DISABLED
+
+#if defined(_MSC_VER) && defined(_DEBUG)
+//the CRT hook already counts the malloc made below
+#define SERVO_ALLOC_NOTE_NEW(size)
+#else
+#define SERVO_ALLOC_NOTE_NEW(size) servoAllocNote(size)
+#endif
+
+void* operator new(size_t size)
+{
+    SERVO_ALLOC_NOTE_NEW(size);
+    void* block = malloc(size ? size : 1);
+    if (block == NULL)
+        throw std::bad_alloc();
+    return block;
+}
+
+void* operator new[](size_t size)
+{
+    SERVO_ALLOC_NOTE_NEW(size);
+    void* block = malloc(size ? size : 1);
+    if (block == NULL)
+        throw std::bad_alloc();
+    return block;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    SERVO_ALLOC_NOTE_NEW(size);
+    return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    SERVO_ALLOC_NOTE_NEW(size);
+    return malloc(size ? size : 1);
+}
+
+void operator delete(void* block) throw()                           { free(block); }
+void operator delete[](void* block) throw()                         { free(block); }
+void operator delete(void* block, const std::nothrow_t&) throw()    { free(block); }
+void operator delete[](void* block, const std::nothrow_t&) throw()  { free(block); }
+
+#endif //SERVO_ALLOC_TRACKING_DISABLED
+
+#endif //SERVO_ALLOC_TRACKER_H
@@ -0,0 +1,102 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ServoAtomic.h
+
+Description:
+
+  The few lock-free primitives shared by the servo (haptic) thread and the
+  graphics loop: memory barriers and atomic add/exchange on a "long".
+  They map onto the Win32 Interlocked functions with MSVC and onto the
+  GCC __sync builtins elsewhere.
+
+******************************************************************************/
+#ifndef SERVO_ATOMIC_H
+#define SERVO_ATOMIC_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>     //_ReadWriteBarrier
+#endif
+
+//Full memory barrier: no load or store moves across it (compiler or CPU).
+inline void servoMemoryBarrier()
+{
+#ifdef _WIN32
+    MemoryBarrier();
+#else
+    __sync_synchronize();
+#endif
+}
+
+//Keeps the loads before it before the loads after it (for the readers of
+// sequence-numbered data).  x86/x64 processors never reorder loads with
+// each other, so there only the compiler has to be held back.
+inline void servoReadBarrier()
+{
+#if defined(_M_IX86) || defined(_M_X64)
+    _ReadWriteBarrier();
+#elif defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("" ::: "memory");
+#else
+    servoMemoryBarrier();
+#endif
+}
+
+//Reads a value written by another thread.  Loads after this one can't be
+// moved before it (acquire).
+inline long servoLoadAcquire(volatile long* value)
+{
+    long result = *value;
+    servoMemoryBarrier();
+    return result;
+}
+
+//Publishes a value to other threads.  Stores before this one can't be
+// moved after it (release).
+inline void servoStoreRelease(volatile long* value, long newValue)
+{
+    servoMemoryBarrier();
+    *value = newValue;
+}
+
+//Atomically adds "amount" to "value" and returns the new value.
+inline long servoAtomicAdd(volatile long* value, long amount)
+{
+#ifdef _WIN32
+    return InterlockedExchangeAdd(value, amount) + amount;
+#else
+    return __sync_add_and_fetch(value, amount);
+#endif
+}
+
+//Atomically replaces "value" with "newValue" and returns the old value.
+inline long servoAtomicExchange(volatile long* value, long newValue)
+{
+#ifdef _WIN32
+    return InterlockedExchange(value, newValue);
+#else
+    return __sync_lock_test_and_set(value, newValue);
+#endif
+}
+
+//Atomically replaces "value" with "newValue" if it equals "expected".
+// Returns the value seen before the operation.
+inline long servoAtomicCompareExchange(volatile long* value, long newValue, long expected)
+{
+#ifdef _WIN32
+    return InterlockedCompareExchange(value, newValue, expected);
+#else
+    return __sync_val_compare_and_swap(value, expected, newValue);
+#endif
+}
+
+#endif //SERVO_ATOMIC_H
@@ -0,0 +1,46 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ServoClock.h
+
+Description:
+
+  A monotonic, high resolution clock shared by the servo (haptic) thread,
+  the graphics loop and the benchmark mode.  Reading the clock never
+  allocates and never blocks, so it is safe to call at servo rate.
+
+******************************************************************************/
+#ifndef SERVO_CLOCK_H
+#define SERVO_CLOCK_H
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//Returns the current time in seconds from an arbitrary (fixed) origin.
+inline double servoClockSeconds()
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency = {0};
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}//END of servoClockSeconds
+
+#endif //SERVO_CLOCK_H
@@ -0,0 +1,213 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ServoEventLog.h
+
+Description:
+
+  Non-blocking error/event reporting for the servo (haptic) thread.
+
+  Printing from the 1 kHz callback (e.g. hduPrintError(stderr, ...)) is
+  blocking console I/O inside the real-time loop, and a burst of device
+  errors turns into a burst of stalls.  Instead, the servo thread posts
+  small fixed-size records into a lock-free single-producer /
+  single-consumer ring, and the graphics loop drains the ring and does
+  the printing.
+
+  Posting costs a few stores and never blocks or allocates:
+  - Deduplication: an event identical to the previous one (same type,
+    error codes and message) within SERVO_EVENT_DEDUP_WINDOW seconds of
+    its first occurrence is only counted; the count is logged with the
+    next distinct event (or when the window expires, see servoEventPoll)
+    as "repeated N times".
+  - Rate limiting: a token bucket allows bursts of SERVO_EVENT_BURST
+    events and SERVO_EVENT_RATE events per second after that.  Events
+    over the limit (or posted while the ring is full) are dropped and
+    counted, and the drain reports how many were lost.
+
+  NOTE: "message" must be a string literal (or otherwise outlive the
+  record), since only the pointer is stored.
+
+******************************************************************************/
+#ifndef SERVO_EVENT_LOG_H
+#define SERVO_EVENT_LOG_H
+
+#include <stdio.h>
+#include <HD/hd.h>
+#include <HDU/hduError.h>
+#include "ServoAtomic.h"
+#include "ServoClock.h"
+
+#define SERVO_EVENT_RING_SIZE       256     //records in the ring (power of 2)
+#define SERVO_EVENT_DEDUP_WINDOW    1.0     //seconds identical events are merged
+#define SERVO_EVENT_BURST           20      //events allowed in one burst
+#define SERVO_EVENT_RATE            10      //events per second after a burst
+
+//kinds of events the servo thread reports
+enum ServoEventType
+{
+    SERVO_EVENT_DEVICE_ERROR = 0,   //an error from hdGetError()
+    SERVO_EVENT_NOTICE              //a message with one value attached
+};
+
+//one record in the ring
+struct ServoEvent
+{
+    int type;               //one of ServoEventType
+    HDErrorInfo error;      //device error (SERVO_EVENT_DEVICE_ERROR only)
+    const char* message;    //static text describing the event
+    double value;           //extra value printed with notices
+    double time;            //servoClockSeconds() when it (first) happened
+    long repeats;           //identical events merged into this record
+};
+
+//the ring: written by the servo thread, read by the graphics loop
+static ServoEvent gServoEventRing[SERVO_EVENT_RING_SIZE];
+static volatile long gServoEventHead = 0;       //next record to write
+static volatile long gServoEventTail = 0;       //next record to read
+static volatile long gServoEventsDropped = 0;   //lost to rate limit/full ring
+
+//producer-side state (servo thread only)
+static ServoEvent gServoEventLast;              //last distinct event posted
+static bool gServoEventHasLast = false;
+static double gServoEventTokens = SERVO_EVENT_BURST;
+static double gServoEventLastRefill = 0;
+
+
+//This function pushes one record into the ring (servo thread only).
+// Returns false if the ring is full.
+inline bool servoEventPush(const ServoEvent& event)
+{
+    long head = gServoEventHead;
+    long tail = servoLoadAcquire(&gServoEventTail);
+    if (head - tail >= SERVO_EVENT_RING_SIZE)
+        return false;
+
+    gServoEventRing[head & (SERVO_EVENT_RING_SIZE - 1)] = event;
+    servoStoreRelease(&gServoEventHead, head + 1);
+    return true;
+}//END of servoEventPush
+
+
+//This procedure pushes a record if the rate limiter allows it, and counts
+// it as dropped otherwise (servo thread only).
+inline void servoEventPublish(const ServoEvent& event, double now, long count)
+{
+    //refill the token bucket
+    gServoEventTokens += (now - gServoEventLastRefill) * SERVO_EVENT_RATE;
+    if (gServoEventTokens > SERVO_EVENT_BURST)
+        gServoEventTokens = SERVO_EVENT_BURST;
+    gServoEventLastRefill = now;
+
+    if (gServoEventTokens >= 1 && servoEventPush(event))
+        gServoEventTokens -= 1;
+    else
+        servoAtomicAdd(&gServoEventsDropped, count);
+}//END of servoEventPublish
+
+
+//This procedure publishes the "repeated N times" summary of the last
+// event, if duplicates of it have been merged (servo thread only).
+inline void servoEventFlushRepeats(double now)
+{
+    if (gServoEventHasLast && gServoEventLast.repeats > 0)
+    {
+        servoEventPublish(gServoEventLast, now, gServoEventLast.repeats);
+        gServoEventLast.repeats = 0;
+    }
+}//END of servoEventFlushRepeats
+
+
+//This procedure reports an event from the servo thread.  It never blocks
+// and never allocates.  "error" may be NULL for notices.
+inline void servoEventPost(int type, const HDErrorInfo* error,
+                           const char* message, double value)
+{
+    double now = servoClockSeconds();
+
+    //identical to the last event and within the window: just count it
+    if (gServoEventHasLast &&
+        gServoEventLast.type == type &&
+        gServoEventLast.message == message &&
+        (error == NULL ||
+         (gServoEventLast.error.errorCode == error->errorCode &&
+          gServoEventLast.error.internalErrorCode == error->internalErrorCode)) &&
+        now - gServoEventLast.time < SERVO_EVENT_DEDUP_WINDOW)
+    {
+        gServoEventLast.repeats++;
+        gServoEventLast.value = value;
+        return;
+    }
+
+    //a new event: summarise the duplicates of the previous one first
+    servoEventFlushRepeats(now);
+
+    ServoEvent& event = gServoEventLast;
+    event.type = type;
+    if (error != NULL)
+        event.error = *error;
+    else
+    {
+        event.error.errorCode = HD_SUCCESS;
+        event.error.internalErrorCode = 0;
+    }
+    event.message = message;
+    event.value = value;
+    event.time = now;
+    event.repeats = 0;
+    gServoEventHasLast = true;
+
+    servoEventPublish(event, now, 1);
+}//END of servoEventPost
+
+
+//Convenience wrapper for device errors.
+inline void servoEventPostError(const HDErrorInfo* error, const char* message)
+{
+    servoEventPost(SERVO_EVENT_DEVICE_ERROR, error, message, 0);
+}
+
+
+//This procedure should be called once per servo tick: it publishes the
+// repeat count of the last event once its deduplication window is over.
+inline void servoEventPoll()
+{
+    if (gServoEventHasLast && gServoEventLast.repeats > 0)
+    {
+        double now = servoClockSeconds();
+        if (now - gServoEventLast.time >= SERVO_EVENT_DEDUP_WINDOW)
+        {
+            servoEventFlushRepeats(now);
+            gServoEventHasLast = false;
+        }
+    }
+}//END of servoEventPoll
+
+
+//This procedure prints (and removes) every event in the ring.  It must be
+// called from one (non real-time) thread only, e.g. the GLUT idle loop.
+inline void servoEventDrain(FILE* file)
+{
+    long tail = gServoEventTail;
+    long head = servoLoadAcquire(&gServoEventHead);
+    while (tail != head)
+    {
+        const ServoEvent& event = gServoEventRing[tail & (SERVO_EVENT_RING_SIZE - 1)];
+        if (event.repeats > 0)
+        {   //summary of merged duplicates
+            fprintf(file, "%s: repeated %ld more time(s)\n", event.message, event.repeats);
+        }
+        else if (event.type == SERVO_EVENT_DEVICE_ERROR)
+            hduPrintError(file, &event.error, event.message);
+        else
+            fprintf(file, "%s (%g)\n", event.message, event.value);
+        tail++;
+    }
+    servoStoreRelease(&gServoEventTail, tail);
+
+    long dropped = servoAtomicExchange(&gServoEventsDropped, 0);
+    if (dropped > 0)
+        fprintf(file, "%ld servo event(s) dropped by the rate limiter\n", dropped);
+}//END of servoEventDrain
+
+#endif //SERVO_EVENT_LOG_H
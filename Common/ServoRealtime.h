@@ -0,0 +1,326 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ServoRealtime.h
+
+Description:
+
+  Real-time set-up of a 1 kHz servo thread, and a jitter measurement to
+  check what it buys on a given machine.
+
+  - servoRealtimeLockMemory (once, at start-up) keeps every page of the
+    process in RAM: a page fault in the servo thread costs far more than
+    a tick.  Linux: mlockall(MCL_CURRENT | MCL_FUTURE).  Windows has no
+    equivalent; the working set minimum is raised so the pages aren't
+    trimmed.
+  - servoRealtimeEnterThread, called on the servo thread itself (the
+    OpenHaptics scheduler owns it, so from its first callback), pins it
+    to one CPU, raises its priority and touches SERVO_RT_STACK_PREFAULT
+    bytes of its stack.  Linux: SCHED_FIFO at SERVO_RT_PRIORITY (needs
+    root, CAP_SYS_NICE or an "rtprio" limit).  Windows: HIGH process
+    class and TIME_CRITICAL thread priority (REALTIME would starve the
+    input and disk threads the device itself needs).  The background
+    threads (threadBackgroundAffinity) then keep off that CPU.
+  - servoRealtimeChooseCpu picks the CPU: the first one isolated from
+    the scheduler ("isolcpus=" on Linux), else the last one, as CPU 0
+    takes most of the interrupts.
+  - ServoDeadline wakes a loop the code runs itself at absolute times,
+    so late wake-ups don't add up: clock_nanosleep(TIMER_ABSTIME) on
+    Linux; on Windows Sleep(1) while more than 2 ms remain, then a
+    yielding spin on the performance counter.
+  - servoJitterMeasure runs a 1 kHz loop on a thread of its own (default
+    scheduling or real-time) and records how late every wake-up is.
+
+  This header needs only the C library and POSIX threads on Linux
+  (g++ -pthread; glibc before 2.17 also needs -lrt), and builds warning
+  free with -Wall.  Its users in this repository are "-realtime" and
+  "-rt-jitter" of Assignment2, built on Windows by its solution and on
+  Linux by the CMakeLists.txt at the top of the repository:
+
+      cmake -S . -B build && cmake --build build
+      sudo build/Assignment2 -rt-jitter 10
+
+  (run as root, or with an "rtprio" limit, for the real-time rows;
+  "-rt-jitter" needs no haptic device).
+
+******************************************************************************/
+#ifndef SERVO_REALTIME_H
+#define SERVO_REALTIME_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "PortableThread.h"
+#include "ServoAtomic.h"
+#include "ServoClock.h"
+
+#ifndef _WIN32
+#include <errno.h>
+#include <sys/mman.h>
+#endif
+
+#define SERVO_RT_PRIORITY       80          //SCHED_FIFO priority of the servo thread (1-99)
+#define SERVO_RT_STACK_PREFAULT (64 * 1024) //stack touched before the first tick (bytes)
+#define SERVO_RT_WORKING_SET    (64 * 1024 * 1024)  //Windows working set minimum (bytes)
+#define SERVO_PERIOD_S          0.001       //servo period (s)
+
+//what servoRealtimeEnterThread managed to do
+struct ServoRealtimeStatus
+{
+    int cpu;                //CPU the thread is pinned to, -1 if it isn't
+    bool priority;          //SCHED_FIFO (Linux) / TIME_CRITICAL (Windows) granted
+};
+
+
+//This function locks the memory of the process (see above).  Returns
+// false if the system refuses it.
+inline bool servoRealtimeLockMemory()
+{
+#ifdef _WIN32
+    return SetProcessWorkingSetSize(GetCurrentProcess(), SERVO_RT_WORKING_SET,
+                                    2 * SERVO_RT_WORKING_SET) != 0;
+#else
+    return mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+#endif
+}
+
+
+//This function returns the CPU to give the servo thread.
+inline int servoRealtimeChooseCpu()
+{
+#ifdef __linux__
+    //"isolated" lists the isolcpus= CPUs, e.g. "3" or "2-3"
+    FILE* file = fopen("/sys/devices/system/cpu/isolated", "r");
+    if (file != NULL)
+    {
+        int cpu = -1;
+        if (fscanf(file, "%d", &cpu) != 1)
+            cpu = -1;
+        fclose(file);
+        if (cpu >= 0 && cpu < 64)
+            return cpu;
+    }
+#endif
+    return threadCpuCount() - 1;
+}
+
+
+//This procedure writes to every page of a buffer, so that none of them
+// faults later in the servo thread.
+inline void servoPrefault(void* buffer, size_t bytes)
+{
+    volatile char* p = static_cast<volatile char*>(buffer);
+    for (size_t offset = 0; offset < bytes; offset += 4096)
+        p[offset] = p[offset];
+    if (bytes > 0)
+        p[bytes - 1] = p[bytes - 1];
+}
+
+
+//This procedure touches the next SERVO_RT_STACK_PREFAULT bytes of the
+// stack of the calling thread.
+inline void servoPrefaultStack()
+{
+    volatile char stack[SERVO_RT_STACK_PREFAULT];
+    char touched = 0;
+    for (int offset = 0; offset < SERVO_RT_STACK_PREFAULT; offset += 4096)
+    {
+        stack[offset] = 0;
+        touched |= stack[offset];
+    }
+    (void)touched;
+}
+
+
+//This procedure makes the calling thread the real-time servo thread, on
+// "cpu" (see above).  It makes system calls: call it once, not per tick.
+inline void servoRealtimeEnterThread(int cpu, ServoRealtimeStatus& status)
+{
+    status.cpu = -1;
+    if (cpu >= 0 && cpu < 64 && threadSetAffinity(threadCurrent(), 1ULL << cpu))
+    {
+        status.cpu = cpu;
+        threadServoCpu() = cpu;
+    }
+#ifdef _WIN32
+    status.priority = SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS) != 0 &&
+                      SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL) != 0;
+#else
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = SERVO_RT_PRIORITY;
+    status.priority = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+#endif
+    servoPrefaultStack();
+}//END of servoRealtimeEnterThread
+
+
+//--------------------------------------------------------
+// *** Absolute deadlines ***
+//--------------------------------------------------------
+
+struct ServoDeadline
+{
+    double period;          //(s)
+    double next;            //next wake-up (s, servoClockSeconds)
+#ifndef _WIN32
+    struct timespec wake;   //the same as a CLOCK_MONOTONIC time
+#endif
+};
+
+
+//This procedure sets the first wake-up one period from now.
+inline void servoDeadlineStart(ServoDeadline& deadline, double period)
+{
+    deadline.period = period;
+#ifdef _WIN32
+    deadline.next = servoClockSeconds() + period;
+#else
+    clock_gettime(CLOCK_MONOTONIC, &deadline.wake);
+    deadline.next = deadline.wake.tv_sec + deadline.wake.tv_nsec * 1e-9;
+    deadline.next += period;
+    long step = (long)(period * 1e9);
+    deadline.wake.tv_nsec += step;
+    while (deadline.wake.tv_nsec >= 1000000000L)
+    {
+        deadline.wake.tv_nsec -= 1000000000L;
+        deadline.wake.tv_sec++;
+    }
+#endif
+}//END of servoDeadlineStart
+
+
+//This function sleeps until the next wake-up and schedules the one after.
+// Returns how late it woke up (s).  After an overrun of more than one
+// period the missed wake-ups are dropped rather than run back to back.
+inline double servoDeadlineWait(ServoDeadline& deadline)
+{
+#ifdef _WIN32
+    while (deadline.next - servoClockSeconds() > 0.002)
+        threadSleepMs(1);
+    double now;
+    while ((now = servoClockSeconds()) < deadline.next)
+        threadYield();
+#else
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline.wake, NULL) == EINTR)
+        ;
+    double now = servoClockSeconds();   //(CLOCK_MONOTONIC too)
+#endif
+    double late = now - deadline.next;
+    long periods = 1;
+    if (late > deadline.period)
+        periods += (long)(late / deadline.period);
+    deadline.next += periods * deadline.period;
+#ifndef _WIN32
+    long long step = (long long)(deadline.period * 1e9) * periods;
+    deadline.wake.tv_sec += (time_t)(step / 1000000000LL);
+    deadline.wake.tv_nsec += (long)(step % 1000000000LL);
+    if (deadline.wake.tv_nsec >= 1000000000L)
+    {
+        deadline.wake.tv_nsec -= 1000000000L;
+        deadline.wake.tv_sec++;
+    }
+#endif
+    return late;
+}//END of servoDeadlineWait
+
+
+//--------------------------------------------------------
+// *** Jitter measurement ***
+//--------------------------------------------------------
+
+struct ServoJitterRun
+{
+    //set by the caller
+    bool realtime;          //set the thread up with servoRealtimeEnterThread
+    int cpu;
+    long ticks;
+    ThreadProc work;        //the work of one tick (may be NULL)
+    void* workData;
+
+    //results
+    ServoRealtimeStatus status;
+    float* late;            //wake-up delay of every tick (s)
+    double workTime;        //total time in "work" (s)
+};
+
+struct ServoJitterStats
+{
+    double mean, median, p99, p999, maximum;    //wake-up delay (us)
+    long missed;            //ticks woken up more than a period late
+};
+
+
+//This procedure is the body of the measuring thread.
+inline void servoJitterThread(void* data)
+{
+    ServoJitterRun& run = *static_cast<ServoJitterRun*>(data);
+    run.status.cpu = -1;
+    run.status.priority = false;
+    if (run.realtime)
+        servoRealtimeEnterThread(run.cpu, run.status);
+
+    ServoDeadline deadline;
+    servoDeadlineStart(deadline, SERVO_PERIOD_S);
+    for (long n = 0; n < run.ticks; n++)
+    {
+        run.late[n] = (float)servoDeadlineWait(deadline);
+        if (run.work != NULL)
+        {
+            double start = servoClockSeconds();
+            run.work(run.workData);
+            run.workTime += servoClockSeconds() - start;
+        }
+    }
+}//END of servoJitterThread
+
+
+inline int servoJitterCompare(const void* a, const void* b)
+{
+    float x = *static_cast<const float*>(a), y = *static_cast<const float*>(b);
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+
+//This function runs "run.ticks" ticks on a new thread and summarizes the
+// wake-up delays.  Returns false if the thread can't be started.
+inline bool servoJitterMeasure(ServoJitterRun& run, ServoJitterStats& stats)
+{
+    memset(&stats, 0, sizeof(stats));
+    run.workTime = 0;
+    run.late = (float*)malloc(sizeof(float) * (run.ticks > 0 ? run.ticks : 1));
+    if (run.late == NULL)
+        return false;
+    servoPrefault(run.late, sizeof(float) * run.ticks);
+
+    ThreadHandle thread;
+    if (!threadStart(servoJitterThread, &run, &thread))
+    {
+        free(run.late);
+        run.late = NULL;
+        return false;
+    }
+    threadJoin(thread);
+
+    double sum = 0;
+    for (long n = 0; n < run.ticks; n++)
+    {
+        sum += run.late[n];
+        if (run.late[n] > SERVO_PERIOD_S)
+            stats.missed++;
+    }
+    qsort(run.late, run.ticks, sizeof(float), servoJitterCompare);
+    if (run.ticks > 0)
+    {
+        stats.mean = 1e6 * sum / run.ticks;
+        stats.median = 1e6 * run.late[run.ticks / 2];
+        stats.p99 = 1e6 * run.late[(long)(run.ticks * 0.99)];
+        stats.p999 = 1e6 * run.late[(long)(run.ticks * 0.999)];
+        stats.maximum = 1e6 * run.late[run.ticks - 1];
+    }
+    free(run.late);
+    run.late = NULL;
+    return true;
+}//END of servoJitterMeasure
+
+#endif //SERVO_REALTIME_H
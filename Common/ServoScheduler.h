@@ -0,0 +1,187 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ServoScheduler.h
+
+Description:
+
+  Several tasks run by the one servo callback, each with a priority and a
+  time budget, so that a tick running late sheds the least important
+  work instead of delaying the force.
+
+  - Tasks run in priority order (0 first) and get the time since their
+    last run, so a task that missed ticks can catch up (e.g. integrate
+    over the whole interval).
+  - A task runs only if its budget still fits in what is left of the
+    tick (SERVO_SCHED_TICK_BUDGET, less however late the tick itself
+    started).  When it doesn't:
+      SERVO_TASK_ALWAYS  runs anyway (the force),
+      SERVO_TASK_DEFER   waits for the next tick with time to spare
+                         (e.g. physics, logging: nothing may be lost),
+      SERVO_TASK_SKIP    drops this tick's run (e.g. publishing a state
+                         that the next tick will replace).
+  - Every run is timed: runs, mean and worst cost, runs over budget,
+    deferrals and skips per task, and the ticks that had to shed work.
+    The counters are plain fields, written by the servo thread only;
+    servoSchedulerPrint reads them from any thread (a report may mix two
+    ticks, nothing more).
+
+  Tasks are added before the servo callback is scheduled; running the
+  scheduler never allocates and never blocks.
+
+******************************************************************************/
+#ifndef SERVO_SCHEDULER_H
+#define SERVO_SCHEDULER_H
+
+#include <stdio.h>
+#include <string.h>
+#include "ServoClock.h"
+
+#define SERVO_SCHED_MAX_TASKS   8
+#define SERVO_SCHED_PERIOD      0.001       //servo period (s)
+#define SERVO_SCHED_TICK_BUDGET 0.0007      //time the tasks may use in a tick (s)
+
+enum ServoTaskPolicy
+{
+    SERVO_TASK_ALWAYS = 0,
+    SERVO_TASK_DEFER,
+    SERVO_TASK_SKIP
+};
+
+//the body of a task: "now" is the start of the tick (s, ServoClock.h),
+// "elapsed" the time since the task last ran (s)
+typedef void (*ServoTaskProc)(void* data, double now, double elapsed);
+
+struct ServoTask
+{
+    const char* name;
+    ServoTaskProc proc;
+    void* data;
+    int priority;               //0 runs first
+    int policy;                 //ServoTaskPolicy
+    double budget;              //expected worst cost (s)
+    double lastRun;             //start of the tick it last ran (s)
+
+    //accounting
+    long runs;
+    long overBudget;            //runs that took longer than "budget"
+    long deferred;              //ticks it was deferred from
+    long skipped;               //ticks it was skipped in
+    double totalCost;           //(s)
+    double worstCost;           //(s)
+};
+
+struct ServoScheduler
+{
+    ServoTask tasks[SERVO_SCHED_MAX_TASKS];     //in priority order
+    int count;
+    double tickBudget;          //(s)
+    double lastTick;            //start of the previous tick (s), 0 before the first
+    long ticks;
+    long sheddingTicks;         //ticks in which a task was deferred or skipped
+    double worstTick;           //longest time spent in the tasks of a tick (s)
+};
+
+
+//This procedure empties the scheduler; the tasks may use "tickBudget"
+// seconds of every tick.
+inline void servoSchedulerInit(ServoScheduler& scheduler, double tickBudget)
+{
+    memset(&scheduler, 0, sizeof(scheduler));
+    scheduler.tickBudget = tickBudget;
+}
+
+
+//This function adds a task ("budgetUs" in microseconds), after the tasks
+// of the same priority.  Returns false when the scheduler is full.
+inline bool servoSchedulerAdd(ServoScheduler& scheduler, const char* name, ServoTaskProc proc,
+                              void* data, int priority, ServoTaskPolicy policy, double budgetUs)
+{
+    if (scheduler.count >= SERVO_SCHED_MAX_TASKS)
+        return false;
+    int k = scheduler.count;
+    while (k > 0 && scheduler.tasks[k - 1].priority > priority)
+    {
+        scheduler.tasks[k] = scheduler.tasks[k - 1];
+        k--;
+    }
+    ServoTask& task = scheduler.tasks[k];
+    memset(&task, 0, sizeof(task));
+    task.name = name;
+    task.proc = proc;
+    task.data = data;
+    task.priority = priority;
+    task.policy = policy;
+    task.budget = budgetUs * 1e-6;
+    scheduler.count++;
+    return true;
+}//END of servoSchedulerAdd
+
+
+//This procedure runs one tick that started at "tickStart" (servo thread).
+inline void servoSchedulerRun(ServoScheduler& scheduler, double tickStart)
+{
+    //a tick that starts late has that much less time
+    double available = scheduler.tickBudget;
+    if (scheduler.lastTick > 0 && tickStart - scheduler.lastTick > SERVO_SCHED_PERIOD)
+        available -= tickStart - scheduler.lastTick - SERVO_SCHED_PERIOD;
+    scheduler.lastTick = tickStart;
+    scheduler.ticks++;
+
+    bool shed = false;
+    double now = tickStart;
+    for (int k = 0; k < scheduler.count; k++)
+    {
+        ServoTask& task = scheduler.tasks[k];
+        if (task.policy != SERVO_TASK_ALWAYS && now - tickStart + task.budget > available)
+        {
+            if (task.policy == SERVO_TASK_DEFER)
+                task.deferred++;
+            else
+            {
+                task.skipped++;
+                task.lastRun = tickStart;   //(that tick is given up)
+            }
+            shed = true;
+            continue;
+        }
+
+        double start = now;
+        task.proc(task.data, tickStart, (task.lastRun > 0) ? tickStart - task.lastRun : SERVO_SCHED_PERIOD);
+        task.lastRun = tickStart;
+        now = servoClockSeconds();
+
+        double cost = now - start;
+        task.runs++;
+        task.totalCost += cost;
+        if (cost > task.worstCost)
+            task.worstCost = cost;
+        if (cost > task.budget)
+            task.overBudget++;
+    }
+
+    if (shed)
+        scheduler.sheddingTicks++;
+    if (now - tickStart > scheduler.worstTick)
+        scheduler.worstTick = now - tickStart;
+}//END of servoSchedulerRun
+
+
+//This procedure prints the cost accounting of every task.
+inline void servoSchedulerPrint(const ServoScheduler& scheduler, FILE* file)
+{
+    static const char* policies[] = { "always", "defer", "skip" };
+    fprintf(file, "Servo tasks over %ld tick(s), %ld shedding work, worst tick %.1f us\n",
+            scheduler.ticks, scheduler.sheddingTicks, 1e6 * scheduler.worstTick);
+    fprintf(file, "Task          prio policy  budget(us) runs      mean(us) worst(us) over   deferred skipped\n");
+    for (int k = 0; k < scheduler.count; k++)
+    {
+        const ServoTask& task = scheduler.tasks[k];
+        fprintf(file, "%-13s %4d %-7s %10.1f %-9ld %8.2f %9.1f %-6ld %-8ld %ld\n",
+                task.name, task.priority, policies[task.policy], 1e6 * task.budget, task.runs,
+                (task.runs > 0) ? 1e6 * task.totalCost / task.runs : 0.0, 1e6 * task.worstCost,
+                task.overBudget, task.deferred, task.skipped);
+    }
+}//END of servoSchedulerPrint
+
+#endif //SERVO_SCHEDULER_H
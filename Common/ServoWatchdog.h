@@ -0,0 +1,186 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: ServoWatchdog.h
+
+Description:
+
+  A watchdog for the force sent to the haptic device.  It is fed with the
+  time stamp of every servo tick and with a heartbeat from the graphics
+  loop, and it trips when
+
+  - the servo callback overruns its period for several ticks in a row,
+  - the graphics loop stops updating state the force depends on (e.g.
+    the ball in Assignment1 while it is attached to the stylus), or
+  - the force to be sent is not a finite number (NaN/infinity).
+
+  Once tripped, the output force is ramped smoothly to zero over
+  SERVO_WATCHDOG_RAMP_DOWN seconds (instead of holding the last force or
+  dropping it in one step) and the event is reported through
+  ServoEventLog.h.  After SERVO_WATCHDOG_RECOVER seconds without faults
+  the force is ramped back in over SERVO_WATCHDOG_RAMP_UP seconds.
+
+  Everything here runs in constant time and never blocks or allocates.
+
+******************************************************************************/
+#ifndef SERVO_WATCHDOG_H
+#define SERVO_WATCHDOG_H
+
+#include <float.h>
+#include <math.h>
+#include "ServoAtomic.h"
+#include "ServoClock.h"
+#include "ServoEventLog.h"
+
+#define SERVO_WATCHDOG_PERIOD       0.001   //nominal servo period (s)
+#define SERVO_WATCHDOG_OVERRUN      0.002   //a tick longer than this is an overrun (s)
+#define SERVO_WATCHDOG_MAX_OVERRUNS 5       //consecutive overruns before tripping
+#define SERVO_WATCHDOG_STALE        0.1     //graphics heartbeat timeout (s)
+#define SERVO_WATCHDOG_RAMP_DOWN    0.005   //time to ramp the force to zero (s)
+#define SERVO_WATCHDOG_RAMP_UP      0.25    //time to ramp the force back in (s)
+#define SERVO_WATCHDOG_RECOVER      0.5     //fault free time before ramping up (s)
+
+#ifdef _MSC_VER
+#define servoIsFinite(x) (_finite(x) != 0)
+#else
+#define servoIsFinite(x) (isfinite(x) != 0)
+#endif
+
+//reasons for tripping the watchdog
+enum ServoWatchdogFault
+{
+    SERVO_FAULT_NONE = 0,
+    SERVO_FAULT_OVERRUN,        //sustained servo overruns
+    SERVO_FAULT_STALE,          //graphics stopped updating the scene
+    SERVO_FAULT_NOT_FINITE      //NaN or infinite force
+};
+
+struct ServoWatchdog
+{
+    volatile long graphicsHeartbeat;    //incremented once per frame
+
+    //servo thread only
+    double lastTickTime;        //time stamp of the previous tick
+    int overruns;               //consecutive overrun ticks
+    long lastHeartbeat;         //heartbeat seen at "lastHeartbeatTime"
+    double lastHeartbeatTime;
+    double lastFaultTime;       //time of the latest fault
+    double gain;                //output scale, 1 (healthy) to 0 (tripped)
+    bool tripped;               //true from a fault until fully recovered
+    double lastGoodForce[3];    //last finite force, held while ramping
+};
+
+//the watchdog of this program (the servo thread is the only writer,
+// except for the graphics heartbeat)
+static ServoWatchdog gServoWatchdog = { 0, 0, 0, 0, 0, 0, 1.0, false, {0, 0, 0} };
+
+
+//This procedure is called by the graphics loop once per frame.
+inline void servoWatchdogFeedGraphics(ServoWatchdog& watchdog)
+{
+    servoAtomicAdd(&watchdog.graphicsHeartbeat, 1);
+}
+
+
+//This procedure is called by the servo callback once per tick, after the
+// force has been computed.  It checks the tick timing, the graphics
+// heartbeat (only when "needsGraphics") and the force itself, and scales
+// "force" in place by the current output gain.
+inline void servoWatchdogFilter(ServoWatchdog& watchdog, double now,
+                                double force[3], bool needsGraphics)
+{
+    //first tick: nothing to compare with yet
+    if (watchdog.lastTickTime == 0)
+    {
+        watchdog.lastTickTime = now;
+        watchdog.lastHeartbeatTime = now;
+    }
+    double dt = now - watchdog.lastTickTime;
+    watchdog.lastTickTime = now;
+
+    //--- detect faults ---
+    int fault = SERVO_FAULT_NONE;
+    double faultValue = 0;
+
+    if (dt > SERVO_WATCHDOG_OVERRUN)
+    {
+        if (++watchdog.overruns >= SERVO_WATCHDOG_MAX_OVERRUNS)
+        {
+            fault = SERVO_FAULT_OVERRUN;
+            faultValue = dt * 1000;     //ms
+        }
+    }
+    else
+        watchdog.overruns = 0;
+
+    long heartbeat = watchdog.graphicsHeartbeat;
+    if (heartbeat != watchdog.lastHeartbeat)
+    {
+        watchdog.lastHeartbeat = heartbeat;
+        watchdog.lastHeartbeatTime = now;
+    }
+    else if (needsGraphics && now - watchdog.lastHeartbeatTime > SERVO_WATCHDOG_STALE)
+    {
+        fault = SERVO_FAULT_STALE;
+        faultValue = (now - watchdog.lastHeartbeatTime) * 1000;     //ms
+    }
+
+    bool finite = servoIsFinite(force[0]) && servoIsFinite(force[1]) &&
+                  servoIsFinite(force[2]);
+    if (!finite)
+        fault = SERVO_FAULT_NOT_FINITE;
+    else
+    {
+        watchdog.lastGoodForce[0] = force[0];
+        watchdog.lastGoodForce[1] = force[1];
+        watchdog.lastGoodForce[2] = force[2];
+    }
+
+    //--- report and update the output gain ---
+    if (fault != SERVO_FAULT_NONE)
+    {
+        if (!watchdog.tripped)
+        {
+            if (fault == SERVO_FAULT_OVERRUN)
+                servoEventPost(SERVO_EVENT_NOTICE, NULL,
+                    "Servo watchdog: sustained overruns, ramping force down (tick ms)", faultValue);
+            else if (fault == SERVO_FAULT_STALE)
+                servoEventPost(SERVO_EVENT_NOTICE, NULL,
+                    "Servo watchdog: scene state is stale, ramping force down (ms)", faultValue);
+            else
+                servoEventPost(SERVO_EVENT_NOTICE, NULL,
+                    "Servo watchdog: force is not finite, ramping force down", 0);
+        }
+        watchdog.tripped = true;
+        watchdog.lastFaultTime = now;
+    }
+
+    //a late tick must not turn the ramp into a step
+    double step = (dt < SERVO_WATCHDOG_PERIOD) ? dt : SERVO_WATCHDOG_PERIOD;
+    if (watchdog.tripped)
+    {
+        if (now - watchdog.lastFaultTime < SERVO_WATCHDOG_RECOVER)
+        {
+            watchdog.gain -= step / SERVO_WATCHDOG_RAMP_DOWN;
+            if (watchdog.gain < 0)
+                watchdog.gain = 0;
+        }
+        else
+        {
+            watchdog.gain += step / SERVO_WATCHDOG_RAMP_UP;
+            if (watchdog.gain >= 1)
+            {
+                watchdog.gain = 1;
+                watchdog.tripped = false;
+                servoEventPost(SERVO_EVENT_NOTICE, NULL,
+                    "Servo watchdog: recovered, full force restored", 0);
+            }
+        }
+    }
+
+    //while ramping, a non-finite force is replaced by the last good one
+    for (int i = 0; i < 3; i++)
+        force[i] = (finite ? force[i] : watchdog.lastGoodForce[i]) * watchdog.gain;
+}//END of servoWatchdogFilter
+
+#endif //SERVO_WATCHDOG_H
@@ -0,0 +1,272 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: SmallVector.h
+
+Description:
+
+  3D vectors for the servo hot path.  Arithmetic on hduVector3Dd builds
+  a temporary vector for every operator, so "-400.0*pos/(zoom*sqrDist)"
+  loops over three elements three times and copies the results around.
+  Here the operators only build small "expression" objects; the loop
+  runs once, element by element, when the expression is assigned to a
+  Vec3 (expression templates), and the compiler reduces it to a few
+  multiplications.
+
+      Vec3d r = p - Vec3d(charge.position);     //p, r: Vec3d
+      force += gain * r;
+      double length = vecNorm(r);
+
+  - Vec3<T> works with T = double (Vec3d) or float (Vec3f).  Defining
+    SMALLVEC_SSE evaluates the float version with SSE (four lanes, the
+    fourth unused).  It is off by default: for a lone 3D vector, moving it
+    in and out of the SIMD registers costs more than the three scalar
+    operations it saves (A2/CentreForce/Vec3f: ~10 ns with SSE, ~7 ns
+    without).
+  - A Vec3d is built from any "const double*", so hduVector3Dd and the
+    plain arrays of the device state convert directly.
+  - Division by a scalar multiplies by its reciprocal (one division per
+    expression instead of three), which may differ from "/" in the last
+    bit.
+  - vecCross and vecNormalize aren't element-wise; they return a Vec3.
+  - Expressions refer to the vectors they use: assign them before the end
+    of the statement, don't keep them.
+
+  (Visual Studio 2010 has no constexpr, so everything is plain inline.)
+
+******************************************************************************/
+#ifndef SMALL_VECTOR_H
+#define SMALL_VECTOR_H
+
+#include <math.h>
+
+#ifdef SMALLVEC_SSE
+#include <xmmintrin.h>
+#endif
+
+template <class T> struct Vec3;
+
+//base of every vector expression ("E" is the expression itself)
+template <class T, class E>
+struct VecExpr
+{
+    const E& self() const { return static_cast<const E&>(*this); }
+    T operator[](int i) const { return self().at(i); }
+};
+
+//how an expression holds its operands: vectors by reference, the (small)
+// expression objects by value
+template <class E> struct VecOperand { typedef const E type; };
+template <class T> struct VecOperand< Vec3<T> > { typedef const Vec3<T>& type; };
+
+//element by element evaluation of an expression into an array
+template <class T>
+struct VecBackend
+{
+    static void set(T v[4], T x, T y, T z)
+    {
+        v[0] = x;
+        v[1] = y;
+        v[2] = z;
+        v[3] = 0;
+    }
+    template <class E> static void assign(T v[4], const E& e)
+    {
+        T x = e.at(0), y = e.at(1), z = e.at(2);   //(e may refer to v)
+        v[0] = x;
+        v[1] = y;
+        v[2] = z;
+    }
+};
+
+#ifdef SMALLVEC_SSE
+//(the vector is always written whole: a load of four floats just after
+// separate stores to them would stall)
+template <>
+struct VecBackend<float>
+{
+    static void set(float v[4], float x, float y, float z)
+    {
+        _mm_storeu_ps(v, _mm_set_ps(0, z, y, x));
+    }
+    template <class E> static void assign(float v[4], const E& e)
+    {
+        _mm_storeu_ps(v, e.packet());
+    }
+};
+#endif
+
+
+//--------------------------------------------------------
+// *** The vector ***
+//--------------------------------------------------------
+
+template <class T>
+struct Vec3 : public VecExpr< T, Vec3<T> >
+{
+    T v[4];     //x, y, z (the fourth pads the SIMD lanes)
+
+    Vec3() {}
+    Vec3(T x, T y, T z) { VecBackend<T>::set(v, x, y, z); }
+    explicit Vec3(const T p[3]) { VecBackend<T>::set(v, p[0], p[1], p[2]); }
+    template <class E> Vec3(const VecExpr<T, E>& e) { v[3] = 0; VecBackend<T>::assign(v, e.self()); }
+
+    template <class E> Vec3& operator=(const VecExpr<T, E>& e)
+    {
+        VecBackend<T>::assign(v, e.self());
+        return *this;
+    }
+    template <class E> Vec3& operator+=(const VecExpr<T, E>& e) { return *this = *this + e; }
+    template <class E> Vec3& operator-=(const VecExpr<T, E>& e) { return *this = *this - e; }
+    Vec3& operator*=(double s) { return *this = *this * s; }
+
+    T at(int i) const { return v[i]; }
+    T& operator[](int i) { return v[i]; }
+    T operator[](int i) const { return v[i]; }
+
+    //This procedure copies the vector into a plain array.
+    void store(T p[3]) const { p[0] = v[0]; p[1] = v[1]; p[2] = v[2]; }
+
+#ifdef SMALLVEC_SSE
+    __m128 packet() const { return _mm_loadu_ps(v); }      //(float only)
+#endif
+};
+
+typedef Vec3<double> Vec3d;
+typedef Vec3<float> Vec3f;
+
+
+//--------------------------------------------------------
+// *** Expressions ***
+//--------------------------------------------------------
+
+template <class T, class A, class B>
+struct VecSum : public VecExpr< T, VecSum<T, A, B> >
+{
+    typename VecOperand<A>::type a;
+    typename VecOperand<B>::type b;
+    VecSum(const A& a_, const B& b_) : a(a_), b(b_) {}
+    T at(int i) const { return a.at(i) + b.at(i); }
+#ifdef SMALLVEC_SSE
+    __m128 packet() const { return _mm_add_ps(a.packet(), b.packet()); }
+#endif
+};
+
+template <class T, class A, class B>
+struct VecDifference : public VecExpr< T, VecDifference<T, A, B> >
+{
+    typename VecOperand<A>::type a;
+    typename VecOperand<B>::type b;
+    VecDifference(const A& a_, const B& b_) : a(a_), b(b_) {}
+    T at(int i) const { return a.at(i) - b.at(i); }
+#ifdef SMALLVEC_SSE
+    __m128 packet() const { return _mm_sub_ps(a.packet(), b.packet()); }
+#endif
+};
+
+template <class T, class A>
+struct VecScale : public VecExpr< T, VecScale<T, A> >
+{
+    T s;
+    typename VecOperand<A>::type a;
+    VecScale(T s_, const A& a_) : s(s_), a(a_) {}
+    T at(int i) const { return s * a.at(i); }
+#ifdef SMALLVEC_SSE
+    __m128 packet() const { return _mm_mul_ps(_mm_set1_ps(s), a.packet()); }
+#endif
+};
+
+template <class T, class A, class B>
+inline VecSum<T, A, B> operator+(const VecExpr<T, A>& a, const VecExpr<T, B>& b)
+{
+    return VecSum<T, A, B>(a.self(), b.self());
+}
+
+template <class T, class A, class B>
+inline VecDifference<T, A, B> operator-(const VecExpr<T, A>& a, const VecExpr<T, B>& b)
+{
+    return VecDifference<T, A, B>(a.self(), b.self());
+}
+
+template <class T, class A>
+inline VecScale<T, A> operator-(const VecExpr<T, A>& a)
+{
+    return VecScale<T, A>(T(-1), a.self());
+}
+
+template <class T, class A>
+inline VecScale<T, A> operator*(double s, const VecExpr<T, A>& a)
+{
+    return VecScale<T, A>(T(s), a.self());
+}
+
+template <class T, class A>
+inline VecScale<T, A> operator*(const VecExpr<T, A>& a, double s)
+{
+    return VecScale<T, A>(T(s), a.self());
+}
+
+template <class T, class A>
+inline VecScale<T, A> operator/(const VecExpr<T, A>& a, double s)
+{
+    return VecScale<T, A>(T(1.0 / s), a.self());
+}
+
+//scaling a scaled expression folds the two factors
+template <class T, class A>
+inline VecScale<T, A> operator*(double s, const VecScale<T, A>& a)
+{
+    return VecScale<T, A>(T(s) * a.s, a.a);
+}
+
+template <class T, class A>
+inline VecScale<T, A> operator/(const VecScale<T, A>& a, double s)
+{
+    return VecScale<T, A>(a.s * T(1.0 / s), a.a);
+}
+
+
+//--------------------------------------------------------
+// *** Functions ***
+//--------------------------------------------------------
+
+template <class T, class A, class B>
+inline T vecDot(const VecExpr<T, A>& a, const VecExpr<T, B>& b)
+{
+    return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+}
+
+template <class T, class A>
+inline T vecSqrNorm(const VecExpr<T, A>& a)
+{
+    Vec3<T> v(a);
+    return v.v[0]*v.v[0] + v.v[1]*v.v[1] + v.v[2]*v.v[2];
+}
+
+template <class T, class A>
+inline T vecNorm(const VecExpr<T, A>& a)
+{
+    return sqrt(vecSqrNorm(a));
+}
+
+//This function returns the unit vector along "a" (zero stays zero).
+template <class T, class A>
+inline Vec3<T> vecNormalize(const VecExpr<T, A>& a)
+{
+    Vec3<T> v(a);
+    T length = sqrt(v.v[0]*v.v[0] + v.v[1]*v.v[1] + v.v[2]*v.v[2]);
+    if (length > 0)
+        v = v / length;
+    return v;
+}
+
+template <class T, class A, class B>
+inline Vec3<T> vecCross(const VecExpr<T, A>& a, const VecExpr<T, B>& b)
+{
+    Vec3<T> u(a), w(b);
+    return Vec3<T>(u.v[1]*w.v[2] - u.v[2]*w.v[1],
+                   u.v[2]*w.v[0] - u.v[0]*w.v[2],
+                   u.v[0]*w.v[1] - u.v[1]*w.v[0]);
+}
+
+#endif //SMALL_VECTOR_H
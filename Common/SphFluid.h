@@ -0,0 +1,714 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: SphFluid.h
+
+Description:
+
+  A particle fluid (smoothed-particle hydrodynamics) in a box, stirred by
+  the stylus ball, with the pressure and drag of the fluid on the ball
+  fed back to the device.
+
+  - Every substep (SPH_SUBSTEP) computes the density of each particle
+    from its neighbours, then the pressure, viscosity, gravity and ball
+    forces, then moves the particles ("Mueller 2003" kernels, pressure
+    proportional to the compression).
+  - The neighbours are found with a cell list: a grid of cells one
+    smoothing length across, rebuilt every substep by a counting sort, so
+    a particle only looks at the 27 cells around its own.
+  - Each of the three phases is split in chunks of SPH_CHUNK particles
+    run on the task pool (TaskPool.h); a particle only writes its own
+    values, so there is no lock.
+  - The fluid runs on a thread of its own, as fast as it can up to real
+    time: a substep of thousands of particles takes milliseconds, far
+    from the 1 kHz of the servo callback.  So after every step the thread
+    publishes a local force model of the ball, linear around where the
+    ball was:
+
+        F(x, v) = F0 - stiffness (x - x0) - damping (v - v0)
+
+    (the stiffness from the particles pressed against the ball, the
+    damping from the drag of those around it).  The servo callback
+    (sphServoForce) evaluates the last two models at the current ball
+    position and velocity and blends from one to the other over a step,
+    so the force changes smoothly however slowly the fluid runs, and
+    fades out if the thread stops publishing.
+  - The model is published under a sequence number (odd while written);
+    the servo callback never waits, and keeps the models it has when it
+    catches one being written.  The stylus position and velocity go the
+    other way as plain values (a torn read only mixes two ticks).
+
+  Units are mm, s and g; the forces are scaled by SPH_FORCE_GAIN to be
+  felt (a small ball in real water feels less than 0.1 N).
+
+******************************************************************************/
+#ifndef SPH_FLUID_H
+#define SPH_FLUID_H
+
+#include <math.h>
+#include <string.h>
+#include "PortableThread.h"
+#include "ServoAtomic.h"
+#include "ServoClock.h"
+#include "TaskPool.h"
+
+#define SPH_MAX_PARTICLES   4096
+#define SPH_GRID_MAX        32          //cells per side at most
+#define SPH_CHUNK           256         //particles per task
+#define SPH_SMOOTHING       10.0        //kernel radius h (mm)
+#define SPH_SPACING         5.0         //particle spacing at rest (mm)
+#define SPH_PARTICLE_MASS   0.125       //(g: water, SPH_SPACING^3 mm^3)
+#define SPH_STIFFNESS       8.0e6       //pressure per unit of extra density (mm^2/s^2)
+#define SPH_VISCOSITY       2.0e3       //(mm^2/s)
+#define SPH_GRAVITY         9810.0      //(mm/s^2, along -Y)
+#define SPH_SUBSTEP         0.001       //(s)
+#define SPH_MAX_SUBSTEPS    10          //per round of the thread
+#define SPH_WALL_BOUNCE     0.3         //normal velocity kept off a wall
+#define SPH_BALL_STIFFNESS  5.0e5       //ball repulsion (mm/s^2 per mm; explicit: under 1/SPH_SUBSTEP^2)
+#define SPH_BALL_DRAG       400.0       //no-slip drag at the ball surface (1/s)
+#define SPH_FORCE_GAIN      20.0        //felt force / fluid force
+#define SPH_MAX_FORCE       3.0         //(N)
+#define SPH_MAX_STIFFNESS   0.3         //of the force model (N/mm)
+#define SPH_MODEL_MAX_AGE   0.05        //a model older than this fades out (s)
+#define SPH_VELOCITY_FILTER 0.05        //servo velocity low-pass (per tick)
+
+#define SPH_PI 3.14159265358979323846
+
+enum SphPhase
+{
+    SPH_PHASE_DENSITY = 0,
+    SPH_PHASE_FORCES,
+    SPH_PHASE_INTEGRATE
+};
+
+//the force of the fluid on the ball, linear around one ball state
+struct SphForceModel
+{
+    double time;                //when it was computed (s, ServoClock.h)
+    double position[3];         //x0 (mm)
+    double velocity[3];         //v0 (mm/s)
+    double force[3];            //F0 (N)
+    double stiffness;           //(N/mm)
+    double damping;             //(N s/mm)
+};
+
+//the servo side of the coupling
+struct SphCoupling
+{
+    //published by the fluid thread
+    volatile long sequence;     //odd while "published" is written
+    SphForceModel published;
+
+    //servo callback only
+    SphForceModel previous, latest;     //blending from one to the other
+    double blendStart, blendPeriod;
+    double lastPosition[3], velocity[3], lastTime;
+
+    //written by the servo callback, read by the fluid thread
+    volatile double ball[3];
+    volatile double ballVelocity[3];
+};
+
+struct SphFluid;
+
+//one chunk of particles (a task)
+struct SphChunk
+{
+    SphFluid* fluid;
+    long begin, end;
+    double force[3];            //force of these particles on the ball (g mm/s^2)
+    double stiffness;           //their share of the model coefficients
+    double damping;
+};
+
+struct SphFluid
+{
+    long count;
+    double position[SPH_MAX_PARTICLES][3];
+    double velocity[SPH_MAX_PARTICLES][3];
+    double acceleration[SPH_MAX_PARTICLES][3];
+    double density[SPH_MAX_PARTICLES];
+    double pressure[SPH_MAX_PARTICLES];
+    float drawn[SPH_MAX_PARTICLES][3];  //positions for the graphics loop
+    double halfSize;                    //the box is +-halfSize on every axis
+    double restDensity;
+
+    //cell list
+    int cellsPerSide;
+    double cellSize;
+    long cellStart[SPH_GRID_MAX * SPH_GRID_MAX * SPH_GRID_MAX + 1];
+    long cellParticles[SPH_MAX_PARTICLES];
+    long particleCell[SPH_MAX_PARTICLES];
+
+    //the ball, as of the current substep
+    double ball[3], ballVelocity[3], ballRadius;
+
+    //kernel constants
+    double poly6, spikyGradient, viscosityLaplacian;
+
+    //parallel chunks
+    TaskPool* pool;                     //NULL: run on the calling thread
+    TaskFuture phaseDone;
+    SphChunk chunks[SPH_MAX_PARTICLES / SPH_CHUNK];
+    int phase;
+
+    //the thread
+    SphCoupling coupling;
+    long steps;                         //substeps run
+    volatile long running;              //cleared to stop the thread
+    ThreadHandle thread;
+};
+
+
+//This procedure empties the fluid: a box "size" wide, with a ball of
+// "ballRadius" stirring it.  "pool" may be NULL.
+inline void sphFluidInit(SphFluid& fluid, double size, double ballRadius, TaskPool* pool)
+{
+    memset(&fluid, 0, sizeof(fluid));
+    fluid.halfSize = size / 2;
+    fluid.cellSize = SPH_SMOOTHING;
+    fluid.cellsPerSide = (int)ceil(size / fluid.cellSize);
+    if (fluid.cellsPerSide > SPH_GRID_MAX)
+    {
+        fluid.cellsPerSide = SPH_GRID_MAX;
+        fluid.cellSize = size / SPH_GRID_MAX;
+    }
+    fluid.ballRadius = ballRadius;
+    fluid.pool = pool;
+
+    double h = SPH_SMOOTHING;
+    fluid.poly6 = 315.0 / (64.0 * SPH_PI * pow(h, 9));
+    fluid.spikyGradient = -45.0 / (SPH_PI * pow(h, 6));
+    fluid.viscosityLaplacian = 45.0 / (SPH_PI * pow(h, 6));
+    fluid.restDensity = SPH_PARTICLE_MASS / (SPH_SPACING * SPH_SPACING * SPH_SPACING);
+    for (int k = 0; k < 3; k++)
+        fluid.coupling.ball[k] = fluid.ball[k] = 2 * size;  //(away from the fluid)
+}//END of sphFluidInit
+
+
+//This procedure fills a block of the box with particles at rest, from
+// the bottom up, "count" of them at most.
+inline void sphFluidFill(SphFluid& fluid, long count, double width, double depth)
+{
+    double lo = -fluid.halfSize + SPH_SPACING / 2;
+    long nx = (long)(width / SPH_SPACING), nz = (long)(depth / SPH_SPACING);
+    if (nx < 1) nx = 1;
+    if (nz < 1) nz = 1;
+    for (long n = 0; n < count && fluid.count < SPH_MAX_PARTICLES; n++)
+    {
+        long layer = n / (nx * nz), row = (n / nx) % nz, column = n % nx;
+        double* p = fluid.position[fluid.count];
+        p[0] = -width / 2 + (column + 0.5) * SPH_SPACING;
+        p[1] = lo + layer * SPH_SPACING;
+        p[2] = -depth / 2 + (row + 0.5) * SPH_SPACING;
+        if (p[1] > fluid.halfSize - SPH_SPACING / 2)
+            break;
+        fluid.velocity[fluid.count][0] = fluid.velocity[fluid.count][1] = fluid.velocity[fluid.count][2] = 0;
+        fluid.drawn[fluid.count][0] = (float)p[0];
+        fluid.drawn[fluid.count][1] = (float)p[1];
+        fluid.drawn[fluid.count][2] = (float)p[2];
+        fluid.count++;
+    }
+}//END of sphFluidFill
+
+
+//--------------------------------------------------------
+// *** Cell list ***
+//--------------------------------------------------------
+
+inline int sphCellCoordinate(const SphFluid& fluid, double x)
+{
+    int c = (int)((x + fluid.halfSize) / fluid.cellSize);
+    return (c < 0) ? 0 : (c >= fluid.cellsPerSide) ? fluid.cellsPerSide - 1 : c;
+}
+
+
+//This procedure sorts the particles by cell (counting sort).
+inline void sphBuildCells(SphFluid& fluid)
+{
+    long n = fluid.cellsPerSide;
+    long cells = n * n * n;
+    memset(fluid.cellStart, 0, sizeof(long) * (cells + 1));
+    for (long i = 0; i < fluid.count; i++)
+    {
+        const double* p = fluid.position[i];
+        long cell = (sphCellCoordinate(fluid, p[0]) * n + sphCellCoordinate(fluid, p[1])) * n +
+                    sphCellCoordinate(fluid, p[2]);
+        fluid.particleCell[i] = cell;
+        fluid.cellStart[cell + 1]++;
+    }
+    for (long c = 0; c < cells; c++)
+        fluid.cellStart[c + 1] += fluid.cellStart[c];
+    //(cellStart[c] is used as the fill point of cell c, then shifted back)
+    for (long i = 0; i < fluid.count; i++)
+        fluid.cellParticles[fluid.cellStart[fluid.particleCell[i]]++] = i;
+    for (long c = cells; c > 0; c--)
+        fluid.cellStart[c] = fluid.cellStart[c - 1];
+    fluid.cellStart[0] = 0;
+}//END of sphBuildCells
+
+
+//This procedure finds the range of cells around particle i.
+inline void sphNeighbourCells(const SphFluid& fluid, long i, int lo[3], int hi[3])
+{
+    for (int k = 0; k < 3; k++)
+    {
+        lo[k] = sphCellCoordinate(fluid, fluid.position[i][k] - SPH_SMOOTHING);
+        hi[k] = sphCellCoordinate(fluid, fluid.position[i][k] + SPH_SMOOTHING);
+    }
+}
+
+
+//--------------------------------------------------------
+// *** The phases of a substep ***
+//--------------------------------------------------------
+
+//This function gives the share of a particle's density (at rest) that
+// lies behind a wall "d" away: the poly6 kernel integrated over the half
+// space, 1/2 at the wall, 0 a smoothing length away.  A wall makes up for
+// the particles missing behind it, or those next to it would read as
+// thin and the fluid would pack down against it.
+inline double sphWallShare(double d)
+{
+    double h = SPH_SMOOTHING;
+    if (d >= h)
+        return 0;
+    if (d < 0)
+        d = 0;
+    double h2 = h * h, h4 = h2 * h2, d2 = d * d;
+    //integral of (h^2 - z^2)^4 dz from d to h
+    double atH = h4 * h4 * h * (1 - 4.0/3 + 6.0/5 - 4.0/7 + 1.0/9);
+    double atD = d * (h4 * h4 - d2 * (4.0/3 * h4 * h2 - d2 * (6.0/5 * h4 - d2 * (4.0/7 * h2 - d2 / 9))));
+    return (atH - atD) / (2 * atH);
+}
+
+
+//This procedure computes the density and pressure of particle i.
+inline void sphDensity(SphFluid& fluid, long i)
+{
+    const double* p = fluid.position[i];
+    double h2 = SPH_SMOOTHING * SPH_SMOOTHING, sum = 0;
+    int lo[3], hi[3];
+    sphNeighbourCells(fluid, i, lo, hi);
+    long n = fluid.cellsPerSide;
+    for (int cx = lo[0]; cx <= hi[0]; cx++)
+        for (int cy = lo[1]; cy <= hi[1]; cy++)
+        {
+            long row = (cx * n + cy) * n;
+            for (long b = fluid.cellStart[row + lo[2]]; b < fluid.cellStart[row + hi[2] + 1]; b++)
+            {
+                const double* q = fluid.position[fluid.cellParticles[b]];
+                double d[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+                double r2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+                if (r2 < h2)
+                {
+                    double w = h2 - r2;
+                    sum += w * w * w;   //(itself included)
+                }
+            }
+        }
+    fluid.density[i] = SPH_PARTICLE_MASS * fluid.poly6 * sum;
+    for (int k = 0; k < 3; k++)
+        fluid.density[i] += fluid.restDensity * (sphWallShare(fluid.halfSize + p[k]) +
+                                                 sphWallShare(fluid.halfSize - p[k]));
+    //no suction: a particle at the surface isn't pulled back in
+    double extra = fluid.density[i] - fluid.restDensity;
+    fluid.pressure[i] = (extra > 0) ? SPH_STIFFNESS * extra : 0;
+}//END of sphDensity
+
+
+//This procedure computes the acceleration of particle i, and adds its
+// push on the ball to the chunk.
+inline void sphForces(SphFluid& fluid, long i, SphChunk& chunk)
+{
+    const double* p = fluid.position[i];
+    const double* v = fluid.velocity[i];
+    double a[3] = { 0, -SPH_GRAVITY, 0 };
+    double h = SPH_SMOOTHING;
+    int lo[3], hi[3];
+    sphNeighbourCells(fluid, i, lo, hi);
+    long n = fluid.cellsPerSide;
+    double pi = fluid.pressure[i] / (fluid.density[i] * fluid.density[i]);
+    for (int cx = lo[0]; cx <= hi[0]; cx++)
+        for (int cy = lo[1]; cy <= hi[1]; cy++)
+        {
+            long row = (cx * n + cy) * n;
+            for (long b = fluid.cellStart[row + lo[2]]; b < fluid.cellStart[row + hi[2] + 1]; b++)
+            {
+                long j = fluid.cellParticles[b];
+                if (j == i)
+                    continue;
+                const double* q = fluid.position[j];
+                double d[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+                double r2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+                if (r2 >= h * h || r2 < 1e-12)
+                    continue;
+                double r = sqrt(r2);
+                //pressure (symmetric form, so pairs push equally)
+                double pj = fluid.pressure[j] / (fluid.density[j] * fluid.density[j]);
+                double gradient = fluid.spikyGradient * (h - r) * (h - r) / r;
+                double scale = -SPH_PARTICLE_MASS * (pi + pj) * gradient;
+                //viscosity
+                double viscosity = SPH_VISCOSITY * SPH_PARTICLE_MASS * fluid.viscosityLaplacian *
+                                   (h - r) / fluid.density[j];
+                const double* u = fluid.velocity[j];
+                for (int k = 0; k < 3; k++)
+                    a[k] += scale * d[k] + viscosity * (u[k] - v[k]);
+            }
+        }
+
+    //the ball: pushes the particle out, and drags it along near its surface
+    double d[3] = { p[0] - fluid.ball[0], p[1] - fluid.ball[1], p[2] - fluid.ball[2] };
+    double r = sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]);
+    double reach = fluid.ballRadius + SPH_SPACING;
+    if (r < reach && r > 1e-9)
+    {
+        double push = SPH_BALL_STIFFNESS * (reach - r);
+        double drag = SPH_BALL_DRAG * (reach - r) / SPH_SPACING;
+        if (drag > SPH_BALL_DRAG)
+            drag = SPH_BALL_DRAG;
+        for (int k = 0; k < 3; k++)
+        {
+            double boundary = push * d[k] / r + drag * (fluid.ballVelocity[k] - v[k]);
+            a[k] += boundary;
+            chunk.force[k] -= SPH_PARTICLE_MASS * boundary;     //(the reaction on the ball)
+        }
+        //how that reaction changes with the ball position and velocity
+        chunk.stiffness += SPH_PARTICLE_MASS * SPH_BALL_STIFFNESS / 3;
+        chunk.damping += SPH_PARTICLE_MASS * drag;
+    }
+
+    fluid.acceleration[i][0] = a[0];
+    fluid.acceleration[i][1] = a[1];
+    fluid.acceleration[i][2] = a[2];
+}//END of sphForces
+
+
+//This procedure moves particle i (semi-implicit Euler), off the walls.
+inline void sphIntegrate(SphFluid& fluid, long i)
+{
+    double* p = fluid.position[i];
+    double* v = fluid.velocity[i];
+    double limit = fluid.halfSize - SPH_SPACING / 2;
+    for (int k = 0; k < 3; k++)
+    {
+        v[k] += SPH_SUBSTEP * fluid.acceleration[i][k];
+        p[k] += SPH_SUBSTEP * v[k];
+        if (p[k] < -limit)
+        {
+            p[k] = -limit;
+            if (v[k] < 0) v[k] = -SPH_WALL_BOUNCE * v[k];
+        }
+        else if (p[k] > limit)
+        {
+            p[k] = limit;
+            if (v[k] > 0) v[k] = -SPH_WALL_BOUNCE * v[k];
+        }
+        fluid.drawn[i][k] = (float)p[k];
+    }
+}//END of sphIntegrate
+
+
+//This procedure runs one phase on a chunk of particles.
+inline void sphChunkPhase(SphChunk& chunk)
+{
+    SphFluid& fluid = *chunk.fluid;
+    long i;
+    switch (fluid.phase)
+    {
+        case SPH_PHASE_DENSITY:
+            for (i = chunk.begin; i < chunk.end; i++)
+                sphDensity(fluid, i);
+            break;
+        case SPH_PHASE_FORCES:
+            chunk.force[0] = chunk.force[1] = chunk.force[2] = 0;
+            chunk.stiffness = chunk.damping = 0;
+            for (i = chunk.begin; i < chunk.end; i++)
+                sphForces(fluid, i, chunk);
+            break;
+        case SPH_PHASE_INTEGRATE:
+            for (i = chunk.begin; i < chunk.end; i++)
+                sphIntegrate(fluid, i);
+            break;
+    }
+}//END of sphChunkPhase
+
+
+inline void sphChunkTask(void* data)
+{
+    sphChunkPhase(*static_cast<SphChunk*>(data));
+}
+
+
+//This procedure runs a phase on every chunk, in parallel when there is
+// more than one, and returns once they have all finished.
+inline void sphRunPhase(SphFluid& fluid, int phase)
+{
+    fluid.phase = phase;
+    long chunks = (fluid.count + SPH_CHUNK - 1) / SPH_CHUNK;
+    for (long c = 0; c < chunks; c++)
+    {
+        fluid.chunks[c].fluid = &fluid;
+        fluid.chunks[c].begin = c * SPH_CHUNK;
+        fluid.chunks[c].end = (c + 1 < chunks) ? (c + 1) * SPH_CHUNK : fluid.count;
+    }
+    if (fluid.pool == NULL || chunks <= 1)
+    {
+        for (long c = 0; c < chunks; c++)
+            sphChunkPhase(fluid.chunks[c]);
+        return;
+    }
+    taskFutureReset(fluid.phaseDone);
+    for (long c = 0; c < chunks; c++)
+        taskSubmit(*fluid.pool, sphChunkTask, &fluid.chunks[c], TASK_PRIORITY_HIGH, &fluid.phaseDone);
+    taskFutureWait(*fluid.pool, fluid.phaseDone);
+}//END of sphRunPhase
+
+
+//This procedure runs one substep and fills "model" with the force on the
+// ball (its time is left to the caller).
+inline void sphSubstep(SphFluid& fluid, SphForceModel& model)
+{
+    sphBuildCells(fluid);
+    sphRunPhase(fluid, SPH_PHASE_DENSITY);
+    sphRunPhase(fluid, SPH_PHASE_FORCES);
+    sphRunPhase(fluid, SPH_PHASE_INTEGRATE);
+    fluid.steps++;
+
+    //the force on the ball (g mm/s^2 = 1e-6 N), felt SPH_FORCE_GAIN times
+    double scale = 1e-6 * SPH_FORCE_GAIN;
+    long chunks = (fluid.count + SPH_CHUNK - 1) / SPH_CHUNK;
+    memset(&model, 0, sizeof(model));
+    for (long c = 0; c < chunks; c++)
+    {
+        for (int k = 0; k < 3; k++)
+            model.force[k] += scale * fluid.chunks[c].force[k];
+        model.stiffness += scale * fluid.chunks[c].stiffness;
+        model.damping += scale * fluid.chunks[c].damping;
+    }
+    if (model.stiffness > SPH_MAX_STIFFNESS)
+        model.stiffness = SPH_MAX_STIFFNESS;
+    for (int k = 0; k < 3; k++)
+    {
+        model.position[k] = fluid.ball[k];
+        model.velocity[k] = fluid.ballVelocity[k];
+    }
+}//END of sphSubstep
+
+
+//--------------------------------------------------------
+// *** The fluid thread ***
+//--------------------------------------------------------
+
+//This procedure publishes a force model for the servo callback.
+inline void sphPublish(SphCoupling& coupling, const SphForceModel& model)
+{
+    long sequence = coupling.sequence;
+    servoStoreRelease(&coupling.sequence, sequence + 1);
+    servoMemoryBarrier();
+    coupling.published = model;
+    servoStoreRelease(&coupling.sequence, sequence + 2);
+}
+
+
+//This procedure is the body of the thread: substeps as long as the fluid
+// is behind real time (SPH_MAX_SUBSTEPS at most, then it drops the rest),
+// publishing the force model after each round.
+inline void sphThread(void* data)
+{
+    SphFluid& fluid = *static_cast<SphFluid*>(data);
+    double simulated = servoClockSeconds();
+    while (servoLoadAcquire(&fluid.running))
+    {
+        double now = servoClockSeconds();
+        if (now - simulated < SPH_SUBSTEP)
+        {
+            threadSleepMs(1);
+            continue;
+        }
+        if (now - simulated > SPH_MAX_SUBSTEPS * SPH_SUBSTEP)
+            simulated = now - SPH_MAX_SUBSTEPS * SPH_SUBSTEP;
+
+        //the ball goes from where it was to where the servo callback last
+        // saw it across the substeps (at once if that is a leap: the first
+        // round, or after a pause)
+        double from[3], to[3], leap2 = 0;
+        int k, substeps = (int)((now - simulated) / SPH_SUBSTEP);
+        for (k = 0; k < 3; k++)
+        {
+            from[k] = fluid.ball[k];
+            to[k] = fluid.coupling.ball[k];
+            fluid.ballVelocity[k] = fluid.coupling.ballVelocity[k];
+            leap2 += (to[k] - from[k]) * (to[k] - from[k]);
+        }
+        if (leap2 > SPH_SMOOTHING * SPH_SMOOTHING * substeps * substeps)
+            for (k = 0; k < 3; k++)
+                from[k] = to[k];
+
+        //the model is the average over the round
+        SphForceModel model, substep;
+        memset(&model, 0, sizeof(model));
+        for (int s = 1; s <= substeps; s++)
+        {
+            for (k = 0; k < 3; k++)
+                fluid.ball[k] = from[k] + (to[k] - from[k]) * s / substeps;
+            sphSubstep(fluid, substep);
+            for (k = 0; k < 3; k++)
+            {
+                model.position[k] += substep.position[k] / substeps;
+                model.velocity[k] += substep.velocity[k] / substeps;
+                model.force[k] += substep.force[k] / substeps;
+            }
+            model.stiffness += substep.stiffness / substeps;
+            model.damping += substep.damping / substeps;
+        }
+        simulated += substeps * SPH_SUBSTEP;
+        model.time = servoClockSeconds();
+        sphPublish(fluid.coupling, model);
+    }
+}//END of sphThread
+
+
+//This function starts the thread.  Returns false if it can't be created.
+inline bool sphFluidStart(SphFluid& fluid)
+{
+    if (fluid.running)
+        return true;
+    fluid.running = 1;
+    if (!threadStart(sphThread, &fluid, &fluid.thread))
+    {
+        fluid.running = 0;
+        return false;
+    }
+    threadSetAffinity(fluid.thread, threadBackgroundAffinity());
+    return true;
+}
+
+
+//This procedure stops the thread.
+inline void sphFluidStop(SphFluid& fluid)
+{
+    if (!fluid.running)
+        return;
+    servoStoreRelease(&fluid.running, 0);
+    threadJoin(fluid.thread);
+}
+
+
+//--------------------------------------------------------
+// *** The servo side ***
+//--------------------------------------------------------
+
+//This function evaluates a force model at ball position "x" and velocity "v".
+inline void sphModelForce(const SphForceModel& model, const double x[3], const double v[3], double force[3])
+{
+    for (int k = 0; k < 3; k++)
+        force[k] = model.force[k] - model.stiffness * (x[k] - model.position[k]) -
+                   model.damping * (v[k] - model.velocity[k]);
+}
+
+
+//This procedure blends two force models, "t" of the way from "a" to "b".
+// The models are linear in the ball position and velocity, so the blend
+// is one too, giving the blend of their forces wherever the ball is.
+inline void sphBlendModels(const SphForceModel& a, const SphForceModel& b, double t, SphForceModel& blend)
+{
+    blend.time = a.time + t * (b.time - a.time);
+    blend.stiffness = a.stiffness + t * (b.stiffness - a.stiffness);
+    blend.damping = a.damping + t * (b.damping - a.damping);
+    for (int k = 0; k < 3; k++)
+    {
+        blend.position[k] = a.position[k] + t * (b.position[k] - a.position[k]);
+        blend.velocity[k] = a.velocity[k] + t * (b.velocity[k] - a.velocity[k]);
+        //(the force at the origin, at rest, blended)
+        double atOriginA = a.force[k] + a.stiffness * a.position[k] + a.damping * a.velocity[k];
+        double atOriginB = b.force[k] + b.stiffness * b.position[k] + b.damping * b.velocity[k];
+        blend.force[k] = atOriginA + t * (atOriginB - atOriginA) -
+                         blend.stiffness * blend.position[k] - blend.damping * blend.velocity[k];
+    }
+}//END of sphBlendModels
+
+
+//This function is how far the servo callback is from "previous" to "latest".
+inline double sphBlendFraction(const SphCoupling& coupling, double now)
+{
+    if (coupling.blendPeriod <= 0)
+        return 1;
+    double t = (now - coupling.blendStart) / coupling.blendPeriod;
+    return (t < 0) ? 0 : (t > 1) ? 1 : t;
+}
+
+
+//This procedure gives the force of the fluid on the ball at "position"
+// at time "now" (servo thread only), and tells the fluid thread where
+// the ball is.  A new model is blended in over the time the fluid took
+// to make it, starting from the blend in use, so the force never jumps.
+inline void sphServoForce(SphCoupling& coupling, double now, const double position[3], double force[3])
+{
+    //the ball velocity, low-pass filtered
+    double dt = now - coupling.lastTime;
+    int k;
+    for (k = 0; k < 3; k++)
+    {
+        if (coupling.lastTime > 0 && dt > 0)
+            coupling.velocity[k] += SPH_VELOCITY_FILTER *
+                                    ((position[k] - coupling.lastPosition[k]) / dt - coupling.velocity[k]);
+        coupling.lastPosition[k] = position[k];
+        coupling.ball[k] = position[k];
+        coupling.ballVelocity[k] = coupling.velocity[k];
+    }
+    coupling.lastTime = now;
+
+    //a new model, unless it is being written
+    long sequence = servoLoadAcquire(&coupling.sequence);
+    if (!(sequence & 1))
+    {
+        servoReadBarrier();
+        SphForceModel model = coupling.published;
+        servoReadBarrier();
+        if (coupling.sequence == sequence && model.time > coupling.latest.time)
+        {
+            if (coupling.latest.time > 0)
+            {
+                SphForceModel current;
+                sphBlendModels(coupling.previous, coupling.latest, sphBlendFraction(coupling, now), current);
+                coupling.previous = current;
+                coupling.blendPeriod = model.time - coupling.latest.time;
+            }
+            else
+            {
+                //(the first one comes in from nothing)
+                memset(&coupling.previous, 0, sizeof(coupling.previous));
+                coupling.blendPeriod = SPH_MODEL_MAX_AGE;
+            }
+            coupling.latest = model;
+            coupling.blendStart = now;
+        }
+    }
+    force[0] = force[1] = force[2] = 0;
+    if (coupling.latest.time <= 0)
+        return;
+
+    SphForceModel current;
+    sphBlendModels(coupling.previous, coupling.latest, sphBlendFraction(coupling, now), current);
+    sphModelForce(current, position, coupling.velocity, force);
+
+    //then out, if the fluid thread has stopped publishing
+    double age = now - coupling.latest.time;
+    double fade = (age < SPH_MODEL_MAX_AGE) ? 1 : (age < 2 * SPH_MODEL_MAX_AGE) ? 2 - age / SPH_MODEL_MAX_AGE : 0;
+
+    double magnitude2 = 0;
+    for (k = 0; k < 3; k++)
+    {
+        force[k] *= fade;
+        magnitude2 += force[k] * force[k];
+    }
+    if (magnitude2 > SPH_MAX_FORCE * SPH_MAX_FORCE)
+    {
+        double scale = SPH_MAX_FORCE / sqrt(magnitude2);
+        for (k = 0; k < 3; k++)
+            force[k] *= scale;
+    }
+}//END of sphServoForce
+
+#endif //SPH_FLUID_H
@@ -0,0 +1,389 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: TaskPool.h
+
+Description:
+
+  A pool of worker threads shared by the background computations of the
+  scene (field lines, equipotential meshes, ...), so that each of them
+  doesn't start threads of its own.
+
+  - A task is a procedure and its data, submitted with one of three
+    priorities.  Workers always run the highest priority task they can
+    find.
+  - Every worker has its own queues; a task submitted by a worker goes
+    to its own queue and is taken back last-in first-out (its data is
+    still in the cache).  Tasks submitted by other threads (the graphics
+    loop) go to shared "injection" queues.  An idle worker takes from
+    the injection queues, then steals the oldest task of another worker
+    (work stealing), so one thread splitting a big job in pieces keeps
+    every worker busy.
+  - The workers are kept off the core of the servo thread
+    (threadBackgroundAffinity) and, when there is nothing to do, yield
+    and then sleep 1 ms at a time, so the pool never competes with the
+    servo callback or with MyGlutDisplay.
+  - A TaskFuture counts the tasks submitted with it.  The graphics loop
+    polls it with taskFutureReady (one load, never waits), and can
+    attach a continuation: a task submitted by the worker that finishes
+    the last one.  The future is ready once the continuation has run.
+  - A thread that does wait (taskFutureWait) runs queued tasks itself
+    meanwhile, so work split in short phases (e.g. a physics step) can be
+    waited on from the graphics loop without losing a time slice each.
+
+  The queues are fixed size, with a short spin lock each (the tasks are
+  much longer than the lock is held).  When a queue is full, or the
+  pool has no workers, the task runs at once on the submitting thread.
+
+******************************************************************************/
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "PortableThread.h"
+#include "ServoAtomic.h"
+
+#define TASK_MAX_WORKERS    16      //most worker threads
+#define TASK_QUEUE_SIZE     512     //tasks per queue (power of 2)
+#define TASK_IDLE_SPINS     64      //yields before an idle worker starts sleeping
+
+enum TaskPriority
+{
+    TASK_PRIORITY_HIGH = 0,     //the user is waiting for it (e.g. a change being shown)
+    TASK_PRIORITY_NORMAL,
+    TASK_PRIORITY_LOW,          //housekeeping (e.g. log compression)
+    TASK_NUM_PRIORITIES
+};
+
+//the body of a task
+typedef void (*TaskProc)(void* data);
+
+//completion of a group of tasks (zeroed before use, see taskFutureReset)
+struct TaskFuture
+{
+    volatile long pending;      //tasks not finished (+1 while a continuation is attached)
+    volatile long hasThen;      //a continuation is attached
+    volatile long thenTaken;    //and has been submitted
+    TaskProc thenProc;
+    void* thenData;
+    int thenPriority;
+};
+
+struct Task
+{
+    TaskProc proc;
+    void* data;
+    TaskFuture* future;         //or NULL
+};
+
+//tasks are pushed at "tail"; the owner takes them back from the tail,
+// everybody else from the head
+struct TaskQueue
+{
+    volatile long lock;
+    long head, tail;
+    Task tasks[TASK_QUEUE_SIZE];
+};
+
+struct TaskPool;
+
+struct TaskWorker
+{
+    TaskPool* pool;
+    int index;
+    ThreadHandle thread;
+    TaskQueue queues[TASK_NUM_PRIORITIES];
+};
+
+struct TaskPool
+{
+    TaskWorker* workers;
+    int workerCount;
+    TaskQueue injected[TASK_NUM_PRIORITIES];    //tasks from other threads
+    volatile long running;                      //cleared to stop the workers
+};
+
+//the worker running on this thread, if any
+#ifdef _WIN32
+static __declspec(thread) TaskWorker* tTaskWorker = NULL;
+#else
+static __thread TaskWorker* tTaskWorker = NULL;
+#endif
+
+
+//--------------------------------------------------------
+// *** Queues ***
+//--------------------------------------------------------
+
+inline void taskQueueLock(TaskQueue& queue)
+{
+    while (servoAtomicExchange(&queue.lock, 1) != 0)
+        while (queue.lock != 0)
+            threadYield();
+}
+
+inline void taskQueueUnlock(TaskQueue& queue)
+{
+    servoStoreRelease(&queue.lock, 0);
+}
+
+
+//This function appends a task; returns false when the queue is full.
+inline bool taskQueuePush(TaskQueue& queue, const Task& task)
+{
+    taskQueueLock(queue);
+    bool pushed = queue.tail - queue.head < TASK_QUEUE_SIZE;
+    if (pushed)
+    {
+        queue.tasks[queue.tail & (TASK_QUEUE_SIZE - 1)] = task;
+        queue.tail++;
+    }
+    taskQueueUnlock(queue);
+    return pushed;
+}
+
+
+//This function takes the newest ("newest" true) or the oldest task.
+// Returns false when the queue is empty.
+inline bool taskQueueTake(TaskQueue& queue, bool newest, Task& task)
+{
+    if (queue.tail == queue.head)   //(unlocked look: most queues are empty)
+        return false;
+    taskQueueLock(queue);
+    bool taken = queue.tail != queue.head;
+    if (taken)
+    {
+        if (newest)
+            task = queue.tasks[--queue.tail & (TASK_QUEUE_SIZE - 1)];
+        else
+            task = queue.tasks[queue.head++ & (TASK_QUEUE_SIZE - 1)];
+    }
+    taskQueueUnlock(queue);
+    return taken;
+}
+
+
+//--------------------------------------------------------
+// *** Tasks and futures ***
+//--------------------------------------------------------
+
+//This procedure clears a future before it is used (again).
+inline void taskFutureReset(TaskFuture& future)
+{
+    memset(&future, 0, sizeof(future));
+}
+
+
+//This function tells whether every task of the future (and its
+// continuation) has finished.  It never waits.
+inline bool taskFutureReady(TaskFuture& future)
+{
+    return servoLoadAcquire(&future.pending) == 0;
+}
+
+
+inline void taskRun(TaskPool& pool, const Task& task);
+
+//This procedure queues a task that has already been counted in its future.
+inline void taskEnqueue(TaskPool& pool, const Task& task, int priority)
+{
+    bool queued = false;
+    if (pool.workerCount > 0 && servoLoadAcquire(&pool.running))
+    {
+        if (tTaskWorker != NULL && tTaskWorker->pool == &pool)
+            queued = taskQueuePush(tTaskWorker->queues[priority], task);
+        else
+            queued = taskQueuePush(pool.injected[priority], task);
+    }
+    if (!queued)
+        taskRun(pool, task);
+}
+
+
+//This procedure submits the continuation of a future, once and only
+// once, when nothing but the continuation is pending.
+inline void taskFutureContinue(TaskPool& pool, TaskFuture& future)
+{
+    if (servoLoadAcquire(&future.hasThen) && servoLoadAcquire(&future.pending) == 1 &&
+        servoAtomicExchange(&future.thenTaken, 1) == 0)
+    {
+        Task task = { future.thenProc, future.thenData, &future };
+        taskEnqueue(pool, task, future.thenPriority);   //(its count is the +1)
+    }
+}
+
+
+//This procedure runs a task and reports it to its future.
+inline void taskRun(TaskPool& pool, const Task& task)
+{
+    task.proc(task.data);
+    if (task.future != NULL && servoAtomicAdd(&task.future->pending, -1) == 1)
+        taskFutureContinue(pool, *task.future);
+}
+
+
+//This procedure submits "proc(data)", counted in "future" (may be NULL).
+inline void taskSubmit(TaskPool& pool, TaskProc proc, void* data,
+                       TaskPriority priority, TaskFuture* future)
+{
+    if (future != NULL)
+        servoAtomicAdd(&future->pending, 1);
+    Task task = { proc, data, future };
+    taskEnqueue(pool, task, priority);
+}
+
+
+//This procedure attaches "proc(data)" to run once every task of the
+// future has finished.  Attach it after submitting those tasks (with no
+// task pending it is submitted at once).
+inline void taskFutureThen(TaskPool& pool, TaskFuture& future, TaskProc proc, void* data,
+                           TaskPriority priority)
+{
+    servoAtomicAdd(&future.pending, 1);
+    future.thenProc = proc;
+    future.thenData = data;
+    future.thenPriority = priority;
+    servoStoreRelease(&future.hasThen, 1);
+    taskFutureContinue(pool, future);
+}
+
+
+//--------------------------------------------------------
+// *** Workers ***
+//--------------------------------------------------------
+
+//This function finds a task for a thread that isn't a worker of the
+// pool: by priority, the oldest injected one, else the oldest task of a
+// worker.
+inline bool taskFindShared(TaskPool& pool, Task& task)
+{
+    for (int p = 0; p < TASK_NUM_PRIORITIES; p++)
+    {
+        if (taskQueueTake(pool.injected[p], false, task))
+            return true;
+        for (int w = 0; w < pool.workerCount; w++)
+            if (taskQueueTake(pool.workers[w].queues[p], false, task))
+                return true;
+    }
+    return false;
+}
+
+//This function finds the next task for a worker: by priority, its own
+// newest task, else the oldest injected one, else the oldest task of
+// another worker.
+inline bool taskFind(TaskPool& pool, TaskWorker& worker, Task& task)
+{
+    for (int p = 0; p < TASK_NUM_PRIORITIES; p++)
+    {
+        if (taskQueueTake(worker.queues[p], true, task) ||
+            taskQueueTake(pool.injected[p], false, task))
+            return true;
+        for (int k = 1; k < pool.workerCount; k++)
+        {
+            TaskWorker& victim = pool.workers[(worker.index + k) % pool.workerCount];
+            if (taskQueueTake(victim.queues[p], false, task))
+                return true;
+        }
+    }
+    return false;
+}//END of taskFind
+
+
+//This procedure is the body of a worker thread.
+inline void taskWorkerLoop(void* data)
+{
+    TaskWorker& worker = *static_cast<TaskWorker*>(data);
+    TaskPool& pool = *worker.pool;
+    tTaskWorker = &worker;
+
+    int idle = 0;
+    while (servoLoadAcquire(&pool.running))
+    {
+        Task task;
+        if (taskFind(pool, worker, task))
+        {
+            taskRun(pool, task);
+            idle = 0;
+        }
+        else if (++idle < TASK_IDLE_SPINS)
+            threadYield();
+        else
+            threadSleepMs(1);
+    }
+    tTaskWorker = NULL;
+}//END of taskWorkerLoop
+
+
+//This function starts "workers" threads (0: one per CPU, less the servo's
+// and the graphics loop's) on the CPUs in "affinity" (0: all but the
+// servo's).  Returns false if no thread could be started; the pool then
+// runs every task on the thread submitting it.
+inline bool taskPoolStart(TaskPool& pool, int workers, unsigned long long affinity)
+{
+    memset(&pool, 0, sizeof(pool));
+    if (workers <= 0)
+        workers = threadCpuCount() - 2;
+    if (workers < 1)
+        workers = 1;
+    if (workers > TASK_MAX_WORKERS)
+        workers = TASK_MAX_WORKERS;
+    if (affinity == 0)
+        affinity = threadBackgroundAffinity();
+
+    pool.workers = (TaskWorker*)calloc(workers, sizeof(TaskWorker));
+    if (pool.workers == NULL)
+        return false;
+    pool.running = 1;
+    for (int w = 0; w < workers; w++)
+    {
+        TaskWorker& worker = pool.workers[w];
+        worker.pool = &pool;
+        worker.index = w;
+        //(counted first: the workers already running may steal from it)
+        pool.workerCount = w + 1;
+        if (!threadStart(taskWorkerLoop, &worker, &worker.thread))
+        {
+            pool.workerCount = w;
+            break;
+        }
+        threadSetAffinity(worker.thread, affinity);
+    }
+    return pool.workerCount > 0;
+}//END of taskPoolStart
+
+
+//This procedure stops the workers (at exit).  Tasks still queued are
+// dropped: stop whatever waits on the pool first.
+inline void taskPoolStop(TaskPool& pool)
+{
+    if (!pool.running)
+        return;
+    servoStoreRelease(&pool.running, 0);
+    for (int w = 0; w < pool.workerCount; w++)
+        threadJoin(pool.workers[w].thread);
+    free(pool.workers);
+    pool.workers = NULL;
+    pool.workerCount = 0;
+}
+
+
+//This procedure waits for a future, running queued tasks meanwhile (the
+// ones it waits for may be behind them).  Once nothing is left to take it
+// yields until the tasks still running finish.
+inline void taskFutureWait(TaskPool& pool, TaskFuture& future)
+{
+    bool worker = tTaskWorker != NULL && tTaskWorker->pool == &pool;
+    while (!taskFutureReady(future))
+    {
+        Task task;
+        if (worker ? taskFind(pool, *tTaskWorker, task) : taskFindShared(pool, task))
+            taskRun(pool, task);
+        else if (!servoLoadAcquire(&pool.running))
+            return;     //(nothing will run it any more)
+        else
+            threadYield();
+    }
+}//END of taskFutureWait
+
+#endif //TASK_POOL_H
@@ -0,0 +1,102 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: TessellationLod.h
+
+Description:
+
+  Level of detail of the tessellated shapes (GLU spheres, cylinders and
+  disks), from how large they are on the screen.
+
+  - The projection is orthographic, so a shape covers the same number of
+    pixels at any depth: its size times the scale of its frame times the
+    pixels a unit of the workspace covers (window size over the width of
+    the glOrtho volume).
+  - A circle of r pixels cut in n slices is off by at most
+    r (1 - cos(pi/n)) pixels, at the middle of each chord.  The slices are
+    the fewest that keep this under LOD_TOLERANCE, rounded up to one of a
+    few levels (so a shape being zoomed doesn't change its mesh every
+    frame), from LOD_MIN_SLICES up to LOD_MAX_SLICES.
+  - A sphere takes half as many stacks as slices (the same angle between
+    them); the sides of a cylinder are straight, so its stacks only
+    follow the lighting, one every LOD_STACK_PIXELS along it; a disk is
+    one ring.
+
+  A ball of 5 pixels gets 8 x 4 facets, and one of 500 pixels 64 x 32,
+  instead of 20 x 20 for both.
+
+******************************************************************************/
+#ifndef TESSELLATION_LOD_H
+#define TESSELLATION_LOD_H
+
+#include <math.h>
+
+#define LOD_TOLERANCE       0.5     //most a silhouette may be off (pixels)
+#define LOD_MIN_SLICES      6
+#define LOD_MAX_SLICES      64
+#define LOD_STACK_PIXELS    40.0    //length of a stack of a cylinder (pixels)
+#define LOD_MAX_STACKS      16
+
+//the numbers of slices used
+static const int lodSliceLevels[] = { 6, 8, 12, 16, 24, 32, 48, 64 };
+#define LOD_NUM_LEVELS (sizeof(lodSliceLevels) / sizeof(lodSliceLevels[0]))
+
+
+//This function gives the largest scale of the axes of a (column-major,
+// affine) matrix: how many units of the parent frame a unit of it covers
+// at most.
+inline double lodMatrixScale(const double m[16])
+{
+    double largest = 0;
+    for (int col = 0; col < 3; col++)
+    {
+        double length2 = m[col*4]*m[col*4] + m[col*4+1]*m[col*4+1] + m[col*4+2]*m[col*4+2];
+        if (length2 > largest)
+            largest = length2;
+    }
+    return sqrt(largest);
+}
+
+
+//This function gives the slices for a circle of "pixels" radius.
+inline int lodCircleSlices(double pixels)
+{
+    if (pixels <= LOD_TOLERANCE)
+        return LOD_MIN_SLICES;
+    double needed = 3.14159265358979323846 / acos(1 - LOD_TOLERANCE / pixels);
+    for (unsigned int k = 0; k < LOD_NUM_LEVELS; k++)
+        if (lodSliceLevels[k] >= needed)
+            return lodSliceLevels[k];
+    return LOD_MAX_SLICES;
+}
+
+
+//This procedure gives the slices and stacks of a sphere of "radius"
+// pixels.
+inline void lodSphere(double radius, int& slices, int& stacks)
+{
+    slices = lodCircleSlices(radius);
+    stacks = slices / 2;
+}
+
+
+//This procedure gives the slices and stacks of a cylinder (or cone) of
+// the given radii and height, in pixels.
+inline void lodCylinder(double baseRadius, double topRadius, double height, int& slices, int& stacks)
+{
+    slices = lodCircleSlices((baseRadius > topRadius) ? baseRadius : topRadius);
+    stacks = 1 + (int)(height / LOD_STACK_PIXELS);
+    if (stacks > LOD_MAX_STACKS)
+        stacks = LOD_MAX_STACKS;
+}
+
+
+//This procedure gives the slices and rings of a disk of "outerRadius"
+// pixels.
+inline void lodDisk(double outerRadius, int& slices, int& loops)
+{
+    slices = lodCircleSlices(outerRadius);
+    loops = 1;
+}
+
+#endif //TESSELLATION_LOD_H
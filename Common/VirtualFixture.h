@@ -0,0 +1,362 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: VirtualFixture.h
+
+Description:
+
+  Guidance virtual fixtures: the stylus is pulled toward a 3D path
+  (FIXTURE_GUIDE) or kept inside a tube around it (FIXTURE_TUBE).  The
+  path is a polyline of thousands of segments, usually a Catmull-Rom
+  spline through a few control points tessellated finely.  The guide
+  spring fades out over FIXTURE_GUIDE_BLEND mm past its "influence", so
+  the force never steps.
+
+  The force needs the point of the path closest to the stylus at every
+  servo tick:
+
+  - the segments are kept in a bounding volume hierarchy.  The path is
+    one chain, so the tree needs no sorting: node n covers a range of
+    segments and its children (2n, 2n+1) the two halves of the range,
+    down to FIXTURE_LEAF_SEGMENTS segments.  Only the boxes are stored;
+    the ranges are recomputed on the way down;
+  - the stylus moves little from one tick to the next, so the search
+    starts with the FIXTURE_WINDOW segments around the last closest one
+    (frame-to-frame coherence).  That distance is nearly always the
+    answer already, and the descent then skips every box farther than
+    it: a few dozen boxes and a few leaves instead of every segment.
+
+  The path is built (fixtureBuild*) by the graphics loop while the
+  fixture is off; the servo callback only reads it.
+
+******************************************************************************/
+#ifndef VIRTUAL_FIXTURE_H
+#define VIRTUAL_FIXTURE_H
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FIXTURE_LEAF_SEGMENTS   8       //segments in a leaf of the tree
+#define FIXTURE_WINDOW          4       //segments either side of the last closest one tried first
+#define FIXTURE_MAX_DEPTH       40      //tree depth the search stack allows
+#define FIXTURE_GUIDE_BLEND     10.0    //band past "influence" the guidance fades out over (mm)
+
+enum FixtureMode
+{
+    FIXTURE_OFF = 0,
+    FIXTURE_GUIDE,          //spring toward the path, within "influence" (then fading out)
+    FIXTURE_TUBE            //free inside "radius", spring back beyond it
+};
+
+//bounding box of a node
+struct FixtureBox
+{
+    double lo[3], hi[3];
+};
+
+struct VirtualFixture
+{
+    double (*points)[3];    //the polyline
+    long count;             //points (segments: count - 1)
+    FixtureBox* boxes;      //the tree, node 1 is the root
+    long boxCount;
+
+    int mode;               //FixtureMode
+    double stiffness;       //(N/mm)
+    double radius;          //tube radius (mm)
+    double influence;       //guidance reaches that far from the path (mm)
+    double maxForce;        //(N)
+
+    long last;              //closest segment at the last query (servo thread)
+    long tested;            //segments tested by the last query
+};
+
+
+//--------------------------------------------------------
+// *** Geometry ***
+//--------------------------------------------------------
+
+//This function returns the squared distance from "p" to segment a-b, and
+// the closest point of the segment.
+inline double fixtureSegmentDistance(const double p[3], const double a[3], const double b[3],
+                                     double closest[3])
+{
+    double ab[3] = { b[0]-a[0], b[1]-a[1], b[2]-a[2] };
+    double ap[3] = { p[0]-a[0], p[1]-a[1], p[2]-a[2] };
+    double length2 = ab[0]*ab[0] + ab[1]*ab[1] + ab[2]*ab[2];
+    double t = (length2 > 0) ? (ap[0]*ab[0] + ap[1]*ab[1] + ap[2]*ab[2]) / length2 : 0;
+    if (t < 0) t = 0;
+    if (t > 1) t = 1;
+    double d2 = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        closest[i] = a[i] + t * ab[i];
+        d2 += (p[i] - closest[i]) * (p[i] - closest[i]);
+    }
+    return d2;
+}//END of fixtureSegmentDistance
+
+
+//This function returns the squared distance from "p" to a box (0 inside).
+inline double fixtureBoxDistance(const double p[3], const FixtureBox& box)
+{
+    double d2 = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        double d = (p[i] < box.lo[i]) ? box.lo[i] - p[i] : (p[i] > box.hi[i]) ? p[i] - box.hi[i] : 0;
+        d2 += d * d;
+    }
+    return d2;
+}
+
+
+//--------------------------------------------------------
+// *** Building ***
+//--------------------------------------------------------
+
+//This procedure computes the box of node "node" (segments begin..end-1)
+// and, recursively, of its children.
+inline void fixtureBuildNode(VirtualFixture& fixture, long node, long begin, long end)
+{
+    FixtureBox& box = fixture.boxes[node];
+    if (end - begin <= FIXTURE_LEAF_SEGMENTS)
+    {
+        for (int i = 0; i < 3; i++)
+            box.lo[i] = box.hi[i] = fixture.points[begin][i];
+        for (long k = begin + 1; k <= end; k++)
+            for (int i = 0; i < 3; i++)
+            {
+                if (fixture.points[k][i] < box.lo[i]) box.lo[i] = fixture.points[k][i];
+                if (fixture.points[k][i] > box.hi[i]) box.hi[i] = fixture.points[k][i];
+            }
+        return;
+    }
+    long middle = (begin + end) / 2;
+    fixtureBuildNode(fixture, 2*node, begin, middle);
+    fixtureBuildNode(fixture, 2*node + 1, middle, end);
+    const FixtureBox& left = fixture.boxes[2*node];
+    const FixtureBox& right = fixture.boxes[2*node + 1];
+    for (int i = 0; i < 3; i++)
+    {
+        box.lo[i] = (left.lo[i] < right.lo[i]) ? left.lo[i] : right.lo[i];
+        box.hi[i] = (left.hi[i] > right.hi[i]) ? left.hi[i] : right.hi[i];
+    }
+}//END of fixtureBuildNode
+
+
+//This procedure releases the path and the tree.
+inline void fixtureFree(VirtualFixture& fixture)
+{
+    free(fixture.points);
+    free(fixture.boxes);
+    fixture.points = NULL;
+    fixture.boxes = NULL;
+    fixture.count = fixture.boxCount = 0;
+}
+
+
+//This function makes the fixture follow the polyline "points" (copied)
+// and builds its tree.  Returns false if out of memory or with fewer than
+// two points.
+inline bool fixtureBuildPolyline(VirtualFixture& fixture, const double (*points)[3], long count)
+{
+    fixtureFree(fixture);
+    if (count < 2)
+        return false;
+    long leaves = (count - 1 + FIXTURE_LEAF_SEGMENTS - 1) / FIXTURE_LEAF_SEGMENTS;
+    fixture.boxCount = 4 * leaves + 2;  //(bounds the node numbers of a halving tree)
+    fixture.points = (double (*)[3])malloc(sizeof(double[3]) * count);
+    fixture.boxes = (FixtureBox*)malloc(sizeof(FixtureBox) * fixture.boxCount);
+    if (fixture.points == NULL || fixture.boxes == NULL)
+    {
+        fixtureFree(fixture);
+        return false;
+    }
+    memcpy(fixture.points, points, sizeof(double[3]) * count);
+    fixture.count = count;
+    fixture.last = 0;
+    fixtureBuildNode(fixture, 1, 0, count - 1);
+    return true;
+}//END of fixtureBuildPolyline
+
+
+//This function makes the fixture follow the Catmull-Rom spline through
+// "control" (closed: back to the first point), "steps" segments per span.
+inline bool fixtureBuildSpline(VirtualFixture& fixture, const double (*control)[3], long controlCount,
+                               int steps, bool closed)
+{
+    if (controlCount < 2 || steps < 1)
+        return false;
+    long spans = closed ? controlCount : controlCount - 1;
+    long count = spans * steps + 1;
+    double (*points)[3] = (double (*)[3])malloc(sizeof(double[3]) * count);
+    if (points == NULL)
+        return false;
+
+    long n = 0;
+    for (long span = 0; span < spans; span++)
+    {
+        //the four control points around the span (clamped at the ends when open)
+        long index[4];
+        for (int j = 0; j < 4; j++)
+        {
+            long c = span - 1 + j;
+            if (closed)
+                c = (c + controlCount) % controlCount;
+            else
+                c = (c < 0) ? 0 : (c >= controlCount) ? controlCount - 1 : c;
+            index[j] = c;
+        }
+        const double* p0 = control[index[0]];
+        const double* p1 = control[index[1]];
+        const double* p2 = control[index[2]];
+        const double* p3 = control[index[3]];
+        for (int s = 0; s < steps; s++, n++)
+        {
+            double t = (double)s / steps, t2 = t*t, t3 = t2*t;
+            for (int i = 0; i < 3; i++)
+                points[n][i] = 0.5 * (2*p1[i] + (p2[i] - p0[i]) * t +
+                                      (2*p0[i] - 5*p1[i] + 4*p2[i] - p3[i]) * t2 +
+                                      (3*p1[i] - p0[i] - 3*p2[i] + p3[i]) * t3);
+        }
+    }
+    const double* end = control[closed ? 0 : controlCount - 1];
+    points[n][0] = end[0];
+    points[n][1] = end[1];
+    points[n][2] = end[2];
+
+    bool built = fixtureBuildPolyline(fixture, points, count);
+    free(points);
+    return built;
+}//END of fixtureBuildSpline
+
+
+//--------------------------------------------------------
+// *** Queries (servo rate) ***
+//--------------------------------------------------------
+
+//This function finds the point of the path closest to "p" and returns its
+// squared distance.  It never allocates.
+inline double fixtureClosest(VirtualFixture& fixture, const double p[3], double closest[3])
+{
+    long segments = fixture.count - 1;
+    double best = 1e300, c[3];
+    long bestSegment = fixture.last;
+    fixture.tested = 0;
+
+    //around the last answer first
+    long first = fixture.last - FIXTURE_WINDOW, lastOne = fixture.last + FIXTURE_WINDOW;
+    if (first < 0) first = 0;
+    if (lastOne > segments - 1) lastOne = segments - 1;
+    long k;
+    for (k = first; k <= lastOne; k++)
+    {
+        double d2 = fixtureSegmentDistance(p, fixture.points[k], fixture.points[k + 1], c);
+        fixture.tested++;
+        if (d2 < best)
+        {
+            best = d2;
+            bestSegment = k;
+            closest[0] = c[0]; closest[1] = c[1]; closest[2] = c[2];
+        }
+    }
+
+    //then whatever part of the tree could still be closer
+    long stackNode[FIXTURE_MAX_DEPTH * 2], stackBegin[FIXTURE_MAX_DEPTH * 2], stackEnd[FIXTURE_MAX_DEPTH * 2];
+    int top = 0;
+    stackNode[0] = 1; stackBegin[0] = 0; stackEnd[0] = segments;
+    top = 1;
+    while (top > 0)
+    {
+        top--;
+        long node = stackNode[top], begin = stackBegin[top], end = stackEnd[top];
+        if (fixtureBoxDistance(p, fixture.boxes[node]) >= best)
+            continue;
+        if (end - begin <= FIXTURE_LEAF_SEGMENTS)
+        {
+            for (k = begin; k < end; k++)
+            {
+                if (k >= first && k <= lastOne)
+                    continue;   //(already tested)
+                double d2 = fixtureSegmentDistance(p, fixture.points[k], fixture.points[k + 1], c);
+                fixture.tested++;
+                if (d2 < best)
+                {
+                    best = d2;
+                    bestSegment = k;
+                    closest[0] = c[0]; closest[1] = c[1]; closest[2] = c[2];
+                }
+            }
+            continue;
+        }
+        //the nearer child is popped first
+        long middle = (begin + end) / 2;
+        long left = 2*node, right = 2*node + 1;
+        bool leftFirst = fixtureBoxDistance(p, fixture.boxes[left]) <= fixtureBoxDistance(p, fixture.boxes[right]);
+        long nearNode = leftFirst ? left : right, farNode = leftFirst ? right : left;
+        stackNode[top] = farNode;
+        stackBegin[top] = leftFirst ? middle : begin;
+        stackEnd[top] = leftFirst ? end : middle;
+        top++;
+        stackNode[top] = nearNode;
+        stackBegin[top] = leftFirst ? begin : middle;
+        stackEnd[top] = leftFirst ? middle : end;
+        top++;
+    }
+
+    fixture.last = bestSegment;
+    return best;
+}//END of fixtureClosest
+
+
+//This function is the same query by testing every segment (to check the
+// tree against).
+inline double fixtureClosestBrute(const VirtualFixture& fixture, const double p[3], double closest[3])
+{
+    double best = 1e300, c[3];
+    for (long k = 0; k + 1 < fixture.count; k++)
+    {
+        double d2 = fixtureSegmentDistance(p, fixture.points[k], fixture.points[k + 1], c);
+        if (d2 < best)
+        {
+            best = d2;
+            closest[0] = c[0]; closest[1] = c[1]; closest[2] = c[2];
+        }
+    }
+    return best;
+}
+
+
+//This procedure adds the force of the fixture on the stylus at "p".
+inline void fixtureForce(VirtualFixture& fixture, const double p[3], double force[3])
+{
+    if (fixture.mode == FIXTURE_OFF || fixture.count < 2)
+        return;
+    double closest[3];
+    double distance = sqrt(fixtureClosest(fixture, p, closest));
+    if (distance <= 0)
+        return;
+
+    double magnitude = 0;     //toward the path
+    if (fixture.mode == FIXTURE_GUIDE && distance < fixture.influence + FIXTURE_GUIDE_BLEND)
+    {
+        magnitude = fixture.stiffness * ((distance < fixture.influence) ? distance : fixture.influence);
+        if (magnitude > fixture.maxForce)
+            magnitude = fixture.maxForce;
+        //past "influence" the force tapers to zero (a step there would be
+        // felt as a jolt and inject energy)
+        if (distance > fixture.influence)
+            magnitude *= (fixture.influence + FIXTURE_GUIDE_BLEND - distance) / FIXTURE_GUIDE_BLEND;
+    }
+    else if (fixture.mode == FIXTURE_TUBE && distance > fixture.radius)
+    {
+        magnitude = fixture.stiffness * (distance - fixture.radius);
+        if (magnitude > fixture.maxForce)
+            magnitude = fixture.maxForce;
+    }
+    for (int i = 0; i < 3; i++)
+        force[i] += magnitude * (closest[i] - p[i]) / distance;
+}//END of fixtureForce
+
+#endif //VIRTUAL_FIXTURE_H
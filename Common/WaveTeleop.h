@@ -0,0 +1,483 @@
+/****************************************************************************
+                  (ENSC488 - PHANTOM Haptic Device Sample Code)
+
+Module Name: WaveTeleop.h
+
+Description:
+
+  Wave-variable coupling for splitting the haptic loop in two: a "device"
+  side that owns the haptic device (and runs the servo callback) and a
+  "simulation" side that owns the virtual environment.  The two exchange
+  one packet per tick in each direction over a WaveChannel: either UDP
+  (two processes, possibly on two hosts) or an in-process loopback with
+  a configurable delay and jitter (for testing).
+
+  Sending forces/positions directly over a delayed link makes the loop
+  unstable at a few ms of delay.  Instead the velocity and force at each
+  port are encoded as wave variables (Niemeyer & Slotine),
+
+      u = (b.v + F) / sqrt(2b),     v = (b.v - F) / sqrt(2b),
+
+  with b the wave impedance, and the power entering a port is
+  (u^2 - v^2)/2.  A constant delay then stores energy but never creates
+  it, so the coupled system stays passive (and stable with a passive
+  user and environment) for any delay.
+
+  Variable delay, jitter, lost packets and holding the last wave can
+  still create energy, so every packet carries the total wave energy
+  sent so far.  The receiver never lets the energy it has taken out of
+  the channel exceed what the other side put in, scaling the incoming
+  wave down (to zero if needed) when it would.
+
+  The coupling does not correct position drift: after contact with a
+  stiff object the proxy can settle a few mm away from the device.
+
+  Units follow the device: positions in mm, forces in N.
+
+******************************************************************************/
+#ifndef WAVE_TELEOP_H
+#define WAVE_TELEOP_H
+
+#ifdef _WIN32
+#include <winsock2.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET WaveSocket;
+#define WAVE_INVALID_SOCKET INVALID_SOCKET
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <unistd.h>
+typedef int WaveSocket;
+#define WAVE_INVALID_SOCKET (-1)
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include "ServoAtomic.h"
+
+#define WAVE_IMPEDANCE          0.002   //b, wave impedance (N.s/mm)
+#define WAVE_LOOPBACK_CAPACITY  4096    //packets in flight per direction (power of 2)
+#define WAVE_VELOCITY_FILTER    0.3     //weight of the newest velocity sample
+#define WAVE_FILTER_CUTOFF      30.0    //cut-off of the incoming wave filter (Hz)
+
+//one packet: the wave sent in one tick, sent as it is in memory, so it
+// has the same layout on Windows and Linux (int is 32 bits on both, long
+// isn't) and no byte left uninitialised
+struct WavePacket
+{
+    int sequence;           //increases by one every tick
+    int unused;             //(0: fills the sequence out to the doubles)
+    double wave[3];         //the wave variable (per axis)
+    double energySent;      //total wave energy sent so far (mJ)
+    double position[3];     //sender's position (used to line up on start)
+};
+
+//one direction of the loopback link (single producer, single consumer)
+struct WaveLoopbackQueue
+{
+    WavePacket packets[WAVE_LOOPBACK_CAPACITY];
+    double deliverAt[WAVE_LOOPBACK_CAPACITY];   //time each packet arrives
+    volatile long head;     //next slot to write
+    volatile long tail;     //next slot to read
+};
+
+//kinds of channel
+enum WaveChannelKind
+{
+    WAVE_CHANNEL_LOOPBACK = 0,
+    WAVE_CHANNEL_UDP
+};
+
+//one end of the link
+struct WaveChannel
+{
+    int kind;
+
+    //loopback: the queues are shared by the two ends
+    WaveLoopbackQueue* sendQueue;
+    WaveLoopbackQueue* receiveQueue;
+    double delay;           //one-way delay (s)
+    double jitter;          //extra random delay, 0..jitter (s)
+    unsigned int random;    //state of the jitter generator
+
+    //UDP
+    WaveSocket socket;
+    sockaddr_in peer;
+    bool hasPeer;           //false until the first packet (simulation side)
+
+    //sending
+    long sendSequence;
+    double energySent;
+
+    //receiving
+    bool hasReceived;           //a packet has arrived
+    long receiveSequence;       //newest packet accepted
+    WavePacket latest;          //newest packet accepted
+    double filtered[3];         //incoming wave after the low-pass filter
+    double energyReceived;      //wave energy taken out of the channel (mJ)
+    long packetsLost;           //sequence gaps seen
+    long wavesLimited;          //ticks the energy check scaled the wave down
+};
+
+
+//This procedure resets the bookkeeping shared by both kinds of channel.
+inline void waveChannelReset(WaveChannel& channel)
+{
+    channel.sendSequence = 0;
+    channel.energySent = 0;
+    channel.hasReceived = false;
+    channel.receiveSequence = -1;
+    memset(&channel.latest, 0, sizeof(channel.latest));
+    memset(channel.filtered, 0, sizeof(channel.filtered));
+    channel.energyReceived = 0;
+    channel.packetsLost = 0;
+    channel.wavesLimited = 0;
+}
+
+
+//This procedure sets up the two ends of an in-process loopback link with
+// the given one-way delay and jitter (in seconds).  "queues" must point
+// to two queues that outlive the link.
+inline void waveLoopbackOpen(WaveChannel& deviceEnd, WaveChannel& simulationEnd,
+                             WaveLoopbackQueue queues[2],
+                             double delay, double jitter)
+{
+    for (int q = 0; q < 2; q++)
+    {
+        queues[q].head = 0;
+        queues[q].tail = 0;
+    }
+
+    WaveChannel* ends[2] = { &deviceEnd, &simulationEnd };
+    for (int i = 0; i < 2; i++)
+    {
+        WaveChannel& channel = *ends[i];
+        channel.kind = WAVE_CHANNEL_LOOPBACK;
+        channel.sendQueue = &queues[i];
+        channel.receiveQueue = &queues[1 - i];
+        channel.delay = delay;
+        channel.jitter = jitter;
+        channel.random = 12345u + 977u*i;
+        channel.socket = WAVE_INVALID_SOCKET;
+        channel.hasPeer = true;
+        waveChannelReset(channel);
+    }
+}//END of waveLoopbackOpen
+
+
+//This function opens the UDP end of a link.  The simulation side passes
+// host == NULL and listens on "port"; the device side sends to host:port.
+// Returns false (with the reason on stderr) on failure.
+inline bool waveUdpOpen(WaveChannel& channel, const char* host, int port)
+{
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+    {
+        fprintf(stderr, "Failed to start Winsock\n");
+        return false;
+    }
+#endif
+    channel.kind = WAVE_CHANNEL_UDP;
+    channel.sendQueue = channel.receiveQueue = NULL;
+    channel.hasPeer = false;
+    waveChannelReset(channel);
+
+    channel.socket = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (channel.socket == WAVE_INVALID_SOCKET)
+    {
+        fprintf(stderr, "Failed to create the UDP socket\n");
+        return false;
+    }
+
+    //the servo thread must never block on the socket
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(channel.socket, FIONBIO, &nonBlocking);
+#else
+    fcntl(channel.socket, F_SETFL, fcntl(channel.socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    memset(&channel.peer, 0, sizeof(channel.peer));
+    if (host == NULL)
+    {   //simulation side: wait for the device side to talk first
+        sockaddr_in local;
+        memset(&local, 0, sizeof(local));
+        local.sin_family = AF_INET;
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        local.sin_port = htons((unsigned short)port);
+        if (bind(channel.socket, (sockaddr*)&local, sizeof(local)) != 0)
+        {
+            fprintf(stderr, "Failed to listen on UDP port %d\n", port);
+            return false;
+        }
+    }
+    else
+    {   //device side: talk to host:port
+        hostent* entry = gethostbyname(host);
+        if (entry == NULL)
+        {
+            fprintf(stderr, "Unknown host %s\n", host);
+            return false;
+        }
+        channel.peer.sin_family = AF_INET;
+        memcpy(&channel.peer.sin_addr, entry->h_addr, entry->h_length);
+        channel.peer.sin_port = htons((unsigned short)port);
+        channel.hasPeer = true;
+    }
+    return true;
+}//END of waveUdpOpen
+
+
+//This function returns a pseudo-random number in [0, 1) (jitter only).
+inline double waveRandom(WaveChannel& channel)
+{
+    channel.random = channel.random * 1103515245u + 12345u;
+    return ((channel.random >> 8) & 0xFFFF) / 65536.0;
+}
+
+
+//This procedure sends one wave.  "dt" is the tick the wave is held for.
+// It never blocks: a full queue or socket just loses the packet.
+inline void waveChannelSend(WaveChannel& channel, double now, double dt,
+                            const double wave[3], const double position[3])
+{
+    channel.energySent += 0.5 * (wave[0]*wave[0] + wave[1]*wave[1] + wave[2]*wave[2]) * dt;
+
+    WavePacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.sequence = (int)channel.sendSequence++;
+    packet.energySent = channel.energySent;
+    for (int i = 0; i < 3; i++)
+    {
+        packet.wave[i] = wave[i];
+        packet.position[i] = position[i];
+    }
+
+    if (channel.kind == WAVE_CHANNEL_LOOPBACK)
+    {
+        WaveLoopbackQueue& queue = *channel.sendQueue;
+        long head = queue.head;
+        if (head - servoLoadAcquire(&queue.tail) >= WAVE_LOOPBACK_CAPACITY)
+            return;
+        long slot = head & (WAVE_LOOPBACK_CAPACITY - 1);
+        queue.packets[slot] = packet;
+        //the link keeps the packets in order, so jitter shows up as
+        // bunching rather than reordering
+        queue.deliverAt[slot] = now + channel.delay + channel.jitter * waveRandom(channel);
+        servoStoreRelease(&queue.head, head + 1);
+    }
+    else if (channel.hasPeer)
+    {
+        sendto(channel.socket, (const char*)&packet, sizeof(packet), 0,
+               (const sockaddr*)&channel.peer, sizeof(channel.peer));
+    }
+}//END of waveChannelSend
+
+
+//This procedure takes every packet that has arrived and keeps the newest.
+inline void waveChannelPoll(WaveChannel& channel, double now)
+{
+    WavePacket packet;
+    for (;;)
+    {
+        if (channel.kind == WAVE_CHANNEL_LOOPBACK)
+        {
+            WaveLoopbackQueue& queue = *channel.receiveQueue;
+            long tail = queue.tail;
+            if (tail == servoLoadAcquire(&queue.head))
+                break;
+            long slot = tail & (WAVE_LOOPBACK_CAPACITY - 1);
+            if (queue.deliverAt[slot] > now)
+                break;      //still on its way
+            packet = queue.packets[slot];
+            servoStoreRelease(&queue.tail, tail + 1);
+        }
+        else
+        {
+            sockaddr_in from;
+#ifdef _WIN32
+            int fromLength = sizeof(from);
+#else
+            socklen_t fromLength = sizeof(from);
+#endif
+            int received = (int)recvfrom(channel.socket, (char*)&packet, sizeof(packet), 0,
+                                         (sockaddr*)&from, &fromLength);
+            if (received != (int)sizeof(packet))
+                break;
+            if (!channel.hasPeer)
+            {   //the simulation side answers whoever talks to it
+                channel.peer = from;
+                channel.hasPeer = true;
+            }
+        }
+
+        if (packet.sequence > channel.receiveSequence)
+        {
+            if (channel.hasReceived)
+                channel.packetsLost += packet.sequence - channel.receiveSequence - 1;
+            channel.receiveSequence = packet.sequence;
+            channel.latest = packet;
+            channel.hasReceived = true;
+        }
+    }
+}//END of waveChannelPoll
+
+
+//This procedure returns in "wave" the wave to use for this tick: the
+// newest one received, low-pass filtered, and scaled down if taking it
+// out of the channel for "dt" would return more energy than the other
+// side has sent.
+//The filter (gain never above one) damps the wave that would otherwise
+// bounce between the two ports every tick; the sampled ports are slightly
+// active at that frequency.
+inline void waveChannelReceive(WaveChannel& channel, double now, double dt, double wave[3])
+{
+    waveChannelPoll(channel, now);
+
+    double weight = dt / (dt + 1.0 / (2 * 3.14159265358979 * WAVE_FILTER_CUTOFF));
+    double energy = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        channel.filtered[i] += weight * (channel.latest.wave[i] - channel.filtered[i]);
+        wave[i] = channel.filtered[i];
+        energy += 0.5 * wave[i] * wave[i] * dt;
+    }
+
+    double budget = channel.latest.energySent - channel.energyReceived;
+    if (energy > budget)
+    {
+        double scale = (budget > 0) ? sqrt(budget / energy) : 0.0;
+        for (int i = 0; i < 3; i++)
+        {
+            wave[i] *= scale;
+            channel.filtered[i] = wave[i];
+        }
+        energy = (budget > 0) ? budget : 0.0;
+        channel.wavesLimited++;
+    }
+    channel.energyReceived += energy;
+}//END of waveChannelReceive
+
+
+
+//--------------------------------------------------------
+// *** The two ports of the coupling ***
+//--------------------------------------------------------
+
+//device side: turns the device motion into a wave and the returning wave
+// into the force felt by the user
+struct WaveMaster
+{
+    bool hasLast;
+    double lastPosition[3];
+    double lastTime;
+    double velocity[3];     //filtered device velocity (mm/s)
+};
+
+//simulation side: a proxy of the device in the virtual environment,
+// moved by the incoming wave and pushed back by the environment
+struct WaveSlave
+{
+    bool hasPosition;       //the proxy has been lined up with the device
+    double position[3];     //proxy position (mm)
+    double lastTime;
+};
+
+//the virtual environment: the force it applies at "position"
+typedef void (*WaveEnvironment)(const double position[3], double force[3]);
+
+
+//This procedure runs the device port for one servo tick: from the device
+// position it computes the force to send to the device and sends the
+// outgoing wave u = sqrt(2b) v_m - v over the channel.
+inline void waveMasterUpdate(WaveMaster& master, WaveChannel& channel, double now,
+                             const double position[3], double force[3])
+{
+    const double b = WAVE_IMPEDANCE;
+    const double root2b = sqrt(2*b);
+    int i;
+
+    double dt = master.hasLast ? now - master.lastTime : 0;
+    if (dt <= 0)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            master.lastPosition[i] = position[i];
+            master.velocity[i] = 0;
+            force[i] = 0;
+        }
+        master.lastTime = now;
+        master.hasLast = true;
+        return;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        double sample = (position[i] - master.lastPosition[i]) / dt;
+        master.velocity[i] += WAVE_VELOCITY_FILTER * (sample - master.velocity[i]);
+        master.lastPosition[i] = position[i];
+    }
+    master.lastTime = now;
+
+    double incoming[3], outgoing[3];
+    waveChannelReceive(channel, now, dt, incoming);
+    for (i = 0; i < 3; i++)
+    {
+        //force the channel puts on the user (before any packet arrives,
+        // the channel acts as a damper of impedance b)
+        force[i] = root2b*incoming[i] - b*master.velocity[i];
+        outgoing[i] = root2b*master.velocity[i] - incoming[i];
+    }
+    waveChannelSend(channel, now, dt, outgoing, position);
+}//END of waveMasterUpdate
+
+
+//This procedure runs the simulation port for one tick: the proxy follows
+// the incoming wave against the environment force, and the returning wave
+// is sent back.  Returns false until the device side has been heard from.
+inline bool waveSlaveUpdate(WaveSlave& slave, WaveChannel& channel, double now,
+                            WaveEnvironment environment)
+{
+    const double b = WAVE_IMPEDANCE;
+    const double root2b = sqrt(2*b);
+    int i;
+
+    waveChannelPoll(channel, now);
+    if (!channel.hasReceived)
+        return false;
+    if (!slave.hasPosition)
+    {   //start the proxy where the device was
+        for (i = 0; i < 3; i++)
+            slave.position[i] = channel.latest.position[i];
+        slave.lastTime = now;
+        slave.hasPosition = true;
+        return true;
+    }
+
+    double dt = now - slave.lastTime;
+    if (dt <= 0)
+        return true;
+    slave.lastTime = now;
+
+    double incoming[3], outgoing[3], envForce[3];
+    waveChannelReceive(channel, now, dt, incoming);
+    environment(slave.position, envForce);
+    for (i = 0; i < 3; i++)
+    {
+        //the proxy is massless: the channel pushes it with -envForce
+        double channelForce = -envForce[i];
+        double velocity = (root2b*incoming[i] - channelForce) / b;
+        outgoing[i] = (b*velocity - channelForce) / root2b;
+        slave.position[i] += velocity * dt;
+    }
+    waveChannelSend(channel, now, dt, outgoing, slave.position);
+    return true;
+}//END of waveSlaveUpdate
+
+#endif //WAVE_TELEOP_H